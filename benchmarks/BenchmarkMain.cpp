@@ -0,0 +1,24 @@
+#include <benchmark/benchmark.h>
+
+#include "Log.h"
+
+/**
+ *  Runs the simulator's benchmarks, see the Google Benchmark documentation for the options
+ *
+ *  Pass --benchmark_out=<file> --benchmark_out_format=json to keep the results for comparison between
+ *  releases, e.g. with compare.py from Google Benchmark, or build the run_benchmarks target to do so.
+ */
+
+int main(int argc, char **argv) {
+    // The simulator's messages would swamp the results, and cost time the benchmarks should not measure
+    Util::Log::SetLevel(Util::LogLevel::NONE);
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,158 @@
+#ifndef BenchmarkNetworks_H
+#define BenchmarkNetworks_H
+
+#include "RailNetwork.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace Benchmarks {
+
+    /**
+     *  The networks the benchmarks run on
+     *
+     *  A ladder is a number of rows, each a line of segments of varied lengths between a terminator at
+     *  each end. Every few segments a crossover segment leads up from one row on to the next, so a single
+     *  row is a line, a few rows a ladder and many rows a grid. Trains are placed on the rows heading up,
+     *  to the up terminator of their own row, so they never meet and never need a crossover.
+     */
+
+    // Segments between the crossovers from each row to the next
+    static const unsigned int CROSSOVER_SPACING = 4;
+
+    // Segments in each row of the ladders the simulation runs on, which bounds the ticks a run takes
+    static const unsigned int ROW_LENGTH = 64;
+
+    inline unsigned int GetSegmentLength(unsigned int row, unsigned int index) {
+        return 5 + (index * 7 + row * 3) % 16;
+    }
+
+    inline bool HasCrossover(unsigned int rows, unsigned int length, unsigned int row, unsigned int index) {
+        return row + 1 < rows && index + 1 < length && index % CROSSOVER_SPACING == 1;
+    }
+
+    inline std::string GetSegmentName(unsigned int row, unsigned int index) {
+        return "R" + std::to_string(row) + "S" + std::to_string(index);
+    }
+
+    inline std::string GetCrossoverName(unsigned int row, unsigned int index) {
+        return "R" + std::to_string(row) + "X" + std::to_string(index);
+    }
+
+    /**
+     *  Get the row and segment the given train of a ladder starts on. Trains are dealt out to the rows in
+     *  turn, each starting further down its row than the one before, so the segments must outnumber the
+     *  trains
+     */
+    inline void GetTrainStart(unsigned int rows, unsigned int length, unsigned int train,
+                              unsigned int& row, unsigned int& index) {
+        row = train % rows;
+        index = (train / rows) % length;
+    }
+
+    /**
+     *  A ladder built through the network building API
+     */
+    struct Ladder {
+        std::unique_ptr<Rail::RailNetwork> mNetwork;
+        std::vector<std::vector<Rail::ISegment*>> mRows;
+        std::vector<Rail::IConnector*> mUpTerminators;
+    };
+
+    inline Ladder BuildLadder(unsigned int rows, unsigned int length) {
+        Ladder ladder;
+        ladder.mNetwork.reset(new Rail::RailNetwork(new Rail::ComponentFactory()));
+        Rail::RailNetwork& network = *ladder.mNetwork;
+
+        ladder.mRows.resize(rows);
+        for(unsigned int r = 0; r < rows; r++) {
+            std::vector<Rail::ISegment*>& row = ladder.mRows[r];
+            row.push_back(network.CreateSegment(GetSegmentName(r, 0), GetSegmentLength(r, 0)));
+            for(unsigned int i = 1; i < length; i++) {
+                row.push_back(network.AttachSegment(row.back(), Rail::Direction::UP, GetSegmentName(r, i), GetSegmentLength(r, i)));
+            }
+
+            network.AddTerminator(row.front(), Rail::Direction::DOWN, "R" + std::to_string(r) + "Down");
+            ladder.mUpTerminators.push_back(network.AddTerminator(row.back(), Rail::Direction::UP, "R" + std::to_string(r) + "Up"));
+        }
+
+        // Crossovers are added once both rows exist, joining a junction on each
+        for(unsigned int r = 0; r < rows; r++) {
+            for(unsigned int i = 0; i < length; i++) {
+                if(HasCrossover(rows, length, r, i)) {
+                    Rail::ISegment* crossover = network.AttachSegment(ladder.mRows[r][i], Rail::Direction::UP,
+                                                                      GetCrossoverName(r, i), GetSegmentLength(r, i));
+                    network.ConnectSegments(crossover, Rail::Direction::UP, ladder.mRows[r + 1][i + 1], Rail::Direction::DOWN);
+                }
+            }
+        }
+
+        network.GetTopology();
+        return ladder;
+    }
+
+    /**
+     *  Get a path for a file a benchmark writes, unique to this process
+     */
+    inline std::string GetTemporaryPath(const std::string& name) {
+        return std::string(P_tmpdir) + "/TrainSimulatorBenchmark." + std::to_string(getpid()) + "." + name;
+    }
+
+    /**
+     *  Write the same ladder as BuildLadder() as a text network file, see Rail::TextNetworkLoader, with
+     *  the given number of trains
+     *
+     *  @return false if the file could not be written
+     */
+    inline bool WriteLadder(const std::string& path, unsigned int rows, unsigned int length, unsigned int trains) {
+        FILE* file = fopen(path.c_str(), "w");
+        if(file == nullptr) {
+            return false;
+        }
+
+        for(unsigned int r = 0; r < rows; r++) {
+            for(unsigned int i = 0; i < length; i++) {
+                fprintf(file, "segment %s %u\n", GetSegmentName(r, i).c_str(), GetSegmentLength(r, i));
+                if(i > 0) {
+                    fprintf(file, "connect %s up %s down\n", GetSegmentName(r, i - 1).c_str(), GetSegmentName(r, i).c_str());
+                }
+            }
+
+            fprintf(file, "terminator R%uDown %s down\n", r, GetSegmentName(r, 0).c_str());
+            fprintf(file, "terminator R%uUp %s up\n", r, GetSegmentName(r, length - 1).c_str());
+        }
+
+        for(unsigned int r = 0; r < rows; r++) {
+            for(unsigned int i = 0; i < length; i++) {
+                if(HasCrossover(rows, length, r, i)) {
+                    std::string crossover = GetCrossoverName(r, i);
+                    fprintf(file, "segment %s %u\n", crossover.c_str(), GetSegmentLength(r, i));
+                    fprintf(file, "connect %s up %s down\n", GetSegmentName(r, i).c_str(), crossover.c_str());
+                    fprintf(file, "connect %s up %s down\n", crossover.c_str(), GetSegmentName(r + 1, i + 1).c_str());
+                }
+            }
+        }
+
+        for(unsigned int t = 0; t < trains; t++) {
+            unsigned int row, index;
+            GetTrainStart(rows, length, t, row, index);
+            fprintf(file, "train T%u %s up R%uUp\n", t, GetSegmentName(row, index).c_str(), row);
+        }
+
+        bool written = !ferror(file);
+        return (fclose(file) == 0) && written;
+    }
+
+    /**
+     *  Split a number of segments into rows of the given length, keeping at least one row
+     */
+    inline unsigned int GetRowCount(unsigned int segments, unsigned int length) {
+        return (segments > length) ? segments / length : 1;
+    }
+
+}
+
+#endif
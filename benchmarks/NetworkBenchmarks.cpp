@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkNetworks.h"
+#include "NetworkLoader.h"
+#include "RailNetwork.h"
+
+#include <cstdio>
+
+/**
+ *  Building a network through the building API, and loading one from a text or network file
+ *
+ *  Arguments are the number of segments, in rows of ROW_LENGTH, and for text files the number of trains
+ */
+
+static void BM_BuildNetwork(benchmark::State& state) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    for(auto _ : state) {
+        Benchmarks::Ladder ladder = Benchmarks::BuildLadder(rows, Benchmarks::ROW_LENGTH);
+        benchmark::DoNotOptimize(ladder.mNetwork.get());
+
+        // Tearing the network down is not part of building it
+        state.PauseTiming();
+        ladder.mNetwork.reset();
+        state.ResumeTiming();
+    }
+
+    state.counters["segments"] = rows * Benchmarks::ROW_LENGTH;
+    state.SetItemsProcessed(state.iterations() * rows * Benchmarks::ROW_LENGTH);
+}
+BENCHMARK(BM_BuildNetwork)->ArgName("segments")->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17)->Unit(benchmark::kMillisecond);
+
+static void BM_LoadTextNetwork(benchmark::State& state) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    std::string path = Benchmarks::GetTemporaryPath("LoadTextNetwork.txt");
+    if(!Benchmarks::WriteLadder(path, rows, Benchmarks::ROW_LENGTH, state.range(1))) {
+        state.SkipWithError("Failed to write the network file");
+        return;
+    }
+
+    for(auto _ : state) {
+        Rail::RailNetwork* network = new Rail::RailNetwork(new Rail::ComponentFactory());
+        Rail::TextNetworkLoader loader(*network);
+        if(!loader.Load(path)) {
+            delete network;
+            state.SkipWithError("Failed to load the network file");
+            break;
+        }
+        network->GetTopology();
+
+        state.PauseTiming();
+        delete network;
+        state.ResumeTiming();
+    }
+
+    remove(path.c_str());
+    state.counters["segments"] = rows * Benchmarks::ROW_LENGTH;
+    state.counters["trains"] = state.range(1);
+}
+BENCHMARK(BM_LoadTextNetwork)->ArgNames({"segments", "trains"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {16, 1024}})->Unit(benchmark::kMillisecond);
+
+static void BM_LoadNetworkFile(benchmark::State& state) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    std::string path = Benchmarks::GetTemporaryPath("LoadNetworkFile.net");
+    if(!Benchmarks::BuildLadder(rows, Benchmarks::ROW_LENGTH).mNetwork->Save(path)) {
+        state.SkipWithError("Failed to save the network file");
+        return;
+    }
+
+    for(auto _ : state) {
+        Rail::RailNetwork* network = new Rail::RailNetwork(new Rail::ComponentFactory());
+        if(!network->Load(path)) {
+            delete network;
+            state.SkipWithError("Failed to load the network file");
+            break;
+        }
+        network->GetTopology();
+
+        state.PauseTiming();
+        delete network;
+        state.ResumeTiming();
+    }
+
+    remove(path.c_str());
+    state.counters["segments"] = rows * Benchmarks::ROW_LENGTH;
+}
+BENCHMARK(BM_LoadNetworkFile)->ArgName("segments")->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17)->Unit(benchmark::kMillisecond);
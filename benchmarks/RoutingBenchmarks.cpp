@@ -0,0 +1,179 @@
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkNetworks.h"
+#include "AltRoutingEngine.h"
+#include "ChRoutingEngine.h"
+#include "DjikstraRoutingEngine.h"
+#include "DjikstraTrafficController.h"
+#include "IncrementalRoutingEngine.h"
+#include "TrainPool.h"
+#include "TrainStore.h"
+
+#include <cmath>
+#include <vector>
+
+/**
+ *  Finding paths with each routing engine, switching connectors along a path, and the traffic
+ *  controller routing trains
+ *
+ *  Arguments are the number of segments, the number of trains, and for path finding the Shape of the
+ *  network, so that paths are found along a line as well as across a grid.
+ */
+
+// Each train starts on its own segment, see Benchmarks::GetTrainStart(), and heads for the up terminator
+// of its row or of a row above it
+static void getQuery(const Benchmarks::Ladder& ladder, const Rail::RailTopology& topology, unsigned int train,
+                     Rail::NodeId& start, Rail::ConnectorId& destination) {
+    unsigned int rows = ladder.mRows.size();
+    unsigned int row, index;
+    Benchmarks::GetTrainStart(rows, ladder.mRows[0].size(), train, row, index);
+
+    start = Rail::MakeNode(topology.LookupSegment(ladder.mRows[row][index]), Rail::Direction::UP);
+    destination = topology.LookupConnector(ladder.mUpTerminators[row + (train * 7) % (rows - row)]);
+}
+
+/**
+ *  The layouts paths are found on
+ *  LINE puts every segment in a single row
+ *  LADDER splits the segments between a few long rows
+ *  GRID has as many rows as segments in each
+ */
+typedef enum {
+    LINE,
+    LADDER,
+    GRID
+} Shape;
+
+static const unsigned int LADDER_ROWS = 8;
+
+static unsigned int getRowLength(unsigned int segments, Shape shape) {
+    switch(shape) {
+        case LADDER:
+            return segments / LADDER_ROWS;
+        case GRID:
+            return static_cast<unsigned int>(std::sqrt(segments));
+        default:
+            return segments;
+    }
+}
+
+template<typename Engine>
+static void BM_FindPath(benchmark::State& state) {
+    unsigned int length = getRowLength(state.range(0), static_cast<Shape>(state.range(2)));
+    Benchmarks::Ladder ladder = Benchmarks::BuildLadder(Benchmarks::GetRowCount(state.range(0), length), length);
+    const Rail::RailTopology& topology = ladder.mNetwork->GetTopology();
+
+    std::vector<std::pair<Rail::NodeId, Rail::ConnectorId>> queries(state.range(1));
+    for(unsigned int t = 0; t < queries.size(); t++) {
+        getQuery(ladder, topology, t, queries[t].first, queries[t].second);
+    }
+
+    // Preprocessing is done once per network, so is not part of each query
+    Engine engine;
+    engine.Prepare(topology);
+
+    for(auto _ : state) {
+        for(const auto& query : queries) {
+            Traffic::Path path = engine.FindPath(topology, query.first, query.second);
+            benchmark::DoNotOptimize(path.data());
+        }
+    }
+
+    const Traffic::RoutingStats& stats = engine.GetStats();
+    state.counters["nodes_per_query"] = stats.mQueries ? static_cast<double>(stats.mNodesExplored) / stats.mQueries : 0;
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+static void findPathArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"segments", "trains", "shape"});
+    for(int segments : {1 << 10, 1 << 14, 1 << 17}) {
+        for(int trains : {16, 256}) {
+            for(int shape : {LINE, LADDER, GRID}) {
+                benchmark->Args({segments, trains, shape});
+            }
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_FindPath, Traffic::DjikstraRoutingEngine)->Apply(findPathArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FindPath, Traffic::AltRoutingEngine)->Apply(findPathArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FindPath, Traffic::ChRoutingEngine)->Apply(findPathArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FindPath, Traffic::IncrementalRoutingEngine)->Apply(findPathArguments)->Unit(benchmark::kMicrosecond);
+
+static void BM_RouteSegment(benchmark::State& state) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    Benchmarks::Ladder ladder = Benchmarks::BuildLadder(rows, Benchmarks::ROW_LENGTH);
+    const Rail::RailTopology& topology = ladder.mNetwork->GetTopology();
+
+    // A path from the bottom of the first row to the top of the last, switching on to each row in turn
+    Traffic::DjikstraRoutingEngine engine;
+    Traffic::Path path = engine.FindPath(topology, Rail::MakeNode(topology.LookupSegment(ladder.mRows[0][0]), Rail::Direction::UP),
+                                         topology.LookupConnector(ladder.mUpTerminators.back()));
+    if(path.size() < 2) {
+        state.SkipWithError("No path through the network");
+        return;
+    }
+
+    for(auto _ : state) {
+        for(size_t i = 1; i < path.size(); i++) {
+            benchmark::DoNotOptimize(ladder.mNetwork->RouteSegment(topology.GetSegment(path[i - 1]),
+                                                                   topology.GetSegment(path[i])));
+        }
+    }
+
+    state.counters["path_length"] = path.size();
+    state.SetItemsProcessed(state.iterations() * (path.size() - 1));
+}
+BENCHMARK(BM_RouteSegment)->ArgName("segments")->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17)->Unit(benchmark::kMicrosecond);
+
+/**
+ *  Routes every train in one update, as the simulator does at the start of each tick
+ *
+ *  @param cached Whether the controller has already found each train's path, so that only the switching
+ *         is measured, or is new in each iteration so must find them
+ */
+static void updateRailNetwork(benchmark::State& state, bool cached) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    Benchmarks::Ladder ladder = Benchmarks::BuildLadder(rows, Benchmarks::ROW_LENGTH);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    for(unsigned int t = 0; t < state.range(1); t++) {
+        unsigned int row, index;
+        Benchmarks::GetTrainStart(rows, Benchmarks::ROW_LENGTH, t, row, index);
+        Train::Train* train = pool.Acquire("T" + std::to_string(t), ladder.mRows[row][index], Rail::Direction::UP);
+        train->SetDestination(ladder.mUpTerminators[row]);
+        trains.push_back(train);
+    }
+
+    Rail::NetworkState& networkState = ladder.mNetwork->GetState();
+    Traffic::DjikstraController* controller = new Traffic::DjikstraController();
+    if(cached) {
+        controller->UpdateRailNetwork(*ladder.mNetwork, networkState, trains);
+    }
+
+    for(auto _ : state) {
+        if(!cached) {
+            state.PauseTiming();
+            delete controller;
+            controller = new Traffic::DjikstraController();
+            state.ResumeTiming();
+        }
+
+        benchmark::DoNotOptimize(controller->UpdateRailNetwork(*ladder.mNetwork, networkState, trains));
+    }
+    delete controller;
+
+    state.SetItemsProcessed(state.iterations() * trains.size());
+}
+
+static void BM_UpdateRailNetwork(benchmark::State& state) {
+    updateRailNetwork(state, false);
+}
+BENCHMARK(BM_UpdateRailNetwork)->ArgNames({"segments", "trains"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {16, 256, 1024}})->Unit(benchmark::kMicrosecond);
+
+static void BM_UpdateRailNetworkCached(benchmark::State& state) {
+    updateRailNetwork(state, true);
+}
+BENCHMARK(BM_UpdateRailNetworkCached)->ArgNames({"segments", "trains"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {16, 256, 1024}})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,149 @@
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkNetworks.h"
+#include "OccupancyIndex.h"
+#include "TrainPool.h"
+#include "TrainSimulator.h"
+#include "TrainStore.h"
+
+#include <cstdio>
+#include <vector>
+
+/**
+ *  Running simulations to completion, and checking trains for collisions
+ *
+ *  Arguments are the number of segments, in rows of ROW_LENGTH, and the number of trains.
+ */
+
+static void runSimulation(benchmark::State& state, Train::Simulator::RunMode mode) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    std::string path = Benchmarks::GetTemporaryPath("SimulatorRun.txt");
+    if(!Benchmarks::WriteLadder(path, rows, Benchmarks::ROW_LENGTH, state.range(1))) {
+        state.SkipWithError("Failed to write the network file");
+        return;
+    }
+
+    uint64_t ticks = 0;
+    for(auto _ : state) {
+        // Each run needs a new simulation, which is not part of the tick loop
+        state.PauseTiming();
+        Train::Simulator* simulator = new Train::Simulator();
+        simulator->SetRunMode(mode);
+        simulator->SetRetainFinishedTrains(false);
+        if(!simulator->Build(path)) {
+            delete simulator;
+            state.SkipWithError("Failed to build the simulation");
+            break;
+        }
+        state.ResumeTiming();
+
+        simulator->Run();
+
+        state.PauseTiming();
+        ticks += simulator->GetTick();
+        delete simulator;
+        state.ResumeTiming();
+    }
+
+    remove(path.c_str());
+    state.counters["ticks"] = benchmark::Counter(ticks, benchmark::Counter::kAvgIterations);
+    state.counters["ticks_per_second"] = benchmark::Counter(ticks, benchmark::Counter::kIsRate);
+}
+
+static void BM_SimulatorRunTick(benchmark::State& state) {
+    runSimulation(state, Train::Simulator::RunMode::TICK);
+}
+BENCHMARK(BM_SimulatorRunTick)->ArgNames({"segments", "trains"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {16, 256, 1024}})->Unit(benchmark::kMillisecond);
+
+static void BM_SimulatorRunEvent(benchmark::State& state) {
+    runSimulation(state, Train::Simulator::RunMode::EVENT);
+}
+BENCHMARK(BM_SimulatorRunEvent)->ArgNames({"segments", "trains"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {16, 256, 1024}})->Unit(benchmark::kMillisecond);
+
+/**
+ *  Conducts every train once a tick, as the conduct phase of a tick does but without the collision checks,
+ *  either through the component interfaces with Train::Conduct(), or by component kind and id on the
+ *  topology with Train::Conduct(topology, state). Trains reaching their terminator start their row again
+ */
+static void BM_ConductTrains(benchmark::State& state) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    Benchmarks::Ladder ladder = Benchmarks::BuildLadder(rows, Benchmarks::ROW_LENGTH);
+    const Rail::RailTopology& topology = ladder.mNetwork->GetTopology();
+    const Rail::NetworkState& networkState = ladder.mNetwork->GetState();
+    const bool byKind = state.range(2) != 0;
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    std::vector<Train::Train::Snapshot> starts;
+    for(unsigned int t = 0; t < state.range(1); t++) {
+        unsigned int row, position;
+        Benchmarks::GetTrainStart(rows, Benchmarks::ROW_LENGTH, t, row, position);
+
+        Train::Train* train = pool.Acquire("T" + std::to_string(t), ladder.mRows[row][position], Rail::Direction::UP);
+        train->SetDestination(ladder.mUpTerminators[row]);
+        trains.push_back(train);
+        starts.push_back(train->Save());
+    }
+
+    for(auto _ : state) {
+        store.Advance();
+        for(size_t t = 0; t < trains.size(); t++) {
+            Train::Train* train = trains[t];
+            if(train->GetState() != Train::Train::State::RUNNING) {
+                train->Restore(starts[t]);
+            }
+
+            if(byKind) {
+                train->Conduct(topology, networkState);
+            } else {
+                train->Conduct();
+            }
+        }
+    }
+
+    state.counters["ticks_per_second"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations() * trains.size());
+}
+BENCHMARK(BM_ConductTrains)->ArgNames({"segments", "trains", "by_kind"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {256, 1024}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+/**
+ *  Checks every train for collisions as a tick does, with the trains spread over the segments at distinct
+ *  places so that none collide, and several on each segment once the trains outnumber the segments
+ */
+static void BM_CheckCollision(benchmark::State& state) {
+    unsigned int rows = Benchmarks::GetRowCount(state.range(0), Benchmarks::ROW_LENGTH);
+    Benchmarks::Ladder ladder = Benchmarks::BuildLadder(rows, Benchmarks::ROW_LENGTH);
+    unsigned int segments = rows * Benchmarks::ROW_LENGTH;
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    Train::OccupancyIndex index;
+    std::vector<Train::Train*> trains;
+    for(unsigned int t = 0; t < state.range(1); t++) {
+        unsigned int row, position;
+        Benchmarks::GetTrainStart(rows, Benchmarks::ROW_LENGTH, t % segments, row, position);
+        Rail::ISegment* segment = ladder.mRows[row][position];
+
+        Train::Train* train = pool.Acquire("T" + std::to_string(t), segment, Rail::Direction::UP);
+        Train::Train::Snapshot snapshot = train->Save();
+        snapshot.mSegmentIndex = (t / segments) % Benchmarks::GetSegmentLength(row, position);
+        snapshot.mPreviousSegmentIndex = snapshot.mSegmentIndex;
+        train->Restore(snapshot);
+
+        index.Insert(train);
+        trains.push_back(train);
+    }
+
+    for(auto _ : state) {
+        index.BeginTick();
+        for(auto train : trains) {
+            index.Update(train);
+            benchmark::DoNotOptimize(index.CheckCollision(train));
+        }
+    }
+
+    state.counters["trains_per_segment"] = static_cast<double>(trains.size()) / segments;
+    state.SetItemsProcessed(state.iterations() * trains.size());
+}
+BENCHMARK(BM_CheckCollision)->ArgNames({"segments", "trains"})->ArgsProduct({{1 << 10, 1 << 14, 1 << 17}, {16, 1024, 4096}})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,215 @@
+#include "AltRoutingEngine.h"
+#include "Log.h"
+
+using namespace Traffic;
+
+AltRoutingEngine::AltRoutingEngine(unsigned int landmarkCount) : mLandmarkCount(landmarkCount) {
+
+}
+
+AltRoutingEngine::~AltRoutingEngine() {
+
+}
+
+void AltRoutingEngine::Preprocess(const Rail::RailTopology& topology) {
+    const size_t nodeCount = topology.GetNodeCount();
+
+    auto table = std::make_shared<LandmarkTable>();
+    table->mTopology = &topology;
+    table->mTopologyVersion = topology.GetVersion();
+    table->mStride = std::min<size_t>(mLandmarkCount, nodeCount);
+    table->mFromLandmark.assign(nodeCount * table->mStride, UINT32_MAX);
+    table->mToLandmark.assign(nodeCount * table->mStride, UINT32_MAX);
+
+    const unsigned int stride = table->mStride;
+    std::vector<unsigned int> from(nodeCount);
+    std::vector<unsigned int> to(nodeCount);
+
+    // Landmarks are picked greedily, each as far as possible from those already picked.
+    // Unreachable nodes count as furthest away, so disconnected parts of the network are covered
+    std::vector<unsigned int> score(nodeCount, UINT32_MAX);
+
+    // Seed with the node furthest from an arbitrary node
+    Rail::NodeId next = (nodeCount > 0) ? 0 : Rail::INVALID_ID;
+    if(next != Rail::INVALID_ID) {
+        computeDistances(topology, 0, false, from);
+        for(Rail::NodeId n = 0; n < nodeCount; n++) {
+            if(from[n] != UINT32_MAX && from[n] > from[next]) {
+                next = n;
+            }
+        }
+    }
+
+    while(next != Rail::INVALID_ID && table->mLandmarks.size() < stride) {
+        const size_t l = table->mLandmarks.size();
+        table->mLandmarks.push_back(next);
+
+        computeDistances(topology, next, false, from);
+        computeDistances(topology, next, true, to);
+
+        next = Rail::INVALID_ID;
+        unsigned int furthest = 0;
+        for(Rail::NodeId n = 0; n < nodeCount; n++) {
+            table->mFromLandmark[n * stride + l] = from[n];
+            table->mToLandmark[n * stride + l] = to[n];
+
+            score[n] = std::min(score[n], std::min(from[n], to[n]));
+            if(score[n] > furthest) {
+                furthest = score[n];
+                next = n;
+            }
+        }
+    }
+
+    LOG_INFO(ROUTING, "Selected %zu landmarks for %zu nodes", table->mLandmarks.size(), nodeCount);
+    mTable = table;
+}
+
+void AltRoutingEngine::Prepare(const Rail::RailTopology& topology) {
+    if(!mTable || mTable->mTopology != &topology || mTable->mTopologyVersion != topology.GetVersion()) {
+        Preprocess(topology);
+    }
+}
+
+IRoutingEngine* AltRoutingEngine::Clone() const {
+    AltRoutingEngine* clone = new AltRoutingEngine(mLandmarkCount);
+    clone->mTable = mTable;
+    return clone;
+}
+
+Path AltRoutingEngine::FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination) {
+    Prepare(topology);
+
+    mStats.mQueries++;
+    mStats.mLastNodesExplored = 0;
+
+    auto attachments = topology.GetAttachments(destination);
+    mTargets.assign(attachments.begin(), attachments.end());
+
+    mSearch.Reset(topology.GetNodeCount());
+
+    unsigned int initialDistance = topology.GetLength(Rail::NodeSegment(start));
+    unsigned int initialBound = getLowerBound(start);
+    if(initialBound == UINT32_MAX) {
+        return Path();
+    }
+
+    mSearch.Update(start, initialDistance, Rail::INVALID_ID, initialDistance + initialBound);
+
+    // A* search, nodes are queued by their distance plus the lower bound to the destination.
+    // The bounds are consistent, so a node's distance is final when it is first popped
+    while(!mSearch.Empty()) {
+        Rail::NodeId next = mSearch.Pop().mVertex;
+        if(mSearch.IsSettled(next)) {
+            continue;
+        }
+
+        mSearch.Settle(next);
+        mStats.mLastNodesExplored++;
+        mStats.mNodesExplored++;
+
+        if(topology.GetEnd(next) == destination) {
+            return mSearch.BuildPath(topology, next);
+        }
+
+        unsigned int nextDistance = mSearch.GetDistance(next);
+        for(auto exploring : topology.GetSuccessors(next)) {
+            if(mSearch.IsSettled(exploring)) {
+                continue;
+            }
+
+            unsigned int distance = nextDistance + topology.GetLength(Rail::NodeSegment(exploring));
+            if(distance < mSearch.GetDistance(exploring)) {
+                unsigned int bound = getLowerBound(exploring);
+
+                // Prune nodes which cannot reach the destination at all
+                if(bound == UINT32_MAX) {
+                    continue;
+                }
+
+                mSearch.Update(exploring, distance, next, distance + bound);
+            }
+        }
+    }
+
+    return Path();
+}
+
+void AltRoutingEngine::computeDistances(const Rail::RailTopology& topology, Rail::NodeId landmark, bool reverse,
+                                        std::vector<unsigned int>& distances) {
+    const size_t nodeCount = topology.GetNodeCount();
+    mSearch.Reset(nodeCount);
+    mSearch.Update(landmark, 0, Rail::INVALID_ID, 0);
+
+    while(!mSearch.Empty()) {
+        Rail::NodeId next = mSearch.Pop().mVertex;
+        if(mSearch.IsSettled(next)) {
+            continue;
+        }
+
+        mSearch.Settle(next);
+        unsigned int nextDistance = mSearch.GetDistance(next);
+
+        if(!reverse) {
+            // An edge costs the length of the segment it leads on to
+            for(auto exploring : topology.GetSuccessors(next)) {
+                unsigned int distance = nextDistance + topology.GetLength(Rail::NodeSegment(exploring));
+                if(distance < mSearch.GetDistance(exploring)) {
+                    mSearch.Update(exploring, distance, next, distance);
+                }
+            }
+        } else {
+            // The topology is symmetric: p precedes n exactly when reverse(n) precedes reverse(p)
+            unsigned int distance = nextDistance + topology.GetLength(Rail::NodeSegment(next));
+            for(auto reversed : topology.GetSuccessors(Rail::ReverseNode(next))) {
+                Rail::NodeId exploring = Rail::ReverseNode(reversed);
+                if(distance < mSearch.GetDistance(exploring)) {
+                    mSearch.Update(exploring, distance, next, distance);
+                }
+            }
+        }
+    }
+
+    for(Rail::NodeId n = 0; n < nodeCount; n++) {
+        distances[n] = mSearch.GetDistance(n);
+    }
+}
+
+unsigned int AltRoutingEngine::getLowerBound(Rail::NodeId node) const {
+    const LandmarkTable& table = *mTable;
+    const unsigned int stride = table.mStride;
+    const unsigned int* fromNode = table.mFromLandmark.data() + node * stride;
+    const unsigned int* toNode = table.mToLandmark.data() + node * stride;
+
+    unsigned int best = UINT32_MAX;
+    for(auto target : mTargets) {
+        const unsigned int* fromTarget = table.mFromLandmark.data() + target * stride;
+        const unsigned int* toTarget = table.mToLandmark.data() + target * stride;
+
+        unsigned int bound = 0;
+        bool reachable = true;
+        for(unsigned int l = 0; l < stride && reachable; l++) {
+            // d(v, t) >= d(L, t) - d(L, v). If the landmark reaches v but not t, then v cannot reach t
+            if(fromTarget[l] == UINT32_MAX) {
+                reachable = (fromNode[l] == UINT32_MAX);
+            } else if(fromNode[l] != UINT32_MAX && fromTarget[l] > fromNode[l]) {
+                bound = std::max(bound, fromTarget[l] - fromNode[l]);
+            }
+
+            // d(v, t) >= d(v, L) - d(t, L). If t reaches the landmark but v does not, then v cannot reach t
+            if(toTarget[l] != UINT32_MAX) {
+                if(toNode[l] == UINT32_MAX) {
+                    reachable = false;
+                } else if(toNode[l] > toTarget[l]) {
+                    bound = std::max(bound, toNode[l] - toTarget[l]);
+                }
+            }
+        }
+
+        if(reachable) {
+            best = std::min(best, bound);
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,118 @@
+#include "ChRoutingEngine.h"
+
+using namespace Traffic;
+
+ChRoutingEngine::ChRoutingEngine() {
+
+}
+
+ChRoutingEngine::~ChRoutingEngine() {
+
+}
+
+void ChRoutingEngine::Preprocess(const Rail::RailTopology& topology) {
+    auto hierarchy = std::make_shared<ContractionHierarchy>();
+    hierarchy->Build(topology);
+    mHierarchy = hierarchy;
+}
+
+void ChRoutingEngine::Prepare(const Rail::RailTopology& topology) {
+    if(!mHierarchy || !mHierarchy->IsBuiltFor(topology)) {
+        Preprocess(topology);
+    }
+}
+
+IRoutingEngine* ChRoutingEngine::Clone() const {
+    ChRoutingEngine* clone = new ChRoutingEngine();
+    clone->mHierarchy = mHierarchy;
+    return clone;
+}
+
+Path ChRoutingEngine::FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination) {
+    Prepare(topology);
+    const ContractionHierarchy& hierarchy = *mHierarchy;
+
+    mStats.mQueries++;
+    mStats.mLastNodesExplored = 0;
+
+    // The forward search starts with the full length of the starting segment,
+    // the backward search starts from every node that ends at the destination
+    mForwardSearch.Reset(topology.GetNodeCount());
+    mBackwardSearch.Reset(topology.GetNodeCount());
+
+    unsigned int initialDistance = topology.GetLength(Rail::NodeSegment(start));
+    mForwardSearch.Update(start, initialDistance, Rail::INVALID_ID, initialDistance);
+    for(auto target : topology.GetAttachments(destination)) {
+        mBackwardSearch.Update(target, 0, Rail::INVALID_ID, 0);
+    }
+
+    unsigned int best = UINT32_MAX;
+    Rail::NodeId meeting = Rail::INVALID_ID;
+
+    // Alternate between the searches, always advancing the one with the closer frontier,
+    // until neither frontier can improve on the best path found
+    while(!mForwardSearch.Empty() || !mBackwardSearch.Empty()) {
+        unsigned int forwardMin = mForwardSearch.Empty() ? UINT32_MAX : mForwardSearch.TopPriority();
+        unsigned int backwardMin = mBackwardSearch.Empty() ? UINT32_MAX : mBackwardSearch.TopPriority();
+        if(std::min(forwardMin, backwardMin) >= best) {
+            break;
+        }
+
+        const bool forward = forwardMin <= backwardMin;
+        SearchSpace& search = forward ? mForwardSearch : mBackwardSearch;
+        const SearchSpace& other = forward ? mBackwardSearch : mForwardSearch;
+
+        Rail::NodeId next = search.Pop().mVertex;
+        if(search.IsSettled(next)) {
+            continue;
+        }
+
+        search.Settle(next);
+        mStats.mLastNodesExplored++;
+        mStats.mNodesExplored++;
+
+        unsigned int nextDistance = search.GetDistance(next);
+        if(other.GetDistance(next) != UINT32_MAX && nextDistance + other.GetDistance(next) < best) {
+            best = nextDistance + other.GetDistance(next);
+            meeting = next;
+        }
+
+        auto edges = forward ? hierarchy.GetUpEdges(next) : hierarchy.GetDownEdges(next);
+        for(auto& edge : edges) {
+            unsigned int distance = nextDistance + edge.mWeight;
+            if(distance < search.GetDistance(edge.mNode)) {
+                search.Update(edge.mNode, distance, next, distance);
+            }
+        }
+    }
+
+    if(meeting == Rail::INVALID_ID) {
+        return Path();
+    }
+
+    // Join the two halves into a path through the hierarchy
+    mHierarchyPath.clear();
+    for(Rail::NodeId node = meeting; node != Rail::INVALID_ID; node = mForwardSearch.GetPredecessor(node)) {
+        mHierarchyPath.push_back(node);
+    }
+    std::reverse(mHierarchyPath.begin(), mHierarchyPath.end());
+
+    for(Rail::NodeId node = mBackwardSearch.GetPredecessor(meeting); node != Rail::INVALID_ID;
+            node = mBackwardSearch.GetPredecessor(node)) {
+        mHierarchyPath.push_back(node);
+    }
+
+    // Then expand the shortcuts back into the original nodes
+    mNodePath.clear();
+    mNodePath.push_back(mHierarchyPath.front());
+    for(size_t i = 0; i + 1 < mHierarchyPath.size(); i++) {
+        hierarchy.Unpack(mHierarchyPath[i], mHierarchyPath[i + 1], mNodePath);
+    }
+
+    Path path(mNodePath.size());
+    for(size_t i = 0; i < mNodePath.size(); i++) {
+        path[i] = Rail::NodeSegment(mNodePath[i]);
+    }
+
+    return path;
+}
@@ -0,0 +1,247 @@
+#include "ContractionHierarchy.h"
+#include "Log.h"
+
+#include <functional>
+#include <queue>
+
+using namespace Traffic;
+
+// Witness searches give up after settling this many nodes. Giving up early only adds shortcuts
+// that were not strictly needed, it never loses a shortest path. Priority estimates are
+// recomputed often, so they use a cheaper search than the contraction itself
+static const unsigned int CONTRACT_SETTLE_LIMIT = 256;
+static const unsigned int ESTIMATE_SETTLE_LIMIT = 32;
+
+ContractionHierarchy::ContractionHierarchy() {
+
+}
+
+ContractionHierarchy::~ContractionHierarchy() {
+
+}
+
+void ContractionHierarchy::Build(const Rail::RailTopology& topology) {
+    const size_t nodeCount = topology.GetNodeCount();
+
+    // Start from the original topology
+    mOutEdges.assign(nodeCount, std::vector<Edge>());
+    mInEdges.assign(nodeCount, std::vector<Edge>());
+    for(Rail::NodeId n = 0; n < nodeCount; n++) {
+        for(auto m : topology.GetSuccessors(n)) {
+            addEdge(n, m, topology.GetLength(Rail::NodeSegment(m)), Rail::INVALID_ID);
+        }
+    }
+
+    mRanks.assign(nodeCount, Rail::INVALID_ID);
+    mContractedNeighbours.assign(nodeCount, 0);
+    mTargetStamps.assign(nodeCount, 0);
+    mSearchStamp = 0;
+
+    // Edges are moved into the hierarchy as each node is contracted
+    std::vector<std::vector<Edge>> upEdges(nodeCount);
+    std::vector<std::vector<Edge>> downEdges(nodeCount);
+    mShortcutCount = 0;
+
+    using Candidate = std::pair<int, Rail::NodeId>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> order;
+    for(Rail::NodeId n = 0; n < nodeCount; n++) {
+        order.push(Candidate(getPriority(n), n));
+    }
+
+    uint32_t rank = 0;
+    while(!order.empty()) {
+        Rail::NodeId v = order.top().second;
+        order.pop();
+
+        if(mRanks[v] != Rail::INVALID_ID) {
+            continue;
+        }
+
+        // Priorities go stale as neighbours are contracted, so recheck lazily before contracting
+        int priority = getPriority(v);
+        if(!order.empty() && priority > order.top().first) {
+            order.push(Candidate(priority, v));
+            continue;
+        }
+
+        findShortcuts(v, mShortcuts, CONTRACT_SETTLE_LIMIT);
+        mRanks[v] = rank++;
+
+        // Every remaining edge of v leads to a node that will be contracted later, i.e. ranked higher
+        upEdges[v].swap(mOutEdges[v]);
+        downEdges[v].swap(mInEdges[v]);
+
+        for(auto& edge : upEdges[v]) {
+            auto& in = mInEdges[edge.mNode];
+            in.erase(std::remove_if(in.begin(), in.end(), [v](const Edge& e) { return e.mNode == v; }), in.end());
+            mContractedNeighbours[edge.mNode]++;
+        }
+
+        for(auto& edge : downEdges[v]) {
+            auto& out = mOutEdges[edge.mNode];
+            out.erase(std::remove_if(out.begin(), out.end(), [v](const Edge& e) { return e.mNode == v; }), out.end());
+            mContractedNeighbours[edge.mNode]++;
+        }
+
+        for(auto& shortcut : mShortcuts) {
+            addEdge(shortcut.mMiddle, shortcut.mNode, shortcut.mWeight, v);
+        }
+        mShortcutCount += mShortcuts.size();
+    }
+
+    // Flatten the hierarchy
+    mUpOffsets.assign(nodeCount + 1, 0);
+    mDownOffsets.assign(nodeCount + 1, 0);
+    mUpEdges.clear();
+    mDownEdges.clear();
+    for(Rail::NodeId n = 0; n < nodeCount; n++) {
+        mUpOffsets[n] = mUpEdges.size();
+        mUpEdges.insert(mUpEdges.end(), upEdges[n].begin(), upEdges[n].end());
+        mDownOffsets[n] = mDownEdges.size();
+        mDownEdges.insert(mDownEdges.end(), downEdges[n].begin(), downEdges[n].end());
+    }
+    mUpOffsets[nodeCount] = mUpEdges.size();
+    mDownOffsets[nodeCount] = mDownEdges.size();
+
+    // Release the build graph
+    std::vector<std::vector<Edge>>().swap(mOutEdges);
+    std::vector<std::vector<Edge>>().swap(mInEdges);
+    std::vector<unsigned int>().swap(mContractedNeighbours);
+    std::vector<uint32_t>().swap(mTargetStamps);
+
+    mTopology = &topology;
+    mTopologyVersion = topology.GetVersion();
+
+    LOG_INFO(ROUTING, "Contraction hierarchy built for %zu nodes with %zu shortcuts", nodeCount, mShortcutCount);
+}
+
+void ContractionHierarchy::Unpack(Rail::NodeId from, Rail::NodeId to, std::vector<Rail::NodeId>& nodes) const {
+    const Edge* edge = findEdge(from, to);
+    if(edge == nullptr || edge->mMiddle == Rail::INVALID_ID) {
+        nodes.push_back(to);
+        return;
+    }
+
+    Unpack(from, edge->mMiddle, nodes);
+    Unpack(edge->mMiddle, to, nodes);
+}
+
+void ContractionHierarchy::findShortcuts(Rail::NodeId v, std::vector<Edge>& shortcuts, unsigned int settleLimit) {
+    shortcuts.clear();
+
+    // Mark the targets, so each witness search can stop once they have all been settled
+    mSearchStamp++;
+    for(auto& out : mOutEdges[v]) {
+        mTargetStamps[out.mNode] = mSearchStamp;
+    }
+
+    for(auto& in : mInEdges[v]) {
+        const Rail::NodeId u = in.mNode;
+
+        // Zero length segments can make every path through v weigh nothing, so only skip u when there is nowhere
+        // to go from it through v
+        bool hasTarget = false;
+        unsigned int maxDistance = 0;
+        for(auto& out : mOutEdges[v]) {
+            if(out.mNode != u) {
+                hasTarget = true;
+                maxDistance = std::max(maxDistance, in.mWeight + out.mWeight);
+            }
+        }
+
+        if(!hasTarget) {
+            continue;
+        }
+
+        // Search for witness paths from u that avoid v, up to the longest path through v
+        mWitnessSearch.Reset(mOutEdges.size());
+        mWitnessSearch.Update(u, 0, Rail::INVALID_ID, 0);
+
+        unsigned int settled = 0;
+        size_t remaining = mOutEdges[v].size();
+        while(!mWitnessSearch.Empty() && settled < settleLimit && remaining > 0) {
+            Rail::NodeId next = mWitnessSearch.Pop().mVertex;
+            if(mWitnessSearch.IsSettled(next)) {
+                continue;
+            }
+
+            mWitnessSearch.Settle(next);
+            settled++;
+            if(mTargetStamps[next] == mSearchStamp) {
+                remaining--;
+            }
+
+            unsigned int nextDistance = mWitnessSearch.GetDistance(next);
+            if(nextDistance > maxDistance) {
+                break;
+            }
+
+            for(auto& edge : mOutEdges[next]) {
+                unsigned int distance = nextDistance + edge.mWeight;
+                if(edge.mNode != v && distance < mWitnessSearch.GetDistance(edge.mNode)) {
+                    mWitnessSearch.Update(edge.mNode, distance, next, distance);
+                }
+            }
+        }
+
+        // Any target without a path at least as short as the one through v needs a shortcut
+        for(auto& out : mOutEdges[v]) {
+            unsigned int viaDistance = in.mWeight + out.mWeight;
+            if(out.mNode != u && mWitnessSearch.GetDistance(out.mNode) > viaDistance) {
+                shortcuts.push_back(Edge {out.mNode, viaDistance, u});
+            }
+        }
+    }
+}
+
+int ContractionHierarchy::getPriority(Rail::NodeId v) {
+    findShortcuts(v, mShortcuts, ESTIMATE_SETTLE_LIMIT);
+
+    // Edge difference, plus a term which spreads contraction evenly across the network
+    int removed = mInEdges[v].size() + mOutEdges[v].size();
+    return static_cast<int>(mShortcuts.size()) - removed + static_cast<int>(mContractedNeighbours[v]);
+}
+
+void ContractionHierarchy::addEdge(Rail::NodeId from, Rail::NodeId to, unsigned int weight, Rail::NodeId middle) {
+    for(auto& out : mOutEdges[from]) {
+        if(out.mNode != to) {
+            continue;
+        }
+
+        // Only keep the shortest edge between any two nodes
+        if(weight < out.mWeight) {
+            out.mWeight = weight;
+            out.mMiddle = middle;
+
+            for(auto& in : mInEdges[to]) {
+                if(in.mNode == from) {
+                    in.mWeight = weight;
+                    in.mMiddle = middle;
+                }
+            }
+        }
+        return;
+    }
+
+    mOutEdges[from].push_back(Edge {to, weight, middle});
+    mInEdges[to].push_back(Edge {from, weight, middle});
+}
+
+const ContractionHierarchy::Edge* ContractionHierarchy::findEdge(Rail::NodeId from, Rail::NodeId to) const {
+    // Edges are stored with the lower ranked of their two nodes
+    if(mRanks[to] > mRanks[from]) {
+        for(auto& edge : GetUpEdges(from)) {
+            if(edge.mNode == to) {
+                return &edge;
+            }
+        }
+    } else {
+        for(auto& edge : GetDownEdges(to)) {
+            if(edge.mNode == from) {
+                return &edge;
+            }
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,70 @@
+#include "DjikstraRoutingEngine.h"
+#include "Log.h"
+
+using namespace Traffic;
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
+// The name of a segment for tracing, which a network loaded in part may not have created
+static const char* getSegmentName(const Rail::RailTopology& topology, Rail::NodeId node) {
+    const Rail::ISegment* segment = topology.GetSegment(Rail::NodeSegment(node));
+    return (segment != nullptr) ? segment->GetName() : "(not created)";
+}
+#endif
+
+DjikstraRoutingEngine::DjikstraRoutingEngine() {
+
+}
+
+DjikstraRoutingEngine::~DjikstraRoutingEngine() {
+
+}
+
+Path DjikstraRoutingEngine::FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination) {
+    mStats.mQueries++;
+    mStats.mLastNodesExplored = 0;
+
+    // For Djikstras we track the shortest distance and predecessor of each node,
+    // and a priority queue of nodes to explore
+    mSearch.Reset(topology.GetNodeCount());
+
+    // Initialize the search with the full length of the starting segment
+    unsigned int initialDistance = topology.GetLength(Rail::NodeSegment(start));
+    mSearch.Update(start, initialDistance, Rail::INVALID_ID, initialDistance);
+
+    // Now begin iterating through the priority queue of nodes to explore
+    while(!mSearch.Empty()) {
+        // Pop the top of the queue, skipping nodes that were queued again with a shorter distance
+        Rail::NodeId next = mSearch.Pop().mVertex;
+        if(mSearch.IsSettled(next)) {
+            continue;
+        }
+
+        mSearch.Settle(next);
+        mStats.mLastNodesExplored++;
+        mStats.mNodesExplored++;
+
+        // If we have our destination at the top of our queue, we have found the shortest path
+        if(topology.GetEnd(next) == destination) {
+            return mSearch.BuildPath(topology, next);
+        }
+
+        // Otherwise loop over all the next segments and relax them
+        LOG_TRACE(ROUTING, "Exploring from %s", getSegmentName(topology, next));
+
+        unsigned int nextDistance = mSearch.GetDistance(next);
+        for(auto exploring : topology.GetSuccessors(next)) {
+            unsigned int distance = nextDistance + topology.GetLength(Rail::NodeSegment(exploring));
+
+            // If the newly explored distance is longer than one we have already found
+            // we don't need to explore this node again
+            if(distance < mSearch.GetDistance(exploring)) {
+                mSearch.Update(exploring, distance, next, distance);
+                LOG_TRACE(ROUTING, "Found a shorter path to %s", getSegmentName(topology, exploring));
+            } else {
+                LOG_TRACE(ROUTING, "We already have a shorter path to %s", getSegmentName(topology, exploring));
+            }
+        }
+    }
+
+    return Path();
+}
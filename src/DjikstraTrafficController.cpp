@@ -1,113 +1,485 @@
 #include "DjikstraTrafficController.h"
+#include "DjikstraRoutingEngine.h"
+#include "AltRoutingEngine.h"
+#include "ChRoutingEngine.h"
+#include "IncrementalRoutingEngine.h"
+#include "Log.h"
 
-#include <queue>
+#include <algorithm>
 
 using namespace Traffic;
 
-DjikstraController::DjikstraController() {
+DjikstraController::DjikstraController(RoutingMode mode, unsigned int threadCount) {
+    switch(mode) {
+        case RoutingMode::ALT:
+            mRoutingEngine = new AltRoutingEngine();
+            break;
+        case RoutingMode::CONTRACTION_HIERARCHY:
+            mRoutingEngine = new ChRoutingEngine();
+            break;
+        case RoutingMode::INCREMENTAL:
+            mRoutingEngine = new IncrementalRoutingEngine();
+            break;
+        case RoutingMode::DJIKSTRA:
+        default:
+            mRoutingEngine = new DjikstraRoutingEngine();
+            break;
+    }
 
+    SetThreadCount(threadCount);
 }
 
 DjikstraController::~DjikstraController() {
+    SetThreadCount(1);
+    delete mRoutingEngine;
+}
+
+void DjikstraController::SetThreadCount(unsigned int threadCount) {
+    delete mThreadPool;
+    mThreadPool = nullptr;
+
+    for(auto engine : mWorkerEngines) {
+        delete engine;
+    }
+    mWorkerEngines.clear();
+    mWorkerTopology = nullptr;
 
+    if(threadCount > 1) {
+        mThreadPool = new Util::ThreadPool(threadCount);
+    }
 }
 
-void DjikstraController::UpdateRailNetwork(Rail::RailNetwork& network, const std::vector<Train::Train *>& trains) {
-    for(auto train : trains) {
-        if(setPath(network, getPath(train))) {
-            return;
-        } else {
-            printf("WARNING Failed to set optimal path for train %s\n", train->GetName());
+bool DjikstraController::UpdateRailNetwork(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                           const std::vector<Train::Train *>& trains) {
+    mUnroutableTrains.clear();
+    syncNetworkState(network.GetTopology(), state);
+    syncNetworkChanges(network);
+
+    if(mThreadPool != nullptr) {
+        findMissingPaths(network, trains);
+    }
+
+    // Switch the connector ahead of every train in one pass, with the claims of this update resolving
+    // any contention between them
+    const Rail::RailTopology& topology = network.GetTopology();
+    mUpdateCount++;
+    mAllRouted = true;
+    for(size_t i = 0; i < trains.size(); i++) {
+        Train::Train* train = trains[i];
+        setLogKey(i);
+
+        const Path* path = getPath(network, train);
+        const Rail::SegmentId current = topology.LookupSegment(train->GetCurrentComponent());
+        if(path != nullptr && std::find(path->begin(), path->end(), current) == path->end()) {
+            // The train has been sent off its path, so needs a new one from where it is now
+            mPathCache.Erase(train);
+            path = getPath(network, train);
+        }
+
+        if(path == nullptr) {
+            LOG_WARNING(ROUTING, "Failed to set optimal path for train %s", train->GetName());
+            recordEvent(Util::EventLogger::PATH_NOT_SET, train);
+            mAllRouted = false;
+        } else if(!setNextStep(network, state, train, *path)) {
+            recordEvent(Util::EventLogger::PATH_NOT_SET, train);
+            mAllRouted = false;
+        }
+    }
+
+    return mAllRouted;
+}
+
+void DjikstraController::ApplyClaims(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                     const std::vector<ConnectorClaim>& claims) {
+    mUpdateCount++;
+    mAllRouted = true;
+    for(size_t i = 0; i < claims.size(); i++) {
+        setLogKey(i);
+        claimConnector(network, state, claims[i]);
+    }
+}
+
+void DjikstraController::RemoveTrain(Train::Train* train) {
+    // The train's address may be reused by a new train, which must not inherit its path
+    mPathCache.Erase(train);
+    mUnroutableTrains.erase(train);
+}
+
+void DjikstraController::SaveState(Util::BinaryWriter& writer, Rail::RailNetwork& network,
+                                   const std::unordered_map<const Train::Train*, uint32_t>& trainIds) {
+    // Drop the paths the network or its state has changed under, so those saved suit the network as it stands
+    if(mNetworkState != nullptr) {
+        syncNetworkState(network.GetTopology(), *mNetworkState);
+    }
+    syncNetworkChanges(network);
+
+    // Save the cached paths in train order, so the same simulation always makes the same checkpoint
+    std::vector<std::pair<uint32_t, const Path*>> paths;
+    mPathCache.ForEach([&](Train::Train* train, const Path& path) {
+        auto id = trainIds.find(train);
+        if(id != trainIds.end()) {
+            paths.push_back(std::make_pair(id->second, &path));
+        }
+    });
+    std::sort(paths.begin(), paths.end());
+
+    writer.Write<uint32_t>(paths.size());
+    for(const auto& entry : paths) {
+        writer.Write<uint32_t>(entry.first);
+        writer.Write<uint32_t>(entry.second->size());
+        for(auto segment : *entry.second) {
+            writer.Write<uint32_t>(segment);
         }
     }
 }
 
+bool DjikstraController::RestoreState(Util::BinaryReader& reader, Rail::RailNetwork& network,
+                                      const std::vector<Train::Train*>& trains) {
+    const Rail::RailTopology& topology = network.GetTopology();
+
+    // Read every path before caching any, so that a damaged state leaves the controller unchanged
+    std::vector<std::pair<Train::Train*, Path>> paths;
+    uint32_t count = 0;
+    reader.Read(count);
+    for(uint32_t i = 0; i < count && !reader.IsFailed(); i++) {
+        uint32_t trainId = 0;
+        uint32_t length = 0;
+        reader.Read(trainId);
+        reader.Read(length);
+
+        Path path;
+        for(uint32_t s = 0; s < length && !reader.IsFailed(); s++) {
+            Rail::SegmentId segment = Rail::INVALID_ID;
+            reader.Read(segment);
+            if(segment >= topology.GetSegmentCount()) {
+                return false;
+            }
+            path.push_back(segment);
+        }
+
+        if(trainId >= trains.size()) {
+            return false;
+        }
+
+        paths.push_back(std::make_pair(trains[trainId], std::move(path)));
+    }
+
+    if(reader.IsFailed()) {
+        return false;
+    }
+
+    // The restored paths suit the network as it stands. Those already cached may not, so are brought up to
+    // date with it first rather than taken to be
+    syncNetworkChanges(network);
+    for(auto& entry : paths) {
+        mPathCache.Insert(entry.first, std::move(entry.second));
+    }
+
+    return true;
+}
 
-Path DjikstraController::getPath(Train::Train* train) {
+const Path* DjikstraController::getPath(Rail::RailNetwork& network, Train::Train* train) {
     // Check if we have a cached path for this train
-    if(mShortestPaths.count(train)) {
-        return mShortestPaths.at(train);
+    const Path* cachedPath = mPathCache.Find(train);
+    if(cachedPath != nullptr) {
+        if(mProfiler != nullptr) {
+            mProfiler->Count(Util::Profiler::CACHE_HITS);
+        }
+        return cachedPath;
     }
 
-    Path shortestPath = findShortestPath(train);
-    if(!shortestPath.empty()) {
-        mShortestPaths[train] = shortestPath;
-    } else {
-        printf("WARNING Could not find shortest path for Train %s\n", train->GetName());
+    if(mUnroutableTrains.count(train)) {
+        return nullptr;
     }
 
-    return shortestPath;
+    const Rail::RailTopology& topology = network.GetTopology();
+    unsigned int nodesExplored = 0;
+    uint64_t start = Util::Profiler::Now();
+    Path shortestPath = findShortestPath(*mRoutingEngine, topology, train, nodesExplored);
+    recordQuery(nodesExplored, Util::Profiler::Now() - start);
+    mPathCache.RecordMiss();
+
+    if(shortestPath.empty()) {
+        LOG_WARNING(ROUTING, "Could not find shortest path for Train %s", train->GetName());
+        recordEvent(Util::EventLogger::NO_PATH, train);
+        mUnroutableTrains.insert(train);
+        return nullptr;
+    }
+
+    recordEvent(Util::EventLogger::PATH_FOUND, train, nodesExplored);
+    return mPathCache.Insert(train, std::move(shortestPath));
 }
 
-Path DjikstraController::findShortestPath(Train::Train* train) {
-    // For Djikstras we track a map of visited nodes, and a priority queue of routes to explore
-    std::map<Rail::IConnector*, unsigned int> visitedNodes;
-    std::priority_queue<PriorityPath, std::vector<PriorityPath>, PriorityPath::CompareFn> priorityPathQueue(PriorityPath::Compare);
-    
-    // Initialize the visited nodes list and priority queue with 
-    // the starting data based off the train's location
-    auto initialSegment = dynamic_cast<const Rail::ISegment*>(train->GetCurrentComponent());
+void DjikstraController::findMissingPaths(Rail::RailNetwork& network, const std::vector<Train::Train *>& trains) {
+    mBatchTrains.clear();
+    for(auto train : trains) {
+        if(!mPathCache.Contains(train)) {
+            mBatchTrains.push_back(train);
+        }
+    }
 
-    unsigned int currentDistance = train->GetCurrentComponent()->GetLength();
-    Path currentPath = Path {initialSegment};
-    Rail::IConnector* currentVertex = initialSegment->GetNext(train->GetDirection());
+    if(mBatchTrains.empty()) {
+        return;
+    }
 
-    visitedNodes[currentVertex] = currentDistance;
-    priorityPathQueue.push(PriorityPath(currentDistance, currentPath, currentVertex));
+    // Preprocessing is done once, up front, and shared read only with the worker engines
+    const Rail::RailTopology& topology = network.GetTopology();
+    mRoutingEngine->Prepare(topology);
 
-    // Now begin iterating through the priority queue of routes to explore
-    while(!priorityPathQueue.empty()) {
-        // Pop the top of the queue
-        PriorityPath next = priorityPathQueue.top();
-        priorityPathQueue.pop();
+    if(mWorkerTopology != &topology || mWorkerTopologyVersion != topology.GetVersion()) {
+        for(auto engine : mWorkerEngines) {
+            delete engine;
+        }
+        mWorkerEngines.clear();
 
-        // If we have our destination at the top of our queue, we have found the shortest path
-        if(next.GetVertex() == train->GetDestination()) {
-            printf("INFO Path found for Train %s\n", train->GetName());
-            return next.GetPath();
+        for(unsigned int worker = 1; worker < mThreadPool->GetThreadCount(); worker++) {
+            mWorkerEngines.push_back(mRoutingEngine->Clone());
         }
 
-        // Otherwise loop over all the next segments and add new Paths for them
-        printf("INFO Exploring from %s for Train %s\n", next.GetPath().back()->GetName(), train->GetName());
+        mWorkerTopology = &topology;
+        mWorkerTopologyVersion = topology.GetVersion();
+    }
 
-        auto nextSegments = next.GetVertex()->GetNext(next.GetPath().back());
-        for(auto& exploring : nextSegments) {
-            // Update the current info according to the explored segment
-            currentDistance = next.GetDistance() + exploring->GetLength();
-            currentPath = next.GetPath();
-            currentPath.push_back(exploring);
-            currentVertex = exploring->GetNext(train->GetDirection());
+    mBatchPaths.assign(mBatchTrains.size(), Path());
+    mBatchNodesExplored.assign(mBatchTrains.size(), 0);
+    mBatchQueryTimes.assign(mBatchTrains.size(), 0);
 
-            // Add the explored vertex to our visited nodes if it has not been found
-            if(!visitedNodes.count(currentVertex)) {
-                visitedNodes[currentVertex] = UINT32_MAX;
-            }
+    mThreadPool->ParallelFor(mBatchTrains.size(), [&](size_t i, unsigned int worker) {
+        IRoutingEngine& engine = (worker == 0) ? *mRoutingEngine : *mWorkerEngines[worker - 1];
+        uint64_t start = Util::Profiler::Now();
+        mBatchPaths[i] = findShortestPath(engine, topology, mBatchTrains[i], mBatchNodesExplored[i]);
+        mBatchQueryTimes[i] = Util::Profiler::Now() - start;
+    });
 
-            // If this vertex is in the set of visited nodes
-            // and the newly explored distance is longer  we don't need to add this new path
-            if(currentDistance < visitedNodes[currentVertex]) {
-                priorityPathQueue.push(PriorityPath(currentDistance, currentPath, currentVertex));
-                visitedNodes[currentVertex] = currentDistance;
-                printf("INFO Found a shorter path to %s for Train %s\n", 
-                        currentVertex->GetName(), train->GetName());
-            } else {
-                printf("INFO We already have a shorter path to %s for Train %s\n", 
-                        currentVertex->GetName(), train->GetName());
-            }
+    // Merge the results in train order
+    for(size_t i = 0; i < mBatchTrains.size(); i++) {
+        recordQuery(mBatchNodesExplored[i], mBatchQueryTimes[i]);
+        mPathCache.RecordMiss();
+
+        if(!mBatchPaths[i].empty()) {
+            mPathCache.Insert(mBatchTrains[i], std::move(mBatchPaths[i]));
+            recordEvent(Util::EventLogger::PATH_FOUND, mBatchTrains[i], mBatchNodesExplored[i]);
+        } else {
+            LOG_WARNING(ROUTING, "Could not find shortest path for Train %s", mBatchTrains[i]->GetName());
+            recordEvent(Util::EventLogger::NO_PATH, mBatchTrains[i]);
+            mUnroutableTrains.insert(mBatchTrains[i]);
+        }
+    }
+}
+
+void DjikstraController::syncNetworkChanges(Rail::RailNetwork& network) {
+    if(network.GetEpoch() == mNetworkEpoch) {
+        return;
+    }
+
+    mChangedSegments.clear();
+    bool kept = network.GetChangedSegments(mNetworkEpoch, mChangedSegments);
+    applyChanges(network.GetTopology(), kept);
+    mNetworkEpoch = network.GetEpoch();
+}
+
+void DjikstraController::syncNetworkState(const Rail::RailTopology& topology, const Rail::NetworkState& state) {
+    if(&state != mNetworkState) {
+        // Paths found on another state may not suit this one. Those cached before the first update, such as
+        // paths restored from a checkpoint, were found on the state the trains started with
+        if(mNetworkState != nullptr) {
+            mPathCache.Clear();
+        }
+
+        mRoutingEngine->SetState(&state);
+        for(auto engine : mWorkerEngines) {
+            engine->SetState(&state);
+        }
+
+        // The engines take the whole of the new state, so only the changes made from now on are passed on
+        mNetworkState = &state;
+        mStateEpoch = state.GetEpoch();
+        return;
+    }
+
+    if(state.GetEpoch() == mStateEpoch) {
+        return;
+    }
+
+    mChangedSegments.clear();
+    bool kept = state.GetChangedSegments(mStateEpoch, mChangedSegments);
+    applyChanges(topology, kept);
+    mStateEpoch = state.GetEpoch();
+}
+
+void DjikstraController::applyChanges(const Rail::RailTopology& topology, bool kept) {
+    if(kept) {
+        mPathCache.Invalidate(mChangedSegments);
+    } else {
+        // The changes are too old to have been kept, so every segment has to be treated as changed
+        mPathCache.Clear();
+        mChangedSegments.clear();
+        for(Rail::SegmentId s = 0; s < topology.GetSegmentCount(); s++) {
+            mChangedSegments.push_back(s);
         }
     }
 
-    printf("ERROR No path found for Train %s to destination %s\n", 
-            train->GetName(), train->GetDestination()->GetName());
-    return Path();
+    mRoutingEngine->UpdateCosts(topology, mChangedSegments);
+    for(auto engine : mWorkerEngines) {
+        engine->UpdateCosts(topology, mChangedSegments);
+    }
+}
+
+void DjikstraController::recordQuery(unsigned int nodesExplored, uint64_t nanoseconds) {
+    mRoutingStats.mQueries++;
+    mRoutingStats.mNodesExplored += nodesExplored;
+    mRoutingStats.mLastNodesExplored = nodesExplored;
+
+    if(mProfiler != nullptr) {
+        mProfiler->Record(Util::Profiler::ROUTE_QUERY, nanoseconds);
+        mProfiler->Count(Util::Profiler::ROUTE_QUERIES);
+        mProfiler->Count(Util::Profiler::NODES_SETTLED, nodesExplored);
+    }
+}
+
+void DjikstraController::recordEvent(Util::EventLogger::EventType type, const Train::Train* train, uint32_t arg) {
+    if(mEventLogger == nullptr) {
+        return;
+    }
+
+    mEventLogger->Record(type, mEventLogger->GetId(train, train->GetName()), Util::EventLogger::INVALID_ID, arg);
+}
+
+Path DjikstraController::findShortestPath(IRoutingEngine& engine, const Rail::RailTopology& topology, Train::Train* train,
+                                          unsigned int& nodesExplored) const {
+    nodesExplored = 0;
+
+    // Resolve the train's location and destination in the topology
+    Rail::SegmentId initialSegment = topology.LookupSegment(train->GetCurrentComponent());
+    Rail::ConnectorId destination = topology.LookupConnector(train->GetDestination());
+
+    if(initialSegment == Rail::INVALID_ID || destination == Rail::INVALID_ID) {
+        LOG_ERROR(ROUTING, "Train %s is not routable between %s and %s",
+                train->GetName(), train->GetCurrentComponent()->GetName(), train->GetDestination()->GetName());
+        return Path();
+    }
+
+    Path path = engine.FindPath(topology, Rail::MakeNode(initialSegment, train->GetDirection()), destination);
+    nodesExplored = engine.GetStats().mLastNodesExplored;
+
+    if(path.empty()) {
+        LOG_ERROR(ROUTING, "No path found for Train %s to destination %s", 
+                train->GetName(), train->GetDestination()->GetName());
+        return path;
+    }
+
+    LOG_DEBUG(ROUTING, "Path found for Train %s, %u nodes explored",
+            train->GetName(), nodesExplored);
+    return path;
+}
+
+size_t DjikstraController::findStep(const Rail::RailTopology& topology, const Path& path, const Train::Train* train) const {
+    const Rail::SegmentId current = topology.LookupSegment(train->GetCurrentComponent());
+    const size_t first = std::find(path.begin(), path.end(), current) - path.begin();
+    if(first + 1 >= path.size()) {
+        return first;
+    }
+
+    const size_t second = std::find(path.begin() + first + 1, path.end(), current) - path.begin();
+    if(second == path.size()) {
+        return first;
+    }
+
+    // The first time along the segment, the path leaves by one end, and the second time by the other
+    const Rail::ConnectorId ahead = topology.GetEnd(Rail::MakeNode(current, train->GetDirection()));
+    const bool leavesAhead = (ahead != Rail::INVALID_ID) &&
+            topology.FindAttachment(ahead, path[first + 1]) != Rail::NetworkState::NO_SELECTION;
+    return leavesAhead ? first : second;
+}
+
+bool DjikstraController::setNextStep(Rail::RailNetwork& network, Rail::NetworkState& state, Train::Train* train,
+                                     const Path& path) {
+    const Rail::RailTopology& topology = network.GetTopology();
+
+    // Once on the last segment of its path, the train only has its destination ahead
+    size_t next = findStep(topology, path, train) + 1;
+    if(next >= path.size()) {
+        return true;
+    }
+
+    const Rail::Direction d = train->GetDirection();
+    const Rail::SegmentId segment = path[next - 1];
+    const Rail::NodeId node = Rail::MakeNode(segment, d);
+
+    // A train held by a red signal cannot cross the connector ahead, so leaves it for the others
+    if(state.GetSignal(node) == Rail::SignalState::RED) {
+        return true;
+    }
+
+    const Rail::ConnectorId c = topology.GetEnd(node);
+    if(c == Rail::INVALID_ID) {
+        return network.RouteSegment(state, segment, d, path[next]);
+    }
+
+    const unsigned int length = topology.GetLength(segment);
+    const unsigned int distance = length - std::min(train->GetCurrentLocation(d), length);
+    const ConnectorClaim request {train, c, segment, path[next], d, distance};
+
+    // Another controller switches a shared connector, once it has the claims of every train on it
+    if(mSharedConnectors != nullptr && (*mSharedConnectors)[c]) {
+        mSharedClaims->push_back(request);
+        return true;
+    }
+
+    return claimConnector(network, state, request);
 }
 
-bool DjikstraController::setPath(Rail::RailNetwork& network, Path path) {
-    bool success = true;
-    // Path is a series of Segments that need to be connected, iterate through and route each to the next
-    for(int i = 0; i < path.size() - 1; i++) {
-        success = success && (network.RouteSegment(path[i], path[i+1]));
+bool DjikstraController::claimConnector(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                        const ConnectorClaim& request) {
+    const Rail::RailTopology& topology = network.GetTopology();
+    const Rail::ConnectorId c = request.mConnector;
+    Train::Train* train = request.mTrain;
+
+    if(c >= mClaims.size()) {
+        mClaims.resize(topology.GetConnectorCount());
+    }
+
+    // The connector only suits a train it has already been switched for this update if it is switched
+    // the same way for both
+    Claim& claim = mClaims[c];
+    bool switched = false;
+    if(claim.mUpdate == mUpdateCount) {
+        const uint16_t from = topology.FindAttachment(c, request.mFrom);
+        const uint16_t to = topology.FindAttachment(c, request.mTo);
+        const uint16_t first = state.GetSelection(c, 0);
+        const uint16_t second = state.GetSelection(c, 1);
+        switched = (first == from && second == to) || (first == to && second == from);
+    }
+
+    if(claim.mUpdate == mUpdateCount && claim.mDistance <= request.mDistance) {
+        if(switched) {
+            return true;
+        }
+
+        LOG_DEBUG(ROUTING, "Connector %s ahead of Train %s is switched for a nearer train",
+                topology.GetConnector(c)->GetName(), train->GetName());
+        return false;
     }
 
-    return success;
-}
\ No newline at end of file
+    if(!network.RouteSegment(state, request.mFrom, request.mDirection, request.mTo)) {
+        return false;
+    }
+
+    if(claim.mUpdate == mUpdateCount && !switched) {
+        LOG_DEBUG(ROUTING, "Connector %s ahead of Train %s is switched for a nearer train",
+                topology.GetConnector(c)->GetName(), claim.mTrain->GetName());
+        recordEvent(Util::EventLogger::PATH_NOT_SET, claim.mTrain);
+        mAllRouted = false;
+    }
+
+    claim.mUpdate = mUpdateCount;
+    claim.mDistance = request.mDistance;
+    claim.mTrain = train;
+    return true;
+}
+
+void DjikstraController::setLogKey(size_t position) const {
+    if(mLogKeys != nullptr) {
+        Util::Log::SetKey((*mLogKeys)[position]);
+    }
+}
@@ -0,0 +1,245 @@
+#include "EventLogger.h"
+#include "RailDefinitions.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace Util;
+
+// Identifies an event log file, and the layout of its records
+static const char FILE_MAGIC[4] = {'T', 'S', 'E', 'V'};
+static const uint32_t FILE_VERSION = 1;
+
+struct FileHeader {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mRecordSize;
+    uint32_t mReserved;
+};
+
+// How long the drain thread sleeps between drains when it is not woken
+static const std::chrono::milliseconds DRAIN_INTERVAL(1);
+
+EventLogger::EventLogger(const std::string& path, size_t capacity) : mHead(0), mDropped(0), mTail(0) {
+    size_t size = 1;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    mRecords.resize(size);
+
+    mFile = fopen(path.c_str(), "wb");
+    if(mFile == nullptr) {
+        LOG_ERROR(TRAIN, "Failed to open event log %s", path.c_str());
+        // Leave the ring with no space, so that every event is discarded
+        mCachedTail = 0;
+        mHead.store(size);
+        return;
+    }
+
+    FileHeader header;
+    memcpy(header.mMagic, FILE_MAGIC, sizeof(header.mMagic));
+    header.mVersion = FILE_VERSION;
+    header.mRecordSize = sizeof(EventRecord);
+    header.mReserved = 0;
+    fwrite(&header, sizeof(header), 1, mFile);
+
+    mThread = std::thread(&EventLogger::drainLoop, this);
+}
+
+EventLogger::~EventLogger() {
+    if(mFile == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    mThread.join();
+
+    fclose(mFile);
+
+    if(GetDroppedCount() > 0) {
+        LOG_WARNING(TRAIN, "Event log dropped %llu events", static_cast<unsigned long long>(GetDroppedCount()));
+    }
+}
+
+uint32_t EventLogger::GetId(const void* key, const char* name) {
+    auto iter = mIds.find(key);
+    if(iter != mIds.end()) {
+        return iter->second;
+    }
+
+    uint32_t id = mNextId++;
+    mIds[key] = id;
+
+    if(mFile != nullptr) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPendingNames.emplace_back(id, name);
+    }
+
+    return id;
+}
+
+void EventLogger::drainLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while(!mStopping) {
+        mWake.wait_for(lock, DRAIN_INTERVAL);
+
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+    lock.unlock();
+
+    // Everything recorded before the logger was destroyed is written
+    drain();
+}
+
+void EventLogger::drain() {
+    std::vector<std::pair<uint32_t, std::string>> names;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        names.swap(mPendingNames);
+    }
+
+    for(auto& name : names) {
+        writeName(name.first, name.second);
+    }
+
+    uint64_t head = mHead.load(std::memory_order_acquire);
+    uint64_t tail = mTail.load(std::memory_order_relaxed);
+
+    // The records between tail and head may wrap around the end of the ring
+    while(tail != head) {
+        size_t start = tail & (mRecords.size() - 1);
+        size_t count = std::min<uint64_t>(head - tail, mRecords.size() - start);
+        fwrite(&mRecords[start], sizeof(EventRecord), count, mFile);
+
+        mLastTick = mRecords[start + count - 1].mTick;
+        tail += count;
+    }
+    mTail.store(tail, std::memory_order_release);
+
+    uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+    if(dropped != mReportedDropped) {
+        EventRecord record = {};
+        record.mType = EventType::DROPPED;
+        record.mTrain = INVALID_ID;
+        record.mTick = mLastTick;
+        record.mComponent = INVALID_ID;
+        record.mArgs[0] = static_cast<uint32_t>(dropped - mReportedDropped);
+        fwrite(&record, sizeof(record), 1, mFile);
+
+        mReportedDropped = dropped;
+    }
+
+    fflush(mFile);
+}
+
+void EventLogger::writeName(uint32_t id, const std::string& name) {
+    EventRecord record = {};
+    record.mType = EventType::NAME;
+    record.mTrain = id;
+    record.mComponent = INVALID_ID;
+    record.mArgs[0] = name.size();
+    fwrite(&record, sizeof(record), 1, mFile);
+
+    // Pad the text out to whole records, so that the records which follow stay aligned
+    std::vector<char> text(((name.size() + sizeof(EventRecord) - 1) / sizeof(EventRecord)) * sizeof(EventRecord), '\0');
+    memcpy(text.data(), name.data(), name.size());
+    fwrite(text.data(), 1, text.size(), mFile);
+}
+
+bool EventLogger::Decode(const std::string& path, FILE* out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == nullptr) {
+        LOG_ERROR(TRAIN, "Failed to open event log %s", path.c_str());
+        return false;
+    }
+
+    FileHeader header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.mMagic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+       header.mVersion != FILE_VERSION || header.mRecordSize != sizeof(EventRecord)) {
+        LOG_ERROR(TRAIN, "%s is not an event log this version can read", path.c_str());
+        fclose(file);
+        return false;
+    }
+
+    std::vector<EventRecord> records;
+    EventRecord record;
+    while(fread(&record, sizeof(record), 1, file) == 1) {
+        records.push_back(record);
+    }
+    fclose(file);
+
+    // Names may be written after the first event to use them, so collect them all first
+    std::unordered_map<uint32_t, std::string> names;
+    for(size_t i = 0; i < records.size(); i++) {
+        if(records[i].mType != EventType::NAME) {
+            continue;
+        }
+
+        size_t length = records[i].mArgs[0];
+        size_t textRecords = (length + sizeof(EventRecord) - 1) / sizeof(EventRecord);
+        if(i + textRecords >= records.size()) {
+            LOG_ERROR(TRAIN, "Event log %s is truncated", path.c_str());
+            break;
+        }
+
+        names[records[i].mTrain].assign(reinterpret_cast<const char*>(&records[i + 1]), length);
+        i += textRecords;
+    }
+
+    auto name = [&names](uint32_t id) {
+        auto iter = names.find(id);
+        return (iter != names.end()) ? iter->second.c_str() : "Unknown";
+    };
+
+    for(size_t i = 0; i < records.size(); i++) {
+        const EventRecord& r = records[i];
+        unsigned long long tick = r.mTick;
+
+        switch(r.mType) {
+            case EventType::NAME:
+                // Skip over the text of the name
+                i += (r.mArgs[0] + sizeof(EventRecord) - 1) / sizeof(EventRecord);
+                break;
+            case EventType::DROPPED:
+                fprintf(out, "[%llu] WARNING %u events dropped\n", tick, r.mArgs[0]);
+                break;
+            case EventType::TRAVERSED:
+                fprintf(out, "[%llu] DEBUG Train %s traversing to %s, travelled: %u units, stopped time: %u units\n",
+                        tick, name(r.mTrain), name(r.mComponent), r.mArgs[0], r.mArgs[1]);
+                break;
+            case EventType::STOPPED:
+                fprintf(out, "[%llu] DEBUG Train %s stopped on %s, direction %s\n",
+                        tick, name(r.mTrain), name(r.mComponent), Rail::PrintDirection(static_cast<Rail::Direction>(r.mArgs[0])));
+                break;
+            case EventType::COLLIDED:
+                fprintf(out, "[%llu] ERROR Train %s collided with %s on component %s\n",
+                        tick, name(r.mTrain), name(r.mArgs[0]), name(r.mComponent));
+                break;
+            case EventType::ARRIVED:
+                fprintf(out, "[%llu] INFO Train %s has reached its destination %s\n", tick, name(r.mTrain), name(r.mComponent));
+                break;
+            case EventType::PATH_FOUND:
+                fprintf(out, "[%llu] DEBUG Path found for Train %s, %u nodes explored\n", tick, name(r.mTrain), r.mArgs[0]);
+                break;
+            case EventType::NO_PATH:
+                fprintf(out, "[%llu] WARNING Could not find shortest path for Train %s\n", tick, name(r.mTrain));
+                break;
+            case EventType::PATH_NOT_SET:
+                fprintf(out, "[%llu] WARNING Failed to set optimal path for train %s\n", tick, name(r.mTrain));
+                break;
+            default:
+                fprintf(out, "[%llu] ERROR Unexpected event type %u\n", tick, r.mType);
+                break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,278 @@
+#include "IncrementalRoutingEngine.h"
+
+#include <algorithm>
+
+using namespace Traffic;
+
+/**
+ *  Add two costs, where UINT32_MAX is an infinite cost
+ */
+static unsigned int addCost(unsigned int a, unsigned int b) {
+    uint64_t sum = static_cast<uint64_t>(a) + b;
+    return (a == UINT32_MAX || b == UINT32_MAX || sum >= UINT32_MAX) ? UINT32_MAX : static_cast<unsigned int>(sum);
+}
+
+IncrementalRoutingEngine::IncrementalRoutingEngine(unsigned int redSignalCost) : mRedSignalCost(redSignalCost) {
+
+}
+
+IncrementalRoutingEngine::~IncrementalRoutingEngine() {
+
+}
+
+IRoutingEngine* IncrementalRoutingEngine::Clone() const {
+    // Search state is per engine, so the clone starts its own
+    IncrementalRoutingEngine* clone = new IncrementalRoutingEngine(mRedSignalCost);
+    clone->mState = mState;
+    return clone;
+}
+
+void IncrementalRoutingEngine::SetState(const Rail::NetworkState* state) {
+    if(state != mState) {
+        // Every signal cost may differ, so the search state is rebuilt on the next query
+        mState = state;
+        mTopology = nullptr;
+    }
+}
+
+void IncrementalRoutingEngine::UpdateCosts(const Rail::RailTopology& topology, const std::vector<Rail::SegmentId>& changed) {
+    // If the topology has been rebuilt, all state is discarded on the next query anyway
+    if(mTopology != &topology || mTopologyVersion != topology.GetVersion()) {
+        return;
+    }
+
+    for(auto segment : changed) {
+        if(segment >= topology.GetSegmentCount()) {
+            continue;
+        }
+
+        for(Rail::Direction d : {Rail::Direction::UP, Rail::Direction::DOWN}) {
+            Rail::NodeId node = Rail::MakeNode(segment, d);
+            unsigned int cost = getSignalCost(topology, node);
+            if(cost == mSignalCosts[node]) {
+                continue;
+            }
+
+            // Only the edges out of this node have changed, so only its lookahead needs recalculating.
+            // The change is propagated to the rest of the network by the next query that needs it
+            mSignalCosts[node] = cost;
+            for(auto& entry : mSearches) {
+                updateNode(topology, entry.second, node);
+            }
+        }
+    }
+}
+
+Path IncrementalRoutingEngine::FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination) {
+    mStats.mQueries++;
+    mStats.mLastNodesExplored = 0;
+
+    if(mTopology != &topology || mTopologyVersion != topology.GetVersion()) {
+        reset(topology);
+    }
+
+    DestinationSearch& search = getSearch(topology, destination);
+    computeDistances(topology, search, start);
+
+    if(search.mDistances[start] == UINT32_MAX) {
+        return Path();
+    }
+
+    // Every node with a distance no greater than the start's is now consistent, so the path follows
+    // the successor which gives each node its distance
+    Path path;
+    path.push_back(Rail::NodeSegment(start));
+
+    nextPathStamp();
+    mPathStamps[start] = mPathStamp;
+
+    Rail::NodeId node = start;
+    while(topology.GetEnd(node) != destination) {
+        Rail::NodeId next = Rail::INVALID_ID;
+        unsigned int nextDistance = UINT32_MAX;
+
+        for(auto successor : topology.GetSuccessors(node)) {
+            unsigned int distance = addCost(getCost(topology, node, successor), search.mDistances[successor]);
+            if(distance < nextDistance) {
+                next = successor;
+                nextDistance = distance;
+            }
+        }
+
+        if(next == Rail::INVALID_ID) {
+            return Path();
+        }
+
+        // Around a loop of zero length segments, a node and its successor can each give the other its
+        // distance, so a walk which comes back on itself finds the path with a search instead
+        if(mPathStamps[next] == mPathStamp) {
+            return findTiedPath(topology, search, start);
+        }
+
+        mPathStamps[next] = mPathStamp;
+        path.push_back(Rail::NodeSegment(next));
+        node = next;
+    }
+
+    return path;
+}
+
+Path IncrementalRoutingEngine::findTiedPath(const Rail::RailTopology& topology, const DestinationSearch& search,
+                                            Rail::NodeId start) {
+    // A breadth first search over the successors which give each node its distance, which never revisits a node
+    nextPathStamp();
+    mPathStamps[start] = mPathStamp;
+    mPathQueue.clear();
+    mPathQueue.push_back(start);
+
+    for(size_t i = 0; i < mPathQueue.size(); i++) {
+        Rail::NodeId node = mPathQueue[i];
+        if(topology.GetEnd(node) == search.mDestination) {
+            Path path;
+            for(; node != start; node = mPathParents[node]) {
+                path.push_back(Rail::NodeSegment(node));
+            }
+            path.push_back(Rail::NodeSegment(start));
+            std::reverse(path.begin(), path.end());
+            return path;
+        }
+
+        for(auto successor : topology.GetSuccessors(node)) {
+            if(mPathStamps[successor] != mPathStamp &&
+               addCost(getCost(topology, node, successor), search.mDistances[successor]) == search.mDistances[node]) {
+                mPathStamps[successor] = mPathStamp;
+                mPathParents[successor] = node;
+                mPathQueue.push_back(successor);
+            }
+        }
+    }
+
+    return Path();
+}
+
+void IncrementalRoutingEngine::nextPathStamp() {
+    // Clear the stamps rather than mistake an old one for the new one once the counter wraps
+    if(++mPathStamp == 0) {
+        std::fill(mPathStamps.begin(), mPathStamps.end(), 0);
+        mPathStamp = 1;
+    }
+}
+
+void IncrementalRoutingEngine::reset(const Rail::RailTopology& topology) {
+    mTopology = &topology;
+    mTopologyVersion = topology.GetVersion();
+    mSearches.clear();
+
+    mPathStamps.assign(topology.GetNodeCount(), 0);
+    mPathStamp = 0;
+    mPathParents.resize(topology.GetNodeCount());
+
+    mSignalCosts.resize(topology.GetNodeCount());
+    for(Rail::NodeId n = 0; n < topology.GetNodeCount(); n++) {
+        mSignalCosts[n] = getSignalCost(topology, n);
+    }
+}
+
+IncrementalRoutingEngine::DestinationSearch& IncrementalRoutingEngine::getSearch(const Rail::RailTopology& topology,
+                                                                                 Rail::ConnectorId destination) {
+    auto iter = mSearches.find(destination);
+    if(iter != mSearches.end()) {
+        return iter->second;
+    }
+
+    DestinationSearch& search = mSearches[destination];
+    search.mDestination = destination;
+    search.mDistances.assign(topology.GetNodeCount(), UINT32_MAX);
+    search.mLookaheads.assign(topology.GetNodeCount(), UINT32_MAX);
+    search.mQueuedKeys.assign(topology.GetNodeCount(), UINT32_MAX);
+
+    // The search is seeded from every node which ends at the destination
+    for(auto node : topology.GetAttachments(destination)) {
+        search.mLookaheads[node] = 0;
+        search.mQueuedKeys[node] = 0;
+        search.mQueue.push_back(QueueEntry(0, node));
+        std::push_heap(search.mQueue.begin(), search.mQueue.end(), QueueEntry::Compare());
+    }
+
+    return search;
+}
+
+void IncrementalRoutingEngine::computeDistances(const Rail::RailTopology& topology, DestinationSearch& search,
+                                                Rail::NodeId start) {
+    for(pruneQueue(search); !search.mQueue.empty(); pruneQueue(search)) {
+        // Expanding every node keyed no higher than the start, rather than stopping at the first tie,
+        // leaves the whole of the start's path consistent
+        unsigned int startKey = std::min(search.mDistances[start], search.mLookaheads[start]);
+        if(search.mQueue.front().mPriority > startKey && search.mDistances[start] == search.mLookaheads[start]) {
+            break;
+        }
+
+        std::pop_heap(search.mQueue.begin(), search.mQueue.end(), QueueEntry::Compare());
+        Rail::NodeId node = search.mQueue.back().mVertex;
+        search.mQueue.pop_back();
+        search.mQueuedKeys[node] = UINT32_MAX;
+
+        mStats.mLastNodesExplored++;
+        mStats.mNodesExplored++;
+
+        if(search.mDistances[node] > search.mLookaheads[node]) {
+            // The node has become closer, so its distance is now final
+            search.mDistances[node] = search.mLookaheads[node];
+        } else if(search.mDistances[node] < search.mLookaheads[node]) {
+            // The node has become further away, so its distance must be found again
+            search.mDistances[node] = UINT32_MAX;
+            updateNode(topology, search, node);
+        } else {
+            continue;
+        }
+
+        // Update every node leading on to this one. Edges are symmetric under reversal, so these are
+        // the reverse of the nodes reached by travelling back along this one
+        for(auto reverse : topology.GetSuccessors(Rail::ReverseNode(node))) {
+            updateNode(topology, search, Rail::ReverseNode(reverse));
+        }
+    }
+}
+
+void IncrementalRoutingEngine::updateNode(const Rail::RailTopology& topology, DestinationSearch& search, Rail::NodeId node) {
+    if(topology.GetEnd(node) != search.mDestination) {
+        unsigned int lookahead = UINT32_MAX;
+        for(auto successor : topology.GetSuccessors(node)) {
+            lookahead = std::min(lookahead, addCost(getCost(topology, node, successor), search.mDistances[successor]));
+        }
+        search.mLookaheads[node] = lookahead;
+    }
+
+    if(search.mDistances[node] != search.mLookaheads[node]) {
+        unsigned int key = std::min(search.mDistances[node], search.mLookaheads[node]);
+        if(key != search.mQueuedKeys[node]) {
+            search.mQueuedKeys[node] = key;
+            search.mQueue.push_back(QueueEntry(key, node));
+            std::push_heap(search.mQueue.begin(), search.mQueue.end(), QueueEntry::Compare());
+        }
+    } else {
+        search.mQueuedKeys[node] = UINT32_MAX;
+    }
+}
+
+unsigned int IncrementalRoutingEngine::getCost(const Rail::RailTopology& topology, Rail::NodeId node, Rail::NodeId successor) const {
+    return addCost(mSignalCosts[node], topology.GetLength(Rail::NodeSegment(successor)));
+}
+
+unsigned int IncrementalRoutingEngine::getSignalCost(const Rail::RailTopology& topology, Rail::NodeId node) const {
+    Rail::SignalState signal = (mState != nullptr) ? mState->GetSignal(node) :
+            topology.GetSegment(Rail::NodeSegment(node))->GetSignalState(Rail::NodeDirection(node));
+    return (signal == Rail::SignalState::RED) ? mRedSignalCost : 0;
+}
+
+void IncrementalRoutingEngine::pruneQueue(DestinationSearch& search) {
+    while(!search.mQueue.empty()) {
+        const QueueEntry& top = search.mQueue.front();
+        if(top.mPriority == search.mQueuedKeys[top.mVertex]) {
+            return;
+        }
+
+        std::pop_heap(search.mQueue.begin(), search.mQueue.end(), QueueEntry::Compare());
+        search.mQueue.pop_back();
+    }
+}
@@ -0,0 +1,150 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <strings.h>
+
+using namespace Util;
+
+// The buffer messages from this thread are captured in, if any
+static thread_local LogBuffer* tCapture = nullptr;
+
+std::atomic<int> Log::sLevels[CATEGORY_COUNT] = {
+    {LogLevel::INFO}, {LogLevel::INFO}, {LogLevel::INFO}, {LogLevel::INFO}
+};
+
+const char* Util::PrintLogLevel(LogLevel level) {
+    switch(level) {
+        case LogLevel::TRACE:
+            return "TRACE";
+        case LogLevel::DEBUG:
+            return "DEBUG";
+        case LogLevel::INFO:
+            return "INFO";
+        case LogLevel::WARNING:
+            return "WARNING";
+        case LogLevel::ERROR:
+            return "ERROR";
+        case LogLevel::NONE:
+            return "NONE";
+        default:
+            return "Unexpected Log Level";
+    }
+}
+
+const char* Util::PrintLogCategory(LogCategory category) {
+    switch(category) {
+        case LogCategory::ROUTING:
+            return "Routing";
+        case LogCategory::TRAVERSAL:
+            return "Traversal";
+        case LogCategory::BUILD:
+            return "Build";
+        case LogCategory::TRAIN:
+            return "Train";
+        default:
+            return "Unexpected Log Category";
+    }
+}
+
+bool Util::ParseLogLevel(const char* name, LogLevel& level) {
+    for(int l = LogLevel::TRACE; l <= LogLevel::NONE; l++) {
+        if(strcasecmp(name, PrintLogLevel(static_cast<LogLevel>(l))) == 0) {
+            level = static_cast<LogLevel>(l);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Log::SetLevel(LogLevel level) {
+    for(auto& categoryLevel : sLevels) {
+        categoryLevel.store(level, std::memory_order_relaxed);
+    }
+}
+
+void Log::SetLevel(LogCategory category, LogLevel level) {
+    sLevels[category].store(level, std::memory_order_relaxed);
+}
+
+void Log::Write(LogLevel level, LogCategory category, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    if(tCapture != nullptr) {
+        va_list sizeArgs;
+        va_copy(sizeArgs, args);
+        int size = vsnprintf(nullptr, 0, format, sizeArgs);
+        va_end(sizeArgs);
+
+        // Format after the level, with room for the terminator vsnprintf writes
+        std::string text = PrintLogLevel(level);
+        text += ' ';
+        size_t prefix = text.size();
+        text.resize(prefix + std::max(size, 0) + 1);
+        vsnprintf(&text[prefix], text.size() - prefix, format, args);
+        text.pop_back();
+
+        tCapture->mMessages.push_back(LogBuffer::Message {tCapture->mKey, std::move(text)});
+        va_end(args);
+        return;
+    }
+
+    // Hold the stream for the whole line so that messages from routing threads are not interleaved
+    flockfile(stdout);
+    fputs(PrintLogLevel(level), stdout);
+    putc_unlocked(' ', stdout);
+    vfprintf(stdout, format, args);
+    putc_unlocked('\n', stdout);
+    funlockfile(stdout);
+
+    va_end(args);
+}
+
+LogBuffer* Log::Capture(LogBuffer* buffer) {
+    LogBuffer* previous = tCapture;
+    tCapture = buffer;
+    return previous;
+}
+
+void Log::SetKey(uint64_t key) {
+    if(tCapture != nullptr) {
+        tCapture->mKey = key;
+    }
+}
+
+void Log::Flush(std::vector<LogBuffer>& buffers) {
+    std::vector<const LogBuffer::Message*> messages;
+    for(const auto& buffer : buffers) {
+        for(const auto& message : buffer.mMessages) {
+            messages.push_back(&message);
+        }
+    }
+
+    if(messages.empty()) {
+        return;
+    }
+
+    std::stable_sort(messages.begin(), messages.end(), [](const LogBuffer::Message* a, const LogBuffer::Message* b) {
+        return a->mKey < b->mKey;
+    });
+
+    if(tCapture != nullptr) {
+        for(auto message : messages) {
+            tCapture->mMessages.push_back(LogBuffer::Message {tCapture->mKey, message->mText});
+        }
+    } else {
+        flockfile(stdout);
+        for(auto message : messages) {
+            fputs(message->mText.c_str(), stdout);
+            putc_unlocked('\n', stdout);
+        }
+        funlockfile(stdout);
+    }
+
+    for(auto& buffer : buffers) {
+        buffer.mMessages.clear();
+    }
+}
@@ -0,0 +1,372 @@
+#include "NetworkFile.h"
+#include "Log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Rail;
+
+static const char MAGIC[4] = {'T', 'S', 'N', 'W'};
+
+// Sections start on multiples of this, so that their tables can be read in place
+static const uint64_t SECTION_ALIGNMENT = 8;
+
+static uint64_t alignSection(uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+// The tables are used in place, so can only be read and written on little-endian hosts
+static bool isLittleEndian() {
+    const uint16_t value = 1;
+    return *reinterpret_cast<const uint8_t*>(&value) == 1;
+}
+
+// Check that offsets into a table of the given size never decrease, and cover the whole table
+static bool validOffsets(const uint32_t* offsets, uint64_t count, uint64_t tableSize) {
+    if(offsets[0] != 0 || offsets[count] != tableSize) {
+        return false;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(offsets[i] > offsets[i + 1]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+NetworkFile::NetworkFile() {
+
+}
+
+NetworkFile::~NetworkFile() {
+    Close();
+}
+
+bool NetworkFile::Open(const std::string& path) {
+    Close();
+
+    if(!isLittleEndian()) {
+        LOG_ERROR(BUILD, "Network files can only be read on little-endian hosts");
+        return false;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        LOG_ERROR(BUILD, "Failed to open network file %s", path.c_str());
+        return false;
+    }
+
+    struct stat status;
+    if(fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+        LOG_ERROR(BUILD, "%s is not a network file", path.c_str());
+        close(fd);
+        return false;
+    }
+
+    // The mapping holds its own reference to the file
+    void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        LOG_ERROR(BUILD, "Failed to map network file %s", path.c_str());
+        return false;
+    }
+
+    mData = data;
+    mSize = status.st_size;
+    mHeader = static_cast<const Header*>(data);
+
+    if(!validate(path)) {
+        Close();
+        return false;
+    }
+
+    LOG_DEBUG(BUILD, "Mapped network file %s, %u segments, %u connectors, %u terminators", path.c_str(),
+            mHeader->mSegmentCount, mHeader->mConnectorCount, mHeader->mTerminatorCount);
+    return true;
+}
+
+void NetworkFile::Close() {
+    if(mData != nullptr) {
+        munmap(mData, mSize);
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mHeader = nullptr;
+}
+
+TopologyArrays NetworkFile::GetTopologyArrays() const {
+    TopologyArrays arrays;
+    arrays.mLengths = section<uint32_t>(SEGMENT_LENGTHS);
+    arrays.mEnds = section<ConnectorId>(NODE_ENDS);
+    arrays.mTerminatorFlags = section<uint8_t>(TERMINATOR_FLAGS);
+    arrays.mAttachmentOffsets = section<uint32_t>(ATTACHMENT_OFFSETS);
+    arrays.mAttachments = section<NodeId>(ATTACHMENTS);
+    arrays.mSuccessorOffsets = section<uint32_t>(SUCCESSOR_OFFSETS);
+    arrays.mSuccessors = section<NodeId>(SUCCESSORS);
+
+    return arrays;
+}
+
+bool NetworkFile::Write(const RailTopology& topology, const NetworkState& state, const std::string& path) {
+    if(!isLittleEndian()) {
+        LOG_ERROR(BUILD, "Network files can only be written on little-endian hosts");
+        return false;
+    }
+
+    const TopologyArrays& arrays = topology.GetArrays();
+    const uint32_t segmentCount = topology.GetSegmentCount();
+    const uint32_t nodeCount = topology.GetNodeCount();
+    const uint32_t connectorTotal = topology.GetConnectorCount();
+
+    if(state.GetNodeCount() != nodeCount || state.GetConnectorCount() != connectorTotal) {
+        LOG_ERROR(BUILD, "Writing network file %s with a state for another topology", path.c_str());
+        return false;
+    }
+
+    // Terminators are numbered after every other connector
+    uint32_t connectorCount = 0;
+    while(connectorCount < connectorTotal && !topology.IsTerminator(connectorCount)) {
+        connectorCount++;
+    }
+
+    std::vector<uint8_t> signals(nodeCount);
+    for(NodeId n = 0; n < nodeCount; n++) {
+        signals[n] = state.GetSignal(n);
+    }
+
+    // Selections are saved as segments, which do not depend on the order of the attachments
+    std::vector<SegmentId> selections(connectorTotal * 2);
+    for(ConnectorId c = 0; c < connectorTotal; c++) {
+        for(unsigned int i = 0; i < 2; i++) {
+            uint16_t position = state.GetSelection(c, i);
+            selections[c * 2 + i] = (position != NetworkState::NO_SELECTION) ?
+                    NodeSegment(topology.GetAttachments(c).begin()[position]) : INVALID_ID;
+        }
+    }
+
+    std::vector<uint32_t> nameOffsets;
+    std::string names;
+    nameOffsets.reserve(segmentCount + connectorTotal + 1);
+    for(SegmentId s = 0; s < segmentCount; s++) {
+        nameOffsets.push_back(names.size());
+        names.append(topology.GetSegment(s)->GetName());
+        names.push_back('\0');
+    }
+
+    for(ConnectorId c = 0; c < connectorTotal; c++) {
+        nameOffsets.push_back(names.size());
+        names.append(topology.GetConnector(c)->GetName());
+        names.push_back('\0');
+    }
+    nameOffsets.push_back(names.size());
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.mMagic, MAGIC, sizeof(MAGIC));
+    header.mVersion = VERSION;
+    header.mHeaderSize = sizeof(Header);
+    header.mSegmentCount = segmentCount;
+    header.mConnectorCount = connectorCount;
+    header.mTerminatorCount = connectorTotal - connectorCount;
+    header.mAttachmentCount = arrays.mAttachmentOffsets[connectorTotal];
+    header.mSuccessorCount = arrays.mSuccessorOffsets[nodeCount];
+
+    const void* data[SECTION_COUNT] = {
+        arrays.mLengths,
+        arrays.mEnds,
+        signals.data(),
+        arrays.mTerminatorFlags,
+        arrays.mAttachmentOffsets,
+        arrays.mAttachments,
+        arrays.mSuccessorOffsets,
+        arrays.mSuccessors,
+        selections.data(),
+        nameOffsets.data(),
+        names.data()
+    };
+
+    const uint64_t sizes[SECTION_COUNT] = {
+        segmentCount * sizeof(uint32_t),
+        nodeCount * sizeof(ConnectorId),
+        signals.size(),
+        connectorTotal * sizeof(uint8_t),
+        (connectorTotal + 1) * sizeof(uint32_t),
+        header.mAttachmentCount * sizeof(NodeId),
+        (nodeCount + 1) * sizeof(uint32_t),
+        header.mSuccessorCount * sizeof(NodeId),
+        selections.size() * sizeof(SegmentId),
+        nameOffsets.size() * sizeof(uint32_t),
+        names.size()
+    };
+
+    uint64_t offset = alignSection(sizeof(Header));
+    for(int s = 0; s < SECTION_COUNT; s++) {
+        header.mSections[s].mOffset = offset;
+        header.mSections[s].mSize = sizes[s];
+        offset = alignSection(offset + sizes[s]);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if(file == nullptr) {
+        LOG_ERROR(BUILD, "Failed to create network file %s", path.c_str());
+        return false;
+    }
+
+    static const char padding[SECTION_ALIGNMENT] = {};
+    uint64_t written = fwrite(&header, 1, sizeof(header), file);
+    for(int s = 0; s < SECTION_COUNT; s++) {
+        written += fwrite(padding, 1, header.mSections[s].mOffset - written, file);
+        if(sizes[s] > 0) {
+            written += fwrite(data[s], 1, sizes[s], file);
+        }
+    }
+
+    bool failed = ferror(file) != 0;
+    failed |= fclose(file) != 0;
+    if(failed) {
+        LOG_ERROR(BUILD, "Failed to write network file %s", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+
+    LOG_INFO(BUILD, "Saved %u segments and %u connectors to %s", segmentCount, connectorTotal, path.c_str());
+    return true;
+}
+
+bool NetworkFile::validate(const std::string& path) const {
+    const Header& header = *mHeader;
+    if(memcmp(header.mMagic, MAGIC, sizeof(MAGIC)) != 0 || header.mVersion != VERSION ||
+            header.mHeaderSize != sizeof(Header)) {
+        LOG_ERROR(BUILD, "%s is not a network file this version can read", path.c_str());
+        return false;
+    }
+
+    // Node and connector ids must fit below INVALID_ID
+    const uint64_t segmentCount = header.mSegmentCount;
+    const uint64_t nodeCount = segmentCount * 2;
+    const uint64_t connectorTotal = static_cast<uint64_t>(header.mConnectorCount) + header.mTerminatorCount;
+    if(nodeCount >= INVALID_ID || connectorTotal >= INVALID_ID) {
+        LOG_ERROR(BUILD, "Network file %s is too large", path.c_str());
+        return false;
+    }
+
+    // Every section must lie within the file, and all but the name text have a size fixed by the counts
+    const uint64_t expected[SECTION_COUNT] = {
+        segmentCount * sizeof(uint32_t),
+        nodeCount * sizeof(ConnectorId),
+        nodeCount * sizeof(uint8_t),
+        connectorTotal * sizeof(uint8_t),
+        (connectorTotal + 1) * sizeof(uint32_t),
+        header.mAttachmentCount * sizeof(NodeId),
+        (nodeCount + 1) * sizeof(uint32_t),
+        header.mSuccessorCount * sizeof(NodeId),
+        connectorTotal * 2 * sizeof(SegmentId),
+        (segmentCount + connectorTotal + 1) * sizeof(uint32_t),
+        0
+    };
+
+    for(int s = 0; s < SECTION_COUNT; s++) {
+        const SectionEntry& entry = header.mSections[s];
+        if(entry.mOffset % SECTION_ALIGNMENT != 0 || entry.mOffset < sizeof(Header) || entry.mOffset > mSize ||
+                entry.mSize > mSize - entry.mOffset || (s != NAMES && entry.mSize != expected[s])) {
+            LOG_ERROR(BUILD, "Network file %s is truncated or damaged", path.c_str());
+            return false;
+        }
+    }
+
+    // Every id in the tables must be in range, so that the network can be used without further checks
+    bool valid = true;
+
+    const ConnectorId* ends = section<ConnectorId>(NODE_ENDS);
+    const uint8_t* signals = section<uint8_t>(NODE_SIGNALS);
+    uint64_t connectedEnds = 0;
+    for(uint64_t n = 0; n < nodeCount; n++) {
+        valid &= ends[n] < connectorTotal || ends[n] == INVALID_ID;
+        valid &= signals[n] <= SignalState::DISABLED;
+        connectedEnds += ends[n] != INVALID_ID;
+    }
+
+    const uint8_t* terminatorFlags = section<uint8_t>(TERMINATOR_FLAGS);
+    const SegmentId* selections = section<SegmentId>(SELECTIONS);
+    for(uint64_t c = 0; c < connectorTotal; c++) {
+        valid &= terminatorFlags[c] == (c < header.mConnectorCount ? 0 : 1);
+        valid &= selections[c * 2] < segmentCount || selections[c * 2] == INVALID_ID;
+        valid &= selections[c * 2 + 1] < segmentCount || selections[c * 2 + 1] == INVALID_ID;
+    }
+
+    // Each connected segment end is attached to the connector at that end, once, and to nothing else, and
+    // each terminator has the one segment attached
+    const uint32_t* attachmentOffsets = section<uint32_t>(ATTACHMENT_OFFSETS);
+    const NodeId* attachments = section<NodeId>(ATTACHMENTS);
+    std::vector<bool> attached(valid ? nodeCount : 0);
+    valid &= connectedEnds == header.mAttachmentCount;
+    valid &= validOffsets(attachmentOffsets, connectorTotal, header.mAttachmentCount);
+    for(uint64_t c = 0; valid && c < connectorTotal; c++) {
+        valid &= c < header.mConnectorCount || attachmentOffsets[c + 1] - attachmentOffsets[c] == 1;
+        for(uint32_t i = attachmentOffsets[c]; valid && i < attachmentOffsets[c + 1]; i++) {
+            valid &= attachments[i] < nodeCount && ends[attachments[i]] == c && !attached[attachments[i]];
+            if(valid) {
+                attached[attachments[i]] = true;
+            }
+        }
+    }
+
+    // Each selected segment is attached to its connector
+    for(uint64_t c = 0; valid && c < connectorTotal; c++) {
+        for(uint64_t i = c * 2; i < c * 2 + 2; i++) {
+            valid &= selections[i] == INVALID_ID ||
+                     ends[MakeNode(selections[i], Direction::UP)] == c || ends[MakeNode(selections[i], Direction::DOWN)] == c;
+        }
+    }
+
+    // The successors of each node are the segments attached to the connector at its end, other than its own,
+    // each leaving the connector, as RailTopology builds them
+    const uint32_t* successorOffsets = section<uint32_t>(SUCCESSOR_OFFSETS);
+    const NodeId* successors = section<NodeId>(SUCCESSORS);
+    std::vector<NodeId> listedBy(valid ? nodeCount : 0, INVALID_ID);
+    valid &= validOffsets(successorOffsets, nodeCount, header.mSuccessorCount);
+    for(uint64_t n = 0; valid && n < nodeCount; n++) {
+        const SegmentId segment = NodeSegment(n);
+        const ConnectorId c = ends[n];
+
+        uint64_t expected = 0;
+        if(c != INVALID_ID && terminatorFlags[c] == 0) {
+            expected = attachmentOffsets[c + 1] - attachmentOffsets[c] -
+                       (ends[MakeNode(segment, Direction::UP)] == c) - (ends[MakeNode(segment, Direction::DOWN)] == c);
+        }
+        valid &= successorOffsets[n + 1] - successorOffsets[n] == expected;
+
+        for(uint32_t i = successorOffsets[n]; valid && i < successorOffsets[n + 1]; i++) {
+            const NodeId successor = successors[i];
+            valid &= successor < nodeCount && NodeSegment(successor) != segment &&
+                     ends[ReverseNode(successor)] == c && listedBy[successor] != n;
+            if(valid) {
+                listedBy[successor] = n;
+            }
+        }
+    }
+
+    // Every name must be terminated within its own part of the text
+    const uint32_t* nameOffsets = section<uint32_t>(NAME_OFFSETS);
+    const char* names = section<char>(NAMES);
+    const uint64_t nameCount = segmentCount + connectorTotal;
+    valid &= validOffsets(nameOffsets, nameCount, header.mSections[NAMES].mSize);
+    for(uint64_t i = 0; valid && i < nameCount; i++) {
+        valid &= nameOffsets[i + 1] > nameOffsets[i] && names[nameOffsets[i + 1] - 1] == '\0';
+    }
+
+    if(!valid) {
+        LOG_ERROR(BUILD, "Network file %s is damaged", path.c_str());
+    }
+
+    return valid;
+}
@@ -0,0 +1,859 @@
+#include "NetworkGenerator.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <strings.h>
+
+using namespace Rail;
+
+// Main line segments between the passing loops of a line
+static const unsigned int PASSING_LOOP_SPACING = 8;
+
+// The segments drawn for each train before it is left out, if every one would meet another train
+static const unsigned int MAX_TRAIN_ATTEMPTS = 16;
+
+// The terminators of each layout unless told otherwise
+static const unsigned int DEFAULT_GRID_TERMINATORS = 4;
+static const unsigned int DEFAULT_CORRIDOR_TERMINATORS = 2;
+static const unsigned int DEFAULT_HUB_TERMINATORS = 8;
+static const unsigned int DEFAULT_PLANAR_TERMINATORS = 8;
+
+static const char* LAYOUT_NAMES[] = {"grid", "corridor", "hub", "planar"};
+static const char* DISTRIBUTION_NAMES[] = {"constant", "uniform", "exponential"};
+
+static const char* printDirection(Direction d) {
+    return (d == Direction::UP) ? "up" : "down";
+}
+
+bool NetworkGenerator::ParseLayout(const char* name, Layout& layout) {
+    for(int l = Layout::GRID; l <= Layout::PLANAR; l++) {
+        if(strcasecmp(name, LAYOUT_NAMES[l]) == 0) {
+            layout = static_cast<Layout>(l);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool NetworkGenerator::ParseLengthDistribution(const char* name, LengthDistribution& distribution) {
+    for(int d = LengthDistribution::CONSTANT; d <= LengthDistribution::EXPONENTIAL; d++) {
+        if(strcasecmp(name, DISTRIBUTION_NAMES[d]) == 0) {
+            distribution = static_cast<LengthDistribution>(d);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+NetworkGenerator::NetworkGenerator(const Options& options) : mOptions(options), mRandomState(options.mSeed) {
+    // Keep the options within what every layout can be built with
+    mOptions.mSegmentCount = std::max<uint64_t>(mOptions.mSegmentCount, 8);
+    mOptions.mMinLength = std::max(mOptions.mMinLength, 1u);
+    mOptions.mMaxLength = std::max(mOptions.mMaxLength, mOptions.mMinLength);
+    mOptions.mJunctionDegree = std::max(mOptions.mJunctionDegree, 3u);
+
+    mLengths.reserve(mOptions.mSegmentCount + mOptions.mSegmentCount / 8);
+    mNodeJunctions.reserve(mLengths.capacity() * 2);
+
+    switch(mOptions.mLayout) {
+        case Layout::CORRIDOR:
+            planCorridor();
+            break;
+        case Layout::HUB:
+            planHub();
+            break;
+        case Layout::PLANAR:
+            planPlanar();
+            break;
+        default:
+            planGrid();
+            break;
+    }
+
+    finish();
+    planSignals();
+    planTrains();
+
+    LOG_INFO(BUILD, "Generated a %s network of %zu segments, %zu terminators and %zu trains",
+             LAYOUT_NAMES[mOptions.mLayout], mLengths.size(), mTerminals.size(), mTrains.size());
+}
+
+NetworkGenerator::~NetworkGenerator() {
+
+}
+
+void NetworkGenerator::Build(RailNetwork& network, std::vector<TextNetworkLoader::TrainRecord>& trains) const {
+    std::vector<ISegment*> segments(mLengths.size());
+    for(SegmentId s = 0; s < segments.size(); s++) {
+        segments[s] = network.CreateSegment("S" + std::to_string(s), mLengths[s]);
+    }
+
+    // The first segment end at each junction is connected to each of the others in turn
+    for(uint32_t j = 0; j + 1 < mJunctionOffsets.size(); j++) {
+        NodeId first = mJunctionNodes[mJunctionOffsets[j]];
+        for(uint32_t i = mJunctionOffsets[j] + 1; i < mJunctionOffsets[j + 1]; i++) {
+            NodeId node = mJunctionNodes[i];
+            network.ConnectSegments(segments[NodeSegment(first)], NodeDirection(first),
+                                    segments[NodeSegment(node)], NodeDirection(node));
+        }
+    }
+
+    std::vector<IConnector*> terminators(mTerminals.size());
+    for(uint32_t t = 0; t < terminators.size(); t++) {
+        terminators[t] = network.AddTerminator(segments[NodeSegment(mTerminals[t])], NodeDirection(mTerminals[t]),
+                                               "T" + std::to_string(t));
+    }
+
+    for(const auto& signal : mSignals) {
+        network.AddSignal(segments[NodeSegment(signal.mNode)], NodeDirection(signal.mNode), signal.mState);
+    }
+
+    for(uint32_t t = 0; t < mTrains.size(); t++) {
+        const PlannedTrain& train = mTrains[t];
+        trains.push_back(TextNetworkLoader::TrainRecord {
+            "Train" + std::to_string(t),
+            segments[NodeSegment(train.mStart)],
+            NodeDirection(train.mStart),
+            terminators[train.mTerminator]
+        });
+    }
+}
+
+bool NetworkGenerator::Write(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if(file == nullptr) {
+        LOG_ERROR(BUILD, "Failed to open %s to write a network to", path.c_str());
+        return false;
+    }
+
+    // The statements are written in the order Build() makes its calls, so the file loads into the same network
+    fprintf(file, "# %s network of %zu segments, %zu terminators and %zu trains, seed %llu\n",
+            LAYOUT_NAMES[mOptions.mLayout], mLengths.size(), mTerminals.size(), mTrains.size(),
+            static_cast<unsigned long long>(mOptions.mSeed));
+
+    for(SegmentId s = 0; s < mLengths.size(); s++) {
+        fprintf(file, "segment S%u %u\n", s, mLengths[s]);
+    }
+
+    for(uint32_t j = 0; j + 1 < mJunctionOffsets.size(); j++) {
+        NodeId first = mJunctionNodes[mJunctionOffsets[j]];
+        for(uint32_t i = mJunctionOffsets[j] + 1; i < mJunctionOffsets[j + 1]; i++) {
+            NodeId node = mJunctionNodes[i];
+            fprintf(file, "connect S%u %s S%u %s\n", NodeSegment(first), printDirection(NodeDirection(first)),
+                    NodeSegment(node), printDirection(NodeDirection(node)));
+        }
+    }
+
+    for(uint32_t t = 0; t < mTerminals.size(); t++) {
+        fprintf(file, "terminator T%u S%u %s\n", t, NodeSegment(mTerminals[t]), printDirection(NodeDirection(mTerminals[t])));
+    }
+
+    for(const auto& signal : mSignals) {
+        fprintf(file, "signal S%u %s %s\n", NodeSegment(signal.mNode), printDirection(NodeDirection(signal.mNode)),
+                (signal.mState == SignalState::RED) ? "red" : "green");
+    }
+
+    for(uint32_t t = 0; t < mTrains.size(); t++) {
+        const PlannedTrain& train = mTrains[t];
+        fprintf(file, "train Train%u S%u %s T%u\n", t, NodeSegment(train.mStart),
+                printDirection(NodeDirection(train.mStart)), train.mTerminator);
+    }
+
+    bool written = !ferror(file);
+    if(fclose(file) != 0 || !written) {
+        LOG_ERROR(BUILD, "Failed to write the network to %s", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void NetworkGenerator::planGrid() {
+    // A full mesh has two segments per junction, a brick wall one and a half
+    bool brick = mOptions.mJunctionDegree < 4;
+    double segmentsPerJunction = brick ? 1.5 : 2.0;
+    uint32_t size = std::max(2u, static_cast<uint32_t>(std::ceil(std::sqrt(mOptions.mSegmentCount / segmentsPerJunction))));
+
+    for(uint64_t j = 0; j < static_cast<uint64_t>(size) * size; j++) {
+        addJunction();
+    }
+
+    for(uint32_t r = 0; r < size; r++) {
+        for(uint32_t c = 0; c < size; c++) {
+            uint32_t junction = r * size + c;
+            if(c + 1 < size) {
+                addSegment(junction, junction + 1);
+            }
+            if(r + 1 < size && (!brick || (r + c) % 2 == 0)) {
+                addSegment(junction, junction + size);
+            }
+        }
+    }
+
+    // Stubs are spread around the edge, clockwise from the top left corner
+    std::vector<uint32_t> edge;
+    for(uint32_t c = 0; c < size; c++) {
+        edge.push_back(c);
+    }
+    for(uint32_t r = 1; r < size; r++) {
+        edge.push_back(r * size + size - 1);
+    }
+    for(uint32_t c = size - 1; c-- > 0;) {
+        edge.push_back((size - 1) * size + c);
+    }
+    for(uint32_t r = size - 1; r-- > 1;) {
+        edge.push_back(r * size);
+    }
+
+    addStubs(edge, mOptions.mTerminatorCount ? mOptions.mTerminatorCount : DEFAULT_GRID_TERMINATORS);
+}
+
+void NetworkGenerator::planCorridor() {
+    unsigned int terminators = mOptions.mTerminatorCount ? mOptions.mTerminatorCount : DEFAULT_CORRIDOR_TERMINATORS;
+    uint64_t corridors = std::max(1u, terminators / 2);
+    uint64_t corridorLength = std::max<uint64_t>(1, mOptions.mSegmentCount / corridors);
+
+    for(uint64_t c = 0; c < corridors; c++) {
+        SegmentId first = mLengths.size();
+        uint32_t start = addJunction();
+        uint32_t end = planLine(start, corridorLength);
+        mLines.push_back(Line {first, static_cast<SegmentId>(mLengths.size()), start, end});
+    }
+}
+
+void NetworkGenerator::planHub() {
+    unsigned int spokes = std::max(2u, mOptions.mTerminatorCount ? mOptions.mTerminatorCount : DEFAULT_HUB_TERMINATORS);
+
+    // Each junction of the ring takes two ring segments and as many spokes as the junction degree leaves
+    // room for, unless a single junction can take every spoke
+    unsigned int spokesPerJunction = mOptions.mJunctionDegree - 2;
+    unsigned int hubJunctions = (spokes <= mOptions.mJunctionDegree) ? 1 : (spokes + spokesPerJunction - 1) / spokesPerJunction;
+
+    // A ring of two would join the same two junctions twice, which routing could not tell apart
+    hubJunctions = (hubJunctions == 2) ? 3 : hubJunctions;
+
+    for(unsigned int j = 0; j < hubJunctions; j++) {
+        addJunction();
+    }
+    if(hubJunctions > 1) {
+        for(unsigned int j = 0; j < hubJunctions; j++) {
+            addSegment(j, (j + 1) % hubJunctions);
+        }
+    }
+
+    uint64_t spokeLength = std::max<uint64_t>(1, (mOptions.mSegmentCount - mLengths.size()) / spokes);
+    for(unsigned int s = 0; s < spokes; s++) {
+        uint32_t hub = (hubJunctions > 1) ? s / spokesPerJunction : 0;
+        SegmentId first = mLengths.size();
+        uint32_t end = planLine(hub, spokeLength);
+        mLines.push_back(Line {first, static_cast<SegmentId>(mLengths.size()), hub, end});
+    }
+}
+
+void NetworkGenerator::planPlanar() {
+    // A square mesh of junctions with one diagonal across each square is planar, so any set of its links
+    // is too. A random depth first spanning tree of the links keeps the network connected with few
+    // branches, and further links are added at random to reach the segment count. Each junction is left
+    // with at least two segments, so only stubs end at terminators.
+    uint32_t size = std::max(2u, static_cast<uint32_t>(std::ceil(std::sqrt(mOptions.mSegmentCount / 1.5))));
+    uint32_t junctions = size * size;
+    for(uint32_t j = 0; j < junctions; j++) {
+        addJunction();
+    }
+
+    // Links are numbered three to a junction: right, down and diagonally down
+    auto getLink = [&](uint32_t link, uint32_t& from, uint32_t& to) {
+        from = link / 3;
+        uint32_t r = from / size;
+        uint32_t c = from % size;
+        switch(link % 3) {
+            case 0:
+                to = (c + 1 < size) ? from + 1 : INVALID_ID;
+                break;
+            case 1:
+                to = (r + 1 < size) ? from + size : INVALID_ID;
+                break;
+            default:
+                // Each square has one diagonal, leaning either way
+                if(r + 1 >= size || c + 1 >= size) {
+                    to = INVALID_ID;
+                } else if((r * 31 + c * 17 + mOptions.mSeed) % 2) {
+                    to = from + size + 1;
+                } else {
+                    from = from + 1;
+                    to = from + size - 1;
+                }
+                break;
+        }
+    };
+
+    // The links of a junction are those numbered from it, from its neighbours to the left and above, and
+    // the diagonals of the four squares around it
+    auto getLinks = [&](uint32_t junction, uint32_t* links) {
+        uint32_t r = junction / size;
+        uint32_t c = junction % size;
+        uint32_t candidates[8] = {junction * 3, junction * 3 + 1, junction * 3 + 2, INVALID_ID,
+                                  INVALID_ID, INVALID_ID, INVALID_ID, INVALID_ID};
+        if(c > 0) {
+            candidates[3] = (junction - 1) * 3;
+            candidates[4] = (junction - 1) * 3 + 2;
+        }
+        if(r > 0) {
+            candidates[5] = (junction - size) * 3 + 1;
+            candidates[6] = (junction - size) * 3 + 2;
+            if(c > 0) {
+                candidates[7] = (junction - size - 1) * 3 + 2;
+            }
+        }
+
+        unsigned int count = 0;
+        for(uint32_t link : candidates) {
+            uint32_t from, to;
+            if(link != INVALID_ID) {
+                getLink(link, from, to);
+                if(to != INVALID_ID && (from == junction || to == junction)) {
+                    links[count++] = link;
+                }
+            }
+        }
+        return count;
+    };
+
+    std::vector<uint8_t> used(static_cast<size_t>(junctions) * 3, 0);
+    auto addLink = [&](uint32_t link) {
+        uint32_t from, to;
+        getLink(link, from, to);
+        addSegment(from, to);
+        used[link] = 1;
+    };
+
+    auto fits = [&](uint32_t link) {
+        uint32_t from, to;
+        getLink(link, from, to);
+        return mJunctionDegrees[from] < mOptions.mJunctionDegree && mJunctionDegrees[to] < mOptions.mJunctionDegree;
+    };
+
+    // Each frame of the search tries the links of its junction in turn, from a random one
+    struct Frame {
+        uint32_t mJunction;
+        uint8_t mNext;
+        uint8_t mOffset;
+    };
+
+    // The search may not reach every junction within the junction degree, so it runs again from each
+    // junction not yet reached, and the trees it grows are joined afterwards
+    std::vector<uint32_t> trees(junctions, INVALID_ID);
+    std::vector<Frame> stack;
+    uint32_t treeCount = 0;
+    for(uint32_t root = 0; root < junctions; root++) {
+        if(trees[root] != INVALID_ID) {
+            continue;
+        }
+
+        trees[root] = treeCount++;
+        stack.push_back(Frame {root, 0, static_cast<uint8_t>(nextRandom(6))});
+        while(!stack.empty()) {
+            Frame& frame = stack.back();
+            uint32_t links[6];
+            unsigned int count = getLinks(frame.mJunction, links);
+            if(frame.mNext >= count || mJunctionDegrees[frame.mJunction] >= mOptions.mJunctionDegree) {
+                stack.pop_back();
+                continue;
+            }
+
+            uint32_t link = links[(frame.mNext++ + frame.mOffset) % count];
+            uint32_t from, to;
+            getLink(link, from, to);
+            uint32_t next = (from == frame.mJunction) ? to : from;
+            if(trees[next] == INVALID_ID) {
+                trees[next] = trees[root];
+                addLink(link);
+                stack.push_back(Frame {next, 0, static_cast<uint8_t>(nextRandom(6))});
+            }
+        }
+    }
+
+    std::vector<uint32_t> links;
+    for(uint32_t link = 0; link < used.size(); link++) {
+        uint32_t from, to;
+        getLink(link, from, to);
+        if(to != INVALID_ID && !used[link]) {
+            links.push_back(link);
+        }
+    }
+
+    for(size_t i = links.size(); i > 1; i--) {
+        std::swap(links[i - 1], links[nextRandom(i)]);
+    }
+
+    // Join the trees, within the junction degree where possible
+    std::vector<uint32_t> parents(treeCount);
+    for(uint32_t t = 0; t < treeCount; t++) {
+        parents[t] = t;
+    }
+    auto findRoot = [&](uint32_t t) {
+        while(parents[t] != t) {
+            parents[t] = parents[parents[t]];
+            t = parents[t];
+        }
+        return t;
+    };
+
+    for(int pass = 0; pass < 2 && treeCount > 1; pass++) {
+        for(size_t i = 0; i < links.size() && treeCount > 1; i++) {
+            uint32_t from, to;
+            getLink(links[i], from, to);
+            uint32_t fromRoot = findRoot(trees[from]);
+            uint32_t toRoot = findRoot(trees[to]);
+            if(fromRoot != toRoot && !used[links[i]] && (pass > 0 || fits(links[i]))) {
+                parents[fromRoot] = toRoot;
+                treeCount--;
+                addLink(links[i]);
+            }
+        }
+    }
+
+    // Leaves of the tree would otherwise become terminators, so each is given another link, within the
+    // junction degree if it can be, before and after the rest are added
+    auto joinLeaves = [&](bool withinDegree) {
+        for(uint32_t j = 0; j < junctions; j++) {
+            if(mJunctionDegrees[j] != 1) {
+                continue;
+            }
+
+            uint32_t candidates[6];
+            unsigned int count = getLinks(j, candidates);
+            uint32_t chosen = INVALID_ID;
+            for(unsigned int i = 0; i < count; i++) {
+                if(!used[candidates[i]] && (fits(candidates[i]) || (!withinDegree && chosen == INVALID_ID))) {
+                    chosen = candidates[i];
+                }
+            }
+            if(chosen != INVALID_ID) {
+                addLink(chosen);
+            }
+        }
+    };
+    joinLeaves(true);
+
+    // Further links, each taken with the chance that leaves the segment count as asked
+    uint64_t wanted = (mOptions.mSegmentCount > mLengths.size()) ? mOptions.mSegmentCount - mLengths.size() : 0;
+    uint64_t remaining = std::count_if(links.begin(), links.end(), [&](uint32_t link) { return !used[link]; });
+    for(uint32_t link : links) {
+        if(used[link]) {
+            continue;
+        }
+        if(wanted > 0 && fits(link) && nextRandom(remaining) < wanted) {
+            addLink(link);
+            wanted--;
+        }
+        remaining--;
+    }
+
+    joinLeaves(false);
+
+    // Stubs go on randomly chosen junctions
+    std::vector<uint32_t> candidates;
+    unsigned int stubs = mOptions.mTerminatorCount ? mOptions.mTerminatorCount : DEFAULT_PLANAR_TERMINATORS;
+    for(unsigned int s = 0; s < stubs * 4; s++) {
+        candidates.push_back(nextRandom(junctions));
+    }
+    addStubs(candidates, stubs);
+}
+
+uint32_t NetworkGenerator::planLine(uint32_t start, uint64_t segmentCount) {
+    // Each passing loop takes two segments beside a main line segment, away from the ends of the line so
+    // that they stay terminators
+    uint64_t mainSegments = std::max<uint64_t>(1, segmentCount * PASSING_LOOP_SPACING / (PASSING_LOOP_SPACING + 2));
+
+    uint32_t junction = start;
+    uint32_t loopStart = INVALID_ID;
+    for(uint64_t i = 0; i < mainSegments; i++) {
+        uint32_t next = addJunction();
+        addSegment(junction, next);
+
+        // Segments joined at both ends could not be told apart when routing, so the loop is in two halves.
+        // It is added after the main line on both sides, so that the junctions are first switched along the
+        // main line
+        if(loopStart != INVALID_ID) {
+            uint32_t middle = addJunction();
+            addSegment(loopStart, middle);
+            addSegment(middle, junction);
+            loopStart = INVALID_ID;
+        }
+        if(i > 0 && i + 1 < mainSegments && i % PASSING_LOOP_SPACING == PASSING_LOOP_SPACING / 2) {
+            loopStart = junction;
+        }
+        junction = next;
+    }
+
+    return junction;
+}
+
+uint32_t NetworkGenerator::addJunction() {
+    mJunctionDegrees.push_back(0);
+    return mJunctionDegrees.size() - 1;
+}
+
+SegmentId NetworkGenerator::addSegment(uint32_t down, uint32_t up) {
+    SegmentId segment = mLengths.size();
+    mLengths.push_back(nextLength());
+
+    // Nodes are numbered by the end of the segment they head towards, see MakeNode()
+    mNodeJunctions.push_back(up);
+    mNodeJunctions.push_back(down);
+    mJunctionDegrees[up]++;
+    mJunctionDegrees[down]++;
+
+    return segment;
+}
+
+void NetworkGenerator::addStub(uint32_t junction) {
+    addSegment(junction, addJunction());
+}
+
+void NetworkGenerator::addStubs(const std::vector<uint32_t>& candidates, unsigned int count) {
+    if(candidates.empty()) {
+        return;
+    }
+
+    for(unsigned int s = 0; s < count; s++) {
+        size_t first = static_cast<size_t>(s) * candidates.size() / count;
+        for(size_t i = 0; i < candidates.size(); i++) {
+            uint32_t junction = candidates[(first + i) % candidates.size()];
+            if(mJunctionDegrees[junction] < mOptions.mJunctionDegree) {
+                addStub(junction);
+                break;
+            }
+        }
+    }
+}
+
+void NetworkGenerator::finish() {
+    uint32_t junctions = mJunctionDegrees.size();
+    mJunctionTerminators.assign(junctions, INVALID_ID);
+
+    // Count the segment ends at each junction which is not a terminator, then place them in node order
+    mJunctionOffsets.assign(junctions + 1, 0);
+    for(NodeId n = 0; n < mNodeJunctions.size(); n++) {
+        uint32_t junction = mNodeJunctions[n];
+        if(mJunctionDegrees[junction] == 1) {
+            mJunctionTerminators[junction] = mTerminals.size();
+            mTerminals.push_back(n);
+        } else {
+            mJunctionOffsets[junction + 1]++;
+        }
+    }
+
+    for(uint32_t j = 0; j < junctions; j++) {
+        mJunctionOffsets[j + 1] += mJunctionOffsets[j];
+    }
+
+    mJunctionNodes.resize(mJunctionOffsets[junctions]);
+    std::vector<uint32_t> next(mJunctionOffsets.begin(), mJunctionOffsets.end() - 1);
+    for(NodeId n = 0; n < mNodeJunctions.size(); n++) {
+        uint32_t junction = mNodeJunctions[n];
+        if(mJunctionDegrees[junction] != 1) {
+            mJunctionNodes[next[junction]++] = n;
+        }
+    }
+}
+
+void NetworkGenerator::planSignals() {
+    if(mOptions.mSignalDensity <= 0.0) {
+        return;
+    }
+
+    for(NodeId n = 0; n < mNodeJunctions.size(); n++) {
+        if(nextUnit() < mOptions.mSignalDensity) {
+            SignalState state = (nextUnit() < mOptions.mRedSignalRatio) ? SignalState::RED : SignalState::GREEN;
+            mSignals.push_back(PlannedSignal {n, state});
+        }
+    }
+}
+
+void NetworkGenerator::planTrains() {
+    if(mTerminals.empty()) {
+        return;
+    }
+
+    // Each train takes a segment of its own, the next free one after where it was drawn
+    size_t count = std::min<size_t>(mOptions.mTrainCount, mLengths.size());
+    std::vector<uint8_t> taken(mLengths.size(), 0);
+    if(!mOptions.mConflictFree) {
+        for(size_t t = 0; t < count; t++) {
+            SegmentId segment = nextRandom(mLengths.size());
+            while(taken[segment]) {
+                segment = (segment + 1) % mLengths.size();
+            }
+            taken[segment] = 1;
+
+            Direction direction;
+            uint32_t terminator = pickTerminator(segment, direction);
+            mTrains.push_back(PlannedTrain {MakeNode(segment, direction), terminator});
+        }
+        return;
+    }
+
+    const size_t nodes = mNodeJunctions.size();
+    mRedNodes.assign(nodes, 0);
+    for(const auto& signal : mSignals) {
+        mRedNodes[signal.mNode] = (signal.mState == SignalState::RED);
+    }
+
+    mDistances.assign(nodes, UINT64_MAX);
+    mEarliestTicks.assign(nodes, 0);
+    mLatestTicks.assign(nodes, 0);
+    mOnRoute.assign(nodes, 0);
+
+    // A train which would meet another is drawn again, and left out if it still does
+    for(size_t t = 0; t < count; t++) {
+        for(unsigned int attempt = 0; attempt < MAX_TRAIN_ATTEMPTS; attempt++) {
+            SegmentId segment = nextRandom(mLengths.size());
+            while(taken[segment]) {
+                segment = (segment + 1) % mLengths.size();
+            }
+
+            Direction direction;
+            uint32_t terminator = pickTerminator(segment, direction);
+            if(reserveRoute(MakeNode(segment, direction), terminator)) {
+                taken[segment] = 1;
+                mTrains.push_back(PlannedTrain {MakeNode(segment, direction), terminator});
+                break;
+            }
+        }
+    }
+
+    if(mTrains.size() < count) {
+        LOG_WARNING(BUILD, "Planned %zu of %zu trains, the others would have met a train or a red signal",
+                    mTrains.size(), count);
+    }
+
+    // The reservations are only needed while planning
+    std::vector<uint8_t>().swap(mRedNodes);
+    std::unordered_map<SegmentId, std::vector<Reservation>>().swap(mSegmentReservations);
+    std::unordered_map<uint32_t, std::vector<Reservation>>().swap(mJunctionReservations);
+    std::vector<uint64_t>().swap(mDistances);
+    std::vector<uint64_t>().swap(mEarliestTicks);
+    std::vector<uint64_t>().swap(mLatestTicks);
+    std::vector<uint8_t>().swap(mOnRoute);
+    std::vector<NodeId>().swap(mReached);
+    std::vector<NodeId>().swap(mSettled);
+}
+
+bool NetworkGenerator::reserveRoute(NodeId start, uint32_t terminator) {
+    const uint32_t destination = mNodeJunctions[mTerminals[terminator]];
+
+    // Search for the shortest distance to the terminator from the start as the routing engines do, counting
+    // the whole of the starting segment, and keep the nodes settled in order of distance
+    typedef std::pair<uint64_t, NodeId> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    auto reach = [&](NodeId node, uint64_t distance) {
+        if(mDistances[node] == UINT64_MAX) {
+            mReached.push_back(node);
+        }
+        mDistances[node] = distance;
+        queue.push(Entry(distance, node));
+    };
+
+    mReached.clear();
+    mSettled.clear();
+    reach(start, mLengths[NodeSegment(start)]);
+
+    uint64_t shortest = UINT64_MAX;
+    NodeId last = INVALID_ID;
+    while(!queue.empty() && queue.top().first < shortest) {
+        Entry entry = queue.top();
+        queue.pop();
+        if(entry.first != mDistances[entry.second]) {
+            continue;
+        }
+
+        const NodeId node = entry.second;
+        const uint32_t junction = mNodeJunctions[node];
+        mSettled.push_back(node);
+        if(junction == destination) {
+            shortest = entry.first;
+            last = node;
+            continue;
+        }
+
+        for(uint32_t i = mJunctionOffsets[junction]; i < mJunctionOffsets[junction + 1]; i++) {
+            const NodeId next = ReverseNode(mJunctionNodes[i]);
+            const uint64_t distance = entry.first + mLengths[NodeSegment(next)];
+            if(NodeSegment(next) != NodeSegment(node) && distance < mDistances[next]) {
+                reach(next, distance);
+            }
+        }
+    }
+
+    // The nodes before another on a shortest route, each a segment end at the junction it is entered from
+    auto forEachPrevious = [&](NodeId node, const std::function<void(NodeId)>& visit) {
+        const uint32_t junction = mNodeJunctions[ReverseNode(node)];
+        for(uint32_t i = mJunctionOffsets[junction]; i < mJunctionOffsets[junction + 1]; i++) {
+            const NodeId previous = mJunctionNodes[i];
+            if(NodeSegment(previous) != NodeSegment(node) && mDistances[previous] != UINT64_MAX &&
+               mDistances[previous] + mLengths[NodeSegment(node)] == mDistances[node]) {
+                visit(previous);
+            }
+        }
+    };
+
+    // Mark every node on a shortest route, back from the terminator
+    std::vector<NodeId> stack;
+    if(last != INVALID_ID) {
+        mOnRoute[last] = 1;
+        stack.push_back(last);
+    }
+    while(!stack.empty()) {
+        NodeId node = stack.back();
+        stack.pop_back();
+        forEachPrevious(node, [&](NodeId previous) {
+            if(!mOnRoute[previous]) {
+                mOnRoute[previous] = 1;
+                stack.push_back(previous);
+            }
+        });
+    }
+
+    // A train takes a tick to move each unit along a segment, and one more to leave it. A train which has
+    // just crossed a junction is still where it entered until its turn in the next tick, so each crossing
+    // holds its junction for that tick too, as does the start of the train. Nodes are settled after those
+    // before them on a route, so the ticks of those are known first
+    const Reservation departure {0, 1, NodeDirection(start)};
+    auto startReservations = mJunctionReservations.find(mNodeJunctions[ReverseNode(start)]);
+    bool free = (last != INVALID_ID) &&
+                isFree((startReservations != mJunctionReservations.end()) ? &startReservations->second : nullptr,
+                       departure, false);
+    for(NodeId node : mSettled) {
+        if(!mOnRoute[node]) {
+            continue;
+        }
+
+        if(node == start) {
+            mEarliestTicks[node] = 0;
+            mLatestTicks[node] = 0;
+        } else {
+            mEarliestTicks[node] = UINT64_MAX;
+            mLatestTicks[node] = 0;
+            forEachPrevious(node, [&](NodeId previous) {
+                if(mOnRoute[previous]) {
+                    const uint64_t crossing = mLengths[NodeSegment(previous)] + 1;
+                    mEarliestTicks[node] = std::min(mEarliestTicks[node], mEarliestTicks[previous] + crossing);
+                    mLatestTicks[node] = std::max(mLatestTicks[node], mLatestTicks[previous] + crossing);
+                }
+            });
+        }
+
+        const uint32_t length = mLengths[NodeSegment(node)];
+        const Reservation onSegment {mEarliestTicks[node], mLatestTicks[node] + length, NodeDirection(node)};
+        const Reservation crossing {mEarliestTicks[node] + length + 1, mLatestTicks[node] + length + 2,
+                                    NodeDirection(node)};
+        auto segmentReservations = mSegmentReservations.find(NodeSegment(node));
+        auto junctionReservations = mJunctionReservations.find(mNodeJunctions[node]);
+
+        free = free && !mRedNodes[node] &&
+               isFree((segmentReservations != mSegmentReservations.end()) ? &segmentReservations->second : nullptr,
+                      onSegment, true) &&
+               isFree((junctionReservations != mJunctionReservations.end()) ? &junctionReservations->second : nullptr,
+                      crossing, false);
+    }
+
+    if(free) {
+        mJunctionReservations[mNodeJunctions[ReverseNode(start)]].push_back(departure);
+        for(NodeId node : mSettled) {
+            if(mOnRoute[node]) {
+                const uint32_t length = mLengths[NodeSegment(node)];
+                mSegmentReservations[NodeSegment(node)].push_back(
+                        Reservation {mEarliestTicks[node], mLatestTicks[node] + length, NodeDirection(node)});
+                mJunctionReservations[mNodeJunctions[node]].push_back(
+                        Reservation {mEarliestTicks[node] + length + 1, mLatestTicks[node] + length + 2,
+                                     NodeDirection(node)});
+            }
+        }
+    }
+
+    for(NodeId node : mReached) {
+        mDistances[node] = UINT64_MAX;
+        mOnRoute[node] = 0;
+    }
+
+    return free;
+}
+
+bool NetworkGenerator::isFree(const std::vector<Reservation>* reservations, const Reservation& reservation,
+                              bool sameDirection) {
+    if(reservations == nullptr) {
+        return true;
+    }
+
+    for(const auto& other : *reservations) {
+        bool overlaps = other.mFirst <= reservation.mLast && reservation.mFirst <= other.mLast;
+        if(overlaps && !(sameDirection && other.mDirection == reservation.mDirection)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t NetworkGenerator::pickTerminator(SegmentId segment, Direction& direction) {
+    direction = nextRandom(2) ? Direction::UP : Direction::DOWN;
+
+    auto line = std::upper_bound(mLines.begin(), mLines.end(), segment, [](SegmentId s, const Line& l) {
+        return s < l.mLast;
+    });
+
+    if(line != mLines.end() && segment >= line->mFirst) {
+        if(mOptions.mLayout == Layout::CORRIDOR) {
+            // Along the corridor to the terminator at the end it is heading for
+            return mJunctionTerminators[(direction == Direction::UP) ? line->mUpJunction : line->mDownJunction];
+        }
+
+        // In to the hub and out along another spoke
+        direction = Direction::DOWN;
+        size_t other = nextRandom(mLines.size() - 1);
+        if(other >= static_cast<size_t>(line - mLines.begin())) {
+            other++;
+        }
+        return mJunctionTerminators[mLines[other].mUpJunction];
+    }
+
+    return nextRandom(mTerminals.size());
+}
+
+uint64_t NetworkGenerator::nextRandom() {
+    // SplitMix64, which gives the same sequence on every platform
+    uint64_t z = (mRandomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t NetworkGenerator::nextRandom(uint64_t bound) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(nextRandom()) * bound) >> 64);
+}
+
+double NetworkGenerator::nextUnit() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+unsigned int NetworkGenerator::nextLength() {
+    switch(mOptions.mLengthDistribution) {
+        case LengthDistribution::CONSTANT:
+            return mOptions.mMinLength;
+        case LengthDistribution::EXPONENTIAL: {
+            double mean = (mOptions.mMaxLength - mOptions.mMinLength) / 4.0;
+            double length = mOptions.mMinLength - std::log(1.0 - nextUnit()) * mean;
+            return std::min(static_cast<unsigned int>(length), mOptions.mMaxLength);
+        }
+        default:
+            return mOptions.mMinLength + nextRandom(mOptions.mMaxLength - mOptions.mMinLength + 1);
+    }
+}
@@ -0,0 +1,475 @@
+#include "NetworkLoader.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+using namespace Rail;
+
+// The most fields a statement has, and the most errors logged for a file
+static const unsigned int MAX_FIELDS = 6;
+static const size_t MAX_REPORTED_ERRORS = 100;
+
+static std::string toString(const char* text, size_t length) {
+    return std::string(text, length);
+}
+
+static bool isKeyword(const char* text, size_t length, const char* keyword) {
+    return length == strlen(keyword) && strncasecmp(text, keyword, length) == 0;
+}
+
+static bool parseDirection(const char* text, size_t length, Direction& direction) {
+    if(isKeyword(text, length, "up")) {
+        direction = Direction::UP;
+    } else if(isKeyword(text, length, "down")) {
+        direction = Direction::DOWN;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static bool parseSignalState(const char* text, size_t length, SignalState& state) {
+    if(isKeyword(text, length, "red")) {
+        state = SignalState::RED;
+    } else if(isKeyword(text, length, "green")) {
+        state = SignalState::GREEN;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static bool parseLength(const char* text, size_t length, uint32_t& value) {
+    uint64_t result = 0;
+    for(size_t i = 0; i < length; i++) {
+        if(text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+
+        result = result * 10 + (text[i] - '0');
+        if(result > UINT32_MAX) {
+            return false;
+        }
+    }
+
+    value = result;
+    return length > 0 && result > 0;
+}
+
+TextNetworkLoader::TextNetworkLoader(RailNetwork& network, unsigned int threadCount, size_t chunkSize) :
+    mNetwork(network), mChunkSize(chunkSize)
+{
+    if(threadCount > 1) {
+        mThreadPool = new Util::ThreadPool(threadCount);
+    }
+}
+
+TextNetworkLoader::~TextNetworkLoader() {
+    delete mThreadPool;
+}
+
+bool TextNetworkLoader::Load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == nullptr) {
+        LOG_ERROR(BUILD, "Failed to open network file %s", path.c_str());
+        mErrorCount++;
+        return false;
+    }
+
+    const size_t startingErrorCount = mErrorCount;
+    mCarry.clear();
+    mNextLine = 1;
+    mErrors.clear();
+    mPending.clear();
+
+    // Parse a couple of chunks per thread at a time, so that uneven chunks are balanced across the pool
+    const unsigned int threadCount = (mThreadPool != nullptr) ? mThreadPool->GetThreadCount() : 1;
+    std::vector<Chunk> batch(threadCount * 2);
+
+    bool more = true;
+    while(more) {
+        size_t chunkCount = 0;
+        while(chunkCount < batch.size() && (more = readChunk(file, batch[chunkCount]))) {
+            chunkCount++;
+        }
+
+        if(mThreadPool != nullptr) {
+            mThreadPool->ParallelFor(chunkCount, [&](size_t i, unsigned int worker) {
+                parseChunk(batch[i]);
+            });
+        } else {
+            for(size_t i = 0; i < chunkCount; i++) {
+                parseChunk(batch[i]);
+            }
+        }
+
+        // Apply the statements in file order, so that components are created in the order they are defined
+        for(size_t i = 0; i < chunkCount; i++) {
+            Chunk& chunk = batch[i];
+            for(const auto& error : chunk.mErrors) {
+                addError(mNextLine + error.mLine, error.mMessage);
+            }
+
+            PendingStatement statement;
+            for(const auto& parsed : chunk.mStatements) {
+                statement.mType = parsed.mType;
+                statement.mLine = mNextLine + parsed.mLine;
+                for(unsigned int n = 0; n < 3; n++) {
+                    statement.mNames[n].assign(parsed.mNames[n].mText, parsed.mNames[n].mLength);
+                }
+                statement.mDirections[0] = parsed.mDirections[0];
+                statement.mDirections[1] = parsed.mDirections[1];
+                statement.mValue = parsed.mValue;
+
+                // Once a statement is kept back, so is every later one but a segment, so that they are all
+                // applied in file order. Segments only define names, so may be created as they are read
+                if(!mPending.empty() && statement.mType != StatementType::SEGMENT) {
+                    mPending.push_back(statement);
+                } else {
+                    apply(statement, false);
+                }
+            }
+
+            mNextLine += chunk.mLineCount;
+        }
+    }
+
+    if(ferror(file) != 0) {
+        LOG_ERROR(BUILD, "Failed to read network file %s", path.c_str());
+        mErrorCount++;
+    }
+    fclose(file);
+
+    // Link the statements kept back, now that every segment is defined. Trains change nothing in the
+    // network, so are added last, once every terminator is defined too
+    std::vector<PendingStatement> pending;
+    pending.swap(mPending);
+    for(const auto& statement : pending) {
+        if(statement.mType != StatementType::TRAIN) {
+            apply(statement, true);
+        }
+    }
+    for(const auto& statement : pending) {
+        if(statement.mType == StatementType::TRAIN) {
+            apply(statement, true);
+        }
+    }
+
+    // Errors in the segments are found before those in the statements kept back
+    std::stable_sort(mErrors.begin(), mErrors.end(),
+            [](const Error& a, const Error& b) { return a.mLine < b.mLine; });
+
+    for(size_t i = 0; i < mErrors.size() && i < MAX_REPORTED_ERRORS; i++) {
+        LOG_ERROR(BUILD, "%s:%llu: %s", path.c_str(), static_cast<unsigned long long>(mErrors[i].mLine),
+                mErrors[i].mMessage.c_str());
+    }
+
+    if(mErrors.size() > MAX_REPORTED_ERRORS) {
+        LOG_ERROR(BUILD, "%s: %zu more errors", path.c_str(), mErrors.size() - MAX_REPORTED_ERRORS);
+    }
+    mErrors.clear();
+
+    LOG_INFO(BUILD, "Loaded %s: %llu lines, %zu segments, %zu terminators, %zu trains", path.c_str(),
+            static_cast<unsigned long long>(mNextLine - 1), mSegments.size(), mTerminators.size(), mTrains.size());
+    return mErrorCount == startingErrorCount;
+}
+
+bool TextNetworkLoader::readChunk(FILE* file, Chunk& chunk) {
+    // Start with the partial line left over from the last chunk
+    chunk.mText.swap(mCarry);
+    mCarry.clear();
+    size_t size = chunk.mText.size();
+
+    while(true) {
+        chunk.mText.resize(size + mChunkSize);
+        size_t read = fread(chunk.mText.data() + size, 1, mChunkSize, file);
+        if(read == 0) {
+            // The last line of the file need not end with a newline
+            chunk.mSize = size;
+            return size > 0;
+        }
+
+        // Keep whole lines, and carry the rest over to the next chunk. A line longer than a chunk is
+        // read into a larger chunk
+        const char* text = chunk.mText.data();
+        for(size_t end = size + read; end > size; end--) {
+            if(text[end - 1] == '\n') {
+                mCarry.assign(text + end, text + size + read);
+                chunk.mSize = end;
+                return true;
+            }
+        }
+
+        size += read;
+    }
+}
+
+void TextNetworkLoader::parseChunk(Chunk& chunk) {
+    chunk.mStatements.clear();
+    chunk.mErrors.clear();
+
+    const char* text = chunk.mText.data();
+    const char* end = text + chunk.mSize;
+    uint32_t line = 0;
+    std::string error;
+
+    for(const char* first = text; first < end; line++) {
+        const char* last = static_cast<const char*>(memchr(first, '\n', end - first));
+        if(last == nullptr) {
+            last = end;
+        }
+
+        Statement statement;
+        if(parseLine(first, last, statement, error)) {
+            statement.mLine = line;
+            chunk.mStatements.push_back(statement);
+        } else if(!error.empty()) {
+            chunk.mErrors.push_back(Error {line, error});
+        }
+
+        first = last + 1;
+    }
+
+    chunk.mLineCount = line;
+}
+
+bool TextNetworkLoader::parseLine(const char* first, const char* last, Statement& statement, std::string& error) {
+    error.clear();
+
+    const char* comment = static_cast<const char*>(memchr(first, '#', last - first));
+    if(comment != nullptr) {
+        last = comment;
+    }
+
+    // Split the line into fields
+    Field fields[MAX_FIELDS + 1];
+    unsigned int fieldCount = 0;
+    for(const char* c = first; c < last; ) {
+        if(*c == ' ' || *c == '\t' || *c == '\r') {
+            c++;
+            continue;
+        }
+
+        const char* start = c;
+        while(c < last && *c != ' ' && *c != '\t' && *c != '\r') {
+            c++;
+        }
+
+        if(fieldCount > MAX_FIELDS) {
+            break;
+        }
+        fields[fieldCount++] = Field {start, static_cast<uint32_t>(c - start)};
+    }
+
+    if(fieldCount == 0) {
+        return false;
+    }
+
+    const Field& keyword = fields[0];
+    unsigned int expected = 0;
+    if(isKeyword(keyword.mText, keyword.mLength, "segment")) {
+        statement.mType = StatementType::SEGMENT;
+        expected = 3;
+    } else if(isKeyword(keyword.mText, keyword.mLength, "connect")) {
+        statement.mType = StatementType::CONNECT;
+        expected = 5;
+    } else if(isKeyword(keyword.mText, keyword.mLength, "terminator")) {
+        statement.mType = StatementType::TERMINATOR;
+        expected = 4;
+    } else if(isKeyword(keyword.mText, keyword.mLength, "signal")) {
+        statement.mType = StatementType::SIGNAL;
+        expected = 4;
+    } else if(isKeyword(keyword.mText, keyword.mLength, "train")) {
+        statement.mType = StatementType::TRAIN;
+        expected = 5;
+    } else {
+        error = "Unknown statement '" + toString(keyword.mText, keyword.mLength) + "'";
+        return false;
+    }
+
+    if(fieldCount != expected) {
+        error = "Expected " + std::to_string(expected - 1) + " fields after '" +
+                toString(keyword.mText, keyword.mLength) + "'";
+        return false;
+    }
+
+    // The positions of the names and directions of each type of statement
+    statement.mNames[0] = statement.mNames[1] = statement.mNames[2] = Field {"", 0};
+    statement.mDirections[0] = statement.mDirections[1] = Direction::UP;
+    statement.mValue = 0;
+
+    unsigned int directionFields[2] = {0, 0};
+    switch(statement.mType) {
+        case StatementType::SEGMENT:
+            statement.mNames[0] = fields[1];
+            if(!parseLength(fields[2].mText, fields[2].mLength, statement.mValue)) {
+                error = "Invalid length '" + toString(fields[2].mText, fields[2].mLength) + "'";
+                return false;
+            }
+            break;
+        case StatementType::CONNECT:
+            statement.mNames[0] = fields[1];
+            statement.mNames[1] = fields[3];
+            directionFields[0] = 2;
+            directionFields[1] = 4;
+            break;
+        case StatementType::TERMINATOR:
+            statement.mNames[0] = fields[1];
+            statement.mNames[1] = fields[2];
+            directionFields[0] = 3;
+            break;
+        case StatementType::SIGNAL: {
+            statement.mNames[0] = fields[1];
+            directionFields[0] = 2;
+
+            SignalState state;
+            if(!parseSignalState(fields[3].mText, fields[3].mLength, state)) {
+                error = "Invalid signal state '" + toString(fields[3].mText, fields[3].mLength) + "'";
+                return false;
+            }
+            statement.mValue = state;
+            break;
+        }
+        case StatementType::TRAIN:
+            statement.mNames[0] = fields[1];
+            statement.mNames[1] = fields[2];
+            statement.mNames[2] = fields[4];
+            directionFields[0] = 3;
+            break;
+    }
+
+    for(unsigned int i = 0; i < 2 && directionFields[i] != 0; i++) {
+        const Field& field = fields[directionFields[i]];
+        if(!parseDirection(field.mText, field.mLength, statement.mDirections[i])) {
+            error = "Invalid direction '" + toString(field.mText, field.mLength) + "'";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TextNetworkLoader::apply(const PendingStatement& statement, bool final) {
+    const std::string* names = statement.mNames;
+    const Direction* directions = statement.mDirections;
+
+    switch(statement.mType) {
+        case StatementType::SEGMENT: {
+            if(mSegments.find(names[0]) != mSegments.end()) {
+                addError(statement.mLine, "Segment " + names[0] + " is already defined");
+                return;
+            }
+
+            mSegments[names[0]] = mNetwork.CreateSegment(names[0], statement.mValue);
+            break;
+        }
+        case StatementType::CONNECT: {
+            ISegment* s1 = findSegment(statement, 0, final);
+            ISegment* s2 = (s1 != nullptr) ? findSegment(statement, 1, final) : nullptr;
+            if(s1 == nullptr || s2 == nullptr) {
+                return;
+            }
+
+            if(s1->GetNext(directions[0]) != nullptr && s2->GetNext(directions[1]) != nullptr) {
+                addError(statement.mLine, "Segments " + names[0] + " and " + names[1] + " are both already connected");
+                return;
+            }
+
+            // A terminator ends the track, so nothing more can join it
+            for(unsigned int i = 0; i < 2; i++) {
+                ISegment* segment = (i == 0) ? s1 : s2;
+                if(mTerminatorConnectors.count(segment->GetNext(directions[i])) != 0) {
+                    addError(statement.mLine, "Segment " + names[i] + " ends at a terminator " + PrintDirection(directions[i]));
+                    return;
+                }
+            }
+
+            mNetwork.ConnectSegments(s1, directions[0], s2, directions[1]);
+            break;
+        }
+        case StatementType::TERMINATOR: {
+            ISegment* segment = findSegment(statement, 1, final);
+            if(segment == nullptr) {
+                return;
+            }
+
+            if(mTerminators.find(names[0]) != mTerminators.end()) {
+                addError(statement.mLine, "Terminator " + names[0] + " is already defined");
+                return;
+            }
+
+            if(segment->GetNext(directions[0]) != nullptr) {
+                addError(statement.mLine, "Segment " + names[1] + " is already connected " + PrintDirection(directions[0]));
+                return;
+            }
+
+            IConnector* terminator = mNetwork.AddTerminator(segment, directions[0], names[0]);
+            mTerminators[names[0]] = terminator;
+            mTerminatorConnectors.insert(terminator);
+            break;
+        }
+        case StatementType::SIGNAL: {
+            ISegment* segment = findSegment(statement, 0, final);
+            if(segment == nullptr) {
+                return;
+            }
+
+            if(segment->GetSignalState(directions[0]) != SignalState::DISABLED) {
+                addError(statement.mLine, "Segment " + names[0] + " already has a signal " + PrintDirection(directions[0]));
+                return;
+            }
+
+            mNetwork.AddSignal(segment, directions[0], static_cast<SignalState>(statement.mValue));
+            break;
+        }
+        case StatementType::TRAIN: {
+            ISegment* start = findSegment(statement, 1, final);
+            IConnector* destination = (start != nullptr) ? findTerminator(statement, 2, final) : nullptr;
+            if(start == nullptr || destination == nullptr) {
+                return;
+            }
+
+            mTrains.push_back(TrainRecord {names[0], start, directions[0], destination});
+            break;
+        }
+    }
+}
+
+ISegment* TextNetworkLoader::findSegment(const PendingStatement& statement, unsigned int index, bool final) {
+    auto iter = mSegments.find(statement.mNames[index]);
+    if(iter != mSegments.end()) {
+        return iter->second;
+    }
+
+    if(final) {
+        addError(statement.mLine, "Unknown segment " + statement.mNames[index]);
+    } else {
+        mPending.push_back(statement);
+    }
+
+    return nullptr;
+}
+
+IConnector* TextNetworkLoader::findTerminator(const PendingStatement& statement, unsigned int index, bool final) {
+    auto iter = mTerminators.find(statement.mNames[index]);
+    if(iter != mTerminators.end()) {
+        return iter->second;
+    }
+
+    if(final) {
+        addError(statement.mLine, "Unknown terminator " + statement.mNames[index]);
+    } else {
+        mPending.push_back(statement);
+    }
+
+    return nullptr;
+}
+
+void TextNetworkLoader::addError(uint64_t line, const std::string& message) {
+    mErrors.push_back(Error {line, message});
+    mErrorCount++;
+}
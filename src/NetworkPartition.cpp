@@ -0,0 +1,51 @@
+#include "NetworkPartition.h"
+
+#include <algorithm>
+
+using namespace Rail;
+
+void NetworkPartition::Build(const RailTopology& topology, unsigned int regionCount) {
+    const size_t segmentCount = topology.GetSegmentCount();
+    const size_t componentCount = segmentCount + topology.GetConnectorCount();
+
+    mTopologyVersion = topology.GetVersion();
+    mSegmentCount = segmentCount;
+    mRegionCount = std::max<size_t>(1, std::min<size_t>(regionCount, componentCount));
+    mRegions.assign(componentCount, INVALID_ID);
+
+    // Number the components in breadth first order, starting again from the next unvisited component
+    // for each disconnected part of the network, and cut the order into regions of equal size
+    const size_t regionSize = (componentCount + mRegionCount - 1) / mRegionCount;
+    std::vector<uint32_t> queue;
+    queue.reserve(componentCount);
+    size_t visited = 0;
+
+    auto visit = [&](uint32_t component) {
+        if(mRegions[component] == INVALID_ID) {
+            mRegions[component] = visited++ / regionSize;
+            queue.push_back(component);
+        }
+    };
+
+    for(size_t start = 0; start < componentCount; start++) {
+        size_t head = queue.size();
+        visit(start);
+
+        while(head < queue.size()) {
+            uint32_t component = queue[head++];
+
+            if(component < segmentCount) {
+                for(Direction d : {Direction::UP, Direction::DOWN}) {
+                    ConnectorId end = topology.GetEnd(MakeNode(component, d));
+                    if(end != INVALID_ID) {
+                        visit(segmentCount + end);
+                    }
+                }
+            } else {
+                for(NodeId n : topology.GetAttachments(component - segmentCount)) {
+                    visit(NodeSegment(n));
+                }
+            }
+        }
+    }
+}
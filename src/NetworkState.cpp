@@ -0,0 +1,46 @@
+#include "NetworkState.h"
+
+using namespace Rail;
+
+// Both positions NO_SELECTION
+static const uint32_t UNSELECTED = UINT32_MAX;
+
+// Maximum number of changes kept in the change journal
+static const size_t MAX_JOURNAL_SIZE = 1 << 16;
+
+void NetworkState::Reset(size_t connectorCount, size_t nodeCount) {
+    mNodeCount = nodeCount;
+    mSelections.assign(connectorCount, UNSELECTED);
+    mSignals.assign((nodeCount + 31) / 32, 0);
+
+    // Anything tracking changes from before the reset must treat every segment as changed
+    mEpoch++;
+    mJournalStart = mEpoch;
+    mJournal.clear();
+}
+
+void NetworkState::MarkChanged(NodeId n) {
+    mEpoch++;
+
+    // Drop the oldest half of the journal once it is full
+    if(mJournal.size() >= MAX_JOURNAL_SIZE) {
+        size_t dropped = mJournal.size() / 2;
+        mJournalStart += dropped;
+        mJournal.erase(mJournal.begin(), mJournal.begin() + dropped);
+    }
+
+    mJournal.push_back(NodeSegment(n));
+}
+
+bool NetworkState::GetChangedSegments(uint64_t epoch, std::vector<SegmentId>& changed) const {
+    if(epoch < mJournalStart) {
+        return false;
+    }
+
+    // Each change has an epoch of its own, so the first change after the given epoch is found directly
+    for(size_t i = epoch - mJournalStart; i < mJournal.size(); i++) {
+        changed.push_back(mJournal[i]);
+    }
+
+    return true;
+}
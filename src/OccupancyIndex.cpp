@@ -0,0 +1,110 @@
+#include "OccupancyIndex.h"
+#include "Log.h"
+
+#include <algorithm>
+
+namespace Train {
+
+void OccupancyIndex::Insert(Train* train) {
+    if(mEntries.count(train)) {
+        return;
+    }
+
+    mEntries[train] = Entry {train->GetCurrentComponent(), 0};
+    addOccupant(train->GetCurrentComponent(), train);
+}
+
+void OccupancyIndex::Remove(Train* train) {
+    auto iter = mEntries.find(train);
+    if(iter == mEntries.end()) {
+        return;
+    }
+
+    removeOccupant(iter->second.mComponent, train);
+    mEntries.erase(iter);
+}
+
+const std::vector<Train*>& OccupancyIndex::GetOccupants(const Rail::IComponent* component) const {
+    static const std::vector<Train*> empty;
+
+    auto occupants = mOccupants.find(component);
+    return (occupants != mOccupants.end()) ? occupants->second : empty;
+}
+
+void OccupancyIndex::Update(Train* train) {
+    auto iter = mEntries.find(train);
+    if(iter == mEntries.end()) {
+        LOG_ERROR(TRAIN, "Updating occupancy of unindexed Train %s", train->GetName());
+        return;
+    }
+
+    Entry& entry = iter->second;
+    entry.mTick = mTick;
+
+    // Only trains which have traversed to a new component need re-bucketing
+    if(entry.mComponent != train->GetCurrentComponent()) {
+        removeOccupant(entry.mComponent, train);
+        addOccupant(train->GetCurrentComponent(), train);
+        entry.mComponent = train->GetCurrentComponent();
+    }
+}
+
+bool OccupancyIndex::CheckCollision(Train* train) {
+    const Rail::IComponent* current = train->GetCurrentComponent();
+    const Rail::IComponent* previous = train->GetPreviousComponent();
+
+    auto occupants = mOccupants.find(current);
+    if(occupants != mOccupants.end()) {
+        for(auto other : occupants->second) {
+            if(train != other && train->CheckCollision(other)) {
+                // Trains can only collide 1:1 so we early return on any collision
+                return true;
+            }
+        }
+
+        for(auto other : occupants->second) {
+            if(train != other && mEntries.find(other)->second.mTick == mTick && train->CheckPassThrough(other)) {
+                return true;
+            }
+        }
+    }
+
+    // A train which swapped components with this one is now on its previous component
+    if(previous != current) {
+        occupants = mOccupants.find(previous);
+        if(occupants != mOccupants.end()) {
+            for(auto other : occupants->second) {
+                if(mEntries.find(other)->second.mTick == mTick && train->CheckPassThrough(other)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void OccupancyIndex::removeOccupant(const Rail::IComponent* component, Train* train) {
+    auto occupants = mOccupants.find(component);
+    if(occupants == mOccupants.end()) {
+        return;
+    }
+
+    auto found = std::find(occupants->second.begin(), occupants->second.end(), train);
+    if(found != occupants->second.end()) {
+        *found = occupants->second.back();
+        occupants->second.pop_back();
+    }
+}
+
+void OccupancyIndex::addOccupant(const Rail::IComponent* component, Train* train) {
+    // Only creates the bucket if the component has not been prepared
+    auto occupants = mOccupants.find(component);
+    if(occupants == mOccupants.end()) {
+        occupants = mOccupants.emplace(component, std::vector<Train*>()).first;
+    }
+
+    occupants->second.push_back(train);
+}
+
+} // namespace Train
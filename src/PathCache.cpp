@@ -0,0 +1,75 @@
+#include "PathCache.h"
+
+#include <algorithm>
+
+using namespace Traffic;
+
+const Path* PathCache::Find(Train::Train* train) {
+    auto iter = mEntries.find(train);
+    if(iter == mEntries.end()) {
+        return nullptr;
+    }
+
+    mStats.mHits++;
+    return &iter->second.mPath;
+}
+
+const Path* PathCache::Insert(Train::Train* train, Path path) {
+    Erase(train);
+
+    Entry& entry = mEntries[train];
+    entry.mPath.swap(path);
+    entry.mSegments = entry.mPath;
+
+    // A path may run over the same segment twice, but only needs indexing once
+    std::sort(entry.mSegments.begin(), entry.mSegments.end());
+    entry.mSegments.erase(std::unique(entry.mSegments.begin(), entry.mSegments.end()), entry.mSegments.end());
+
+    for(auto segment : entry.mSegments) {
+        if(segment >= mDependents.size()) {
+            mDependents.resize(segment + 1);
+        }
+        mDependents[segment].push_back(train);
+    }
+
+    return &entry.mPath;
+}
+
+void PathCache::Erase(Train::Train* train) {
+    auto iter = mEntries.find(train);
+    if(iter == mEntries.end()) {
+        return;
+    }
+
+    for(auto segment : iter->second.mSegments) {
+        auto& dependents = mDependents[segment];
+        auto found = std::find(dependents.begin(), dependents.end(), train);
+        if(found != dependents.end()) {
+            *found = dependents.back();
+            dependents.pop_back();
+        }
+    }
+
+    mEntries.erase(iter);
+}
+
+void PathCache::Invalidate(const std::vector<Rail::SegmentId>& segments) {
+    for(auto segment : segments) {
+        if(segment >= mDependents.size()) {
+            continue;
+        }
+
+        // Erase modifies the dependents of this segment, so work from the back
+        auto& dependents = mDependents[segment];
+        while(!dependents.empty()) {
+            Erase(dependents.back());
+            mStats.mInvalidations++;
+        }
+    }
+}
+
+void PathCache::Clear() {
+    mStats.mInvalidations += mEntries.size();
+    mEntries.clear();
+    mDependents.clear();
+}
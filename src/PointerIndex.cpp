@@ -0,0 +1,72 @@
+#include "PointerIndex.h"
+
+using namespace Util;
+
+// The table is grown before it becomes more than this full, keeping probe sequences short
+static const size_t MAX_LOAD_NUMERATOR = 3;
+static const size_t MAX_LOAD_DENOMINATOR = 4;
+
+static const size_t MIN_CAPACITY = 16;
+
+void PointerIndex::Reserve(size_t count) {
+    size_t capacity = MIN_CAPACITY;
+    while(capacity * MAX_LOAD_NUMERATOR < count * MAX_LOAD_DENOMINATOR) {
+        capacity *= 2;
+    }
+
+    if(capacity > mEntries.size()) {
+        rehash(capacity);
+    }
+}
+
+void PointerIndex::Clear() {
+    for(auto& entry : mEntries) {
+        entry = Entry {nullptr, NOT_FOUND};
+    }
+
+    mSize = 0;
+}
+
+void PointerIndex::Set(const void* key, uint32_t id) {
+    if((mSize + 1) * MAX_LOAD_DENOMINATOR > mEntries.size() * MAX_LOAD_NUMERATOR) {
+        rehash(mEntries.empty() ? MIN_CAPACITY : mEntries.size() * 2);
+    }
+
+    for(size_t i = slot(key); ; i = (i + 1) & mMask) {
+        Entry& entry = mEntries[i];
+        if(entry.mKey == key) {
+            entry.mId = id;
+            return;
+        }
+
+        if(entry.mKey == nullptr) {
+            entry = Entry {key, id};
+            mSize++;
+            return;
+        }
+    }
+}
+
+void PointerIndex::rehash(size_t capacity) {
+    std::vector<Entry> entries(capacity, Entry {nullptr, NOT_FOUND});
+    entries.swap(mEntries);
+
+    mMask = capacity - 1;
+    mShift = 64;
+    for(size_t c = capacity; c > 1; c >>= 1) {
+        mShift--;
+    }
+
+    for(const auto& entry : entries) {
+        if(entry.mKey == nullptr) {
+            continue;
+        }
+
+        for(size_t i = slot(entry.mKey); ; i = (i + 1) & mMask) {
+            if(mEntries[i].mKey == nullptr) {
+                mEntries[i] = entry;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Util;
+
+// The percentiles reported for each phase
+static const double SUMMARY_PERCENTILES[] = {50.0, 90.0, 99.0, 99.9};
+
+LatencyHistogram::LatencyHistogram() {
+    Reset();
+}
+
+void LatencyHistogram::Reset() {
+    for(auto& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    mCount.store(0, std::memory_order_relaxed);
+    mTotal.store(0, std::memory_order_relaxed);
+    mMin.store(UINT64_MAX, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+    uint64_t count = GetCount();
+    if(count == 0) {
+        return 0;
+    }
+
+    // The rank of the value at the percentile, counting from 1
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(count)));
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+
+    uint64_t seen = 0;
+    for(unsigned int b = 0; b < BUCKET_COUNT; b++) {
+        seen += GetBucketCount(b);
+        if(seen >= rank) {
+            return std::min(GetBucketHighest(b), GetMax());
+        }
+    }
+
+    return GetMax();
+}
+
+uint64_t LatencyHistogram::GetBucketLowest(unsigned int bucket) {
+    if(bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+
+    unsigned int exponent = bucket / SUB_BUCKET_COUNT - 1;
+    return static_cast<uint64_t>(bucket % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << exponent;
+}
+
+uint64_t LatencyHistogram::GetBucketHighest(unsigned int bucket) {
+    if(bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+
+    unsigned int exponent = bucket / SUB_BUCKET_COUNT - 1;
+    return GetBucketLowest(bucket) + ((static_cast<uint64_t>(1) << exponent) - 1);
+}
+
+Profiler::Profiler() {
+    for(auto& counter : mCounters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* Profiler::PrintPhase(Phase phase) {
+    switch(phase) {
+        case Phase::TICK:
+            return "tick";
+        case Phase::UPDATE_RAIL_NETWORK:
+            return "update_rail_network";
+        case Phase::CONDUCT_TRAINS:
+            return "conduct_trains";
+        case Phase::CHECK_TRAIN_COLLISION:
+            return "check_train_collision";
+        case Phase::REMOVE_FINISHED_TRAINS:
+            return "remove_finished_trains";
+        case Phase::ROUTE_QUERY:
+            return "route_query";
+        default:
+            return "unexpected_phase";
+    }
+}
+
+const char* Profiler::PrintCounter(Counter counter) {
+    switch(counter) {
+        case Counter::TICKS:
+            return "ticks";
+        case Counter::SKIPPED_TICKS:
+            return "skipped_ticks";
+        case Counter::ROUTE_QUERIES:
+            return "route_queries";
+        case Counter::NODES_SETTLED:
+            return "nodes_settled";
+        case Counter::CACHE_HITS:
+            return "cache_hits";
+        case Counter::TRAINS_STOPPED:
+            return "trains_stopped";
+        case Counter::TRAVERSALS:
+            return "traversals";
+        case Counter::TRAINS_FINISHED:
+            return "trains_finished";
+        default:
+            return "unexpected_counter";
+    }
+}
+
+void Profiler::Reset() {
+    for(auto& histogram : mHistograms) {
+        histogram.Reset();
+    }
+
+    for(auto& counter : mCounters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::Summarize(FILE* out) const {
+    fprintf(out, "Profile:\n");
+    for(int c = 0; c < COUNTER_COUNT; c++) {
+        Counter counter = static_cast<Counter>(c);
+        fprintf(out, "  %-24s %llu\n", PrintCounter(counter), static_cast<unsigned long long>(GetCounter(counter)));
+    }
+
+    // Latencies are printed in microseconds
+    fprintf(out, "  %-24s %10s %10s %10s %10s %10s %10s %10s %12s\n",
+            "phase (us)", "count", "mean", "p50", "p90", "p99", "p99.9", "max", "total");
+    for(int p = 0; p < PHASE_COUNT; p++) {
+        const LatencyHistogram& histogram = mHistograms[p];
+        fprintf(out, "  %-24s %10llu %10.2f", PrintPhase(static_cast<Phase>(p)),
+                static_cast<unsigned long long>(histogram.GetCount()), histogram.GetMean() / 1000.0);
+        for(double percentile : SUMMARY_PERCENTILES) {
+            fprintf(out, " %10.2f", static_cast<double>(histogram.GetPercentile(percentile)) / 1000.0);
+        }
+        fprintf(out, " %10.2f %12.2f\n", static_cast<double>(histogram.GetMax()) / 1000.0,
+                static_cast<double>(histogram.GetTotal()) / 1000.0);
+    }
+}
+
+bool Profiler::Write(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if(file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"counters\": {");
+    for(int c = 0; c < COUNTER_COUNT; c++) {
+        Counter counter = static_cast<Counter>(c);
+        fprintf(file, "%s\n    \"%s\": %llu", (c > 0) ? "," : "", PrintCounter(counter),
+                static_cast<unsigned long long>(GetCounter(counter)));
+    }
+
+    // Every phase is in nanoseconds, with its non empty buckets as [lowest, highest, count]
+    fprintf(file, "\n  },\n  \"phases\": {");
+    for(int p = 0; p < PHASE_COUNT; p++) {
+        const LatencyHistogram& histogram = mHistograms[p];
+        fprintf(file, "%s\n    \"%s\": {\n", (p > 0) ? "," : "", PrintPhase(static_cast<Phase>(p)));
+        fprintf(file, "      \"count\": %llu,\n", static_cast<unsigned long long>(histogram.GetCount()));
+        fprintf(file, "      \"total\": %llu,\n", static_cast<unsigned long long>(histogram.GetTotal()));
+        fprintf(file, "      \"min\": %llu,\n", static_cast<unsigned long long>(histogram.GetMin()));
+        fprintf(file, "      \"max\": %llu,\n", static_cast<unsigned long long>(histogram.GetMax()));
+        fprintf(file, "      \"mean\": %.1f,\n", histogram.GetMean());
+        for(double percentile : SUMMARY_PERCENTILES) {
+            fprintf(file, "      \"p%g\": %llu,\n", percentile,
+                    static_cast<unsigned long long>(histogram.GetPercentile(percentile)));
+        }
+
+        fprintf(file, "      \"buckets\": [");
+        bool first = true;
+        for(unsigned int b = 0; b < LatencyHistogram::BUCKET_COUNT; b++) {
+            uint64_t count = histogram.GetBucketCount(b);
+            if(count == 0) {
+                continue;
+            }
+
+            fprintf(file, "%s[%llu, %llu, %llu]", first ? "" : ", ",
+                    static_cast<unsigned long long>(LatencyHistogram::GetBucketLowest(b)),
+                    static_cast<unsigned long long>(LatencyHistogram::GetBucketHighest(b)),
+                    static_cast<unsigned long long>(count));
+            first = false;
+        }
+        fprintf(file, "]\n    }");
+    }
+    fprintf(file, "\n  }\n}\n");
+
+    bool written = !ferror(file);
+    return (fclose(file) == 0) && written;
+}
@@ -1,4 +1,5 @@
 #include "RailComponents.h"
+#include "Log.h"
 
 using namespace Rail;
 
@@ -7,7 +8,7 @@ using namespace Rail;
  */
 
 Connector::Connector(const std::string& name) : mName(name) {
-    printf("DEBUG Connector %s created\n", GetName());
+    LOG_DEBUG(BUILD, "Connector %s created", GetName());
 }
 
 Connector::~Connector() {
@@ -29,8 +30,8 @@ const IComponent* Connector::Traverse(const IComponent* src, Direction d) const
     
     if (target == nullptr) {
         // Traversing network not from a selected segment
-        // TODO this crash will not be detected by train
-        printf("ERROR CRASH Train crossing improperly switched connector\n");
+        // The train detects the crash from the nullptr
+        LOG_ERROR(TRAVERSAL, "CRASH Train crossing improperly switched connector");
         return nullptr;
     }
 
@@ -40,7 +41,7 @@ const IComponent* Connector::Traverse(const IComponent* src, Direction d) const
 std::set<const ISegment*> Connector::GetNext(const ISegment* src) {
     if(mAvailableSegments.find(src) == mAvailableSegments.end()) {
         // Available segments does not contain src
-        printf("ERROR GetNext on connector with invalid source segment\n");
+        LOG_ERROR(ROUTING, "GetNext on connector with invalid source segment");
         return std::set<const ISegment*>();
     }
 
@@ -55,7 +56,7 @@ void Connector::Connect(ISegment* target) {
     // TODO null check
     // Check to make sure we have not already connected to this segment
     if(mAvailableSegments.find(target) != mAvailableSegments.end()) {
-        printf("INFO Connector %s has already connected segment %s\n", GetName(), target->GetName());
+        LOG_INFO(BUILD, "Connector %s has already connected segment %s", GetName(), target->GetName());
         return;
     }
 
@@ -73,7 +74,7 @@ bool Connector::Select(const ISegment *s1, const ISegment *s2) {
     // TODO null check
     // Check to make sure that our targets are valid within our connected segments
     if(mAvailableSegments.find(s1) == mAvailableSegments.end() || mAvailableSegments.find(s2) == mAvailableSegments.end()) {
-        printf("WARNING Attempting to select a segment not in the available list\n");
+        LOG_WARNING(ROUTING, "Attempting to select a segment not in the available list");
         return false;
     }
 
@@ -93,12 +94,7 @@ void Connector::Fix(ISegment* src) {
 Segment::Segment(const std::string& name, unsigned int length) : 
     mName(name), mLength(length) {
 
-    mConnectorMap[Direction::UP] = nullptr;
-    mConnectorMap[Direction::DOWN] = nullptr;
-    mSignalMap[Direction::UP] = Rail::Signal();
-    mSignalMap[Direction::DOWN] = Rail::Signal();
-
-    printf("DEBUG Segment %s created\n", GetName());
+    LOG_DEBUG(BUILD, "Segment %s created", GetName());
 }
 
 Segment::~Segment() {
@@ -109,24 +105,15 @@ void Segment::AddSignal(Direction d) {
     Signal s = Signal();
     s.SetState(SignalState::RED);
 
-    mSignalMap[d] = s;
+    mSignals[d] = s;
 }
 
 SignalState Segment::GetSignalState(Direction d) const {
-    if(mSignalMap.find(d) == mSignalMap.end()) {
-        return SignalState::DISABLED;
-    }
-
-    return mSignalMap.at(d).GetState();
+    return mSignals[d].GetState();
 }
 
 void Segment::SetSignalState(SignalState state, Direction d) {
-    if(mSignalMap.find(d) == mSignalMap.end()) {
-        printf("ERROR Attempting to set state of nonexistent signal\n");
-        return;
-    }
-
-    mSignalMap.at(d).SetState(state);
+    mSignals[d].SetState(state);
 }
 
 const char * const Segment::GetInfo() const {
@@ -136,27 +123,27 @@ const char * const Segment::GetInfo() const {
 const IComponent* Segment::Traverse(const IComponent* src, Direction d) const {
     // Check the signal in the departing direction
     if(GetSignalState(d) == SignalState::RED) {
-        printf("WARNING Train stopped at red light\n");
+        LOG_DEBUG(TRAVERSAL, "Train stopped at red light");
         return src;
     }
 
-    return mConnectorMap.at(d)->Traverse(src, d);
+    return mConnectors[d]->Traverse(src, d);
 }
 
 IConnector* Segment::GetNext(Direction d) const {
-    return mConnectorMap.at(d);
+    return mConnectors[d];
 }
 
 void Segment::Connect(IConnector* target, Direction d) {
     // TODO Null check
-    mConnectorMap[d] = target;
+    mConnectors[d] = target;
 }
 
 /**
  *  Terminator Implementation
  */
 Terminator::Terminator(const std::string& name) : Connector(name) {
-    printf("DEBUG Terminator %s created\n", GetName());
+    LOG_DEBUG(BUILD, "Terminator %s created", GetName());
 }
 
 Terminator::~Terminator() {
@@ -165,21 +152,38 @@ Terminator::~Terminator() {
 
 void Terminator::Connect(ISegment* target) {
     if(mConnectedSegment != nullptr) {
-        printf("ERROR Attempting to connect already connected Terminator\n");
+        LOG_ERROR(BUILD, "Attempting to connect already connected Terminator");
         return;
     }
 
     mConnectedSegment = target;
-    printf("INFO Terminator %s connected to segment %s\n", GetName(), target->GetName());
+    LOG_DEBUG(BUILD, "Terminator %s connected to segment %s", GetName(), target->GetName());
 }
 
 
 const IComponent* Terminator::Traverse(const IComponent* src, Direction d) const {
     if(src != mConnectedSegment) {
-        printf("ERROR Train traversing to terminator from segment %s, expecting %s\n", 
+        LOG_ERROR(TRAVERSAL, "Train traversing to terminator from segment %s, expecting %s", 
             src->GetName(), mConnectedSegment->GetName());
         return src;
     }
 
     return this;
 }
+
+/**
+ *  ComponentFactory Implementation
+ */
+ComponentFactory::~ComponentFactory() {
+    for(auto s : mSegments) {
+        delete s;
+    }
+
+    for(auto c : mConnectors) {
+        delete c;
+    }
+
+    for(auto t : mTerminators) {
+        delete t;
+    }
+}
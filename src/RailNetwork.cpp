@@ -1,31 +1,30 @@
 #include "RailNetwork.h"
+#include "Log.h"
+
+#include <algorithm>
 
 using namespace Rail;
 
-RailNetwork::RailNetwork(const IComponentFactory* f) :
+// The number of changes kept in the journal. Consumers further behind than this see every segment as changed
+static const size_t MAX_JOURNAL_SIZE = 1 << 16;
+
+RailNetwork::RailNetwork(IComponentFactory* f) :
     mComponentFactory(f), mSegments(), mConnectors(), mTerminators()
 {
 
 }
 
 RailNetwork::~RailNetwork() {
-    // Free the created components
-    for(auto s : mSegments) {
-        free(s);
-    }
-
-    for(auto c : mConnectors) {
-        free(c);
-    }
-
-    for(auto t : mTerminators) {
-        free(t);
-    }
+    // The factory owns the created components
+    delete mComponentFactory;
 }
 
 ISegment* RailNetwork::CreateSegment(const std::string& name, unsigned int length) {
     ISegment *segment = mComponentFactory->NewSegment(name, length);
+    mSegmentIds.Set(segment, mSegments.size());
     mSegments.push_back(segment);
+    mTopologyDirty = true;
+    markChanged(segment);
 
     return segment;
 }
@@ -47,7 +46,7 @@ void RailNetwork::ConnectSegments(ISegment* s1, Direction d1, ISegment* s2, Dire
     if(c1 != nullptr && c2 != nullptr) {
         // If both segments are already connected to other segments in the given directions
         // We cannot complete this operation
-        printf("ERROR Connecting two already connected segments");
+        LOG_ERROR(BUILD, "Connecting two already connected segments");
         return;
     }
 
@@ -71,53 +70,126 @@ void RailNetwork::ConnectSegments(ISegment* s1, Direction d1, ISegment* s2, Dire
     if(c2 == nullptr) {
         s2->Connect(target, d2);
     }
+
+    mTopologyDirty = true;
+    markChanged(target, s1);
 }
 
 /**
  *  Switch the connector between the given segments so that trains traverse from src to dst
  */
 bool RailNetwork::RouteSegment(const ISegment* src, const ISegment* dst) {
-    // Attempt the up facing connection first
-    IConnector* upConnector = src->GetNext(Direction::UP);
-    if(upConnector->Select(src, dst)) {
-        return true;
+    const RailTopology& topology = GetTopology();
+    ConnectorId c = route(GetState(), topology.LookupSegment(src), topology.LookupSegment(dst),
+                          {Direction::UP, Direction::DOWN});
+    if(c == INVALID_ID) {
+        return false;
     }
 
-    // If that failed, we may be routing down
-    IConnector* downConnector = src->GetNext(Direction::DOWN);
-    if(downConnector->Select(src, dst)) {
-        return true;
+    // Keep the components in step with the network's own state
+    mTopology.GetConnector(c)->Select(src, dst);
+    return true;
+}
+
+bool RailNetwork::RouteSegment(NetworkState& state, const ISegment* src, const ISegment* dst) {
+    const RailTopology& topology = GetTopology();
+    return RouteSegment(state, topology.LookupSegment(src), topology.LookupSegment(dst));
+}
+
+bool RailNetwork::RouteSegment(NetworkState& state, const ISegment* src, Direction d, const ISegment* dst) {
+    const RailTopology& topology = GetTopology();
+    return RouteSegment(state, topology.LookupSegment(src), d, topology.LookupSegment(dst));
+}
+
+bool RailNetwork::RouteSegment(NetworkState& state, SegmentId src, SegmentId dst) {
+    return route(state, src, dst, {Direction::UP, Direction::DOWN}) != INVALID_ID;
+}
+
+bool RailNetwork::RouteSegment(NetworkState& state, SegmentId src, Direction d, SegmentId dst) {
+    return route(state, src, dst, {d}) != INVALID_ID;
+}
+
+ConnectorId RailNetwork::route(NetworkState& state, SegmentId src, SegmentId dst, std::initializer_list<Direction> ends) {
+    const RailTopology& topology = GetTopology();
+    const bool known = src < topology.GetSegmentCount() && dst < topology.GetSegmentCount();
+
+    // Attempt the up facing connection first, and if that failed, we may be routing down
+    for(Direction d : ends) {
+        ConnectorId c = known ? topology.GetEnd(MakeNode(src, d)) : INVALID_ID;
+        if(c == INVALID_ID) {
+            continue;
+        }
+
+        uint16_t second = topology.FindAttachment(c, dst);
+        if(second == NetworkState::NO_SELECTION) {
+            continue;
+        }
+
+        state.Select(c, topology.FindAttachment(c, src), second);
+        if(mRouteRecorder != nullptr) {
+            mRouteRecorder->emplace_back(src, dst);
+        }
+        return c;
     }
 
-    printf("WARNING Failed to route segments %s and %s\n",
-            src->GetName(), dst->GetName());
-    return false;
+    LOG_WARNING(ROUTING, "Failed to route segments %s and %s", getSegmentName(src), getSegmentName(dst));
+    return INVALID_ID;
+}
+
+const char* RailNetwork::getSegmentName(SegmentId s) {
+    const RailTopology& topology = GetTopology();
+    if(s >= topology.GetSegmentCount()) {
+        return "(none)";
+    }
+
+    // A network loaded in part has the names of the segments it has not created in its file
+    return (topology.GetSegment(s) != nullptr) ? topology.GetSegment(s)->GetName() : mFile->GetSegmentName(s);
 }
 
 void RailNetwork::AddSignal(ISegment* segment, Direction d, SignalState state) {
     SignalState currentState = segment->GetSignalState(d);
     if (currentState != SignalState::DISABLED) {
-        printf("ERROR Adding signal to location where signal has already been added");
+        LOG_ERROR(BUILD, "Adding signal to location where signal has already been added");
         return;
     }
 
     segment->AddSignal(d);
     segment->SetSignalState(state, d);
+
+    // A stale state is taken from the components when the topology is rebuilt
+    if(!mTopologyDirty) {
+        mState.SetSignal(MakeNode(mSegmentIds.Find(segment), d), state);
+    }
+    markChanged(segment);
 }
 
 void RailNetwork::SetSignal(ISegment* segment, Direction d, SignalState state) {
     SignalState currentState = segment->GetSignalState(d);
     if (currentState == SignalState::DISABLED) {
-        printf("ERROR Setting signal state in location where no signal exits");
+        LOG_ERROR(BUILD, "Setting signal state in location where no signal exists");
         return;
     }
 
     segment->SetSignalState(state, d);
+    if(!mTopologyDirty) {
+        mState.SetSignal(MakeNode(mSegmentIds.Find(segment), d), state);
+    }
+    markChanged(segment);
+}
+
+void RailNetwork::SetSignal(NetworkState& state, NodeId node, SignalState signalState) {
+    if(node >= state.GetNodeCount() || state.GetSignal(node) == SignalState::DISABLED) {
+        LOG_ERROR(BUILD, "Setting signal state in location where no signal exists");
+        return;
+    }
+
+    state.SetSignal(node, signalState);
+    state.MarkChanged(node);
 }
 
 IConnector* RailNetwork::AddTerminator(ISegment* src, Direction d, const std::string& name) {
     if(src->GetNext(d) != nullptr) {
-        printf("ERROR Connecting terminator to connected segment");
+        LOG_ERROR(BUILD, "Connecting terminator to connected segment");
         return nullptr;
     }
 
@@ -127,5 +199,275 @@ IConnector* RailNetwork::AddTerminator(ISegment* src, Direction d, const std::st
 
     // Save the new terminator
     mTerminators.push_back(terminator);
+    mTopologyDirty = true;
+    markChanged(src);
     return terminator;
-}
\ No newline at end of file
+}
+
+bool RailNetwork::Load(const std::string& path) {
+    return load(path, false);
+}
+
+bool RailNetwork::LoadPartial(const std::string& path) {
+    return load(path, true);
+}
+
+bool RailNetwork::load(const std::string& path, bool partial) {
+    if(!mSegments.empty() || !mConnectors.empty() || !mTerminators.empty()) {
+        LOG_ERROR(BUILD, "Loading network file %s into a network which is not empty", path.c_str());
+        return false;
+    }
+
+    std::unique_ptr<NetworkFile> file(new NetworkFile());
+    if(!file->Open(path)) {
+        return false;
+    }
+
+    const uint32_t segmentCount = file->GetSegmentCount();
+    const uint32_t connectorCount = file->GetConnectorCount();
+    const uint32_t connectorTotal = connectorCount + file->GetTerminatorCount();
+    const TopologyArrays arrays = file->GetTopologyArrays();
+
+    // Create the components in id order, so the file's topology matches them as it stands. Those of a network
+    // loaded in part are created later, into their places
+    std::vector<IConnector*> connectors(connectorTotal);
+    if(partial) {
+        mSegments.assign(segmentCount, nullptr);
+        mConnectors.assign(connectorCount, nullptr);
+        mTerminators.assign(connectorTotal - connectorCount, nullptr);
+    } else {
+        mSegments.reserve(segmentCount);
+        mConnectors.reserve(connectorCount);
+        mTerminators.reserve(connectorTotal - connectorCount);
+
+        for(SegmentId s = 0; s < segmentCount; s++) {
+            mSegments.push_back(mComponentFactory->NewSegment(file->GetSegmentName(s), arrays.mLengths[s]));
+        }
+
+        for(ConnectorId c = 0; c < connectorTotal; c++) {
+            if(c < connectorCount) {
+                connectors[c] = mComponentFactory->NewConnector(file->GetConnectorName(c));
+                mConnectors.push_back(connectors[c]);
+            } else {
+                connectors[c] = mComponentFactory->NewTerminator(file->GetConnectorName(c));
+                mTerminators.push_back(connectors[c]);
+            }
+        }
+    }
+
+    mTopology.Attach(arrays, mSegments, mConnectors, mTerminators);
+    mTopologyDirty = false;
+    mState.Reset(connectorTotal, segmentCount * 2);
+
+    // Connect the components directly, as the file already holds the result of the building API
+    for(ConnectorId c = 0; c < connectorTotal; c++) {
+        SegmentId first = file->GetSelection(c, 0);
+        SegmentId second = file->GetSelection(c, 1);
+
+        if(!partial) {
+            for(uint32_t i = arrays.mAttachmentOffsets[c]; i < arrays.mAttachmentOffsets[c + 1]; i++) {
+                NodeId n = arrays.mAttachments[i];
+                mSegments[NodeSegment(n)]->Connect(connectors[c], NodeDirection(n));
+                connectors[c]->Connect(mSegments[NodeSegment(n)]);
+            }
+
+            if(first != INVALID_ID && second != INVALID_ID) {
+                connectors[c]->Select(mSegments[first], mSegments[second]);
+            }
+        }
+
+        mState.Select(c, (first != INVALID_ID) ? mTopology.FindAttachment(c, first) : NetworkState::NO_SELECTION,
+                      (second != INVALID_ID) ? mTopology.FindAttachment(c, second) : NetworkState::NO_SELECTION);
+    }
+
+    for(NodeId n = 0; n < segmentCount * 2; n++) {
+        SignalState state = file->GetSignal(n);
+        if(state != SignalState::DISABLED) {
+            if(!partial) {
+                mSegments[NodeSegment(n)]->AddSignal(NodeDirection(n));
+                mSegments[NodeSegment(n)]->SetSignalState(state, NodeDirection(n));
+            }
+            mState.SetSignal(n, state);
+        }
+    }
+
+    if(!partial) {
+        mSegmentIds.Reserve(segmentCount);
+        for(SegmentId s = 0; s < segmentCount; s++) {
+            mSegmentIds.Set(mSegments[s], s);
+        }
+    }
+
+    mFile = std::move(file);
+    mPartial = partial;
+
+    // Anything tracking changes from before the load must treat every segment as changed
+    mEpoch++;
+    mJournalStart = mEpoch;
+    mJournal.clear();
+
+    LOG_INFO(BUILD, "Loaded %u segments and %u connectors from %s", segmentCount, connectorTotal, path.c_str());
+    return true;
+}
+
+const IComponent* RailNetwork::LoadComponent(uint32_t component) {
+    const RailTopology& topology = GetTopology();
+    const uint32_t segmentCount = topology.GetSegmentCount();
+    if(component < segmentCount) {
+        if(mPartial && topology.GetSegment(component) == nullptr) {
+            createSegment(component);
+        }
+        return topology.GetSegment(component);
+    }
+
+    if(component == INVALID_ID || component - segmentCount >= topology.GetConnectorCount()) {
+        return nullptr;
+    }
+
+    ConnectorId c = component - segmentCount;
+    if(mPartial && topology.GetConnector(c) == nullptr) {
+        createConnector(c);
+    }
+    return topology.GetConnector(c);
+}
+
+void RailNetwork::createSegment(SegmentId s) {
+    ISegment* segment = mComponentFactory->NewSegment(mFile->GetSegmentName(s), mTopology.GetLength(s));
+    mSegments[s] = segment;
+    mSegmentIds.Set(segment, s);
+    mTopology.SetSegment(s, segment);
+
+    for(Direction d : {Direction::UP, Direction::DOWN}) {
+        NodeId n = MakeNode(s, d);
+        SignalState state = mState.GetSignal(n);
+        if(state != SignalState::DISABLED) {
+            segment->AddSignal(d);
+            segment->SetSignalState(state, d);
+        }
+
+        ConnectorId c = mTopology.GetEnd(n);
+        IConnector* connector = (c == INVALID_ID) ? nullptr :
+                (c < mConnectors.size()) ? mConnectors[c] : mTerminators[c - mConnectors.size()];
+        if(connector != nullptr) {
+            connectCreated(n, c, connector);
+        }
+    }
+}
+
+void RailNetwork::createConnector(ConnectorId c) {
+    const uint32_t connectorCount = mFile->GetConnectorCount();
+    IConnector* connector = nullptr;
+    if(c < connectorCount) {
+        connector = mComponentFactory->NewConnector(mFile->GetConnectorName(c));
+        mConnectors[c] = connector;
+    } else {
+        connector = mComponentFactory->NewTerminator(mFile->GetConnectorName(c));
+        mTerminators[c - connectorCount] = connector;
+    }
+    mTopology.SetConnector(c, connector);
+
+    for(NodeId n : mTopology.GetAttachments(c)) {
+        if(mSegments[NodeSegment(n)] != nullptr) {
+            connectCreated(n, c, connector);
+        }
+    }
+}
+
+void RailNetwork::connectCreated(NodeId node, ConnectorId c, IConnector* connector) {
+    ISegment* segment = mSegments[NodeSegment(node)];
+    segment->Connect(connector, NodeDirection(node));
+    connector->Connect(segment);
+
+    uint16_t first = mState.GetSelection(c, 0);
+    uint16_t second = mState.GetSelection(c, 1);
+    if(first == NetworkState::NO_SELECTION || second == NetworkState::NO_SELECTION) {
+        return;
+    }
+
+    const NodeId* attachments = mTopology.GetAttachments(c).begin();
+    const ISegment* firstSegment = mSegments[NodeSegment(attachments[first])];
+    const ISegment* secondSegment = mSegments[NodeSegment(attachments[second])];
+    if(firstSegment != nullptr && secondSegment != nullptr) {
+        connector->Select(firstSegment, secondSegment);
+    }
+}
+
+bool RailNetwork::Save(const std::string& path) {
+    return Save(path, GetState());
+}
+
+bool RailNetwork::Save(const std::string& path, const NetworkState& state) {
+    // The file needs the name of every component
+    if(mPartial) {
+        LOG_ERROR(BUILD, "Saving network %s which was loaded in part", path.c_str());
+        return false;
+    }
+
+    return NetworkFile::Write(GetTopology(), state, path);
+}
+
+const RailTopology& RailNetwork::GetTopology() {
+    if(mTopologyDirty) {
+        mTopology.Build(mSegments, mConnectors, mTerminators);
+        mTopologyDirty = false;
+        captureState();
+
+        // The topology no longer uses the tables of any loaded file
+        mFile.reset();
+    }
+
+    return mTopology;
+}
+
+void RailNetwork::captureState() {
+    mState.Reset(mTopology.GetConnectorCount(), mTopology.GetNodeCount());
+
+    for(ConnectorId c = 0; c < mTopology.GetConnectorCount(); c++) {
+        auto selected = mTopology.GetConnector(c)->GetSelected();
+        SegmentId first = mTopology.LookupSegment(selected.first);
+        SegmentId second = mTopology.LookupSegment(selected.second);
+        mState.Select(c, (first != INVALID_ID) ? mTopology.FindAttachment(c, first) : NetworkState::NO_SELECTION,
+                      (second != INVALID_ID) ? mTopology.FindAttachment(c, second) : NetworkState::NO_SELECTION);
+    }
+
+    for(NodeId n = 0; n < mTopology.GetNodeCount(); n++) {
+        mState.SetSignal(n, mSegments[NodeSegment(n)]->GetSignalState(NodeDirection(n)));
+    }
+}
+
+bool RailNetwork::GetChangedSegments(uint64_t epoch, std::vector<SegmentId>& changed) const {
+    if(epoch < mJournalStart) {
+        return false;
+    }
+
+    // The journal is in epoch order, so skip straight to the first change after the given epoch
+    auto first = std::upper_bound(mJournal.begin(), mJournal.end(), epoch,
+            [](uint64_t e, const Change& change) { return e < change.mEpoch; });
+
+    for(auto iter = first; iter != mJournal.end(); iter++) {
+        changed.push_back(iter->mSegment);
+    }
+
+    return true;
+}
+
+void RailNetwork::markChanged(const ISegment* segment) {
+    mEpoch++;
+
+    // Drop the oldest half of the journal once it is full
+    if(mJournal.size() >= MAX_JOURNAL_SIZE) {
+        size_t dropped = mJournal.size() / 2;
+        mJournalStart = mJournal[dropped - 1].mEpoch;
+        mJournal.erase(mJournal.begin(), mJournal.begin() + dropped);
+    }
+
+    mJournal.push_back(Change {mEpoch, mSegmentIds.Find(segment)});
+}
+
+void RailNetwork::markChanged(IConnector* connector, const ISegment* attached) {
+    markChanged(attached);
+
+    for(auto segment : connector->GetNext(attached)) {
+        mJournal.push_back(Change {mEpoch, mSegmentIds.Find(segment)});
+    }
+}
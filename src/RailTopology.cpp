@@ -0,0 +1,198 @@
+#include "RailTopology.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace Rail;
+
+// The version of the next topology built, shared by every topology so that no two builds have the same version
+static std::atomic<uint64_t> sNextVersion(1);
+
+RailTopology::RailTopology() {
+
+}
+
+RailTopology::~RailTopology() {
+
+}
+
+void RailTopology::Build(const std::vector<ISegment*>& segments,
+                         const std::vector<IConnector*>& connectors,
+                         const std::vector<IConnector*>& terminators) {
+    setComponents(segments, connectors, terminators);
+
+    mTerminatorFlags.assign(mConnectors.size(), 0);
+    for(ConnectorId c = connectors.size(); c < mConnectors.size(); c++) {
+        mTerminatorFlags[c] = 1;
+    }
+
+    // Lengths and the connector at each end of each segment
+    const size_t nodeCount = GetNodeCount();
+    mLengths.resize(mSegments.size());
+    mEnds.assign(nodeCount, INVALID_ID);
+
+    for(SegmentId s = 0; s < mSegments.size(); s++) {
+        mLengths[s] = mSegments[s]->GetLength();
+
+        for(Direction d : {Direction::UP, Direction::DOWN}) {
+            IConnector* connector = mSegments[s]->GetNext(d);
+            if(connector != nullptr) {
+                mEnds[MakeNode(s, d)] = LookupConnector(connector);
+            }
+        }
+    }
+
+    // Bucket each node by the connector at its end to get the connector attachments
+    mAttachmentOffsets.assign(mConnectors.size() + 1, 0);
+    for(NodeId n = 0; n < nodeCount; n++) {
+        if(mEnds[n] != INVALID_ID) {
+            mAttachmentOffsets[mEnds[n] + 1]++;
+        }
+    }
+
+    for(ConnectorId c = 0; c < mConnectors.size(); c++) {
+        mAttachmentOffsets[c + 1] += mAttachmentOffsets[c];
+    }
+
+    mAttachments.resize(mAttachmentOffsets.back());
+    std::vector<uint32_t> cursor(mAttachmentOffsets.begin(), mAttachmentOffsets.end() - 1);
+    for(NodeId n = 0; n < nodeCount; n++) {
+        if(mEnds[n] != INVALID_ID) {
+            mAttachments[cursor[mEnds[n]]++] = n;
+        }
+    }
+
+    mArrays.mLengths = mLengths.data();
+    mArrays.mEnds = mEnds.data();
+    mArrays.mTerminatorFlags = mTerminatorFlags.data();
+    mArrays.mAttachmentOffsets = mAttachmentOffsets.data();
+    mArrays.mAttachments = mAttachments.data();
+
+    // A node continues on to every other segment at its end connector, travelling away from it
+    mSuccessorOffsets.resize(nodeCount + 1);
+    mSuccessors.clear();
+    for(NodeId n = 0; n < nodeCount; n++) {
+        mSuccessorOffsets[n] = mSuccessors.size();
+
+        ConnectorId end = mEnds[n];
+        if(end == INVALID_ID || IsTerminator(end)) {
+            continue;
+        }
+
+        for(NodeId attached : GetAttachments(end)) {
+            if(NodeSegment(attached) != NodeSegment(n)) {
+                mSuccessors.push_back(ReverseNode(attached));
+            }
+        }
+    }
+    mSuccessorOffsets[nodeCount] = mSuccessors.size();
+
+    mArrays.mSuccessorOffsets = mSuccessorOffsets.data();
+    mArrays.mSuccessors = mSuccessors.data();
+
+    mVersion = sNextVersion++;
+}
+
+void RailTopology::Attach(const TopologyArrays& arrays,
+                          const std::vector<ISegment*>& segments,
+                          const std::vector<IConnector*>& connectors,
+                          const std::vector<IConnector*>& terminators) {
+    setComponents(segments, connectors, terminators);
+    mArrays = arrays;
+
+    // Release the storage of any previous build
+    std::vector<uint32_t>().swap(mLengths);
+    std::vector<ConnectorId>().swap(mEnds);
+    std::vector<uint8_t>().swap(mTerminatorFlags);
+    std::vector<uint32_t>().swap(mAttachmentOffsets);
+    std::vector<NodeId>().swap(mAttachments);
+    std::vector<uint32_t>().swap(mSuccessorOffsets);
+    std::vector<NodeId>().swap(mSuccessors);
+
+    mVersion = sNextVersion++;
+}
+
+void RailTopology::setComponents(const std::vector<ISegment*>& segments,
+                                 const std::vector<IConnector*>& connectors,
+                                 const std::vector<IConnector*>& terminators) {
+    mSegments.assign(segments.begin(), segments.end());
+    mConnectors.assign(connectors.begin(), connectors.end());
+    mConnectors.insert(mConnectors.end(), terminators.begin(), terminators.end());
+
+    // A topology attached without some of its components only indexes those it has
+    mSegmentIds.Clear();
+    mSegmentIds.Reserve(mSegments.size() - std::count(mSegments.begin(), mSegments.end(), nullptr));
+    for(SegmentId s = 0; s < mSegments.size(); s++) {
+        if(mSegments[s] != nullptr) {
+            mSegmentIds.Set(mSegments[s], s);
+        }
+    }
+
+    mConnectorIds.Clear();
+    mConnectorIds.Reserve(mConnectors.size() - std::count(mConnectors.begin(), mConnectors.end(), nullptr));
+    for(ConnectorId c = 0; c < mConnectors.size(); c++) {
+        if(mConnectors[c] != nullptr) {
+            mConnectorIds.Set(mConnectors[c], c);
+        }
+    }
+}
+
+void RailTopology::SetSegment(SegmentId s, ISegment* segment) {
+    mSegments[s] = segment;
+    mSegmentIds.Set(segment, s);
+}
+
+void RailTopology::SetConnector(ConnectorId c, IConnector* connector) {
+    mConnectors[c] = connector;
+    mConnectorIds.Set(connector, c);
+}
+
+SegmentId RailTopology::LookupSegment(const IComponent* component) const {
+    return mSegmentIds.Find(component);
+}
+
+ConnectorId RailTopology::LookupConnector(const IComponent* component) const {
+    return mConnectorIds.Find(component);
+}
+
+uint16_t RailTopology::FindAttachment(ConnectorId c, SegmentId s) const {
+    IdRange attachments = GetAttachments(c);
+    for(size_t i = 0; i < attachments.size() && i < NetworkState::NO_SELECTION; i++) {
+        if(NodeSegment(attachments.begin()[i]) == s) {
+            return static_cast<uint16_t>(i);
+        }
+    }
+
+    return NetworkState::NO_SELECTION;
+}
+
+uint32_t RailTopology::Lookup(const IComponent* component, ComponentKind& kind) const {
+    SegmentId s = LookupSegment(component);
+    if(s != INVALID_ID) {
+        kind = ComponentKind::SEGMENT;
+        return s;
+    }
+
+    ConnectorId c = LookupConnector(component);
+    kind = (c == INVALID_ID) ? ComponentKind::UNKNOWN : (IsTerminator(c) ? ComponentKind::TERMINATOR : ComponentKind::CONNECTOR);
+    return c;
+}
+
+uint32_t RailTopology::blocked(NodeId n, ComponentKind& kind) const {
+    LOG_DEBUG(TRAVERSAL, "Train stopped at red light");
+    kind = ComponentKind::SEGMENT;
+    return NodeSegment(n);
+}
+
+uint32_t RailTopology::crashed(NodeId n, ComponentKind& kind) const {
+    if(GetEnd(n) == INVALID_ID) {
+        LOG_ERROR(TRAVERSAL, "CRASH Train leaving unconnected segment %s", mSegments[NodeSegment(n)]->GetName());
+    } else {
+        // The train detects the crash from the INVALID_ID
+        LOG_ERROR(TRAVERSAL, "CRASH Train crossing improperly switched connector");
+    }
+
+    kind = ComponentKind::UNKNOWN;
+    return INVALID_ID;
+}
@@ -0,0 +1,133 @@
+#include "ScenarioRunner.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace Train;
+
+ScenarioRunner::ScenarioRunner(unsigned int threadCount) : mThreadPool(std::max(1u, threadCount)) {
+}
+
+ScenarioRunner::~ScenarioRunner() {
+}
+
+bool ScenarioRunner::Load(const std::string& path) {
+    std::unique_ptr<Rail::RailNetwork> network(new Rail::RailNetwork(new Rail::ArenaComponentFactory()));
+    if(!network->Load(path)) {
+        return false;
+    }
+
+    mNetwork = std::move(network);
+    return true;
+}
+
+void ScenarioRunner::Run(const std::vector<Scenario>& scenarios, std::vector<ScenarioResult>& results) {
+    results.assign(scenarios.size(), ScenarioResult());
+    if(mNetwork == nullptr) {
+        LOG_ERROR(TRAIN, "Running scenarios without a network");
+        return;
+    }
+
+    // Nothing changes the network itself while the scenarios run, so the threads only read it
+    const Rail::NetworkState& initial = mNetwork->GetState();
+
+    std::vector<Util::LogBuffer> logs(mThreadPool.GetThreadCount());
+    mThreadPool.ParallelFor(scenarios.size(), [&](size_t s, unsigned int worker) {
+        Util::Log::Capture(&logs[worker]);
+        results[s] = runScenario(initial, scenarios[s]);
+        logs[worker].Clear();
+        Util::Log::Capture(nullptr);
+    });
+}
+
+ScenarioResult ScenarioRunner::runScenario(const Rail::NetworkState& initial, const Scenario& scenario) {
+    auto start = std::chrono::steady_clock::now();
+    ScenarioResult result;
+
+    Rail::RailNetwork& network = *mNetwork;
+    Rail::NetworkState state = initial;
+    const Rail::RailTopology& topology = network.GetTopology();
+
+    for(const auto& signal : scenario.mSignals) {
+        if(signal.mNode < topology.GetNodeCount()) {
+            network.SetSignal(state, signal.mNode, signal.mState);
+        }
+    }
+
+    // Trains are added in order of departure, and in the order of the scenario among those departing together
+    std::vector<const ScenarioTrain*> trains;
+    for(const auto& train : scenario.mTrains) {
+        trains.push_back(&train);
+    }
+    std::stable_sort(trains.begin(), trains.end(), [](const ScenarioTrain* a, const ScenarioTrain* b) {
+        return a->mDeparture < b->mDeparture;
+    });
+
+    Simulator simulator(&network, &state);
+    size_t departed = 0;
+    while(departed < trains.size() && trains[departed]->mDeparture < scenario.mTickLimit) {
+        uint64_t departure = trains[departed]->mDeparture;
+        simulator.AdvanceTo(departure);
+
+        for(; departed < trains.size() && trains[departed]->mDeparture == departure; departed++) {
+            const ScenarioTrain& record = *trains[departed];
+            if(record.mStart >= topology.GetSegmentCount() || record.mDestination >= topology.GetConnectorCount()) {
+                LOG_ERROR(TRAIN, "Train %s of scenario %s is not on the network", record.mName.c_str(),
+                          scenario.mName.c_str());
+                continue;
+            }
+
+            Train* train = simulator.AddTrain(record.mName, topology.GetSegment(record.mStart), record.mDirection);
+            train->SetDestination(topology.GetConnector(record.mDestination));
+        }
+    }
+
+    simulator.RunUntil(scenario.mTickLimit);
+
+    result.mSucceeded = simulator.mSucceededCount;
+    result.mCrashed = simulator.mCrashedCount;
+    result.mUnfinished = simulator.mRunningTrains.size() + (trains.size() - departed);
+    result.mTicks = simulator.GetTick();
+
+    for(const auto* running : {&simulator.mFinishedTrains, &simulator.mRunningTrains}) {
+        for(auto train : *running) {
+            result.mDistance += train->GetDistance();
+            result.mStoppedTime += train->GetStoppedTime();
+        }
+    }
+
+    result.mValid = simulator.ValidateResults() && departed == trains.size();
+    result.mSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void ScenarioRunner::PrintResults(FILE* out, const std::vector<Scenario>& scenarios,
+                                  const std::vector<ScenarioResult>& results) {
+    fprintf(out, "%-20s %6s %10s %10s %10s %12s %14s %14s %10s\n", "scenario", "valid", "succeeded", "crashed",
+            "unfinished", "ticks", "distance", "stopped", "ms");
+
+    ScenarioResult total;
+    size_t validCount = 0;
+    for(size_t s = 0; s < results.size(); s++) {
+        const ScenarioResult& result = results[s];
+        fprintf(out, "%-20s %6s %10zu %10zu %10zu %12llu %14llu %14llu %10.1f\n", scenarios[s].mName.c_str(),
+                result.mValid ? "YES" : "NO", result.mSucceeded, result.mCrashed, result.mUnfinished,
+                static_cast<unsigned long long>(result.mTicks), static_cast<unsigned long long>(result.mDistance),
+                static_cast<unsigned long long>(result.mStoppedTime), result.mSeconds * 1000);
+
+        validCount += result.mValid;
+        total.mSucceeded += result.mSucceeded;
+        total.mCrashed += result.mCrashed;
+        total.mUnfinished += result.mUnfinished;
+        total.mTicks += result.mTicks;
+        total.mDistance += result.mDistance;
+        total.mStoppedTime += result.mStoppedTime;
+        total.mSeconds += result.mSeconds;
+    }
+
+    fprintf(out, "%-20s %6zu %10zu %10zu %10zu %12llu %14llu %14llu %10.1f\n", "total", validCount,
+            total.mSucceeded, total.mCrashed, total.mUnfinished, static_cast<unsigned long long>(total.mTicks),
+            static_cast<unsigned long long>(total.mDistance), static_cast<unsigned long long>(total.mStoppedTime),
+            total.mSeconds * 1000);
+}
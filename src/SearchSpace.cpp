@@ -0,0 +1,37 @@
+#include "SearchSpace.h"
+
+using namespace Traffic;
+
+void SearchSpace::Reset(size_t nodeCount) {
+    // Scratch buffers only ever grow, so repeated queries on the same topology do not allocate
+    if(mDistances.size() < nodeCount) {
+        mDistances.resize(nodeCount);
+        mPredecessors.resize(nodeCount);
+        mStamps.resize(nodeCount, 0);
+        mSettledStamps.resize(nodeCount, 0);
+        mQueue.reserve(nodeCount);
+    }
+
+    mQueue.clear();
+
+    // Advancing the stamp invalidates every entry from the previous search at once
+    if(++mStamp == 0) {
+        std::fill(mStamps.begin(), mStamps.end(), 0);
+        std::fill(mSettledStamps.begin(), mSettledStamps.end(), 0);
+        mStamp = 1;
+    }
+}
+
+Path SearchSpace::BuildPath(const Rail::RailTopology& topology, Rail::NodeId last) const {
+    size_t length = 0;
+    for(Rail::NodeId node = last; node != Rail::INVALID_ID; node = mPredecessors[node]) {
+        length++;
+    }
+
+    Path path(length);
+    for(Rail::NodeId node = last; node != Rail::INVALID_ID; node = mPredecessors[node]) {
+        path[--length] = Rail::NodeSegment(node);
+    }
+
+    return path;
+}
@@ -0,0 +1,1062 @@
+#include "ShardedRun.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <csignal>
+#include <numeric>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_set>
+
+using namespace Train;
+
+// Messages between the coordinator and its shards, each starting with its type
+typedef enum {
+    START,      // The trains on a shard's region, with their paths
+    READY,      // Shard started: running train count
+    TICK,       // Start a tick
+    BOUNDARY,   // Routes set, claims on connectors between regions, trains for the coordinator to conduct
+    RETURN,     // Routes set on connectors between regions, trains now on a shard's region
+    DONE,       // Tick finished: messages, finished trains, running and stopped train counts, whether changed
+    STOP,       // Stop running
+    REMAINING   // Shard stopped: trains still running, with their paths
+} MessageType;
+
+// Messages written while routing, conducting and removing trains are keyed by phase, then by train, with trains
+// identified between processes by their place in the order of the trains
+static const uint64_t ROUTE_PHASE = 0;
+static const uint64_t CONDUCT_PHASE = 1;
+static const uint64_t REMOVE_PHASE = 2;
+
+static uint64_t logKey(uint64_t phase, uint32_t order) {
+    return (phase << 32) | order;
+}
+
+// Whether a shard's process is still running. The process is not reaped if it has exited, so that Run() can
+// still collect its exit status. A process which has exited but not been reaped still takes signals, so
+// kill(pid, 0) would report it alive
+static bool isRunning(pid_t pid) {
+    siginfo_t info;
+    info.si_pid = 0;
+    return waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0;
+}
+
+static Util::BinaryWriter startMessage(MessageType type) {
+    Util::BinaryWriter writer;
+    writer.Write<uint8_t>(type);
+    return writer;
+}
+
+// Check that a message is of the expected type, leaving the reader after the type
+static bool readMessageType(Util::BinaryReader& reader, MessageType type) {
+    uint8_t actual = 0;
+    return reader.Read(actual) && actual == type;
+}
+
+static void readLog(Util::BinaryReader& reader, Util::LogBuffer& log) {
+    uint32_t count = 0;
+    reader.Read(count);
+    for(uint32_t i = 0; i < count && !reader.IsFailed(); i++) {
+        uint64_t key = 0;
+        std::string text;
+        reader.Read(key);
+        reader.ReadString(text);
+        log.Append(key, text);
+    }
+}
+
+static void writeRoutes(Util::BinaryWriter& writer, const std::vector<std::pair<Rail::SegmentId, Rail::SegmentId>>& routes) {
+    Util::BinaryWriter ids;
+    for(const auto& route : routes) {
+        ids.Write<uint32_t>(route.first);
+        ids.Write<uint32_t>(route.second);
+    }
+    writer.WriteBlock(ids);
+}
+
+// Mark a connector and every segment attached to it
+static void markAround(const Rail::RailTopology& topology, Rail::ConnectorId c, std::vector<uint8_t>& components) {
+    components[topology.GetSegmentCount() + c] = 1;
+    for(Rail::NodeId n : topology.GetAttachments(c)) {
+        components[Rail::NodeSegment(n)] = 1;
+    }
+}
+
+template<typename Work>
+void ShardedRun::quietly(Work work) {
+    Util::LogBuffer discarded;
+    Util::LogBuffer* previous = Util::Log::Capture(&discarded);
+    work();
+    Util::Log::Capture(previous);
+}
+
+ShardedRun::ShardedRun(Simulator& simulator, unsigned int shardCount) :
+    mSimulator(simulator), mShardCount(std::max(1u, shardCount)) {
+}
+
+ShardedRun::~ShardedRun() {
+}
+
+bool ShardedRun::Run() {
+    Simulator& simulator = mSimulator;
+    if(simulator.mEventLogger != nullptr) {
+        LOG_ERROR(TRAIN, "Sharded runs cannot record an event log");
+        return false;
+    }
+
+    if(!loadNetwork()) {
+        return false;
+    }
+
+    // The trains are run on the network loaded in part, in the simulator's state if it is the same network
+    mPart.reset(new Simulator(mNetwork, (mNetwork == simulator.mRailNetwork) ? simulator.mNetworkState : nullptr));
+
+    const Rail::RailTopology& topology = mNetwork->GetTopology();
+    mPartition.Build(topology, mShardCount);
+    mShardCount = mPartition.GetRegionCount();
+    markBoundary(topology);
+
+    // Each shard is given the trains on its region, with their places in the order of the trains. The topology
+    // numbers the components as the simulator's own does
+    const Rail::RailTopology& simulatorTopology = simulator.mRailNetwork->GetTopology();
+    std::vector<std::vector<std::pair<uint32_t, Train*>>> shardTrains(mShardCount);
+    for(uint32_t order = 0; order < simulator.mRunningTrains.size(); order++) {
+        Train* train = simulator.mRunningTrains[order];
+        uint32_t s = getShard(simulatorTopology, train->GetCurrentComponent());
+        if(s == Rail::INVALID_ID) {
+            LOG_ERROR(TRAIN, "Train %s is not on the network, so cannot be run on a shard", train->GetName());
+            return false;
+        }
+        shardTrains[s].push_back(std::make_pair(order, train));
+    }
+
+    std::vector<Util::BinaryWriter> starts;
+    for(uint32_t s = 0; s < mShardCount; s++) {
+        starts.push_back(startMessage(START));
+        writeTrains(starts.back(), simulator, shardTrains[s]);
+    }
+
+    for(uint32_t s = 0; s < mShardCount; s++) {
+        mToShards.emplace_back(new Util::SharedQueue());
+        mFromShards.emplace_back(new Util::SharedQueue());
+        if(!mToShards.back()->IsOpen() || !mFromShards.back()->IsOpen()) {
+            return false;
+        }
+    }
+
+    // Anything buffered would otherwise be written again by every shard
+    fflush(stdout);
+    mCoordinatorPid = getpid();
+
+    bool started = true;
+    for(uint32_t s = 0; s < mShardCount && started; s++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            mShard = s;
+            _exit(runShard(topology) ? 0 : 1);
+        }
+
+        started = pid > 0;
+        if(started) {
+            mShardPids.push_back(pid);
+        } else {
+            LOG_ERROR(TRAIN, "Failed to start shard %u", s);
+        }
+    }
+
+    // The shards now run the trains, and hand back those which finish
+    for(uint32_t s = 0; s < mShardCount && started; s++) {
+        started = sendToShard(s, starts[s]);
+    }
+
+    quietly([&]() {
+        for(auto train: simulator.mRunningTrains) {
+            simulator.retireTrain(train);
+        }
+    });
+    simulator.mRunningTrains.clear();
+    simulator.mOccupancy = OccupancyIndex();
+    simulator.mEventStamps.clear();
+
+    bool completed = started && coordinate(topology);
+    if(!completed) {
+        for(auto pid: mShardPids) {
+            kill(pid, SIGKILL);
+        }
+    }
+
+    for(uint32_t s = 0; s < mShardPids.size(); s++) {
+        int status = 0;
+        if(waitpid(mShardPids[s], &status, 0) != mShardPids[s] || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if(completed) {
+                LOG_ERROR(TRAIN, "Shard %u failed", s);
+            }
+            completed = false;
+        }
+    }
+
+    // The connectors were switched on the network the trains ran on
+    Rail::NetworkState& state = simulator.getNetworkState();
+    if(completed && &state != &mPart->getNetworkState()) {
+        state = mPart->getNetworkState();
+    }
+
+    return completed;
+}
+
+bool ShardedRun::loadNetwork() {
+    Simulator& simulator = mSimulator;
+    if(simulator.mRailNetwork->IsPartial()) {
+        mNetwork = simulator.mRailNetwork;
+        return true;
+    }
+
+    // A copy of the network is written to a file and mapped back, and the file removed once mapped
+    const char* directory = getenv("TMPDIR");
+    std::string path = std::string((directory != nullptr) ? directory : "/tmp") + "/ShardedRun.XXXXXX";
+    int file = mkstemp(&path[0]);
+    if(file < 0) {
+        LOG_ERROR(TRAIN, "Failed to create a file for the network of a sharded run");
+        return false;
+    }
+    close(file);
+
+    mCopiedNetwork.reset(new Rail::RailNetwork(new Rail::ArenaComponentFactory()));
+    bool loaded = false;
+    quietly([&]() {
+        loaded = simulator.mRailNetwork->Save(path, simulator.getNetworkState()) && mCopiedNetwork->LoadPartial(path);
+    });
+    unlink(path.c_str());
+
+    if(!loaded) {
+        LOG_ERROR(TRAIN, "Failed to copy the network of a sharded run to %s", path.c_str());
+        return false;
+    }
+
+    mNetwork = mCopiedNetwork.get();
+    return true;
+}
+
+void ShardedRun::markBoundary(const Rail::RailTopology& topology) {
+    const size_t segmentCount = topology.GetSegmentCount();
+    mBoundary.assign(segmentCount + topology.GetConnectorCount(), 0);
+    mCrossing.assign(topology.GetConnectorCount(), 0);
+
+    // Trains can only reach another region through a connector whose segments, or which as a terminator
+    // itself, are in more than one region. Every train on or about to reach those components is handed
+    // to the coordinator, along with the trains which might meet them
+    for(Rail::ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+        bool terminator = topology.IsTerminator(c);
+        uint32_t region = terminator ? mPartition.GetConnectorRegion(c) : Rail::INVALID_ID;
+        bool crossing = false;
+
+        for(Rail::NodeId n : topology.GetAttachments(c)) {
+            uint32_t segmentRegion = mPartition.GetSegmentRegion(Rail::NodeSegment(n));
+            crossing |= (region != Rail::INVALID_ID && segmentRegion != region);
+            region = segmentRegion;
+        }
+
+        if(!crossing) {
+            continue;
+        }
+
+        mCrossing[c] = 1;
+        if(terminator) {
+            mBoundary[segmentCount + c] = 1;
+        }
+
+        for(Rail::NodeId n : topology.GetAttachments(c)) {
+            mBoundary[Rail::NodeSegment(n)] = 1;
+        }
+    }
+}
+
+void ShardedRun::createComponents(const std::vector<uint8_t>& components) {
+    quietly([&]() {
+        for(uint32_t component = 0; component < components.size(); component++) {
+            if(components[component]) {
+                mNetwork->LoadComponent(component);
+            }
+        }
+    });
+}
+
+uint32_t ShardedRun::getShard(const Rail::RailTopology& topology, const Rail::IComponent* component) const {
+    Rail::SegmentId segment = topology.LookupSegment(component);
+    if(segment != Rail::INVALID_ID) {
+        return mPartition.GetSegmentRegion(segment);
+    }
+
+    // Trains can only stay on a terminator once they have reached one
+    Rail::ConnectorId connector = topology.LookupConnector(component);
+    if(connector == Rail::INVALID_ID || !topology.IsTerminator(connector)) {
+        return Rail::INVALID_ID;
+    }
+
+    return mPartition.GetConnectorRegion(connector);
+}
+
+bool ShardedRun::coordinate(const Rail::RailTopology& topology) {
+    Simulator& simulator = mSimulator;
+    Simulator& part = *mPart;
+
+    // The trains conducted here are all around the connectors between regions
+    std::vector<uint8_t> components(topology.GetSegmentCount() + topology.GetConnectorCount(), 0);
+    for(Rail::ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+        if(mCrossing[c]) {
+            markAround(topology, c, components);
+        }
+    }
+    createComponents(components);
+
+    std::vector<uint32_t> runningCounts(mShardCount);
+    std::vector<uint32_t> stoppedCounts(mShardCount);
+    std::vector<std::vector<char>> messages(mShardCount);
+
+    for(uint32_t s = 0; s < mShardCount; s++) {
+        if(!receiveFromShard(s, messages[s])) {
+            return false;
+        }
+
+        Util::BinaryReader reader(messages[s].data(), messages[s].size());
+        if(!readMessageType(reader, READY) || !reader.Read(runningCounts[s])) {
+            return false;
+        }
+    }
+
+    // One buffer of messages per shard, and one for the work done here
+    std::vector<Util::LogBuffer> logs(mShardCount + 1);
+    Util::LogBuffer& coordinatorLog = logs[mShardCount];
+
+    std::vector<Handover> handovers;
+    std::unordered_map<const Train*, const Handover*> handoverIndex;
+    std::unordered_map<uint32_t, Train*> orderIndex;
+    std::vector<std::pair<uint32_t, Traffic::ConnectorClaim>> orderedClaims;
+    std::vector<Traffic::ConnectorClaim> claims;
+    std::vector<uint64_t> claimKeys;
+    std::vector<std::pair<Rail::SegmentId, Rail::SegmentId>> routes;
+    std::unordered_set<const Rail::IComponent*> returned;
+    std::vector<std::pair<uint32_t, Train*>> finished;
+    std::vector<uint32_t> footprint;
+    bool stalled = false;
+
+    while(!stalled && std::any_of(runningCounts.begin(), runningCounts.end(), [](uint32_t count) { return count > 0; })) {
+        // Every shard routes its own trains, leaving the connectors between regions to be switched here
+        Util::BinaryWriter start = startMessage(TICK);
+        for(uint32_t s = 0; s < mShardCount; s++) {
+            if(!sendToShard(s, start)) {
+                return false;
+            }
+        }
+
+        // Take the trains around the boundaries between regions, with the routes their shards set. The trains
+        // on each component arrive in the order their shard held them in, so are checked for collisions in the
+        // same order
+        handovers.clear();
+        handoverIndex.clear();
+        orderIndex.clear();
+        orderedClaims.clear();
+        part.mOccupancy.BeginTick();
+
+        for(uint32_t s = 0; s < mShardCount; s++) {
+            if(!receiveFromShard(s, messages[s])) {
+                return false;
+            }
+
+            Util::BinaryReader reader(messages[s].data(), messages[s].size());
+            Util::BinaryReader shardRoutes(nullptr, 0);
+            Util::BinaryReader shardClaims(nullptr, 0);
+            Util::BinaryReader trains(nullptr, 0);
+            uint32_t claimCount = 0;
+            uint32_t count = 0;
+            bool valid = readMessageType(reader, BOUNDARY) && reader.ReadBlock(shardRoutes) &&
+                         applyRoutes(shardRoutes, topology) && reader.Read(claimCount) &&
+                         reader.ReadBlock(shardClaims) && reader.Read(count) && reader.ReadBlock(trains);
+
+            for(uint32_t i = 0; i < claimCount && valid; i++) {
+                uint32_t order = 0;
+                uint8_t direction = 0;
+                Traffic::ConnectorClaim claim {nullptr, 0, 0, 0, Rail::Direction::UP, 0};
+                valid = shardClaims.Read(order) && shardClaims.Read(claim.mConnector) && shardClaims.Read(claim.mFrom) &&
+                        shardClaims.Read(claim.mTo) && shardClaims.Read(direction) && shardClaims.Read(claim.mDistance) &&
+                        claim.mConnector < topology.GetConnectorCount() && claim.mFrom < topology.GetSegmentCount() &&
+                        claim.mTo < topology.GetSegmentCount() && direction <= Rail::Direction::DOWN;
+                claim.mDirection = static_cast<Rail::Direction>(direction);
+                orderedClaims.push_back(std::make_pair(order, claim));
+            }
+
+            for(uint32_t i = 0; i < count && valid; i++) {
+                Handover handover {0, nullptr, Util::BinaryReader(nullptr, 0)};
+                trains.Read(handover.mOrder);
+                quietly([&]() {
+                    handover.mTrain = part.readTrain(trains, *mNetwork);
+                });
+
+                valid = handover.mTrain != nullptr;
+                if(valid) {
+                    valid = trains.ReadBlock(handover.mPath);
+                    part.mOccupancy.Insert(handover.mTrain);
+                    handovers.push_back(handover);
+                    orderIndex[handover.mOrder] = handover.mTrain;
+                }
+            }
+
+            if(!valid) {
+                LOG_ERROR(TRAIN, "Shard %u handed over a damaged train", s);
+                return false;
+            }
+        }
+
+        std::sort(handovers.begin(), handovers.end(), [](const Handover& a, const Handover& b) {
+            return a.mOrder < b.mOrder;
+        });
+        for(const auto& handover : handovers) {
+            handoverIndex[handover.mTrain] = &handover;
+        }
+
+        // Every train claiming a connector between regions is on a boundary segment, so has been handed over.
+        // Their claims are resolved together, in the order of the trains, as in a single update
+        std::stable_sort(orderedClaims.begin(), orderedClaims.end(),
+                         [](const std::pair<uint32_t, Traffic::ConnectorClaim>& a,
+                            const std::pair<uint32_t, Traffic::ConnectorClaim>& b) {
+            return a.first < b.first;
+        });
+
+        claims.clear();
+        claimKeys.clear();
+        for(auto& entry : orderedClaims) {
+            auto train = orderIndex.find(entry.first);
+            if(train == orderIndex.end()) {
+                LOG_ERROR(TRAIN, "A train claimed a connector between regions without being handed over");
+                return false;
+            }
+
+            entry.second.mTrain = train->second;
+            claims.push_back(entry.second);
+            claimKeys.push_back(logKey(ROUTE_PHASE, entry.first));
+        }
+
+        Traffic::ITrafficController& controller = *part.mTrafficController;
+        Util::LogBuffer* previous = Util::Log::Capture(&coordinatorLog);
+        routes.clear();
+        mNetwork->SetRouteRecorder(&routes);
+        controller.SetLogKeys(&claimKeys);
+        controller.ApplyClaims(*mNetwork, part.getNetworkState(), claims);
+        controller.SetLogKeys(nullptr);
+        mNetwork->SetRouteRecorder(nullptr);
+
+        // Conduct the trains handed over together, in order, once the components they may reach are created
+        quietly([&]() {
+            for(const auto& handover : handovers) {
+                getFootprint(handover.mTrain, topology, footprint);
+                for(auto component : footprint) {
+                    mNetwork->LoadComponent(component);
+                }
+            }
+        });
+
+        bool changed = false;
+        part.mTrainStore.Advance();
+        for(const auto& handover : handovers) {
+            coordinatorLog.SetKey(logKey(CONDUCT_PHASE, handover.mOrder));
+            changed |= part.conductTrain(handover.mTrain, topology, part.getNetworkState()) != 0;
+        }
+        Util::Log::Capture(previous);
+
+        // Hand each train to the shard whose region it is now on, with the trains on each component in the
+        // order they are held here
+        std::vector<Util::BinaryWriter> returns(mShardCount);
+        std::vector<uint32_t> returnCounts(mShardCount, 0);
+        returned.clear();
+        for(const auto& handover : handovers) {
+            const Rail::IComponent* component = handover.mTrain->GetCurrentComponent();
+            if(!returned.insert(component).second) {
+                continue;
+            }
+
+            uint32_t s = getShard(topology, component);
+            if(s == Rail::INVALID_ID) {
+                LOG_ERROR(TRAIN, "Train %s has left the network", handover.mTrain->GetName());
+                return false;
+            }
+
+            for(auto train : part.mOccupancy.GetOccupants(component)) {
+                const Handover& occupant = *handoverIndex[train];
+                returns[s].Write<uint32_t>(occupant.mOrder);
+                Simulator::writeTrain(returns[s], topology, train);
+                returns[s].WriteBlock(occupant.mPath.GetData(), occupant.mPath.GetSize());
+                returnCounts[s]++;
+            }
+        }
+
+        quietly([&]() {
+            for(const auto& handover : handovers) {
+                part.mOccupancy.Remove(handover.mTrain);
+                part.retireTrain(handover.mTrain);
+            }
+        });
+
+        for(uint32_t s = 0; s < mShardCount; s++) {
+            Util::BinaryWriter writer = startMessage(RETURN);
+            writeRoutes(writer, routes);
+            writer.Write<uint32_t>(returnCounts[s]);
+            writer.WriteBlock(returns[s].GetData().data(), returns[s].GetData().size());
+            if(!sendToShard(s, writer)) {
+                return false;
+            }
+        }
+
+        // Collect the messages and finished trains of the tick, and report them in the order of the trains
+        finished.clear();
+        for(uint32_t s = 0; s < mShardCount; s++) {
+            if(!receiveFromShard(s, messages[s])) {
+                return false;
+            }
+
+            Util::BinaryReader reader(messages[s].data(), messages[s].size());
+            Util::BinaryReader trains(nullptr, 0);
+            uint32_t count = 0;
+            uint8_t shardChanged = 0;
+            bool valid = readMessageType(reader, DONE);
+            readLog(reader, logs[s]);
+            valid = valid && reader.Read(count) && reader.ReadBlock(trains) && reader.Read(runningCounts[s]) &&
+                    reader.Read(stoppedCounts[s]) && reader.Read(shardChanged);
+            changed |= shardChanged != 0;
+
+            for(uint32_t i = 0; i < count && valid; i++) {
+                uint32_t order = 0;
+                Train* train = nullptr;
+                trains.Read(order);
+                quietly([&]() {
+                    train = simulator.readTrain(trains, *simulator.mRailNetwork);
+                });
+
+                valid = train != nullptr;
+                if(valid) {
+                    finished.push_back(std::make_pair(order, train));
+                }
+            }
+
+            if(!valid) {
+                LOG_ERROR(TRAIN, "Shard %u reported a damaged train", s);
+                return false;
+            }
+        }
+
+        Util::Log::Flush(logs);
+
+        std::sort(finished.begin(), finished.end());
+        for(const auto& entry : finished) {
+            Train* train = entry.second;
+            if(train->GetState() == Train::State::SUCCESS) {
+                simulator.mSucceededCount++;
+            } else {
+                simulator.mCrashedCount++;
+            }
+
+            if(simulator.mRetainFinishedTrains) {
+                simulator.mFinishedTrains.push_back(train);
+            } else {
+                simulator.retireTrain(train);
+            }
+        }
+
+        simulator.mTick++;
+
+        // As in Simulator::runTicks(), nothing will start the trains again once a tick has passed without any
+        // changing while every train is stopped
+        uint32_t runningCount = std::accumulate(runningCounts.begin(), runningCounts.end(), 0u);
+        uint32_t stoppedCount = std::accumulate(stoppedCounts.begin(), stoppedCounts.end(), 0u);
+        if(!changed && stoppedCount == runningCount) {
+            LOG_ERROR(TRAIN, "Simulation deadlocked with %zu trains stopped", static_cast<size_t>(runningCount));
+            stalled = true;
+        }
+    }
+
+    return stopShards();
+}
+
+bool ShardedRun::stopShards() {
+    Simulator& simulator = mSimulator;
+    Util::BinaryWriter stop = startMessage(STOP);
+    for(uint32_t s = 0; s < mShardCount; s++) {
+        if(!sendToShard(s, stop)) {
+            return false;
+        }
+    }
+
+    // Take back the trains still running, as a single process would have kept them, with their paths
+    std::vector<std::pair<uint32_t, Train*>> remaining;
+    std::vector<char> message;
+    bool valid = true;
+    for(uint32_t s = 0; s < mShardCount && valid; s++) {
+        if(!receiveFromShard(s, message)) {
+            return false;
+        }
+
+        Util::BinaryReader reader(message.data(), message.size());
+        valid = readMessageType(reader, REMAINING) && readTrains(reader, simulator, remaining);
+    }
+
+    std::sort(remaining.begin(), remaining.end());
+    for(const auto& entry : remaining) {
+        simulator.mRunningTrains.push_back(entry.second);
+        simulator.mOccupancy.Insert(entry.second);
+    }
+
+    if(!valid) {
+        LOG_ERROR(TRAIN, "A shard handed back a damaged train");
+    }
+    return valid;
+}
+
+bool ShardedRun::runShard(const Rail::RailTopology& topology) {
+    Simulator& part = *mPart;
+
+    // A shard is of no use once its coordinator has gone
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if(getppid() != mCoordinatorPid) {
+        return false;
+    }
+
+    // Everything the shard writes is passed to the coordinator, to be written in order
+    Util::Log::Capture(&mLog);
+
+    // Create the components of this shard's region, and those next to it which its trains may reach or be
+    // routed through
+    const size_t segmentCount = topology.GetSegmentCount();
+    std::vector<uint8_t> components(segmentCount + topology.GetConnectorCount(), 0);
+    for(Rail::SegmentId s = 0; s < segmentCount; s++) {
+        if(mPartition.GetSegmentRegion(s) != mShard) {
+            continue;
+        }
+
+        components[s] = 1;
+        for(Rail::Direction d : {Rail::Direction::UP, Rail::Direction::DOWN}) {
+            Rail::ConnectorId end = topology.GetEnd(Rail::MakeNode(s, d));
+            if(end != Rail::INVALID_ID) {
+                markAround(topology, end, components);
+            }
+        }
+    }
+
+    for(Rail::ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+        if(topology.IsTerminator(c) && mPartition.GetConnectorRegion(c) == mShard) {
+            markAround(topology, c, components);
+        }
+    }
+    createComponents(components);
+
+    // Take the trains on this shard's region, in their order as a single process would hold them
+    part.mRetainFinishedTrains = false;
+    std::vector<char> message;
+    if(!receiveFromCoordinator(message)) {
+        return false;
+    }
+
+    std::vector<std::pair<uint32_t, Train*>> trains;
+    Util::BinaryReader start(message.data(), message.size());
+    if(!readMessageType(start, START) || !readTrains(start, part, trains)) {
+        return false;
+    }
+
+    for(const auto& entry : trains) {
+        mOrders[entry.second] = entry.first;
+        part.mRunningTrains.push_back(entry.second);
+        part.mOccupancy.Insert(entry.second);
+    }
+
+    mMarked.assign(mBoundary.size(), 0);
+
+    Util::BinaryWriter ready = startMessage(READY);
+    ready.Write<uint32_t>(part.mRunningTrains.size());
+    if(!sendToCoordinator(ready)) {
+        return false;
+    }
+
+    while(receiveFromCoordinator(message)) {
+        Util::BinaryReader reader(message.data(), message.size());
+        uint8_t type = STOP;
+        reader.Read(type);
+
+        if(type == TICK) {
+            if(!tickShard(topology)) {
+                return false;
+            }
+        } else {
+            return type == STOP && handBack();
+        }
+    }
+
+    return false;
+}
+
+bool ShardedRun::tickShard(const Rail::RailTopology& topology) {
+    Simulator& part = *mPart;
+    std::vector<Train*>& running = part.mRunningTrains;
+    Traffic::ITrafficController& controller = *part.mTrafficController;
+
+    // Route every train of this shard in one update, in order, leaving the connectors between regions to be
+    // switched by the coordinator once it has the claims of every shard
+    std::vector<uint64_t> keys;
+    for(auto train : running) {
+        keys.push_back(logKey(ROUTE_PHASE, mOrders[train]));
+    }
+
+    std::vector<Traffic::ConnectorClaim> claims;
+    std::vector<std::pair<Rail::SegmentId, Rail::SegmentId>> routes;
+    mNetwork->SetRouteRecorder(&routes);
+    controller.SetSharedConnectors(&mCrossing, &claims);
+    controller.SetLogKeys(&keys);
+    part.updateRailNetwork();
+    controller.SetLogKeys(nullptr);
+    controller.SetSharedConnectors(nullptr, nullptr);
+    mNetwork->SetRouteRecorder(nullptr);
+    mLog.SetKey(0);
+
+    Util::BinaryWriter boundary = startMessage(BOUNDARY);
+    writeRoutes(boundary, routes);
+
+    Util::BinaryWriter claimed;
+    for(const auto& claim : claims) {
+        claimed.Write<uint32_t>(mOrders[claim.mTrain]);
+        claimed.Write<uint32_t>(claim.mConnector);
+        claimed.Write<uint32_t>(claim.mFrom);
+        claimed.Write<uint32_t>(claim.mTo);
+        claimed.Write<uint8_t>(claim.mDirection);
+        claimed.Write<uint32_t>(claim.mDistance);
+    }
+    boundary.Write<uint32_t>(claims.size());
+    boundary.WriteBlock(claimed);
+
+    takeBoundaryTrains(boundary, topology);
+    if(!sendToCoordinator(boundary)) {
+        return false;
+    }
+
+    // Conduct the rest of the trains while the coordinator conducts those handed to it. None of them can reach
+    // a connector between regions within the tick
+    bool changed = false;
+    part.mOccupancy.BeginTick();
+    part.mTrainStore.Advance();
+    for(auto train: running) {
+        mLog.SetKey(logKey(CONDUCT_PHASE, mOrders[train]));
+        changed |= part.conductTrain(train, topology, part.getNetworkState()) != 0;
+    }
+
+    // Take back the trains now on this shard's region, with their paths
+    std::vector<char> message;
+    if(!receiveFromCoordinator(message)) {
+        return false;
+    }
+
+    Util::BinaryReader returns(message.data(), message.size());
+    Util::BinaryReader crossingRoutes(nullptr, 0);
+    Util::BinaryReader trains(nullptr, 0);
+    uint32_t count = 0;
+    bool valid = readMessageType(returns, RETURN) && returns.ReadBlock(crossingRoutes) &&
+                 applyRoutes(crossingRoutes, topology) && returns.Read(count) && returns.ReadBlock(trains);
+    for(uint32_t i = 0; i < count && valid; i++) {
+        uint32_t order = 0;
+        trains.Read(order);
+        quietly([&]() {
+            Train* train = part.readTrain(trains, *mNetwork);
+            valid = train != nullptr;
+            if(!valid) {
+                return;
+            }
+
+            mOrders[train] = order;
+            running.push_back(train);
+            part.mOccupancy.Insert(train);
+
+            Util::BinaryReader path(nullptr, 0);
+            valid = trains.ReadBlock(path) && part.mTrafficController->RestoreState(path, *mNetwork, {train});
+        });
+    }
+
+    if(!valid) {
+        return false;
+    }
+
+    std::sort(running.begin(), running.end(), [&](const Train* a, const Train* b) {
+        return mOrders[a] < mOrders[b];
+    });
+
+    // Remove the trains which have finished, and pass them on to be reported
+    Util::BinaryWriter finished;
+    uint32_t finishedCount = 0;
+    size_t kept = 0;
+    for(size_t i = 0; i < running.size(); i++) {
+        Train* train = running[i];
+        if(train->GetState() == Train::State::RUNNING) {
+            running[kept++] = train;
+            continue;
+        }
+
+        uint32_t order = mOrders[train];
+        mLog.SetKey(logKey(REMOVE_PHASE, order));
+        finished.Write<uint32_t>(order);
+        Simulator::writeTrain(finished, topology, train);
+        finishedCount++;
+
+        mOrders.erase(train);
+        part.finishTrain(train);
+    }
+    running.resize(kept);
+
+    uint32_t stoppedCount = std::count_if(running.begin(), running.end(), [](const Train* train) {
+        return train->IsStopped();
+    });
+
+    Util::BinaryWriter done = startMessage(DONE);
+    writeLog(done);
+    done.Write<uint32_t>(finishedCount);
+    done.WriteBlock(finished);
+    done.Write<uint32_t>(running.size());
+    done.Write<uint32_t>(stoppedCount);
+    done.Write<uint8_t>(changed || finishedCount > 0);
+
+    return sendToCoordinator(done);
+}
+
+bool ShardedRun::handBack() {
+    std::vector<std::pair<uint32_t, Train*>> trains;
+    for(auto train : mPart->mRunningTrains) {
+        trains.push_back(std::make_pair(mOrders[train], train));
+    }
+
+    Util::BinaryWriter remaining = startMessage(REMAINING);
+    writeTrains(remaining, *mPart, trains);
+    return sendToCoordinator(remaining);
+}
+
+void ShardedRun::takeBoundaryTrains(Util::BinaryWriter& writer, const Rail::RailTopology& topology) {
+    Simulator& part = *mPart;
+    std::vector<Train*>& running = part.mRunningTrains;
+    std::vector<uint32_t> footprint;
+
+    auto isMarked = [&](uint32_t component) {
+        return mBoundary[component] || mMarked[component];
+    };
+
+    // Take the trains which may reach a boundary component, then any which may meet those trains, until no
+    // more are found. The rest cannot meet a train of another shard within the tick
+    mSelected.assign(running.size(), 0);
+    bool found = true;
+    while(found) {
+        found = false;
+        for(size_t i = 0; i < running.size(); i++) {
+            if(mSelected[i]) {
+                continue;
+            }
+
+            getFootprint(running[i], topology, footprint);
+            if(std::none_of(footprint.begin(), footprint.end(), isMarked)) {
+                continue;
+            }
+
+            mSelected[i] = 1;
+            for(auto component : footprint) {
+                if(!isMarked(component)) {
+                    mMarked[component] = 1;
+                    mMarkedList.push_back(component);
+                    found = true;
+                }
+            }
+        }
+    }
+
+    for(auto component : mMarkedList) {
+        mMarked[component] = 0;
+    }
+    mMarkedList.clear();
+
+    // Every train on a component taken is taken too, so hand them over in the order they are held in for
+    // collision checks
+    Util::BinaryWriter trains;
+    uint32_t count = 0;
+    std::unordered_set<const Rail::IComponent*> taken;
+    for(size_t i = 0; i < running.size(); i++) {
+        const Rail::IComponent* component = running[i]->GetCurrentComponent();
+        if(!mSelected[i] || !taken.insert(component).second) {
+            continue;
+        }
+
+        for(auto train : part.mOccupancy.GetOccupants(component)) {
+            Util::BinaryWriter path;
+            part.mTrafficController->SaveState(path, *mNetwork, {{train, 0}});
+
+            trains.Write<uint32_t>(mOrders[train]);
+            Simulator::writeTrain(trains, topology, train);
+            trains.WriteBlock(path);
+            count++;
+        }
+    }
+
+    writer.Write<uint32_t>(count);
+    writer.WriteBlock(trains);
+
+    if(count == 0) {
+        return;
+    }
+
+    size_t kept = 0;
+    for(size_t i = 0; i < running.size(); i++) {
+        Train* train = running[i];
+        if(!taken.count(train->GetCurrentComponent())) {
+            running[kept++] = train;
+            continue;
+        }
+
+        mOrders.erase(train);
+        part.mOccupancy.Remove(train);
+        quietly([&]() {
+            part.retireTrain(train);
+        });
+    }
+    running.resize(kept);
+}
+
+void ShardedRun::getFootprint(const Train* train, const Rail::RailTopology& topology, std::vector<uint32_t>& components) {
+    const size_t segmentCount = topology.GetSegmentCount();
+    components.clear();
+
+    Rail::SegmentId segment = train->GetSegmentId();
+    if(segment == Rail::INVALID_ID) {
+        segment = topology.LookupSegment(train->GetCurrentComponent());
+    }
+
+    if(segment == Rail::INVALID_ID) {
+        components.push_back(segmentCount + topology.LookupConnector(train->GetCurrentComponent()));
+        return;
+    }
+
+    components.push_back(segment);
+
+    // A train short of the end of its segment, or stopped, stays on it for the tick
+    unsigned int index = train->GetCurrentLocation(train->GetDirection());
+    if(train->IsStopped() || index < topology.GetLength(segment)) {
+        return;
+    }
+
+    Rail::ConnectorId end = topology.GetEnd(Rail::MakeNode(segment, train->GetDirection()));
+    if(end == Rail::INVALID_ID) {
+        return;
+    }
+
+    if(topology.IsTerminator(end)) {
+        components.push_back(segmentCount + end);
+    }
+
+    for(Rail::NodeId n : topology.GetAttachments(end)) {
+        components.push_back(Rail::NodeSegment(n));
+    }
+}
+
+bool ShardedRun::applyRoutes(Util::BinaryReader& reader, const Rail::RailTopology& topology) {
+    const size_t segmentCount = topology.GetSegmentCount();
+    bool valid = true;
+
+    quietly([&]() {
+        while(valid && !reader.IsAtEnd()) {
+            uint32_t src = Rail::INVALID_ID;
+            uint32_t dst = Rail::INVALID_ID;
+            valid = reader.Read(src) && reader.Read(dst) && src < segmentCount && dst < segmentCount &&
+                    mNetwork->RouteSegment(mPart->getNetworkState(), src, dst);
+        }
+    });
+
+    return valid;
+}
+
+void ShardedRun::writeTrains(Util::BinaryWriter& writer, Simulator& simulator,
+                             const std::vector<std::pair<uint32_t, Train*>>& trains) {
+    const Rail::RailTopology& topology = simulator.mRailNetwork->GetTopology();
+    Util::BinaryWriter records;
+    std::unordered_map<const Train*, uint32_t> trainIds;
+    for(const auto& entry : trains) {
+        uint32_t id = trainIds.size();
+        trainIds[entry.second] = id;
+        records.Write<uint32_t>(entry.first);
+        Simulator::writeTrain(records, topology, entry.second);
+    }
+
+    // The paths of every train are saved together, numbered in the order the trains are written
+    Util::BinaryWriter paths;
+    simulator.mTrafficController->SaveState(paths, *simulator.mRailNetwork, trainIds);
+
+    writer.Write<uint32_t>(trains.size());
+    writer.WriteBlock(records);
+    writer.WriteBlock(paths);
+}
+
+bool ShardedRun::readTrains(Util::BinaryReader& reader, Simulator& simulator,
+                            std::vector<std::pair<uint32_t, Train*>>& trains) {
+    uint32_t count = 0;
+    Util::BinaryReader records(nullptr, 0);
+    Util::BinaryReader paths(nullptr, 0);
+    bool valid = reader.Read(count) && reader.ReadBlock(records) && reader.ReadBlock(paths);
+
+    std::vector<Train*> read;
+    quietly([&]() {
+        for(uint32_t i = 0; i < count && valid; i++) {
+            uint32_t order = 0;
+            Train* train = records.Read(order) ? simulator.readTrain(records, *simulator.mRailNetwork) : nullptr;
+            valid = train != nullptr;
+            if(valid) {
+                trains.push_back(std::make_pair(order, train));
+                read.push_back(train);
+            }
+        }
+
+        valid = valid && simulator.mTrafficController->RestoreState(paths, *simulator.mRailNetwork, read);
+    });
+
+    return valid;
+}
+
+void ShardedRun::writeLog(Util::BinaryWriter& writer) {
+    writer.Write<uint32_t>(mLog.GetSize());
+    for(size_t i = 0; i < mLog.GetSize(); i++) {
+        writer.Write<uint64_t>(mLog.GetKey(i));
+        writer.WriteString(mLog.GetText(i));
+    }
+    mLog.Clear();
+}
+
+bool ShardedRun::sendToShard(uint32_t shard, const Util::BinaryWriter& writer) {
+    pid_t pid = mShardPids[shard];
+    return mToShards[shard]->Send(writer.GetData(), [pid]() {
+        return isRunning(pid);
+    });
+}
+
+bool ShardedRun::receiveFromShard(uint32_t shard, std::vector<char>& message) {
+    pid_t pid = mShardPids[shard];
+    bool received = mFromShards[shard]->Receive(message, [pid]() {
+        return isRunning(pid);
+    });
+
+    if(!received) {
+        LOG_ERROR(TRAIN, "Shard %u stopped responding", shard);
+    }
+    return received;
+}
+
+bool ShardedRun::sendToCoordinator(const Util::BinaryWriter& writer) {
+    pid_t coordinator = mCoordinatorPid;
+    return mFromShards[mShard]->Send(writer.GetData(), [coordinator]() {
+        return getppid() == coordinator;
+    });
+}
+
+bool ShardedRun::receiveFromCoordinator(std::vector<char>& message) {
+    pid_t coordinator = mCoordinatorPid;
+    return mToShards[mShard]->Receive(message, [coordinator]() {
+        return getppid() == coordinator;
+    });
+}
@@ -0,0 +1,156 @@
+#include "SharedQueue.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+
+using namespace Util;
+
+// How long a wait lasts before the other process is checked on
+static const long WAIT_NANOSECONDS = 50 * 1000 * 1000;
+
+SharedQueue::SharedQueue(size_t capacity) {
+    mCapacity = 1;
+    while(mCapacity < capacity) {
+        mCapacity *= 2;
+    }
+
+    mMappingSize = sizeof(State) + mCapacity;
+    void* mapping = mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED) {
+        LOG_ERROR(TRAIN, "Failed to map %zu bytes for a shared queue: %s", mMappingSize, strerror(errno));
+        return;
+    }
+
+    mState = static_cast<State*>(mapping);
+    mBuffer = static_cast<char*>(mapping) + sizeof(State);
+    mState->mHead = 0;
+    mState->mTail = 0;
+
+    // A robust mutex lets one process carry on if the other dies while holding it
+    pthread_mutexattr_t mutexAttributes;
+    pthread_mutexattr_init(&mutexAttributes);
+    pthread_mutexattr_setpshared(&mutexAttributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutexAttributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&mState->mMutex, &mutexAttributes);
+    pthread_mutexattr_destroy(&mutexAttributes);
+
+    pthread_condattr_t condAttributes;
+    pthread_condattr_init(&condAttributes);
+    pthread_condattr_setpshared(&condAttributes, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&condAttributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&mState->mChanged, &condAttributes);
+    pthread_condattr_destroy(&condAttributes);
+}
+
+SharedQueue::~SharedQueue() {
+    // The other process may still be using its own mapping, so the mutex and condition are left as they are
+    if(mState != nullptr) {
+        munmap(mState, mMappingSize);
+    }
+}
+
+bool SharedQueue::Send(const std::vector<char>& message, const std::function<bool()>& isPeerAlive) {
+    uint64_t size = message.size();
+    return write(reinterpret_cast<const char*>(&size), sizeof(size), isPeerAlive) &&
+           write(message.data(), message.size(), isPeerAlive);
+}
+
+bool SharedQueue::Receive(std::vector<char>& message, const std::function<bool()>& isPeerAlive) {
+    uint64_t size = 0;
+    if(!read(reinterpret_cast<char*>(&size), sizeof(size), isPeerAlive)) {
+        return false;
+    }
+
+    message.resize(size);
+    return read(message.data(), message.size(), isPeerAlive);
+}
+
+bool SharedQueue::write(const char* data, size_t size, const std::function<bool()>& isPeerAlive) {
+    while(size > 0) {
+        if(!lock()) {
+            return false;
+        }
+
+        while(mState->mHead - mState->mTail == mCapacity) {
+            if(!isPeerAlive()) {
+                pthread_mutex_unlock(&mState->mMutex);
+                return false;
+            }
+            wait();
+        }
+
+        // Copy as much as fits, up to the end of the buffer
+        size_t offset = mState->mHead & (mCapacity - 1);
+        size_t count = std::min(size, std::min(mCapacity - (mState->mHead - mState->mTail), mCapacity - offset));
+        memcpy(mBuffer + offset, data, count);
+        mState->mHead += count;
+
+        pthread_cond_broadcast(&mState->mChanged);
+        pthread_mutex_unlock(&mState->mMutex);
+
+        data += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool SharedQueue::read(char* data, size_t size, const std::function<bool()>& isPeerAlive) {
+    while(size > 0) {
+        if(!lock()) {
+            return false;
+        }
+
+        while(mState->mHead == mState->mTail) {
+            if(!isPeerAlive()) {
+                pthread_mutex_unlock(&mState->mMutex);
+                return false;
+            }
+            wait();
+        }
+
+        size_t offset = mState->mTail & (mCapacity - 1);
+        size_t count = std::min(size, std::min<size_t>(mState->mHead - mState->mTail, mCapacity - offset));
+        memcpy(data, mBuffer + offset, count);
+        mState->mTail += count;
+
+        pthread_cond_broadcast(&mState->mChanged);
+        pthread_mutex_unlock(&mState->mMutex);
+
+        data += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool SharedQueue::lock() {
+    int result = pthread_mutex_lock(&mState->mMutex);
+    if(result == EOWNERDEAD) {
+        // The other process died holding the lock. Head and tail only move once the bytes they cover have
+        // been copied, so the queue is whole, and the wait which follows finds the process has gone
+        result = pthread_mutex_consistent(&mState->mMutex);
+    }
+
+    return result == 0;
+}
+
+void SharedQueue::wait() {
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += WAIT_NANOSECONDS;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // The lock is held again however the wait ends, as in lock()
+    int result = pthread_cond_timedwait(&mState->mChanged, &mState->mMutex, &deadline);
+    if(result == EOWNERDEAD) {
+        pthread_mutex_consistent(&mState->mMutex);
+    }
+}
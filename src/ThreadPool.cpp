@@ -0,0 +1,79 @@
+#include "ThreadPool.h"
+
+using namespace Util;
+
+ThreadPool::ThreadPool(unsigned int threadCount) : mNext(0) {
+    for(unsigned int worker = 1; worker < threadCount; worker++) {
+        mThreads.emplace_back(&ThreadPool::workerLoop, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+
+    for(auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t, unsigned int)>& fn) {
+    if(count == 0) {
+        return;
+    }
+
+    // Nothing to share the work with, run it inline
+    if(mThreads.empty() || count == 1) {
+        for(size_t i = 0; i < count; i++) {
+            fn(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &fn;
+        mCount = count;
+        mNext = 0;
+        mActive = mThreads.size();
+        mGeneration++;
+    }
+    mWake.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mActive == 0; });
+    mTask = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned int worker) {
+    uint64_t generation = 0;
+
+    while(true) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [&] { return mStopping || mGeneration != generation; });
+        if(mStopping) {
+            return;
+        }
+
+        generation = mGeneration;
+        lock.unlock();
+
+        runTasks(worker);
+
+        lock.lock();
+        if(--mActive == 0) {
+            mDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::runTasks(unsigned int worker) {
+    for(size_t i = mNext++; i < mCount; i = mNext++) {
+        (*mTask)(i, worker);
+    }
+}
@@ -1,43 +1,162 @@
 #include "Train.h"
+#include "Log.h"
 
 namespace Train {
 
-Train::Train(const std::string& name, const Rail::IComponent *startingComponent, Rail::Direction direction) : 
-    mName(name), mCurrentComponent(startingComponent), mDirection(direction)
+Train::Train(TrainStore& store, const std::string& name, const Rail::IComponent *startingComponent, Rail::Direction direction) :
+    mName(name), mStore(store), mSlot(store.Add(startingComponent, direction))
 {
     // TODO Null check
-    printf("INFO Train %s created, starting on segment %s in direction %s\n",
+    LOG_INFO(TRAIN, "Train %s created, starting on segment %s in direction %s",
             GetName(), startingComponent->GetName(), Rail::PrintDirection(direction));
 }
 
-Train::~Train() {}
+Train::~Train() {
+    if(mStore.GetEventLogger() != nullptr) {
+        mStore.GetEventLogger()->Forget(this);
+    }
+    mStore.Remove(mSlot);
+}
 
 void Train::Conduct() {
-    if(mState != State::RUNNING) {
-        printf("WARNING Conducting a Train that is not RUNNING");
+    if(GetState() != State::RUNNING) {
+        LOG_WARNING(TRAIN, "Conducting Train %s that is not RUNNING", GetName());
+        return;
+    }
+
+    // The train has already progressed along its component in bulk
+    if(mStore.mPending[mSlot]) {
+        mStore.mPending[mSlot] = false;
         return;
     }
-    
+
+    savePosition();
+
     // If we have not reached the end of a component simply progress by one unit
-    if(mSegmentIndex < mCurrentComponent->GetLength()) {
+    if(mStore.mSegmentIndexes[mSlot] < GetCurrentComponent()->GetLength()) {
         handleProgressed();
         return;
     }
 
     // If we have reached the end of a segment, attempt to traverse the network
-    handleTraversed();
+    const Rail::IComponent* currentComponent = GetCurrentComponent();
+    const Rail::IComponent* newComponent = currentComponent->Traverse(currentComponent, GetDirection());
+    if(handleTraversed(newComponent)) {
+        mStore.mLengths[mSlot] = newComponent->GetLength();
+        faceAwayFrom(currentComponent);
+    }
+}
+
+void Train::Conduct(const Rail::RailTopology& topology, const Rail::NetworkState& state) {
+    if(GetState() != State::RUNNING) {
+        LOG_WARNING(TRAIN, "Conducting Train %s that is not RUNNING", GetName());
+        return;
+    }
+
+    // Look the component up even if the train does not need it yet, so that its id is known from the
+    // first tick, see GetSegmentId()
+    resolveComponent(topology);
+
+    // The train has already progressed along its component in bulk
+    if(mStore.mPending[mSlot]) {
+        mStore.mPending[mSlot] = false;
+        return;
+    }
+
+    savePosition();
+
+    if(mStore.mSegmentIndexes[mSlot] < mStore.mLengths[mSlot]) {
+        handleProgressed();
+        return;
+    }
+
+    // Dispatch on the kind of the current component, so that a segment, which nearly every train is on,
+    // is traversed by id without calling through IComponent, and the id of the next component comes with it
+    switch(GetComponentKind()) {
+        case Rail::ComponentKind::SEGMENT: {
+            Rail::ComponentKind kind;
+            const Rail::NodeId node = Rail::MakeNode(mStore.mComponentIds[mSlot], GetDirection());
+            uint32_t id = topology.Traverse(state, node, kind);
+            if(handleTraversed(topology.GetComponent(id, kind))) {
+                mStore.mComponentIds[mSlot] = id;
+                mStore.mComponentKinds[mSlot] = kind;
+                mStore.mLengths[mSlot] = (kind == Rail::ComponentKind::SEGMENT) ?
+                        topology.GetLength(id) : GetCurrentComponent()->GetLength();
+
+                // Entered by the end it was heading for, see faceAwayFrom()
+                if(kind == Rail::ComponentKind::SEGMENT &&
+                        topology.GetEnd(Rail::MakeNode(id, GetDirection())) == topology.GetEnd(node)) {
+                    ReverseDirection();
+                }
+            }
+            break;
+        }
+
+        default:
+            // Terminators, and components outside the topology, are traversed by the component itself. The
+            // new component is resolved straight away, so that its id is known while the train is advanced
+            // along it
+            const Rail::IComponent* currentComponent = GetCurrentComponent();
+            if(handleTraversed(currentComponent->Traverse(currentComponent, GetDirection()))) {
+                resolveComponent(topology);
+                faceAwayFrom(currentComponent);
+            }
+            break;
+    }
+}
+
+Train::Snapshot Train::Save() const {
+    Snapshot snapshot;
+    snapshot.mComponent = GetCurrentComponent();
+    snapshot.mPreviousComponent = GetPreviousComponent();
+    snapshot.mSegmentIndex = mStore.mSegmentIndexes[mSlot];
+    snapshot.mPreviousSegmentIndex = mStore.mPreviousSegmentIndexes[mSlot];
+    snapshot.mDistance = mStore.mDistances[mSlot];
+    snapshot.mStoppedTime = mStore.mStoppedTimes[mSlot];
+    snapshot.mDirection = GetDirection();
+    snapshot.mState = GetState();
+    snapshot.mStopped = IsStopped();
+
+    return snapshot;
+}
+
+void Train::Restore(const Snapshot& snapshot) {
+    mStore.mComponents[mSlot] = snapshot.mComponent;
+    mStore.mComponentIds[mSlot] = Rail::INVALID_ID;
+    mStore.mComponentKinds[mSlot] = Rail::ComponentKind::UNKNOWN;
+    mStore.mLengths[mSlot] = snapshot.mComponent->GetLength();
+    mStore.mSegmentIndexes[mSlot] = snapshot.mSegmentIndex;
+    mStore.mPreviousComponents[mSlot] = snapshot.mPreviousComponent;
+    mStore.mPreviousSegmentIndexes[mSlot] = snapshot.mPreviousSegmentIndex;
+    mStore.mDistances[mSlot] = snapshot.mDistance;
+    mStore.mStoppedTimes[mSlot] = snapshot.mStoppedTime;
+    mStore.mDirections[mSlot] = snapshot.mDirection;
+    mStore.mStates[mSlot] = snapshot.mState;
+    mStore.mStopped[mSlot] = snapshot.mStopped;
+    mStore.mPending[mSlot] = false;
 }
 
 void Train::NotifyCollided(Train* other) {
     //TODO null check
-    printf("ERROR Train %s collided with %s on component %s\n", GetName(), other->GetName(), mCurrentComponent->GetName());
-    mState = State::CRASHED;
+    LOG_ERROR(TRAIN, "Train %s collided with %s on component %s", GetName(), other->GetName(), GetCurrentComponent()->GetName());
+    if(mStore.GetEventLogger() != nullptr) {
+        recordEvent(Util::EventLogger::COLLIDED, GetCurrentComponent(), mStore.GetEventLogger()->GetId(other, other->GetName()));
+    }
+    mStore.mStates[mSlot] = State::CRASHED;
+
+    // A train that crashes before its turn to be conducted does not move, so undo any bulk progress
+    if(mStore.mPending[mSlot]) {
+        mStore.mPending[mSlot] = false;
+        mStore.mSegmentIndexes[mSlot]--;
+        mStore.mDistances[mSlot]--;
+    }
 }
 
 bool Train::CheckCollision(Train* other) {
     //TODO null check
+    Rail::Direction d = GetDirection();
     if(GetCurrentComponent() == other->GetCurrentComponent() &&
-       GetCurrentLocation(mDirection) == other->GetCurrentLocation(mDirection)) {
+       GetCurrentLocation(d) == other->GetCurrentLocation(d)) {
         // If the trains are at the same location on the same connector, then
         // A collision has ocurred
         NotifyCollided(other);
@@ -48,59 +167,161 @@ bool Train::CheckCollision(Train* other) {
     return false;
 }
 
+bool Train::CheckPassThrough(Train* other) {
+    //TODO null check
+    bool passed = false;
+    Rail::Direction d = GetDirection();
+
+    if(GetCurrentComponent() != GetPreviousComponent()) {
+        // Trains which swapped components have crossed at the connector between them
+        passed = (GetCurrentComponent() == other->GetPreviousComponent() &&
+                  GetPreviousComponent() == other->GetCurrentComponent());
+    } else if(other->GetCurrentComponent() == GetCurrentComponent() && other->GetPreviousComponent() == GetCurrentComponent() &&
+              other->GetDirection() != d) {
+        // Trains travelling towards each other along a component have crossed if their order has flipped
+        unsigned int before = getPreviousLocation(d);
+        unsigned int after = GetCurrentLocation(d);
+        unsigned int otherBefore = other->getPreviousLocation(d);
+        unsigned int otherAfter = other->GetCurrentLocation(d);
+
+        passed = (before < otherBefore && after > otherAfter) || (before > otherBefore && after < otherAfter);
+    }
+
+    if(passed) {
+        NotifyCollided(other);
+        other->NotifyCollided(this);
+    }
+
+    return passed;
+}
+
 unsigned int Train::GetCurrentLocation(Rail::Direction d) const {
-    if(mDirection == d) {
-        return mSegmentIndex;
+    // A train progressed in bulk is still where it was until its turn to be conducted
+    unsigned int index = mStore.mSegmentIndexes[mSlot] - mStore.mPending[mSlot];
+
+    if(GetDirection() == d) {
+        return index;
     } else {
-        return mCurrentComponent->GetLength() - mSegmentIndex + 1;
+        return mStore.mLengths[mSlot] - index + 1;
+    }
+}
+
+unsigned int Train::getPreviousLocation(Rail::Direction d) const {
+    unsigned int index = mStore.mPreviousSegmentIndexes[mSlot];
+
+    if(GetDirection() == d) {
+        return index;
+    } else {
+        // A train which has not left its component has its length to hand
+        unsigned int length = (GetPreviousComponent() == GetCurrentComponent()) ?
+                mStore.mLengths[mSlot] : GetPreviousComponent()->GetLength();
+        return length - index + 1;
     }
 }
 
 void Train::PrintStatus() const {
-    printf("INFO Train %s: %s at %s\n", 
-            GetName(), PrintState(mState), mCurrentComponent->GetName());
-    printf("INFO Train %s: travelled: %d units\n", GetName(), mDistanceTraveled);
-    printf("INFO Train %s: stopped time: %d units\n\n", GetName(), mStoppedTime);
+    LOG_INFO(TRAIN, "Train %s: %s at %s",
+            GetName(), PrintState(GetState()), GetCurrentComponent()->GetName());
+    LOG_INFO(TRAIN, "Train %s: travelled: %d units", GetName(), mStore.mDistances[mSlot]);
+    LOG_INFO(TRAIN, "Train %s: stopped time: %d units", GetName(), mStore.mStoppedTimes[mSlot]);
 }
 
 
 // Handles a case where Conduct progesses along the current component
 void Train::handleProgressed() {
-    mSegmentIndex++;
-    mDistanceTraveled++;
+    mStore.mStopped[mSlot] = false;
+    mStore.mSegmentIndexes[mSlot]++;
+    mStore.mDistances[mSlot]++;
 }
 
-// Handles the case where Conduct traverses to a new component
-void Train::handleTraversed() {
-    const Rail::IComponent* newComponent = mCurrentComponent->Traverse(mCurrentComponent, mDirection);
+// Handles the case where Conduct traverses to a new component, returning true if the train moved on to it.
+// The caller sets the id, kind and length of the new component
+bool Train::handleTraversed(const Rail::IComponent* newComponent) {
+    const Rail::IComponent* currentComponent = GetCurrentComponent();
+
+    // A connector not switched for this train's component cannot be crossed, and the train crashes on to it
+    if(newComponent == nullptr) {
+        mStore.mStates[mSlot] = State::CRASHED;
+        LOG_ERROR(TRAIN, "Train %s crashed leaving %s", GetName(), currentComponent->GetName());
+        return false;
+    }
 
     // If we have not moved components, record that we are stopped
-    if(mCurrentComponent == newComponent) {
+    if(currentComponent == newComponent) {
         handleStopped();
-        return;
+        return false;
     }
 
     // We have moved to a new component, update data
-    mSegmentIndex = 0;
-    mCurrentComponent = newComponent;
+    mStore.mStopped[mSlot] = false;
+    mStore.mSegmentIndexes[mSlot] = 0;
+    mStore.mComponents[mSlot] = newComponent;
+    mStore.mComponentIds[mSlot] = Rail::INVALID_ID;
+    mStore.mComponentKinds[mSlot] = Rail::ComponentKind::UNKNOWN;
 
-    // Printing every transition for debug
-    printf("INFO Train %s traversing to new component\n", GetName());
-    PrintStatus();
+    LOG_DEBUG(TRAVERSAL, "Train %s traversing to %s, travelled: %d units, stopped time: %d units",
+            GetName(), newComponent->GetName(), mStore.mDistances[mSlot], mStore.mStoppedTimes[mSlot]);
+    recordEvent(Util::EventLogger::TRAVERSED, newComponent, mStore.mDistances[mSlot], mStore.mStoppedTimes[mSlot]);
 
     // Then we need to check if we are at our destination
-    if (mCurrentComponent == mDestinationComponent) {
-        mState = State::SUCCESS;
-        printf("SUCCESS Train %s has reached its destination %s\n", 
+    if (newComponent == mDestinationComponent) {
+        mStore.mStates[mSlot] = State::SUCCESS;
+        LOG_INFO(TRAIN, "Train %s has reached its destination %s",
                 GetName(), mDestinationComponent->GetName());
+        recordEvent(Util::EventLogger::ARRIVED, mDestinationComponent);
     }
+
+    return true;
+}
+
+// Turns a train which has just entered a segment by the end it was heading for, so that it heads for the
+// other end. Segments meeting at a connector need not face the same way, and routes cross between them
+// either way round, see RailTopology::GetSuccessors()
+void Train::faceAwayFrom(const Rail::IComponent* previousComponent) {
+    auto previous = dynamic_cast<const Rail::ISegment*>(previousComponent);
+    auto current = dynamic_cast<const Rail::ISegment*>(GetCurrentComponent());
+    if(previous != nullptr && current != nullptr && current->GetNext(GetDirection()) == previous->GetNext(GetDirection())) {
+        ReverseDirection();
+    }
+}
+
+// Looks up the id, kind and length of the current component, if not already known
+void Train::resolveComponent(const Rail::RailTopology& topology) {
+    if(GetComponentKind() != Rail::ComponentKind::UNKNOWN) {
+        return;
+    }
+
+    Rail::ComponentKind kind;
+    mStore.mComponentIds[mSlot] = topology.Lookup(GetCurrentComponent(), kind);
+    mStore.mComponentKinds[mSlot] = kind;
+
+    // Only segments have their lengths in the topology
+    mStore.mLengths[mSlot] = (kind == Rail::ComponentKind::SEGMENT) ?
+            topology.GetLength(mStore.mComponentIds[mSlot]) : GetCurrentComponent()->GetLength();
+}
+
+// Records where the train is before Conduct moves it
+void Train::savePosition() {
+    mStore.mPreviousComponents[mSlot] = GetCurrentComponent();
+    mStore.mPreviousSegmentIndexes[mSlot] = mStore.mSegmentIndexes[mSlot];
 }
 
 // Handles the case where Conduct is called while the train is stopped
 void Train::handleStopped() {
-    mStoppedTime++;
-    printf("INFO Train %s stopped on %s, direction %s\n", 
-            GetName(), mCurrentComponent->GetName(), Rail::PrintDirection(mDirection));
+    mStore.mStopped[mSlot] = true;
+    mStore.mStoppedTimes[mSlot]++;
+    LOG_DEBUG(TRAVERSAL, "Train %s stopped on %s, direction %s",
+            GetName(), GetCurrentComponent()->GetName(), Rail::PrintDirection(GetDirection()));
+    recordEvent(Util::EventLogger::STOPPED, GetCurrentComponent(), GetDirection());
+}
+
+void Train::recordEvent(Util::EventLogger::EventType type, const Rail::IComponent* component, uint32_t arg0, uint32_t arg1) {
+    Util::EventLogger* logger = mStore.GetEventLogger();
+    if(logger == nullptr) {
+        return;
+    }
+
+    logger->Record(type, logger->GetId(this, GetName()), logger->GetId(component, component->GetName()), arg0, arg1);
 }
 
-} // namespace Train
\ No newline at end of file
+} // namespace Train
@@ -0,0 +1,39 @@
+#include "TrainPool.h"
+#include "Log.h"
+
+#include <new>
+
+namespace Train {
+
+TrainPool::~TrainPool() {
+    for(auto train : mActiveTrains) {
+        train->~Train();
+    }
+}
+
+Train* TrainPool::Acquire(const std::string& name, const Rail::IComponent* startingComponent, Rail::Direction direction) {
+    TrainStorage* storage;
+    if(!mFreeStorage.empty()) {
+        storage = mFreeStorage.back();
+        mFreeStorage.pop_back();
+    } else {
+        storage = mStorage.New();
+    }
+
+    Train* train = new (storage) Train(mStore, name, startingComponent, direction);
+    mActiveTrains.insert(train);
+
+    return train;
+}
+
+void TrainPool::Release(Train* train) {
+    if(mActiveTrains.erase(train) == 0) {
+        LOG_ERROR(TRAIN, "Releasing Train %s which was not acquired from this pool", train->GetName());
+        return;
+    }
+
+    train->~Train();
+    mFreeStorage.push_back(reinterpret_cast<TrainStorage*>(train));
+}
+
+} // namespace Train
@@ -1,17 +1,100 @@
 #include "TrainSimulator.h"
+#include "ShardedRun.h"
 #include "DjikstraTrafficController.h"
+#include "NetworkLoader.h"
 #include "RailNetwork.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
 
 using namespace Train;
 
-Simulator::Simulator() {
-    mRailNetwork = new Rail::RailNetwork(new Rail::ComponentFactory());
+// Regions the network is split into per thread, so that threads can balance regions with uneven numbers of
+// trains between them
+static const unsigned int REGIONS_PER_THREAD = 8;
+
+// Pieces the running trains are split into per thread, to be placed in their regions concurrently
+static const unsigned int CHUNKS_PER_THREAD = 4;
+
+// Trains are advanced in ranges of slots which are a multiple of this, so that threads do not share cache
+// lines of the train store
+static const size_t ADVANCE_RANGE_ALIGNMENT = 64;
+
+// A checkpoint is a network file followed by the state of the simulation, and ends with a footer locating
+// that state
+static const char CHECKPOINT_MAGIC[4] = {'T', 'S', 'C', 'P'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointFooter {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint64_t mStateOffset;
+    uint64_t mStateSize;
+};
+
+// Components are saved as their id within the topology, with connectors numbered after the segments
+static uint32_t saveComponent(const Rail::RailTopology& topology, const Rail::IComponent* component) {
+    Rail::SegmentId segment = topology.LookupSegment(component);
+    if(segment != Rail::INVALID_ID) {
+        return segment;
+    }
+
+    Rail::ConnectorId connector = topology.LookupConnector(component);
+    return (connector != Rail::INVALID_ID) ? topology.GetSegmentCount() + connector : Rail::INVALID_ID;
+}
+
+// Read the simulation state from the end of a checkpoint
+static bool readCheckpointState(const std::string& path, std::vector<char>& state) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == nullptr) {
+        return false;
+    }
+
+    CheckpointFooter footer;
+    bool valid = fseek(file, 0, SEEK_END) == 0;
+    long size = ftell(file);
+    valid = valid && size >= static_cast<long>(sizeof(footer)) &&
+            fseek(file, size - sizeof(footer), SEEK_SET) == 0 &&
+            fread(&footer, sizeof(footer), 1, file) == 1 &&
+            memcmp(footer.mMagic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) == 0 &&
+            footer.mVersion == CHECKPOINT_VERSION &&
+            footer.mStateOffset <= size - sizeof(footer) &&
+            footer.mStateSize <= size - sizeof(footer) - footer.mStateOffset;
+
+    if(valid) {
+        state.resize(footer.mStateSize);
+        valid = fseek(file, footer.mStateOffset, SEEK_SET) == 0 &&
+                fread(state.data(), 1, state.size(), file) == state.size();
+    }
+
+    fclose(file);
+    return valid;
+}
+
+Simulator::Simulator() : Simulator(new Rail::RailNetwork(new Rail::ArenaComponentFactory())) {
+    mOwnsRailNetwork = true;
+}
+
+Simulator::Simulator(Rail::RailNetwork* network, Rail::NetworkState* state) : mTrainPool(mTrainStore) {
+    mRailNetwork = network;
+    mOwnsRailNetwork = false;
+    mNetworkState = state;
     mTrafficController = new Traffic::DjikstraController();
+    mTrafficController->SetProfiler(&mProfiler);
 }
 
 Simulator::~Simulator() {
-    free(mRailNetwork);
-    free(mTrafficController);
+    mTrainStore.SetEventLogger(nullptr);
+    delete mEventLogger;
+    if(mOwnsRailNetwork) {
+        delete mRailNetwork;
+    }
+    delete mTrafficController;
+    delete mThreadPool;
 }
 
 void Simulator::RunSimpleNetworkTest() {
@@ -32,11 +115,9 @@ void Simulator::RunSimpleNetworkTest() {
     auto termB = mRailNetwork->AddTerminator(segC, Rail::Direction::UP, "TermB");
 
     // Add a train to the network
-    Train* testTrain = new Train("TestTrain", segA, Rail::Direction::UP);
+    Train* testTrain = AddTrain("TestTrain", segA, Rail::Direction::UP);
     testTrain->SetDestination(termB);
 
-    mRunningTrains.push_back(testTrain);
-
     Run();
     ValidateResults();
 }
@@ -55,69 +136,749 @@ void Simulator::RunCollisionTest() {
     auto termB = mRailNetwork->AddTerminator(segC, Rail::Direction::UP, "TermB");
 
     // Add a train to the network
-    Train* testTrain = new Train("TestTrain", segA, Rail::Direction::UP);
+    Train* testTrain = AddTrain("TestTrain", segA, Rail::Direction::UP);
     testTrain->SetDestination(termB);
-    mRunningTrains.push_back(testTrain);
 
     // And one that will crash with the first
-    Train* crashTrain = new Train("CrashTrain", segC, Rail::Direction::DOWN);
+    Train* crashTrain = AddTrain("CrashTrain", segC, Rail::Direction::DOWN);
     crashTrain->SetDestination(termA);
-    mRunningTrains.push_back(crashTrain);
 
     Run();
     ValidateResults();
 }
 
+Train::Train* Simulator::AddTrain(const std::string& name, const Rail::IComponent* startingComponent, Rail::Direction direction) {
+    Train* train = mTrainPool.Acquire(name, startingComponent, direction);
+    mRunningTrains.push_back(train);
+
+    return train;
+}
+
+void Simulator::SetThreadCount(unsigned int threadCount) {
+    delete mThreadPool;
+    mThreadPool = nullptr;
+
+    // The partition depends on the thread count, so is built again on the next tick
+    mPartition = Rail::NetworkPartition();
+
+    if(threadCount > 1) {
+        mThreadPool = new Util::ThreadPool(threadCount);
+    }
+}
+
+bool Simulator::SetEventLog(const std::string& path) {
+    Util::EventLogger* logger = new Util::EventLogger(path);
+    if(!logger->IsOpen()) {
+        delete logger;
+        return false;
+    }
+
+    delete mEventLogger;
+    mEventLogger = logger;
+    mTrainStore.SetEventLogger(mEventLogger);
+    mTrafficController->SetEventLogger(mEventLogger);
+    return true;
+}
+
 /**
  *  Build a rail network and populate it with trains
  */
-void Simulator::Build() {
-    // TODO this should be populated with methods for user input
+bool Simulator::Build(const std::string& path) {
+    Rail::TextNetworkLoader loader(*mRailNetwork, std::thread::hardware_concurrency());
+    bool loaded = loader.Load(path);
+
+    for(const auto& record : loader.GetTrains()) {
+        Train* train = AddTrain(record.mName, record.mStart, record.mDirection);
+        train->SetDestination(record.mDestination);
+    }
+
+    return loaded;
+}
+
+void Simulator::Generate(const Rail::NetworkGenerator::Options& options) {
+    std::vector<Rail::TextNetworkLoader::TrainRecord> trains;
+    Rail::NetworkGenerator(options).Build(*mRailNetwork, trains);
+
+    for(const auto& record : trains) {
+        Train* train = AddTrain(record.mName, record.mStart, record.mDirection);
+        train->SetDestination(record.mDestination);
+    }
 }
 
 /**
  *  Run a built simulation
  */
 void Simulator::Run() {
+    RunUntil(UINT64_MAX);
+}
+
+void Simulator::RunUntil(uint64_t tick) {
+    if(mRailNetwork->IsPartial()) {
+        LOG_ERROR(TRAIN, "A simulation restored in part can only be run sharded");
+        return;
+    }
+
+    for(auto train: mRunningTrains) {
+        mOccupancy.Insert(train);
+    }
+
+    if(mRunMode == RunMode::EVENT) {
+        runEvents(tick);
+    } else {
+        runTicks(tick);
+    }
+}
+
+void Simulator::AdvanceTo(uint64_t tick) {
+    RunUntil(tick);
+
+    if(mRunningTrains.empty() && mTick < tick) {
+        mTick = tick;
+    }
+}
+
+bool Simulator::RunSharded(unsigned int shardCount) {
+    ShardedRun run(*this, shardCount);
+    return run.Run();
+}
+
+bool Simulator::Checkpoint(const std::string& path) {
+    if(!mRailNetwork->Save(path, getNetworkState())) {
+        return false;
+    }
+
+    const Rail::RailTopology& topology = mRailNetwork->GetTopology();
+
+    Util::BinaryWriter writer;
+    writer.Write<uint64_t>(mTick);
+    writer.Write<uint64_t>(mSucceededCount);
+    writer.Write<uint64_t>(mCrashedCount);
+    writer.Write<uint32_t>(mRunningTrains.size());
+    writer.Write<uint32_t>(mFinishedTrains.size());
+
+    // Trains are numbered in the order they are saved, running trains first so they keep their order
+    std::unordered_map<const Train*, uint32_t> trainIds;
+    auto saveTrain = [&](const Train* train) {
+        uint32_t id = trainIds.size();
+        trainIds[train] = id;
+
+        writeTrain(writer, topology, train);
+    };
+
+    for(auto train: mRunningTrains) {
+        saveTrain(train);
+    }
+
+    for(auto train: mFinishedTrains) {
+        saveTrain(train);
+    }
+
+    Util::BinaryWriter controller;
+    mTrafficController->SaveState(controller, *mRailNetwork, trainIds);
+    writer.WriteBlock(controller);
+
+    // Append the state to the network file, aligned as its tables are
+    FILE* file = fopen(path.c_str(), "ab");
+    if(file == nullptr) {
+        LOG_ERROR(TRAIN, "Failed to open checkpoint %s", path.c_str());
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    static const char padding[8] = {};
+    size_t paddingSize = (8 - end % 8) % 8;
+
+    CheckpointFooter footer;
+    memcpy(footer.mMagic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    footer.mVersion = CHECKPOINT_VERSION;
+    footer.mStateOffset = end + paddingSize;
+    footer.mStateSize = writer.GetData().size();
+
+    fwrite(padding, 1, paddingSize, file);
+    fwrite(writer.GetData().data(), 1, writer.GetData().size(), file);
+    fwrite(&footer, sizeof(footer), 1, file);
+
+    bool failed = ferror(file) != 0;
+    failed |= fclose(file) != 0;
+    if(failed) {
+        LOG_ERROR(TRAIN, "Failed to write checkpoint %s", path.c_str());
+        return false;
+    }
+
+    LOG_INFO(TRAIN, "Saved checkpoint %s at tick %llu, %zu trains", path.c_str(),
+            static_cast<unsigned long long>(mTick), trainIds.size());
+    return true;
+}
+
+bool Simulator::Restore(const std::string& path, bool partial) {
+    if(!mRunningTrains.empty() || !mFinishedTrains.empty()) {
+        LOG_ERROR(TRAIN, "Restoring checkpoint %s into a simulation which already has trains", path.c_str());
+        return false;
+    }
+
+    // The checkpoint replaces the network, so the simulation must own it, and not have built it yet
+    const Rail::RailTopology& currentTopology = mRailNetwork->GetTopology();
+    if(!mOwnsRailNetwork || currentTopology.GetSegmentCount() != 0 || currentTopology.GetConnectorCount() != 0) {
+        LOG_ERROR(TRAIN, "Restoring checkpoint %s into a simulation which already has a network", path.c_str());
+        return false;
+    }
+
+    std::vector<char> state;
+    if(!readCheckpointState(path, state)) {
+        LOG_ERROR(TRAIN, "%s is not a checkpoint this version can read", path.c_str());
+        return false;
+    }
+
+    // Load the network into a new one, which only replaces the simulation's once the whole checkpoint has been
+    // read, so that a damaged checkpoint leaves the simulation unchanged
+    std::unique_ptr<Rail::RailNetwork> network(new Rail::RailNetwork(new Rail::ArenaComponentFactory()));
+    if(!(partial ? network->LoadPartial(path) : network->Load(path))) {
+        return false;
+    }
+
+    Util::BinaryReader reader(state.data(), state.size());
+
+    uint64_t tick = 0;
+    uint64_t succeededCount = 0;
+    uint64_t crashedCount = 0;
+    uint32_t runningCount = 0;
+    uint32_t finishedCount = 0;
+    reader.Read(tick);
+    reader.Read(succeededCount);
+    reader.Read(crashedCount);
+    reader.Read(runningCount);
+    reader.Read(finishedCount);
+
+    std::vector<Train*> trains;
+    bool valid = !reader.IsFailed();
+    for(uint64_t i = 0; valid && i < static_cast<uint64_t>(runningCount) + finishedCount; i++) {
+        Train* train = readTrain(reader, *network);
+        valid = train != nullptr;
+        if(valid) {
+            trains.push_back(train);
+        }
+    }
+
+    Util::BinaryReader controller(nullptr, 0);
+    valid = valid && reader.ReadBlock(controller) && reader.IsAtEnd() &&
+            mTrafficController->RestoreState(controller, *network, trains);
+
+    if(!valid) {
+        LOG_ERROR(TRAIN, "Checkpoint %s is damaged", path.c_str());
+        for(auto train: trains) {
+            retireTrain(train);
+        }
+        return false;
+    }
+
+    delete mRailNetwork;
+    mRailNetwork = network.release();
+
+    mRunningTrains.assign(trains.begin(), trains.begin() + runningCount);
+    mFinishedTrains.assign(trains.begin() + runningCount, trains.end());
+    mTick = tick;
+    mSucceededCount = succeededCount;
+    mCrashedCount = crashedCount;
+
+    LOG_INFO(TRAIN, "Restored checkpoint %s at tick %llu, %zu trains", path.c_str(),
+            static_cast<unsigned long long>(mTick), trains.size());
+    return true;
+}
+
+void Simulator::writeTrain(Util::BinaryWriter& writer, const Rail::RailTopology& topology, const Train* train) {
+    Train::Snapshot snapshot = train->Save();
+    writer.WriteString(train->GetName());
+    writer.Write<uint32_t>(saveComponent(topology, train->GetDestination()));
+    writer.Write<uint32_t>(saveComponent(topology, snapshot.mComponent));
+    writer.Write<uint32_t>(saveComponent(topology, snapshot.mPreviousComponent));
+    writer.Write<uint32_t>(snapshot.mSegmentIndex);
+    writer.Write<uint32_t>(snapshot.mPreviousSegmentIndex);
+    writer.Write<uint32_t>(snapshot.mDistance);
+    writer.Write<uint32_t>(snapshot.mStoppedTime);
+    writer.Write<uint8_t>(snapshot.mDirection);
+    writer.Write<uint8_t>(snapshot.mState);
+    writer.Write<uint8_t>(snapshot.mStopped);
+}
+
+Train::Train* Simulator::readTrain(Util::BinaryReader& reader, Rail::RailNetwork& network) {
+    std::string name;
+    uint32_t destination = 0;
+    uint32_t component = 0;
+    uint32_t previousComponent = 0;
+    uint8_t direction = 0;
+    uint8_t trainState = 0;
+    uint8_t stopped = 0;
+
+    Train::Snapshot snapshot;
+    reader.ReadString(name);
+    reader.Read(destination);
+    reader.Read(component);
+    reader.Read(previousComponent);
+    reader.Read(snapshot.mSegmentIndex);
+    reader.Read(snapshot.mPreviousSegmentIndex);
+    reader.Read(snapshot.mDistance);
+    reader.Read(snapshot.mStoppedTime);
+    reader.Read(direction);
+    reader.Read(trainState);
+    reader.Read(stopped);
+
+    snapshot.mComponent = network.LoadComponent(component);
+    snapshot.mPreviousComponent = network.LoadComponent(previousComponent);
+    snapshot.mDirection = static_cast<Rail::Direction>(direction);
+    snapshot.mState = static_cast<Train::State>(trainState);
+    snapshot.mStopped = stopped != 0;
+
+    bool valid = !reader.IsFailed() && snapshot.mComponent != nullptr && snapshot.mPreviousComponent != nullptr &&
+                 direction <= Rail::Direction::DOWN && trainState <= Train::State::SUCCESS &&
+                 (destination == Rail::INVALID_ID || network.LoadComponent(destination) != nullptr);
+    if(!valid) {
+        return nullptr;
+    }
+
+    Train* train = mTrainPool.Acquire(name, snapshot.mComponent, snapshot.mDirection);
+    train->SetDestination(network.LoadComponent(destination));
+    train->Restore(snapshot);
+    return train;
+}
+
+void Simulator::runTicks(uint64_t stopTick) {
     // As long as trains are still in the simulator, tick the simulation
-    while(!mRunningTrains.empty()) {
-        // Let the traffic controller update the rail network
-        updateRailNetwork();
+    while(!mRunningTrains.empty() && mTick < stopTick) {
+        bool changed = tick();
+
+        // Once a tick has passed without any train changing while every train is stopped, nothing will start
+        // them again, as in runEvents()
+        if(!changed && std::all_of(mRunningTrains.begin(), mRunningTrains.end(),
+                                   [](const Train* train) { return train->IsStopped(); })) {
+            LOG_ERROR(TRAIN, "Simulation deadlocked with %zu trains stopped", mRunningTrains.size());
+            return;
+        }
+    }
+}
+
+void Simulator::runEvents(uint64_t stopTick) {
+    mEvents = decltype(mEvents)();
+    mEventStamps.clear();
+
+    for(auto train: mRunningTrains) {
+        mEventStamps[train] = 0;
+    }
+
+    for(auto train: mRunningTrains) {
+        scheduleEvents(train);
+    }
 
-        // Conduct each train forward
+    // The first tick is always simulated, to let the traffic controller set up the network
+    bool changed = true;
+
+    while(!mRunningTrains.empty() && mTick < stopTick) {
+        // Between events every train either progresses along its component or stays stopped. Once a tick
+        // has passed without any train changing, the traffic controller makes the same decisions every
+        // tick, so the network does not change either and the ticks up to the next event can be skipped
+        if(!changed) {
+            while(!mEvents.empty() && !isCurrent(mEvents.top())) {
+                mEvents.pop();
+            }
+
+            if(mEvents.empty()) {
+                // Every remaining train is stopped and nothing will start them, which would tick forever
+                LOG_ERROR(TRAIN, "Simulation deadlocked with %zu trains stopped", mRunningTrains.size());
+                return;
+            }
+
+            unsigned int skipped = std::min(mEvents.top().mTick, stopTick) - mTick;
+            mTrainStore.Skip(skipped);
+            mTick += skipped;
+            mProfiler.Count(Util::Profiler::SKIPPED_TICKS, skipped);
+
+            if(mTick == stopTick) {
+                return;
+            }
+        }
+
+        // Take the events for this tick, and simulate it in full
+        std::vector<Event> events;
+        while(!mEvents.empty() && mEvents.top().mTick <= mTick) {
+            if(isCurrent(mEvents.top())) {
+                events.push_back(mEvents.top());
+            }
+            mEvents.pop();
+        }
+
+        changed = tick();
+
+        for(auto train: mChangedTrains) {
+            if(train->GetState() == Train::State::RUNNING) {
+                mEventStamps[train]++;
+                scheduleEvents(train);
+            }
+        }
+
+        // Trains which may have been about to collide, but have not, are checked again
+        for(auto& event: events) {
+            if(event.mOther != nullptr && isCurrent(event)) {
+                schedulePair(event.mTrain, event.mOther, false);
+            }
+        }
+    }
+}
+
+bool Simulator::tick() {
+    Util::Profiler::ScopedTimer tickTimer(mProfiler, Util::Profiler::TICK);
+    mSampleCollisions = mProfiler.IsCollisionSample();
+    mProfiler.Count(Util::Profiler::TICKS);
+
+    if(mEventLogger != nullptr) {
+        mEventLogger->SetTick(mTick);
+    }
+
+    // Let the traffic controller update the rail network
+    updateRailNetwork();
+    mOccupancy.BeginTick();
+    mChangedTrains.clear();
+
+    const Rail::RailTopology& topology = mRailNetwork->GetTopology();
+    const Rail::NetworkState& state = getNetworkState();
+    uint64_t conductStart = Util::Profiler::Now();
+
+    // Progress every train part way along its component at once, leaving only those at the end of
+    // a component to traverse when they are conducted
+    if(mThreadPool != nullptr) {
+        const size_t slotCount = mTrainStore.GetSlotCount();
+        const size_t rangeCount = mThreadPool->GetThreadCount();
+        size_t rangeSize = (slotCount + rangeCount - 1) / rangeCount;
+        rangeSize = (rangeSize + ADVANCE_RANGE_ALIGNMENT - 1) / ADVANCE_RANGE_ALIGNMENT * ADVANCE_RANGE_ALIGNMENT;
+
+        mThreadPool->ParallelFor(rangeCount, [&](size_t range, unsigned int worker) {
+            size_t first = std::min(slotCount, range * rangeSize);
+            size_t last = std::min(slotCount, first + rangeSize);
+            mTrainStore.Advance(first, last);
+        });
+    } else {
+        mTrainStore.Advance();
+    }
+
+    // Conduct each train forward. Trains record their events in the order they are conducted, so are
+    // conducted on one thread while recording
+    bool conducted = mThreadPool != nullptr && mEventLogger == nullptr && conductTrainsParallel(topology, state);
+    if(!conducted) {
         for(auto train: mRunningTrains) {
-            // Because we do not remove trains until each has been updated,
-            // A crashed train can still be in the queue
+            unsigned int changes = conductTrain(train, topology, state);
+            if(changes != 0) {
+                countChanges(changes);
+                mChangedTrains.push_back(train);
+            }
+        }
+    }
+    mProfiler.Record(Util::Profiler::CONDUCT_TRAINS, Util::Profiler::Now() - conductStart);
+
+    // Remove any trains that have finished their simulation
+    size_t runningCount = mRunningTrains.size();
+    removeFinishedTrains();
+    mTick++;
+
+    return !mChangedTrains.empty() || mRunningTrains.size() != runningCount;
+}
+
+unsigned int Simulator::conductTrain(Train* train, const Rail::RailTopology& topology,
+                                     const Rail::NetworkState& state) {
+    // Because we do not remove trains until each has been updated,
+    // A crashed train can still be in the queue
+    if(train->GetState() != Train::State::RUNNING) {
+        return 0;
+    }
+
+    const Rail::IComponent* component = train->GetCurrentComponent();
+    bool stopped = train->IsStopped();
+
+    train->Conduct(topology, state);
+    mOccupancy.Update(train);
+
+    // Check for state updates, but wait until each train has been
+    // Conducted before we remove them. A collision check is too quick to time every one cheaply, so
+    // only those of sampled ticks are timed
+    if(mSampleCollisions) {
+        uint64_t start = Util::Profiler::Now();
+        checkTrainCollision(train);
+        mProfiler.Record(Util::Profiler::CHECK_TRAIN_COLLISION, Util::Profiler::Now() - start);
+    } else {
+        checkTrainCollision(train);
+    }
+    checkTrainSucceeded(train);
+
+    unsigned int changes = 0;
+    if(train->GetCurrentComponent() != component) {
+        changes |= ConductChange::TRAVERSED;
+    }
+    if(train->IsStopped() != stopped) {
+        changes |= stopped ? ConductChange::STARTED : ConductChange::STOPPED;
+    }
+    return changes;
+}
+
+void Simulator::countChanges(unsigned int changes) {
+    if(changes & ConductChange::TRAVERSED) {
+        mProfiler.Count(Util::Profiler::TRAVERSALS);
+    }
+    if(changes & ConductChange::STOPPED) {
+        mProfiler.Count(Util::Profiler::TRAINS_STOPPED);
+    }
+}
+
+bool Simulator::conductTrainsParallel(const Rail::RailTopology& topology, const Rail::NetworkState& state) {
+    const unsigned int threadCount = mThreadPool->GetThreadCount();
+    if(mPartition.GetTopologyVersion() != topology.GetVersion()) {
+        mPartition.Build(topology, threadCount * REGIONS_PER_THREAD);
+    }
+
+    const size_t regionCount = mPartition.GetRegionCount();
+    const size_t trainCount = mRunningTrains.size();
+    const size_t chunkCount = threadCount * CHUNKS_PER_THREAD;
+    const size_t chunkSize = (trainCount + chunkCount - 1) / chunkCount;
+    mChunks.resize(chunkCount);
+
+    // Place each train in the region of its component. A train can only meet trains on the components it
+    // starts or ends the tick on, so the regions of the components it may traverse on to are joined to its
+    // own. Trains which have been advanced stay where they are
+    std::atomic<bool> unplaced(false);
+    mThreadPool->ParallelFor(chunkCount, [&](size_t c, unsigned int worker) {
+        TickChunk& chunk = mChunks[c];
+        chunk.mRegionTrains.resize(regionCount);
+        for(auto& trains : chunk.mRegionTrains) {
+            trains.clear();
+        }
+        chunk.mCrossings.clear();
+        chunk.mUnprepared.clear();
+
+        auto join = [&](uint32_t region, uint32_t other, const Rail::IComponent* component) {
+            if(other != region) {
+                chunk.mCrossings.push_back(std::make_pair(region, other));
+            }
+
+            if(!mOccupancy.IsPrepared(component)) {
+                chunk.mUnprepared.push_back(component);
+            }
+        };
+
+        const size_t last = std::min(trainCount, (c + 1) * chunkSize);
+        for(size_t i = c * chunkSize; i < last; i++) {
+            Train* train = mRunningTrains[i];
             if(train->GetState() != Train::State::RUNNING) {
                 continue;
             }
 
-            train->Conduct();
+            Rail::SegmentId segment = train->GetSegmentId();
+            if(segment == Rail::INVALID_ID) {
+                segment = topology.LookupSegment(train->GetCurrentComponent());
+            }
+
+            if(segment == Rail::INVALID_ID) {
+                // Trains can only stay on a terminator once they have reached one
+                Rail::ConnectorId connector = topology.LookupConnector(train->GetCurrentComponent());
+                if(connector == Rail::INVALID_ID || !topology.IsTerminator(connector)) {
+                    unplaced = true;
+                    continue;
+                }
+
+                chunk.mRegionTrains[mPartition.GetConnectorRegion(connector)].push_back(i);
+                continue;
+            }
+
+            uint32_t region = mPartition.GetSegmentRegion(segment);
+            chunk.mRegionTrains[region].push_back(i);
+            if(train->IsAdvanced()) {
+                continue;
+            }
+
+            Rail::ConnectorId end = topology.GetEnd(Rail::MakeNode(segment, train->GetDirection()));
+            if(end == Rail::INVALID_ID) {
+                continue;
+            }
+
+            if(topology.IsTerminator(end)) {
+                join(region, mPartition.GetConnectorRegion(end), topology.GetConnector(end));
+            }
 
-            // Check for state updates, but wait until each train has been
-            // Conducted before we remove them
-            checkTrainCollision(train);
-            checkTrainSucceeded(train);
+            for(Rail::NodeId n : topology.GetAttachments(end)) {
+                Rail::SegmentId next = Rail::NodeSegment(n);
+                join(region, mPartition.GetSegmentRegion(next), topology.GetSegment(next));
+            }
         }
+    });
 
-        // Remove any trains that have finished their simulation
-        removeFinishedTrains();
+    // Trains off the topology cannot be placed, so this tick is conducted on one thread
+    if(unplaced) {
+        return false;
     }
+
+    // Join the regions trains may cross between into groups, and give trains the buckets they may need
+    mRegionParents.resize(regionCount);
+    for(uint32_t r = 0; r < regionCount; r++) {
+        mRegionParents[r] = r;
+    }
+
+    auto findGroup = [&](uint32_t region) {
+        while(mRegionParents[region] != region) {
+            mRegionParents[region] = mRegionParents[mRegionParents[region]];
+            region = mRegionParents[region];
+        }
+        return region;
+    };
+
+    for(auto& chunk : mChunks) {
+        for(auto& crossing : chunk.mCrossings) {
+            uint32_t a = findGroup(crossing.first);
+            uint32_t b = findGroup(crossing.second);
+            mRegionParents[std::max(a, b)] = std::min(a, b);
+        }
+
+        for(auto component : chunk.mUnprepared) {
+            mOccupancy.Prepare(component);
+        }
+    }
+
+    mRegionGroups.clear();
+    std::vector<uint32_t> groupIndexes(regionCount);
+    for(uint32_t r = 0; r < regionCount; r++) {
+        uint32_t group = findGroup(r);
+        if(group == r) {
+            groupIndexes[r] = mRegionGroups.size();
+            mRegionGroups.emplace_back();
+        }
+        mRegionGroups[groupIndexes[group]].push_back(r);
+    }
+
+    // Conduct each group of regions on its own thread, in the order of the running trains. Messages are
+    // held back until every group is done, and then written in that order too
+    mChangedFlags.assign(trainCount, 0);
+    mLogBuffers.resize(threadCount);
+    mGroupTrains.resize(threadCount);
+
+    mThreadPool->ParallelFor(mRegionGroups.size(), [&](size_t g, unsigned int worker) {
+        const std::vector<uint32_t>& regions = mRegionGroups[g];
+        std::vector<uint32_t>& merged = mGroupTrains[worker];
+        Util::LogBuffer& log = mLogBuffers[worker];
+        Util::LogBuffer* previous = Util::Log::Capture(&log);
+
+        for(auto& chunk : mChunks) {
+            // Trains are in order within each region of a chunk, so only need merging for a group of regions
+            const std::vector<uint32_t>* trains = &chunk.mRegionTrains[regions[0]];
+            if(regions.size() > 1) {
+                merged.clear();
+                for(auto region : regions) {
+                    merged.insert(merged.end(), chunk.mRegionTrains[region].begin(), chunk.mRegionTrains[region].end());
+                }
+                std::sort(merged.begin(), merged.end());
+                trains = &merged;
+            }
+
+            for(uint32_t i : *trains) {
+                log.SetKey(i);
+                mChangedFlags[i] = static_cast<uint8_t>(conductTrain(mRunningTrains[i], topology, state));
+            }
+        }
+
+        Util::Log::Capture(previous);
+    });
+
+    Util::Log::Flush(mLogBuffers);
+
+    for(size_t i = 0; i < trainCount; i++) {
+        if(mChangedFlags[i]) {
+            countChanges(mChangedFlags[i]);
+            mChangedTrains.push_back(mRunningTrains[i]);
+        }
+    }
+
+    return true;
+}
+
+void Simulator::scheduleEvents(Train* train) {
+    unsigned int stamp = mEventStamps[train];
+
+    // A moving train next acts when it tries to leave its component. A stopped train only starts again
+    // once the network changes, which is always simulated in full
+    if(!train->IsStopped()) {
+        unsigned int index = train->GetCurrentLocation(train->GetDirection());
+        unsigned int length = train->GetCurrentComponent()->GetLength();
+        uint64_t arrival = mTick + ((index < length) ? length - index : 0);
+
+        mEvents.push(Event {arrival, train, nullptr, stamp, 0});
+    }
+
+    for(auto other: mOccupancy.GetOccupants(train->GetCurrentComponent())) {
+        if(other != train && mEventStamps.count(other)) {
+            schedulePair(train, other, true);
+        }
+    }
+}
+
+void Simulator::schedulePair(Train* train, Train* other, bool moved) {
+    // Measure both trains along the direction of the first, as in Train::CheckCollision()
+    Rail::Direction d = train->GetDirection();
+    int64_t gap = static_cast<int64_t>(other->GetCurrentLocation(d)) - train->GetCurrentLocation(d);
+
+    int speed = train->IsStopped() ? 0 : 1;
+    int otherSpeed = other->IsStopped() ? 0 : 1;
+    int closing = speed - ((other->GetDirection() == d) ? otherSpeed : -otherSpeed);
+    if(gap < 0) {
+        gap = -gap;
+        closing = -closing;
+    }
+
+    // Each train moves at most one unit per tick, so trains at least three units apart at the start of
+    // a tick cannot meet or pass through each other within it
+    uint64_t conflict;
+    if(closing > 0) {
+        conflict = mTick + ((gap > 2) ? (gap - 2 + closing - 1) / closing : 0);
+    } else if(closing == 0 && moved && gap <= 2) {
+        // Trains keeping their distance either collide in the first tick, depending on which is conducted
+        // first, or never do
+        conflict = mTick;
+    } else {
+        return;
+    }
+
+    mEvents.push(Event {conflict, train, other, mEventStamps[train], mEventStamps[other]});
+}
+
+bool Simulator::isCurrent(const Event& event) const {
+    auto stamp = mEventStamps.find(event.mTrain);
+    if(stamp == mEventStamps.end() || stamp->second != event.mStamp) {
+        return false;
+    }
+
+    if(event.mOther != nullptr) {
+        auto otherStamp = mEventStamps.find(event.mOther);
+        return otherStamp != mEventStamps.end() && otherStamp->second == event.mOtherStamp;
+    }
+
+    return true;
 }
 
 /**
  *  Validate the results of a simulation
  */
 bool Simulator::ValidateResults() {
-    bool success = true;
     for(auto train: mFinishedTrains) {
         train->PrintStatus();
-        success = success && (train->GetState() == Train::State::SUCCESS);
     }
 
-    printf("INFO Simulation Results: \n");
-    printf("INFO All trains safe? %s \n", success ? "YES" : "NO");
-    printf("INFO All trains finished? %s \n", mRunningTrains.empty() ? "YES" : "NO");
+    bool success = (mCrashedCount == 0);
+
+    LOG_INFO(TRAIN, "Simulation Results:");
+    LOG_INFO(TRAIN, "Trains finished: %zu succeeded, %zu crashed", mSucceededCount, mCrashedCount);
+    LOG_INFO(TRAIN, "All trains safe? %s", success ? "YES" : "NO");
+    LOG_INFO(TRAIN, "All trains finished? %s", mRunningTrains.empty() ? "YES" : "NO");
+
+    // The finished trains have been reported on, so the next simulation starts afresh
+    for(auto train: mFinishedTrains) {
+        retireTrain(train);
+    }
+    mFinishedTrains.clear();
+    mSucceededCount = 0;
+    mCrashedCount = 0;
 
     return success && mRunningTrains.empty();
 }
@@ -126,14 +887,8 @@ bool Simulator::ValidateResults() {
  *  Checks to see if the train has collided with any other trains
  */
 bool Simulator::checkTrainCollision(Train* train) {
-    for(auto other: mRunningTrains) {
-        if(train != other && train->CheckCollision(other)) {
-            // Trains can only collide 1:1 so we early return on any collision
-            return true;
-        }
-    }
-
-    return false;
+    // Only trains on the same or the previous component can have collided with this one
+    return mOccupancy.CheckCollision(train);
 }
 
 /**
@@ -147,23 +902,51 @@ bool Simulator::checkTrainSucceeded(const Train* train) {
  *  Removes finished trains from the running simulation
  */
 void Simulator::removeFinishedTrains() {
-    for(auto iter = mRunningTrains.begin(); iter != mRunningTrains.end(); ) {
-        if((*iter)->GetState() != Train::State::RUNNING) {
-            // Find any trains that are not RUNNING
-            printf("INFO Removing Train %s from simulation\n", (*iter)->GetName());
-
-            // and move them to finished trains
-            mFinishedTrains.push_back(*iter);
-            iter = mRunningTrains.erase(iter);
-        } else {
-            iter++;
+    Util::Profiler::ScopedTimer timer(mProfiler, Util::Profiler::REMOVE_FINISHED_TRAINS);
+
+    // Compact the running trains in a single pass, so that they are still conducted in the same order
+    size_t running = 0;
+    for(size_t i = 0; i < mRunningTrains.size(); i++) {
+        Train* train = mRunningTrains[i];
+        if(train->GetState() == Train::State::RUNNING) {
+            mRunningTrains[running++] = train;
+            continue;
         }
+
+        finishTrain(train);
+    }
+
+    mRunningTrains.resize(running);
+}
+
+void Simulator::finishTrain(Train* train) {
+    LOG_INFO(TRAIN, "Removing Train %s from simulation", train->GetName());
+    mOccupancy.Remove(train);
+    mEventStamps.erase(train);
+    mProfiler.Count(Util::Profiler::TRAINS_FINISHED);
+
+    if(train->GetState() == Train::State::SUCCESS) {
+        mSucceededCount++;
+    } else {
+        mCrashedCount++;
     }
+
+    if(mRetainFinishedTrains) {
+        mFinishedTrains.push_back(train);
+    } else {
+        retireTrain(train);
+    }
+}
+
+void Simulator::retireTrain(Train* train) {
+    mTrafficController->RemoveTrain(train);
+    mTrainPool.Release(train);
 }
 
 /**
  *  Updates simulator's rail network accoring to the Traffic Controller
  */
 void Simulator::updateRailNetwork() {
-    mTrafficController->UpdateRailNetwork(*mRailNetwork, mRunningTrains);
+    Util::Profiler::ScopedTimer timer(mProfiler, Util::Profiler::UPDATE_RAIL_NETWORK);
+    mTrafficController->UpdateRailNetwork(*mRailNetwork, getNetworkState(), mRunningTrains);
 }
@@ -0,0 +1,116 @@
+#include "TrainStore.h"
+#include "Train.h"
+
+namespace Train {
+
+uint32_t TrainStore::Add(const Rail::IComponent* component, Rail::Direction direction) {
+    uint32_t slot;
+    if(!mFreeSlots.empty()) {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        slot = mComponents.size();
+        mComponents.emplace_back();
+        mComponentIds.emplace_back();
+        mComponentKinds.emplace_back();
+        mLengths.emplace_back();
+        mSegmentIndexes.emplace_back();
+        mDirections.emplace_back();
+        mStates.emplace_back();
+        mStopped.emplace_back();
+        mPending.emplace_back();
+        mDistances.emplace_back();
+        mStoppedTimes.emplace_back();
+        mPreviousComponents.emplace_back();
+        mPreviousSegmentIndexes.emplace_back();
+    }
+
+    mComponents[slot] = component;
+    mComponentIds[slot] = Rail::INVALID_ID;
+    mComponentKinds[slot] = Rail::ComponentKind::UNKNOWN;
+    mLengths[slot] = component->GetLength();
+    mSegmentIndexes[slot] = 0;
+    mDirections[slot] = direction;
+    mStates[slot] = Train::State::RUNNING;
+    mStopped[slot] = false;
+    mPending[slot] = false;
+    mDistances[slot] = 0;
+    mStoppedTimes[slot] = 0;
+    mPreviousComponents[slot] = component;
+    mPreviousSegmentIndexes[slot] = 0;
+
+    return slot;
+}
+
+void TrainStore::Remove(uint32_t slot) {
+    // Free slots are never running, so the bulk updates pass over them
+    mStates[slot] = Train::State::CRASHED;
+    mPending[slot] = false;
+    mFreeSlots.push_back(slot);
+}
+
+void TrainStore::Advance(size_t first, size_t last) {
+    const size_t count = last - first;
+    const uint8_t* states = mStates.data() + first;
+    const uint8_t* stopped = mStopped.data() + first;
+    const unsigned int* lengths = mLengths.data() + first;
+    unsigned int* indexes = mSegmentIndexes.data() + first;
+    unsigned int* previousIndexes = mPreviousSegmentIndexes.data() + first;
+    unsigned int* distances = mDistances.data() + first;
+    uint8_t* pending = mPending.data() + first;
+    const Rail::IComponent** components = mComponents.data() + first;
+    const Rail::IComponent** previousComponents = mPreviousComponents.data() + first;
+
+    // Both loops are branch free so that the compiler can vectorise them. A train which does not
+    // progress has a step of zero
+    for(size_t i = 0; i < count; i++) {
+        pending[i] = (states[i] == Train::State::RUNNING) & (stopped[i] == 0) & (indexes[i] < lengths[i]);
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        previousIndexes[i] = indexes[i];
+        indexes[i] += pending[i];
+        distances[i] += pending[i];
+    }
+
+    // Advanced trains stay on their component
+    for(size_t i = 0; i < count; i++) {
+        if(pending[i]) {
+            previousComponents[i] = components[i];
+        }
+    }
+}
+
+void TrainStore::Skip(unsigned int ticks) {
+    const size_t count = mComponents.size();
+    const uint8_t* states = mStates.data();
+    const uint8_t* stopped = mStopped.data();
+    unsigned int* indexes = mSegmentIndexes.data();
+    unsigned int* previousIndexes = mPreviousSegmentIndexes.data();
+    unsigned int* distances = mDistances.data();
+    unsigned int* stoppedTimes = mStoppedTimes.data();
+
+    if(ticks == 0) {
+        return;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        unsigned int running = (states[i] == Train::State::RUNNING);
+        unsigned int moving = running & (stopped[i] == 0);
+        unsigned int waiting = running & (stopped[i] != 0);
+
+        // Leave each train as though the last skipped tick had been conducted
+        indexes[i] += moving * ticks;
+        previousIndexes[i] = indexes[i] - moving;
+        distances[i] += moving * ticks;
+        stoppedTimes[i] += waiting * ticks;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        if(states[i] == Train::State::RUNNING) {
+            mPreviousComponents[i] = mComponents[i];
+        }
+    }
+}
+
+} // namespace Train
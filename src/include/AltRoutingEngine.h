@@ -0,0 +1,89 @@
+#ifndef AltRoutingEngine_H
+#define AltRoutingEngine_H
+
+#include "interfaces/IRoutingEngine.h"
+#include "SearchSpace.h"
+
+#include <memory>
+
+namespace Traffic {
+
+    /**
+     *  Routes trains with an A* search, using ALT (A*, Landmarks, Triangle inequality) lower bounds
+     *
+     *  The shortest distances from and to a small set of landmark nodes are precomputed once per
+     *  topology. For any node v and target t, d(v, t) >= d(L, t) - d(L, v) and d(v, t) >= d(v, L) - d(t, L),
+     *  which guides the search towards the destination while still finding the shortest path.
+     */
+    class AltRoutingEngine : public IRoutingEngine {
+        public:
+        /**
+         *  @param landmarkCount The number of landmarks to select. More landmarks give tighter bounds,
+         *                       at the cost of two distances per landmark per node
+         */
+        AltRoutingEngine(unsigned int landmarkCount = 8);
+        virtual ~AltRoutingEngine();
+
+        /**
+         *  Build the landmark distance tables for a topology
+         *
+         *  @note This is called automatically by FindPath when the topology changes
+         */
+        void Preprocess(const Rail::RailTopology& topology);
+
+        // IRoutingEngine
+        virtual void Prepare(const Rail::RailTopology& topology);
+        virtual IRoutingEngine* Clone() const;
+
+        // Signals do not affect the paths found, so there is nothing to update
+        virtual void UpdateCosts(const Rail::RailTopology& topology, const std::vector<Rail::SegmentId>& changed) {}
+
+        virtual Path FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination);
+
+        virtual const RoutingStats& GetStats() const {
+            return mStats;
+        }
+
+        private:
+        /**
+         *  Compute the shortest distance from (or to) the given node for every node in the topology
+         */
+        void computeDistances(const Rail::RailTopology& topology, Rail::NodeId landmark, bool reverse,
+                              std::vector<unsigned int>& distances);
+
+        /**
+         *  Get a lower bound on the distance from a node to the closest current target
+         *
+         *  @return The lower bound, or UINT32_MAX if no target is reachable from the node
+         */
+        unsigned int getLowerBound(Rail::NodeId node) const;
+
+        /**
+         *  The precomputed landmark distances for a topology. Tables are read only once built,
+         *  so clones of an engine share them
+         */
+        struct LandmarkTable {
+            // The topology the table was built for
+            const Rail::RailTopology* mTopology = nullptr;
+            uint64_t mTopologyVersion = 0;
+
+            // Distances from and to each landmark, stored node-major so a node's bounds share a cache line
+            std::vector<Rail::NodeId> mLandmarks;
+            unsigned int mStride = 0;
+            std::vector<unsigned int> mFromLandmark;
+            std::vector<unsigned int> mToLandmark;
+        };
+
+        unsigned int mLandmarkCount;
+        std::shared_ptr<const LandmarkTable> mTable;
+
+        // Nodes which end at the destination of the current query
+        std::vector<Rail::NodeId> mTargets;
+
+        SearchSpace mSearch;
+        RoutingStats mStats;
+    };
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef Arena_H
+#define Arena_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+    /**
+     *  Allocates objects of a single type contiguously, in slabs which grow geometrically
+     *
+     *  Objects cannot be freed individually. Every object is destroyed, and every slab released, when the
+     *  arena is cleared or destroyed. Objects never move, so pointers to them stay valid until then.
+     */
+    template<typename T>
+    class Arena {
+        public:
+        /**
+         *  @param firstSlabSize The number of objects in the first slab
+         *  @param maxSlabSize The largest number of objects in a slab
+         */
+        Arena(size_t firstSlabSize = 64, size_t maxSlabSize = 64 * 1024) :
+            mFirstSlabSize(firstSlabSize), mMaxSlabSize(maxSlabSize) {}
+
+        ~Arena() {
+            Clear();
+        }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+         *  Construct a new object in the arena
+         */
+        template<typename... Args>
+        T* New(Args&&... args) {
+            if(mSlabs.empty() || mSlabs.back().mUsed == mSlabs.back().mCapacity) {
+                addSlab();
+            }
+
+            Slab& slab = mSlabs.back();
+            T* object = new (slab.mObjects + slab.mUsed) T(std::forward<Args>(args)...);
+            slab.mUsed++;
+            mSize++;
+
+            return object;
+        }
+
+        /**
+         *  Destroy every object in the arena, in the order they were created, and release all memory
+         */
+        void Clear() {
+            for(auto& slab : mSlabs) {
+                for(size_t i = 0; i < slab.mUsed; i++) {
+                    slab.mObjects[i].~T();
+                }
+                ::operator delete(slab.mObjects);
+            }
+
+            mSlabs.clear();
+            mSize = 0;
+        }
+
+        /**
+         *  Gets the number of objects in the arena
+         */
+        size_t GetSize() const {
+            return mSize;
+        }
+
+        private:
+        struct Slab {
+            T* mObjects;
+            size_t mUsed;
+            size_t mCapacity;
+        };
+
+        void addSlab() {
+            size_t capacity = mSlabs.empty() ? mFirstSlabSize : mSlabs.back().mCapacity * 2;
+            if(capacity > mMaxSlabSize) {
+                capacity = mMaxSlabSize;
+            }
+
+            // Reserve the entry first, so a failed allocation leaves the arena unchanged
+            mSlabs.reserve(mSlabs.size() + 1);
+            T* objects = static_cast<T*>(::operator new(capacity * sizeof(T)));
+            mSlabs.push_back(Slab {objects, 0, capacity});
+        }
+
+        size_t mFirstSlabSize;
+        size_t mMaxSlabSize;
+
+        std::vector<Slab> mSlabs;
+        size_t mSize = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef BinaryStream_H
+#define BinaryStream_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Util {
+
+    /**
+     *  Appends values to a buffer in the byte order of the host
+     *
+     *  Files made from these buffers, such as simulation checkpoints, are only written and read on
+     *  little-endian hosts, as for Rail::NetworkFile.
+     */
+    class BinaryWriter {
+        public:
+        template<typename T>
+        void Write(T value) {
+            static_assert(std::is_arithmetic<T>::value, "Only plain values can be written");
+            const size_t offset = mData.size();
+            mData.resize(offset + sizeof(T));
+            memcpy(mData.data() + offset, &value, sizeof(T));
+        }
+
+        /**
+         *  Write a string, preceded by its length
+         */
+        void WriteString(const std::string& value) {
+            Write<uint32_t>(value.size());
+            mData.insert(mData.end(), value.begin(), value.end());
+        }
+
+        /**
+         *  Write the contents of another writer, preceded by their size, so that a reader can skip them
+         */
+        void WriteBlock(const BinaryWriter& block) {
+            Write<uint64_t>(block.mData.size());
+            mData.insert(mData.end(), block.mData.begin(), block.mData.end());
+        }
+
+        /**
+         *  Write a block of data read elsewhere, preceded by its size, e.g. to pass on a block unchanged
+         */
+        void WriteBlock(const char* data, size_t size) {
+            Write<uint64_t>(size);
+            mData.insert(mData.end(), data, data + size);
+        }
+
+        const std::vector<char>& GetData() const {
+            return mData;
+        }
+
+        private:
+        std::vector<char> mData;
+    };
+
+    /**
+     *  Reads values written by a BinaryWriter
+     *
+     *  Reading past the end of the data fails, and leaves the reader failed, so that a sequence of
+     *  reads can be checked once at the end.
+     */
+    class BinaryReader {
+        public:
+        BinaryReader(const char* data, size_t size) : mData(data), mSize(size) {}
+
+        template<typename T>
+        bool Read(T& value) {
+            static_assert(std::is_arithmetic<T>::value, "Only plain values can be read");
+            if(!take(sizeof(T))) {
+                return false;
+            }
+
+            memcpy(&value, mData + mOffset - sizeof(T), sizeof(T));
+            return true;
+        }
+
+        bool ReadString(std::string& value) {
+            uint32_t size = 0;
+            if(!Read(size) || !take(size)) {
+                return false;
+            }
+
+            value.assign(mData + mOffset - size, size);
+            return true;
+        }
+
+        /**
+         *  Read a block written by BinaryWriter::WriteBlock()
+         *
+         *  @param block Receives a reader over the contents of the block
+         */
+        bool ReadBlock(BinaryReader& block) {
+            uint64_t size = 0;
+            if(!Read(size) || !take(size)) {
+                return false;
+            }
+
+            block = BinaryReader(mData + mOffset - size, size);
+            return true;
+        }
+
+        bool IsFailed() const {
+            return mFailed;
+        }
+
+        /**
+         *  Get all of the data being read, whatever has been read so far
+         */
+        const char* GetData() const {
+            return mData;
+        }
+
+        size_t GetSize() const {
+            return mSize;
+        }
+
+        /**
+         *  Check whether every byte has been read
+         */
+        bool IsAtEnd() const {
+            return mOffset == mSize;
+        }
+
+        private:
+        bool take(uint64_t size) {
+            if(mFailed || size > mSize - mOffset) {
+                mFailed = true;
+                return false;
+            }
+
+            mOffset += size;
+            return true;
+        }
+
+        const char* mData;
+        size_t mSize;
+        size_t mOffset = 0;
+        bool mFailed = false;
+    };
+
+}
+
+#endif
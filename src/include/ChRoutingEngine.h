@@ -0,0 +1,59 @@
+#ifndef ChRoutingEngine_H
+#define ChRoutingEngine_H
+
+#include "interfaces/IRoutingEngine.h"
+#include "ContractionHierarchy.h"
+#include "SearchSpace.h"
+
+#include <memory>
+
+namespace Traffic {
+
+    /**
+     *  Routes trains with a bidirectional search over a contraction hierarchy
+     *
+     *  The hierarchy is built once per topology. Each query searches upwards from the train and
+     *  backwards-upwards from the destination, and the shortest path meets at its highest ranked node.
+     */
+    class ChRoutingEngine : public IRoutingEngine {
+        public:
+        ChRoutingEngine();
+        virtual ~ChRoutingEngine();
+
+        /**
+         *  Build the contraction hierarchy for a topology
+         *
+         *  @note This is called automatically by FindPath when the topology changes
+         */
+        void Preprocess(const Rail::RailTopology& topology);
+
+        // IRoutingEngine
+        virtual void Prepare(const Rail::RailTopology& topology);
+        virtual IRoutingEngine* Clone() const;
+
+        // Signals do not affect the paths found, so there is nothing to update
+        virtual void UpdateCosts(const Rail::RailTopology& topology, const std::vector<Rail::SegmentId>& changed) {}
+
+        virtual Path FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination);
+
+        virtual const RoutingStats& GetStats() const {
+            return mStats;
+        }
+
+        private:
+        // The hierarchy is read only once built, so clones of an engine share it
+        std::shared_ptr<const ContractionHierarchy> mHierarchy;
+
+        SearchSpace mForwardSearch;
+        SearchSpace mBackwardSearch;
+
+        // Scratch buffers for unpacking the path
+        std::vector<Rail::NodeId> mHierarchyPath;
+        std::vector<Rail::NodeId> mNodePath;
+
+        RoutingStats mStats;
+    };
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef ContractionHierarchy_H
+#define ContractionHierarchy_H
+
+#include "RailTopology.h"
+#include "SearchSpace.h"
+
+namespace Traffic {
+
+    /**
+     *  A contraction hierarchy over the nodes of a RailTopology
+     *
+     *  Nodes are contracted one at a time in order of importance. Contracting a node v removes it from
+     *  the graph, adding a shortcut u->x through v wherever u->v->x is the only shortest path between
+     *  u and x. The hierarchy is the original edges plus the shortcuts, split by rank so that a query
+     *  only ever has to search upwards from both ends.
+     *
+     *  Contraction works on the directed segment nodes of the topology, so shortcuts never include a
+     *  train turning back through the segment it arrived on.
+     */
+    class ContractionHierarchy {
+        public:
+        ContractionHierarchy();
+        ~ContractionHierarchy();
+
+        /**
+         *  An edge of the hierarchy
+         *  mNode is the far end of the edge, mMiddle is the node a shortcut bypasses, or INVALID_ID
+         *  for an edge of the original topology
+         */
+        struct Edge {
+            Rail::NodeId mNode;
+            unsigned int mWeight;
+            Rail::NodeId mMiddle;
+        };
+
+        class EdgeRange {
+            public:
+            EdgeRange(const Edge* first, const Edge* last) : mFirst(first), mLast(last) {}
+
+            const Edge* begin() const {
+                return mFirst;
+            }
+
+            const Edge* end() const {
+                return mLast;
+            }
+
+            private:
+            const Edge* mFirst;
+            const Edge* mLast;
+        };
+
+        /**
+         *  Contract every node of the topology
+         */
+        void Build(const Rail::RailTopology& topology);
+
+        /**
+         *  Check whether the hierarchy was built for the current version of a topology
+         */
+        bool IsBuiltFor(const Rail::RailTopology& topology) const {
+            return mTopology == &topology && mTopologyVersion == topology.GetVersion();
+        }
+
+        /**
+         *  Get the edges from n to higher ranked nodes, mNode is the target
+         */
+        EdgeRange GetUpEdges(Rail::NodeId n) const {
+            return EdgeRange(mUpEdges.data() + mUpOffsets[n], mUpEdges.data() + mUpOffsets[n + 1]);
+        }
+
+        /**
+         *  Get the edges from higher ranked nodes to n, mNode is the source
+         */
+        EdgeRange GetDownEdges(Rail::NodeId n) const {
+            return EdgeRange(mDownEdges.data() + mDownOffsets[n], mDownEdges.data() + mDownOffsets[n + 1]);
+        }
+
+        /**
+         *  Expand an edge of the hierarchy into nodes of the original topology
+         *
+         *  @param from The source of the edge
+         *  @param to The target of the edge
+         *  @param nodes Receives the original nodes after from, up to and including to
+         */
+        void Unpack(Rail::NodeId from, Rail::NodeId to, std::vector<Rail::NodeId>& nodes) const;
+
+        size_t GetShortcutCount() const {
+            return mShortcutCount;
+        }
+
+        private:
+        /**
+         *  Find the shortcuts needed to contract v from the remaining graph
+         *
+         *  @param v The node to contract
+         *  @param shortcuts Receives the shortcuts, mMiddle holds the source of each
+         *  @param settleLimit The number of nodes each witness search may settle
+         */
+        void findShortcuts(Rail::NodeId v, std::vector<Edge>& shortcuts, unsigned int settleLimit);
+
+        /**
+         *  Estimate how much contracting v now would grow the graph. Lower is contracted first
+         */
+        int getPriority(Rail::NodeId v);
+
+        /**
+         *  Add an edge to the remaining graph, or shorten an existing one
+         */
+        void addEdge(Rail::NodeId from, Rail::NodeId to, unsigned int weight, Rail::NodeId middle);
+
+        /**
+         *  Find the edge from -> to in the hierarchy
+         */
+        const Edge* findEdge(Rail::NodeId from, Rail::NodeId to) const;
+
+        const Rail::RailTopology* mTopology = nullptr;
+        uint64_t mTopologyVersion = 0;
+
+        // Contraction order of each node
+        std::vector<uint32_t> mRanks;
+
+        // The hierarchy, in compressed sparse row form
+        std::vector<uint32_t> mUpOffsets;
+        std::vector<Edge> mUpEdges;
+        std::vector<uint32_t> mDownOffsets;
+        std::vector<Edge> mDownEdges;
+        size_t mShortcutCount = 0;
+
+        // Graph of the uncontracted nodes, only used while building
+        std::vector<std::vector<Edge>> mOutEdges;
+        std::vector<std::vector<Edge>> mInEdges;
+        std::vector<unsigned int> mContractedNeighbours;
+        std::vector<Edge> mShortcuts;
+        std::vector<uint32_t> mTargetStamps;
+        uint32_t mSearchStamp = 0;
+        SearchSpace mWitnessSearch;
+    };
+
+}
+
+#endif
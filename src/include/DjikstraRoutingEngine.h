@@ -0,0 +1,40 @@
+#ifndef DjikstraRoutingEngine_H
+#define DjikstraRoutingEngine_H
+
+#include "interfaces/IRoutingEngine.h"
+#include "SearchSpace.h"
+
+namespace Traffic {
+
+    /**
+     *  Routes trains with a plain Djikstra search over the topology
+     */
+    class DjikstraRoutingEngine : public IRoutingEngine {
+        public:
+        DjikstraRoutingEngine();
+        virtual ~DjikstraRoutingEngine();
+
+        // IRoutingEngine
+        virtual void Prepare(const Rail::RailTopology& topology) {}
+
+        virtual IRoutingEngine* Clone() const {
+            return new DjikstraRoutingEngine();
+        }
+
+        // Signals do not affect the paths found, so there is nothing to update
+        virtual void UpdateCosts(const Rail::RailTopology& topology, const std::vector<Rail::SegmentId>& changed) {}
+
+        virtual Path FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination);
+
+        virtual const RoutingStats& GetStats() const {
+            return mStats;
+        }
+
+        private:
+        SearchSpace mSearch;
+        RoutingStats mStats;
+    };
+
+}
+
+#endif
@@ -2,80 +2,235 @@
 #define DjikstraTrafficController_H
 
 #include "interfaces/ITrafficController.h"
+#include "interfaces/IRoutingEngine.h"
+#include "PathCache.h"
+#include "ThreadPool.h"
+
+#include <unordered_set>
 
 namespace Traffic {
     
-    using Path = std::vector<const Rail::ISegment*>;
+    /**
+     *  The routing engines available to the controller
+     *  DJIKSTRA searches outwards from the train until the destination is found
+     *  ALT runs an A* search guided by precomputed landmark distances
+     *  CONTRACTION_HIERARCHY runs a bidirectional search over a precomputed contraction hierarchy
+     *  INCREMENTAL avoids red signals, and repairs its previous searches as signals change
+     */
+    typedef enum {
+        DJIKSTRA,
+        ALT,
+        CONTRACTION_HIERARCHY,
+        INCREMENTAL
+    } RoutingMode;
 
     class DjikstraController : public ITrafficController {
         public:
-        DjikstraController();
+        /**
+         *  @param mode The routing engine to find paths with
+         *  @param threadCount The number of threads to find paths on, see SetThreadCount()
+         */
+        DjikstraController(RoutingMode mode = RoutingMode::DJIKSTRA, unsigned int threadCount = 1);
         virtual ~DjikstraController();
 
         // ITrafficController
-        virtual void UpdateRailNetwork(Rail::RailNetwork& network, const std::vector<Train::Train *>& trains);
+        virtual bool UpdateRailNetwork(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                       const std::vector<Train::Train *>& trains);
+
+        virtual void RemoveTrain(Train::Train* train);
+
+        virtual void SetEventLogger(Util::EventLogger* logger) {
+            mEventLogger = logger;
+        }
+
+        virtual void SetProfiler(Util::Profiler* profiler) {
+            mProfiler = profiler;
+        }
+
+        virtual void SaveState(Util::BinaryWriter& writer, Rail::RailNetwork& network,
+                               const std::unordered_map<const Train::Train*, uint32_t>& trainIds);
+
+        virtual bool RestoreState(Util::BinaryReader& reader, Rail::RailNetwork& network,
+                                  const std::vector<Train::Train*>& trains);
+
+        virtual void SetSharedConnectors(const std::vector<uint8_t>* shared, std::vector<ConnectorClaim>* claims) {
+            mSharedConnectors = shared;
+            mSharedClaims = claims;
+        }
+
+        virtual void ApplyClaims(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                 const std::vector<ConnectorClaim>& claims);
+
+        virtual void SetLogKeys(const std::vector<uint64_t>* keys) {
+            mLogKeys = keys;
+        }
+
+        /**
+         *  Set the number of threads used to find paths
+         *
+         *  With more than one thread, each update first finds the paths for every train that does not
+         *  have one cached, concurrently. Paths are still set on the network by the calling thread,
+         *  in train order, so the results do not depend on the thread count.
+         */
+        void SetThreadCount(unsigned int threadCount);
+
+        /**
+         *  Get the counters for the routing queries made by this controller, 
+         *  including the nodes explored by the most recent query
+         */
+        const RoutingStats& GetRoutingStats() const {
+            return mRoutingStats;
+        }
+
+        /**
+         *  Get the counters for the path cache
+         */
+        const PathCacheStats& GetPathCacheStats() const {
+            return mPathCache.GetStats();
+        }
 
         private:
 
         /**
          *  Get the shortest path for the given train.
          * 
-         *  @note Paths returned by this method are cached in mShortestPaths, and must
-         *        be manually cleared if we want to subsequently recalculate the path
+         *  @return The path, or nullptr if there is none
+         *
+         *  @note Paths returned by this method are cached in mPathCache, until a change
+         *        to the network touches one of the segments along the path
          */
-        Path getPath(Train::Train* train);
+        const Path* getPath(Rail::RailNetwork& network, Train::Train* train);
 
         /**
          *  Find the shortest path across the network for the given train
          * 
-         *  @return The shortest path found using Djikstra's algorithm
+         *  @param engine The routing engine to search with
+         *  @param topology The topology of the network to search
+         *  @param nodesExplored Receives the number of nodes the search explored
+         *  @return The shortest path found using the given routing engine
+         *
+         *  @note This does not modify the controller, so may be called from any thread
+         *        with an engine owned by that thread
          */
-        Path findShortestPath(Train::Train* train);
+        Path findShortestPath(IRoutingEngine& engine, const Rail::RailTopology& topology, Train::Train* train,
+                              unsigned int& nodesExplored) const;
 
         /**
-         *  Links junctions to create the given path in the network
-         * 
-         *  @param network The network to set the path on
-         *  @param path The path of components to set in the network
+         *  Find paths concurrently for every train without a cached path, and cache them
          */
-        bool setPath(Rail::RailNetwork& network, Path path);
+        void findMissingPaths(Rail::RailNetwork& network, const std::vector<Train::Train *>& trains);
 
-        std::map<Train::Train*, Path> mShortestPaths;
-    };
+        /**
+         *  Invalidate the cached paths affected by changes made to the network since the last update,
+         *  and pass the changes on to the routing engines
+         */
+        void syncNetworkChanges(Rail::RailNetwork& network);
 
-    class PriorityPath {
-        public:
-        PriorityPath(unsigned int distance, Path path, Rail::IConnector* vertex) : 
-            mDistance(distance), mPath(path), mVertex(vertex) {}
-    
-        ~PriorityPath() {}
+        /**
+         *  Route by the signals of the given state from now on, dropping any paths found by another's, or
+         *  pass on the changes made to the state since the last update if it is the same state
+         */
+        void syncNetworkState(const Rail::RailTopology& topology, const Rail::NetworkState& state);
 
-        using CompareFn = std::function<bool(PriorityPath, PriorityPath)>;
+        /**
+         *  Invalidate the cached paths through the segments in mChangedSegments and pass them on to the
+         *  routing engines, or treat every segment as changed if the changes were not kept
+         */
+        void applyChanges(const Rail::RailTopology& topology, bool kept);
 
-        static bool Compare(PriorityPath below, PriorityPath above) {
-            return below.mDistance > above.mDistance;
-        }
+        /**
+         *  Update the routing counters and the profiler after a query
+         */
+        void recordQuery(unsigned int nodesExplored, uint64_t nanoseconds);
 
-        unsigned int GetDistance() {
-            return mDistance;
-        }
+        /**
+         *  Record a routing event for a train, if there is an event logger
+         */
+        void recordEvent(Util::EventLogger::EventType type, const Train::Train* train, uint32_t arg = 0);
 
-        const Path GetPath() {
-            return mPath;
-        }
+        /**
+         *  Find the position of a train's segment along its path
+         *
+         *  A path may run along a segment once each way, to turn a train around, in which case the position
+         *  is the one at which the path runs the way the train is heading
+         *
+         *  @return The position, or the length of the path if the train is not on it
+         */
+        size_t findStep(const Rail::RailTopology& topology, const Path& path, const Train::Train* train) const;
 
-        void AppendPath(Rail::ISegment* segment) {
-            mPath.push_back(segment);
-        }
+        /**
+         *  Switch the connector ahead of a train for the next step along its path
+         *
+         *  Where trains contend for a connector in the same update, the one nearest to it wins, and of
+         *  those equally near, the first to be routed
+         *
+         *  @param state The state to switch the connector in
+         *  @param path The train's path, which must run through its current segment
+         *  @return false if the connector could not be switched for the train
+         */
+        bool setNextStep(Rail::RailNetwork& network, Rail::NetworkState& state, Train::Train* train,
+                         const Path& path);
 
-        Rail::IConnector* GetVertex() {
-            return mVertex;
-        }
+        /**
+         *  Switch a connector for a train, unless a nearer train has claimed it in the same update
+         *
+         *  @return false if the connector could not be switched for the train
+         */
+        bool claimConnector(Rail::RailNetwork& network, Rail::NetworkState& state, const ConnectorClaim& request);
 
-        private:
-        unsigned int mDistance = UINT32_MAX;
-        Path mPath;
-        Rail::IConnector* mVertex = nullptr;
+        /**
+         *  Set the key of the messages logged from now on to that of the given position, if keyed
+         */
+        void setLogKey(size_t position) const;
+
+        PathCache mPathCache;
+        // The network epoch the cache and engines were last synced with
+        uint64_t mNetworkEpoch = 0;
+        // The state the cache and engines were last synced with
+        const Rail::NetworkState* mNetworkState = nullptr;
+        // The epoch of that state the cache and engines were last synced with
+        uint64_t mStateEpoch = 0;
+        std::vector<Rail::SegmentId> mChangedSegments;
+
+        // The update a connector was last switched in, and the train it was switched for with its distance
+        // from the connector
+        struct Claim {
+            uint64_t mUpdate = 0;
+            unsigned int mDistance = 0;
+            const Train::Train* mTrain = nullptr;
+        };
+
+        // Indexed by ConnectorId
+        std::vector<Claim> mClaims;
+        uint64_t mUpdateCount = 0;
+        // Whether every train routed so far in the current update still has the connector ahead switched for it
+        bool mAllRouted = true;
+
+        // The connectors left to another controller, and the claims recorded on them, see SetSharedConnectors()
+        const std::vector<uint8_t>* mSharedConnectors = nullptr;
+        std::vector<ConnectorClaim>* mSharedClaims = nullptr;
+        const std::vector<uint64_t>* mLogKeys = nullptr;
+
+        IRoutingEngine* mRoutingEngine;
+        RoutingStats mRoutingStats;
+
+        // Batch routing state. Worker 0 is the calling thread and uses mRoutingEngine,
+        // worker n uses mWorkerEngines[n - 1]
+        Util::ThreadPool* mThreadPool = nullptr;
+        std::vector<IRoutingEngine*> mWorkerEngines;
+        const Rail::RailTopology* mWorkerTopology = nullptr;
+        uint64_t mWorkerTopologyVersion = 0;
+
+        std::vector<Train::Train*> mBatchTrains;
+        std::vector<Path> mBatchPaths;
+        std::vector<unsigned int> mBatchNodesExplored;
+        std::vector<uint64_t> mBatchQueryTimes;
+
+        // Trains the current update already failed to find a path for
+        std::unordered_set<Train::Train*> mUnroutableTrains;
+
+        Util::EventLogger* mEventLogger = nullptr;
+        Util::Profiler* mProfiler = nullptr;
     };
 
 }
@@ -0,0 +1,187 @@
+#ifndef EventLogger_H
+#define EventLogger_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Util {
+
+    /**
+     *  A fixed size binary record of a simulation event
+     *
+     *  Trains and components are referred to by the ids the logger gave their names, see
+     *  EventLogger::GetId(). The meaning of the arguments depends on the type of event.
+     */
+    struct EventRecord {
+        uint32_t mType;
+        uint32_t mTrain;
+        uint64_t mTick;
+        uint32_t mComponent;
+        uint32_t mArgs[3];
+    };
+
+    /**
+     *  Records simulation events to a binary file without stalling the simulation
+     *
+     *  Events are written as EventRecords into a lock free ring buffer, which a background thread drains
+     *  to the file. Only one thread, the one running the simulation, may record events or look up ids.
+     *  If the ring is full the event is dropped and counted rather than waiting for the drain thread, and
+     *  the number of dropped events is written to the file in its place.
+     *
+     *  The file starts with a header, followed by records in the byte order of the host. The names of
+     *  trains and components are written out of line by the drain thread, as a NAME record followed by
+     *  the text padded to a whole number of records, so may follow the first event that uses them.
+     *  Decode() turns a file back into the equivalent log messages.
+     */
+    class EventLogger {
+        public:
+        typedef enum {
+            NAME,           // mTrain is the id being named, mArgs[0] is the length of the name which follows
+            DROPPED,        // mArgs[0] is the number of events dropped since the last DROPPED record
+            TRAVERSED,      // mArgs[0] is the distance travelled, and mArgs[1] the time spent stopped
+            STOPPED,        // mArgs[0] is the direction of the train
+            COLLIDED,       // mArgs[0] is the id of the other train
+            ARRIVED,
+            PATH_FOUND,     // mArgs[0] is the number of nodes explored
+            NO_PATH,
+            PATH_NOT_SET,
+            EVENT_TYPE_COUNT
+        } EventType;
+
+        static const uint32_t INVALID_ID = UINT32_MAX;
+        static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+        /**
+         *  Open a file to record events to, and start draining to it
+         *
+         *  @param capacity The number of records the ring buffer holds, rounded up to a power of two
+         */
+        EventLogger(const std::string& path, size_t capacity = DEFAULT_CAPACITY);
+
+        /**
+         *  Write out every recorded event and close the file
+         */
+        ~EventLogger();
+
+        /**
+         *  Checks whether the file was opened. Events recorded to a logger that is not open are
+         *  discarded, and counted as dropped.
+         */
+        bool IsOpen() const {
+            return mFile != nullptr;
+        }
+
+        /**
+         *  Set the tick stamped on subsequently recorded events
+         */
+        void SetTick(uint64_t tick) {
+            mTick = tick;
+        }
+
+        /**
+         *  Get the id of a train or component, naming it in the file the first time it is seen
+         *
+         *  @param key The object the name belongs to
+         */
+        uint32_t GetId(const void* key, const char* name);
+
+        /**
+         *  Forget the id of a destroyed object, so that a new object at the same address gets a new id
+         */
+        void Forget(const void* key) {
+            mIds.erase(key);
+        }
+
+        /**
+         *  Record an event, or drop it if the ring buffer is full
+         */
+        void Record(EventType type, uint32_t train, uint32_t component = INVALID_ID,
+                    uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0) {
+            uint64_t head = mHead.load(std::memory_order_relaxed);
+            if(head - mCachedTail >= mRecords.size()) {
+                mCachedTail = mTail.load(std::memory_order_acquire);
+                if(head - mCachedTail >= mRecords.size()) {
+                    mDropped.store(mDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+
+            EventRecord& record = mRecords[head & (mRecords.size() - 1)];
+            record.mType = type;
+            record.mTrain = train;
+            record.mTick = mTick;
+            record.mComponent = component;
+            record.mArgs[0] = arg0;
+            record.mArgs[1] = arg1;
+            record.mArgs[2] = arg2;
+
+            mHead.store(head + 1, std::memory_order_release);
+        }
+
+        /**
+         *  Gets the total number of events dropped because the ring buffer was full
+         */
+        uint64_t GetDroppedCount() const {
+            return mDropped.load(std::memory_order_relaxed);
+        }
+
+        /**
+         *  Write the log messages for each event in a file
+         *
+         *  @return false if the file could not be read
+         */
+        static bool Decode(const std::string& path, FILE* out);
+
+        private:
+        void drainLoop();
+
+        /**
+         *  Write the pending names and every event recorded so far to the file
+         */
+        void drain();
+
+        void writeName(uint32_t id, const std::string& name);
+
+        FILE* mFile = nullptr;
+        std::vector<EventRecord> mRecords;
+
+        // The counters written by each thread are padded on to separate cache lines, so that recording
+        // does not contend with draining
+        static const size_t CACHE_LINE_SIZE = 64;
+
+        // Written by the recording thread only
+        char mRecorderPadding[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> mHead;
+        uint64_t mCachedTail = 0;
+        uint64_t mTick = 0;
+        std::unordered_map<const void*, uint32_t> mIds;
+        uint32_t mNextId = 0;
+        std::atomic<uint64_t> mDropped;
+
+        // Written by the drain thread only
+        char mDrainPadding[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> mTail;
+        uint64_t mReportedDropped = 0;
+        uint64_t mLastTick = 0;
+
+        char mSharedPadding[CACHE_LINE_SIZE];
+
+        // Names waiting to be written, shared under mMutex
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::vector<std::pair<uint32_t, std::string>> mPendingNames;
+        bool mStopping = false;
+
+        std::thread mThread;
+    };
+
+}
+
+#endif
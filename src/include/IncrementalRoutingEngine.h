@@ -0,0 +1,142 @@
+#ifndef IncrementalRoutingEngine_H
+#define IncrementalRoutingEngine_H
+
+#include "interfaces/IRoutingEngine.h"
+#include "SearchSpace.h"
+
+#include <unordered_map>
+
+namespace Traffic {
+
+    /**
+     *  Routes trains with an incremental (LPA*) search, which takes signals into account and repairs
+     *  its search state when they change rather than searching again from scratch
+     *
+     *  The search runs backwards from the destination, so its state holds the distance from every
+     *  explored node to the destination, and is kept between queries. Because it does not depend on
+     *  where a train starts, the state is shared by every train heading to the same destination, and
+     *  a train which has moved on only extends the existing search. When a signal changes, only the
+     *  nodes whose distance depends on it are updated.
+     *
+     *  Leaving a segment past a red signal costs an additional delay on top of the length of the next
+     *  segment. Signals in any other state are free to pass.
+     */
+    class IncrementalRoutingEngine : public IRoutingEngine {
+        public:
+        // The default delay for passing a red signal, in units of track length
+        static const unsigned int DEFAULT_RED_SIGNAL_COST = 1000;
+
+        // A red signal cost which closes the track beyond it entirely
+        static const unsigned int IMPASSABLE = UINT32_MAX;
+
+        /**
+         *  @param redSignalCost The cost added for passing a red signal, or IMPASSABLE if trains should
+         *                       be routed as though a red signal will never clear
+         */
+        IncrementalRoutingEngine(unsigned int redSignalCost = DEFAULT_RED_SIGNAL_COST);
+        virtual ~IncrementalRoutingEngine();
+
+        // IRoutingEngine
+        virtual void Prepare(const Rail::RailTopology& topology) {}
+        virtual IRoutingEngine* Clone() const;
+        virtual void UpdateCosts(const Rail::RailTopology& topology, const std::vector<Rail::SegmentId>& changed);
+        virtual void SetState(const Rail::NetworkState* state);
+        virtual Path FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination);
+
+        virtual const RoutingStats& GetStats() const {
+            return mStats;
+        }
+
+        private:
+        /**
+         *  The search state towards a single destination
+         *
+         *  mDistances holds the distance from the end of each node to the destination as of the last
+         *  time the node was expanded, and mLookaheads the distance implied by its successors' distances.
+         *  A node where these differ is inconsistent, and is queued to be expanded.
+         */
+        struct DestinationSearch {
+            Rail::ConnectorId mDestination;
+
+            std::vector<unsigned int> mDistances;
+            std::vector<unsigned int> mLookaheads;
+
+            // The key each node is queued with, or UINT32_MAX if it is not queued. Queue entries whose
+            // priority does not match are stale and skipped
+            std::vector<unsigned int> mQueuedKeys;
+            std::vector<QueueEntry> mQueue;
+        };
+
+        /**
+         *  Discard all search state, and take a fresh snapshot of the signals in a topology
+         */
+        void reset(const Rail::RailTopology& topology);
+
+        /**
+         *  Get the search state for a destination, starting a new search if there is none
+         */
+        DestinationSearch& getSearch(const Rail::RailTopology& topology, Rail::ConnectorId destination);
+
+        /**
+         *  Expand inconsistent nodes until the distance from the start node is known
+         */
+        void computeDistances(const Rail::RailTopology& topology, DestinationSearch& search, Rail::NodeId start);
+
+        /**
+         *  Find the path from a start node whose distance is known by searching the successors which give
+         *  each node its distance, for when following them alone would loop
+         */
+        Path findTiedPath(const Rail::RailTopology& topology, const DestinationSearch& search, Rail::NodeId start);
+
+        /**
+         *  Move on to a new stamp for marking the nodes of a path
+         */
+        void nextPathStamp();
+
+        /**
+         *  Recalculate the lookahead of a node from its successors, and queue it if it is inconsistent
+         */
+        void updateNode(const Rail::RailTopology& topology, DestinationSearch& search, Rail::NodeId node);
+
+        /**
+         *  Get the cost of travelling along a node on to one of its successors
+         */
+        unsigned int getCost(const Rail::RailTopology& topology, Rail::NodeId node, Rail::NodeId successor) const;
+
+        /**
+         *  Get the signal cost of leaving a node, from the current state of its signal
+         */
+        unsigned int getSignalCost(const Rail::RailTopology& topology, Rail::NodeId node) const;
+
+        /**
+         *  Remove stale entries from the top of a search queue
+         */
+        void pruneQueue(DestinationSearch& search);
+
+        unsigned int mRedSignalCost;
+
+        // The state signals are read from, or nullptr to read them from the segments
+        const Rail::NetworkState* mState = nullptr;
+
+        // The topology the search state was built for
+        const Rail::RailTopology* mTopology = nullptr;
+        uint64_t mTopologyVersion = 0;
+
+        // The signal cost of leaving each node, as last seen
+        std::vector<unsigned int> mSignalCosts;
+
+        std::unordered_map<Rail::ConnectorId, DestinationSearch> mSearches;
+
+        // Scratch space for finding a path: the nodes stamped with mPathStamp are those already on the path
+        // or reached by findTiedPath(), which records the node each was reached from
+        std::vector<uint32_t> mPathStamps;
+        uint32_t mPathStamp = 0;
+        std::vector<Rail::NodeId> mPathParents;
+        std::vector<Rail::NodeId> mPathQueue;
+
+        RoutingStats mStats;
+    };
+
+}
+
+#endif
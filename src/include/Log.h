@@ -0,0 +1,207 @@
+#ifndef Log_H
+#define Log_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Numeric levels, so that the compiled in level can be tested by the preprocessor
+#define LOG_LEVEL_TRACE   0
+#define LOG_LEVEL_DEBUG   1
+#define LOG_LEVEL_INFO    2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_ERROR   4
+#define LOG_LEVEL_NONE    5
+
+/**
+ *  The lowest level compiled into the build. Messages below it are removed by the preprocessor, along
+ *  with the evaluation of their arguments. Release builds keep INFO and above unless told otherwise.
+ */
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+namespace Util {
+
+    typedef enum {
+        TRACE = LOG_LEVEL_TRACE,
+        DEBUG = LOG_LEVEL_DEBUG,
+        INFO = LOG_LEVEL_INFO,
+        WARNING = LOG_LEVEL_WARNING,
+        ERROR = LOG_LEVEL_ERROR,
+        NONE = LOG_LEVEL_NONE
+    } LogLevel;
+
+    typedef enum {
+        ROUTING,    // Path finding and switching
+        TRAVERSAL,  // Trains moving between components
+        BUILD,      // Constructing and connecting the network
+        TRAIN,      // Train lifecycle and simulation results
+        CATEGORY_COUNT
+    } LogCategory;
+
+    const char* PrintLogLevel(LogLevel level);
+    const char* PrintLogCategory(LogCategory category);
+
+    /**
+     *  Parse a level from its name, ignoring case
+     *
+     *  @return False if the name is not a level
+     */
+    bool ParseLogLevel(const char* name, LogLevel& level);
+
+    /**
+     *  Messages held back by a thread rather than written, see Log::Capture()
+     */
+    class LogBuffer {
+        public:
+        /**
+         *  Set the key of the messages captured from now on, which orders them when they are flushed
+         */
+        void SetKey(uint64_t key) {
+            mKey = key;
+        }
+
+        /**
+         *  Access the messages held back, e.g. to pass them to another process to be written
+         */
+        size_t GetSize() const {
+            return mMessages.size();
+        }
+
+        uint64_t GetKey(size_t index) const {
+            return mMessages[index].mKey;
+        }
+
+        const std::string& GetText(size_t index) const {
+            return mMessages[index].mText;
+        }
+
+        /**
+         *  Add a message held back elsewhere, with the level already prefixed to its text
+         */
+        void Append(uint64_t key, const std::string& text) {
+            mMessages.push_back(Message {key, text});
+        }
+
+        void Clear() {
+            mMessages.clear();
+        }
+
+        private:
+        friend class Log;
+
+        struct Message {
+            uint64_t mKey;
+            std::string mText;
+        };
+
+        std::vector<Message> mMessages;
+        uint64_t mKey = 0;
+    };
+
+    /**
+     *  Leveled logging to stdout, with a runtime threshold per category
+     *
+     *  Use the LOG_* macros rather than calling Write() directly, so that disabled levels cost nothing.
+     *  Each message is written as a single line, prefixed by its level.
+     */
+    class Log {
+        public:
+        /**
+         *  Set the lowest level logged for every category
+         */
+        static void SetLevel(LogLevel level);
+
+        /**
+         *  Set the lowest level logged for one category
+         */
+        static void SetLevel(LogCategory category, LogLevel level);
+
+        static LogLevel GetLevel(LogCategory category) {
+            return static_cast<LogLevel>(sLevels[category].load(std::memory_order_relaxed));
+        }
+
+        static bool IsEnabled(LogLevel level, LogCategory category) {
+            return level >= LOG_COMPILE_LEVEL && level >= sLevels[category].load(std::memory_order_relaxed);
+        }
+
+        /**
+         *  Write a message regardless of the threshold. A trailing newline is added.
+         */
+        static void Write(LogLevel level, LogCategory category, const char* format, ...)
+            __attribute__((format(printf, 3, 4)));
+
+        /**
+         *  Hold back the messages written by the calling thread in a buffer, or write them directly again
+         *  if the buffer is nullptr
+         *
+         *  This lets work split across threads log in the order it would have done on one thread.
+         *
+         *  @return The buffer the thread was capturing to before, to be restored once done
+         */
+        static LogBuffer* Capture(LogBuffer* buffer);
+
+        /**
+         *  Set the key of the messages the calling thread captures from now on, if it is capturing, see
+         *  LogBuffer::SetKey()
+         */
+        static void SetKey(uint64_t key);
+
+        /**
+         *  Write the messages held back in a set of buffers in order of their keys, and empty the buffers.
+         *  Messages with the same key are written in the order of their buffers in the set, then in the
+         *  order they were captured. If the calling thread is capturing itself, the messages are captured
+         *  in its buffer instead of written
+         */
+        static void Flush(std::vector<LogBuffer>& buffers);
+
+        private:
+        static std::atomic<int> sLevels[CATEGORY_COUNT];
+    };
+
+}
+
+#define LOG_WRITE(level, category, ...) \
+    do { \
+        if(Util::Log::IsEnabled(Util::level, Util::category)) { \
+            Util::Log::Write(Util::level, Util::category, __VA_ARGS__); \
+        } \
+    } while(0)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(category, ...) LOG_WRITE(TRACE, category, __VA_ARGS__)
+#else
+#define LOG_TRACE(category, ...) do {} while(0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) LOG_WRITE(DEBUG, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) do {} while(0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) LOG_WRITE(INFO, category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) do {} while(0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(category, ...) LOG_WRITE(WARNING, category, __VA_ARGS__)
+#else
+#define LOG_WARNING(category, ...) do {} while(0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(category, ...) LOG_WRITE(ERROR, category, __VA_ARGS__)
+#else
+#define LOG_ERROR(category, ...) do {} while(0)
+#endif
+
+#endif
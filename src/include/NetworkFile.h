@@ -0,0 +1,167 @@
+#ifndef NetworkFile_H
+#define NetworkFile_H
+
+#include "RailTopology.h"
+#include "NetworkState.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Rail {
+
+    /**
+     *  A rail network saved in a binary file, which is mapped into memory and used in place
+     *
+     *  The file is little-endian throughout. It starts with a header holding the component counts and a
+     *  directory of sections, each of which starts on an 8 byte boundary and holds one table:
+     *
+     *    SEGMENT_LENGTHS     uint32_t per segment
+     *    NODE_ENDS           ConnectorId per node, or INVALID_ID where the segment is unconnected
+     *    NODE_SIGNALS        uint8_t SignalState per node, for the signal before the end of the node
+     *    TERMINATOR_FLAGS    uint8_t per connector
+     *    ATTACHMENT_OFFSETS  uint32_t per connector, plus one, into ATTACHMENTS
+     *    ATTACHMENTS         NodeId per connected segment end
+     *    SUCCESSOR_OFFSETS   uint32_t per node, plus one, into SUCCESSORS
+     *    SUCCESSORS          NodeId per edge
+     *    SELECTIONS          Two SegmentIds per connector, the selected segments or INVALID_ID
+     *    NAME_OFFSETS        uint32_t per segment then connector, plus one, into NAMES
+     *    NAMES               The names of the segments then connectors, each terminated by a nul
+     *
+     *  Connectors are numbered as in RailTopology, with the terminators after the other connectors, so the
+     *  topology tables can be used by a RailTopology without being copied. The file is checked when it is
+     *  opened, so that a damaged file can neither lead to reads outside of it nor give a topology which
+     *  RailTopology would not have built.
+     */
+    class NetworkFile {
+        public:
+        static const uint32_t VERSION = 1;
+
+        typedef enum {
+            SEGMENT_LENGTHS,
+            NODE_ENDS,
+            NODE_SIGNALS,
+            TERMINATOR_FLAGS,
+            ATTACHMENT_OFFSETS,
+            ATTACHMENTS,
+            SUCCESSOR_OFFSETS,
+            SUCCESSORS,
+            SELECTIONS,
+            NAME_OFFSETS,
+            NAMES,
+            SECTION_COUNT
+        } Section;
+
+        NetworkFile();
+        ~NetworkFile();
+
+        NetworkFile(const NetworkFile&) = delete;
+        NetworkFile& operator=(const NetworkFile&) = delete;
+
+        /**
+         *  Map a network file into memory, closing any file already open
+         *
+         *  @return false if the file could not be mapped, or is not a valid network file
+         */
+        bool Open(const std::string& path);
+
+        /**
+         *  Unmap the file. Anything using its tables must have stopped doing so
+         */
+        void Close();
+
+        bool IsOpen() const {
+            return mHeader != nullptr;
+        }
+
+        /**
+         *  Save the components and state of a network to a file
+         *
+         *  @param topology The topology of the network to save
+         *  @param state The switches and signals to save, which must be sized for the topology
+         *  @return false if the file could not be written
+         */
+        static bool Write(const RailTopology& topology, const NetworkState& state, const std::string& path);
+
+        /**
+         *  Component counts. Connectors do not include terminators
+         */
+        uint32_t GetSegmentCount() const {
+            return mHeader->mSegmentCount;
+        }
+
+        uint32_t GetConnectorCount() const {
+            return mHeader->mConnectorCount;
+        }
+
+        uint32_t GetTerminatorCount() const {
+            return mHeader->mTerminatorCount;
+        }
+
+        /**
+         *  Get the topology tables, for RailTopology::Attach()
+         */
+        TopologyArrays GetTopologyArrays() const;
+
+        /**
+         *  Get the state of the signal before the end of a node
+         */
+        SignalState GetSignal(NodeId n) const {
+            return static_cast<SignalState>(section<uint8_t>(NODE_SIGNALS)[n]);
+        }
+
+        /**
+         *  Get the segments selected in a connector, either of which may be INVALID_ID
+         */
+        SegmentId GetSelection(ConnectorId c, unsigned int index) const {
+            return section<SegmentId>(SELECTIONS)[c * 2 + index];
+        }
+
+        const char* GetSegmentName(SegmentId s) const {
+            return getName(s);
+        }
+
+        const char* GetConnectorName(ConnectorId c) const {
+            return getName(mHeader->mSegmentCount + c);
+        }
+
+        private:
+        struct SectionEntry {
+            uint64_t mOffset;
+            uint64_t mSize;
+        };
+
+        struct Header {
+            char mMagic[4];
+            uint32_t mVersion;
+            uint32_t mHeaderSize;
+            uint32_t mSegmentCount;
+            uint32_t mConnectorCount;
+            uint32_t mTerminatorCount;
+            uint32_t mAttachmentCount;
+            uint32_t mSuccessorCount;
+            SectionEntry mSections[SECTION_COUNT];
+        };
+
+        template<typename T>
+        const T* section(Section s) const {
+            return reinterpret_cast<const T*>(static_cast<const char*>(mData) + mHeader->mSections[s].mOffset);
+        }
+
+        const char* getName(uint32_t component) const {
+            return section<char>(NAMES) + section<uint32_t>(NAME_OFFSETS)[component];
+        }
+
+        /**
+         *  Check the header and tables of a newly mapped file
+         */
+        bool validate(const std::string& path) const;
+
+        void* mData = nullptr;
+        size_t mSize = 0;
+        const Header* mHeader = nullptr;
+    };
+
+}
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef NetworkGenerator_H
+#define NetworkGenerator_H
+
+#include "RailNetwork.h"
+#include "NetworkLoader.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Rail {
+
+    /**
+     *  Generates networks of a given layout and size, and a workload of trains to run on them
+     *
+     *  The network is planned first, as segments whose ends meet at junctions, and the plan is then either
+     *  built into a RailNetwork through the building API or written as a text network file which loads
+     *  into the same network, see TextNetworkLoader. Every random choice is drawn from a generator seeded
+     *  by the options, so the same options give the same network and trains on every platform.
+     *
+     *  Junctions joining a single segment end are terminators, as are the ends of the stubs added to give
+     *  the layout the number of terminators asked for. Signals are placed on a share of the segment ends.
+     *  Each train starts on a segment of its own, heading for a terminator it can reach in the layout.
+     *  Trains are drawn at random, so they may meet each other or a red signal, unless planned conflict free.
+     */
+    class NetworkGenerator {
+        public:
+        /**
+         *  The layouts networks can be generated in
+         *  GRID is a square mesh of junctions. With a junction degree of 3 alternate vertical links are
+         *       left out, so the mesh looks like a brick wall. Terminators are on stubs around the edge
+         *  CORRIDOR is a number of long lines with a passing loop every few segments, and a terminator at
+         *       each end of each line
+         *  HUB is a ring of junctions at the centre, with lines radiating out from it to a terminator each
+         *  PLANAR is a random planar graph over scattered junctions, with terminators on random stubs
+         */
+        typedef enum {
+            GRID,
+            CORRIDOR,
+            HUB,
+            PLANAR
+        } Layout;
+
+        /**
+         *  How segment lengths are drawn
+         *  CONSTANT gives every segment the minimum length
+         *  UNIFORM draws evenly between the minimum and maximum length
+         *  EXPONENTIAL draws mostly short segments, with a mean a quarter of the way from the minimum to the
+         *              maximum, and cut off at the maximum
+         */
+        typedef enum {
+            CONSTANT,
+            UNIFORM,
+            EXPONENTIAL
+        } LengthDistribution;
+
+        struct Options {
+            Layout mLayout = GRID;
+            uint64_t mSeed = 1;
+
+            // The number of segments to aim for. Layouts round this to their own shape
+            uint64_t mSegmentCount = 1000;
+
+            LengthDistribution mLengthDistribution = UNIFORM;
+            unsigned int mMinLength = 5;
+            unsigned int mMaxLength = 50;
+
+            // The most segments to join at a junction, where the layout allows. Layouts need at least 3
+            unsigned int mJunctionDegree = 4;
+
+            // The share of segment ends with a signal, and the share of those which are red
+            double mSignalDensity = 0.0;
+            double mRedSignalRatio = 0.0;
+
+            // The number of terminators, or 0 for the layout's own number
+            unsigned int mTerminatorCount = 0;
+
+            unsigned int mTrainCount = 0;
+
+            // Whether to only plan trains whose routes never meet another train or a red signal, so that every
+            // train reaches its terminator. This searches the route of each train, which is slow on large
+            // networks, and leaves out trains which cannot be planned
+            bool mConflictFree = false;
+        };
+
+        /**
+         *  Parse a layout or length distribution from its name, ignoring case
+         *
+         *  @return False if the name is not known
+         */
+        static bool ParseLayout(const char* name, Layout& layout);
+        static bool ParseLengthDistribution(const char* name, LengthDistribution& distribution);
+
+        /**
+         *  Plan a network and its trains
+         */
+        NetworkGenerator(const Options& options);
+        ~NetworkGenerator();
+
+        /**
+         *  Build the planned network into a network, which should be empty
+         *
+         *  @param trains Receives the planned trains, on the components of the network
+         */
+        void Build(RailNetwork& network, std::vector<TextNetworkLoader::TrainRecord>& trains) const;
+
+        /**
+         *  Write the planned network and its trains as a text network file
+         *
+         *  @return false if the file could not be written
+         */
+        bool Write(const std::string& path) const;
+
+        size_t GetSegmentCount() const {
+            return mLengths.size();
+        }
+
+        size_t GetTerminatorCount() const {
+            return mTerminals.size();
+        }
+
+        size_t GetTrainCount() const {
+            return mTrains.size();
+        }
+
+        private:
+        /**
+         *  A planned train, starting on a segment end and heading for one of mTerminals
+         */
+        struct PlannedTrain {
+            NodeId mStart;
+            uint32_t mTerminator;
+        };
+
+        struct PlannedSignal {
+            NodeId mNode;
+            SignalState mState;
+        };
+
+        /**
+         *  The ticks in which a planned train may be on a segment, heading one way, or crossing a junction
+         */
+        struct Reservation {
+            uint64_t mFirst;
+            uint64_t mLast;
+            Direction mDirection;
+        };
+
+        /**
+         *  A run of segments added by planLine(), with the junctions at its ends
+         */
+        struct Line {
+            SegmentId mFirst;
+            SegmentId mLast;
+            uint32_t mDownJunction;
+            uint32_t mUpJunction;
+        };
+
+        /**
+         *  Plan each layout, adding segments between junctions
+         */
+        void planGrid();
+        void planCorridor();
+        void planHub();
+        void planPlanar();
+
+        /**
+         *  Add a line of segments heading up from a junction, with a passing loop every few segments
+         *
+         *  @return The junction at the up end of the line
+         */
+        uint32_t planLine(uint32_t start, uint64_t segmentCount);
+
+        /**
+         *  Create a junction, with no segments yet
+         */
+        uint32_t addJunction();
+
+        /**
+         *  Add a segment, from its down end at one junction to its up end at another, of a length drawn from
+         *  the distribution
+         *
+         *  @return The id of the segment
+         */
+        SegmentId addSegment(uint32_t down, uint32_t up);
+
+        /**
+         *  Add a stub segment from a junction to a new terminator
+         */
+        void addStub(uint32_t junction);
+
+        /**
+         *  Add stubs at evenly spaced junctions from a list, skipping those already at the junction degree
+         */
+        void addStubs(const std::vector<uint32_t>& candidates, unsigned int count);
+
+        /**
+         *  Turn the junctions with a single segment end into terminators, and group the rest by junction
+         */
+        void finish();
+
+        /**
+         *  Plan the signals and the trains, once the network is finished
+         */
+        void planSignals();
+        void planTrains();
+
+        /**
+         *  Pick a direction for a train starting on the given segment, and a terminator it can head for
+         */
+        uint32_t pickTerminator(SegmentId segment, Direction& direction);
+
+        /**
+         *  Reserve the segments and junctions a train may pass on its way to a terminator, for the ticks it
+         *  may pass them
+         *
+         *  Trains move a unit a tick and are routed by the shortest distance, as in the simulator, so every
+         *  shortest route is reserved, whichever one the train is given. A train is only planned if none of
+         *  its routes meets a red signal, crosses a junction in the same tick as a train already planned, or
+         *  shares a segment with one heading the other way, so that every train reaches its terminator.
+         *
+         *  @return false if the train could not be planned, in which case nothing is reserved
+         */
+        bool reserveRoute(NodeId start, uint32_t terminator);
+
+        /**
+         *  Check a reservation against those already made for the same segment or junction
+         *
+         *  @param sameDirection Whether trains heading the same way may share the ticks
+         */
+        static bool isFree(const std::vector<Reservation>* reservations, const Reservation& reservation,
+                           bool sameDirection);
+
+        /**
+         *  Draw random numbers from the seeded generator
+         */
+        uint64_t nextRandom();
+        uint64_t nextRandom(uint64_t bound);
+        double nextUnit();
+        unsigned int nextLength();
+
+        Options mOptions;
+        uint64_t mRandomState;
+
+        // The length of each segment, and the junction at each of its ends, indexed by NodeId
+        std::vector<uint32_t> mLengths;
+        std::vector<uint32_t> mNodeJunctions;
+        std::vector<uint32_t> mJunctionDegrees;
+
+        // The segment ends at each junction which is not a terminator, grouped by junction in segment order
+        std::vector<uint32_t> mJunctionOffsets;
+        std::vector<NodeId> mJunctionNodes;
+
+        // The segment end at each terminator
+        std::vector<NodeId> mTerminals;
+
+        // The terminator at each junction of a single segment end, or INVALID_ID
+        std::vector<uint32_t> mJunctionTerminators;
+
+        // The lines of a CORRIDOR or HUB layout, which trains are kept to
+        std::vector<Line> mLines;
+
+        std::vector<PlannedSignal> mSignals;
+        std::vector<PlannedTrain> mTrains;
+
+        // Whether each node has a red signal, and the reservations of the trains planned so far
+        std::vector<uint8_t> mRedNodes;
+        std::unordered_map<SegmentId, std::vector<Reservation>> mSegmentReservations;
+        std::unordered_map<uint32_t, std::vector<Reservation>> mJunctionReservations;
+
+        // The search of reserveRoute(), by node: the shortest distance, the earliest and latest tick the train
+        // may reach the node's segment, and whether the node is on a shortest route
+        std::vector<uint64_t> mDistances;
+        std::vector<uint64_t> mEarliestTicks;
+        std::vector<uint64_t> mLatestTicks;
+        std::vector<uint8_t> mOnRoute;
+        std::vector<NodeId> mReached;
+        std::vector<NodeId> mSettled;
+    };
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef NetworkLoader_H
+#define NetworkLoader_H
+
+#include "RailNetwork.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Rail {
+
+    /**
+     *  Builds a network from a text file, such as one exported from a planning tool
+     *
+     *  Each line of the file holds one statement, with fields separated by whitespace:
+     *
+     *    segment <name> <length>
+     *    connect <segment> <up|down> <segment> <up|down>
+     *    terminator <name> <segment> <up|down>
+     *    signal <segment> <up|down> <red|green>
+     *    train <name> <segment> <up|down> <terminator>
+     *
+     *  Keywords are not case sensitive, names are. A '#' starts a comment which runs to the end of the
+     *  line, and blank lines are ignored.
+     *
+     *  The file is read in chunks, a batch of which is parsed in parallel and then applied to the network
+     *  in file order through the building API, so only a batch of the file is held in memory at a time.
+     *  A statement which names a segment or terminator not yet defined is kept back, along with every
+     *  statement after it but the segments, and these are applied in file order in a single linking pass
+     *  once the whole file has been read. Trains are linked last, so may name terminators defined after
+     *  them. The network built, and the errors found, are as if every segment were defined first and the
+     *  rest of the file then applied in order.
+     */
+    class TextNetworkLoader {
+        public:
+        static const size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+        /**
+         *  A train to be added to the simulation
+         */
+        struct TrainRecord {
+            std::string mName;
+            ISegment* mStart;
+            Direction mDirection;
+            IConnector* mDestination;
+        };
+
+        /**
+         *  @param network The network to add the components to
+         *  @param threadCount The number of threads to parse with, including the caller
+         *  @param chunkSize The number of bytes of the file each thread parses at a time
+         */
+        TextNetworkLoader(RailNetwork& network, unsigned int threadCount = 1, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        ~TextNetworkLoader();
+
+        /**
+         *  Load a file into the network
+         *
+         *  Each error is logged with the line it was found on. Statements with errors are skipped, and the
+         *  rest of the file is still loaded.
+         *
+         *  @return false if the file could not be read or had any errors
+         */
+        bool Load(const std::string& path);
+
+        /**
+         *  Get the trains defined by the files loaded so far
+         */
+        const std::vector<TrainRecord>& GetTrains() const {
+            return mTrains;
+        }
+
+        size_t GetErrorCount() const {
+            return mErrorCount;
+        }
+
+        private:
+        typedef enum {
+            SEGMENT,
+            CONNECT,
+            TERMINATOR,
+            SIGNAL,
+            TRAIN
+        } StatementType;
+
+        /**
+         *  A field of a statement, within the text of its chunk
+         */
+        struct Field {
+            const char* mText;
+            uint32_t mLength;
+        };
+
+        /**
+         *  A parsed statement, whose names point into the text of its chunk
+         */
+        struct Statement {
+            StatementType mType;
+            uint32_t mLine;         // Within the chunk
+            Field mNames[3];
+            Direction mDirections[2];
+            uint32_t mValue;        // The length of a segment, or the state of a signal
+        };
+
+        /**
+         *  A statement to apply, holding its own copy of its names so that it can be kept back until the
+         *  components they name are defined
+         */
+        struct PendingStatement {
+            StatementType mType;
+            uint64_t mLine;
+            std::string mNames[3];
+            Direction mDirections[2];
+            uint32_t mValue;
+        };
+
+        struct Error {
+            uint64_t mLine;
+            std::string mMessage;
+        };
+
+        /**
+         *  A piece of the file made of whole lines, and what was parsed from it
+         */
+        struct Chunk {
+            std::vector<char> mText;
+            size_t mSize = 0;
+            uint32_t mLineCount = 0;
+            std::vector<Statement> mStatements;
+            std::vector<Error> mErrors;     // With lines within the chunk
+        };
+
+        /**
+         *  Read the next chunk of whole lines from the file, carrying any partial line over to the next
+         *
+         *  @return false at the end of the file
+         */
+        bool readChunk(FILE* file, Chunk& chunk);
+
+        /**
+         *  Split a chunk into statements
+         */
+        void parseChunk(Chunk& chunk);
+        bool parseLine(const char* first, const char* last, Statement& statement, std::string& error);
+
+        /**
+         *  Apply a statement to the network
+         *
+         *  @param final Whether to report names which are not yet defined as errors, rather than keep the
+         *               statement back
+         */
+        void apply(const PendingStatement& statement, bool final);
+
+        /**
+         *  Find a component by name
+         *
+         *  @return The component, or nullptr if it is not defined. If final this is reported as an error,
+         *          otherwise the statement is kept back to be applied again
+         */
+        ISegment* findSegment(const PendingStatement& statement, unsigned int index, bool final);
+        IConnector* findTerminator(const PendingStatement& statement, unsigned int index, bool final);
+
+        void addError(uint64_t line, const std::string& message);
+
+        RailNetwork& mNetwork;
+        Util::ThreadPool* mThreadPool = nullptr;
+        size_t mChunkSize;
+
+        // Any partial line left at the end of the last chunk read
+        std::vector<char> mCarry;
+        uint64_t mNextLine = 1;
+
+        std::unordered_map<std::string, ISegment*> mSegments;
+        std::unordered_map<std::string, IConnector*> mTerminators;
+        std::unordered_set<const IConnector*> mTerminatorConnectors;
+        std::vector<PendingStatement> mPending;
+        std::vector<TrainRecord> mTrains;
+
+        std::vector<Error> mErrors;
+        size_t mErrorCount = 0;
+    };
+
+}
+
+#endif
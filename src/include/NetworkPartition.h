@@ -0,0 +1,59 @@
+#ifndef NetworkPartition_H
+#define NetworkPartition_H
+
+#include "RailTopology.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Rail {
+
+    /**
+     *  Splits the components of a topology into contiguous regions, with the boundaries between regions
+     *  falling at connectors
+     *
+     *  Components are numbered as in the topology, with segments first and connectors after them. Regions
+     *  are grown breadth first through the network, so that most of the neighbours of a component share its
+     *  region, and hold as near as possible the same number of components.
+     */
+    class NetworkPartition {
+        public:
+        NetworkPartition() {}
+        ~NetworkPartition() {}
+
+        /**
+         *  Partition a topology into the given number of regions, or fewer if it has fewer components
+         */
+        void Build(const RailTopology& topology, unsigned int regionCount);
+
+        /**
+         *  Get the version of the topology the partition was built from, see RailTopology::GetVersion()
+         */
+        uint64_t GetTopologyVersion() const {
+            return mTopologyVersion;
+        }
+
+        unsigned int GetRegionCount() const {
+            return mRegionCount;
+        }
+
+        uint32_t GetSegmentRegion(SegmentId s) const {
+            return mRegions[s];
+        }
+
+        uint32_t GetConnectorRegion(ConnectorId c) const {
+            return mRegions[mSegmentCount + c];
+        }
+
+        private:
+        uint64_t mTopologyVersion = 0;
+        unsigned int mRegionCount = 0;
+        size_t mSegmentCount = 0;
+
+        // Region of each component, segments first
+        std::vector<uint32_t> mRegions;
+    };
+
+}
+
+#endif
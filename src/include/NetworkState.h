@@ -0,0 +1,123 @@
+#ifndef NetworkState_H
+#define NetworkState_H
+
+#include "RailDefinitions.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Rail {
+
+    /**
+     *  The switches and signals of a rail network, held apart from its topology
+     *
+     *  Each connector's selection is packed into 32 bits, as the positions of its two selected segments
+     *  within RailTopology::GetAttachments(). Each node's signal takes two bits, stored with DISABLED as zero
+     *  so that a new state has no signals. The whole state is a few plain arrays, so many simulations can
+     *  share one topology and each copy the state they start from cheaply.
+     */
+    class NetworkState {
+        public:
+        // The position of an unselected segment
+        static const uint16_t NO_SELECTION = UINT16_MAX;
+
+        /**
+         *  Size the state for a topology, with nothing selected and no signals
+         */
+        void Reset(size_t connectorCount, size_t nodeCount);
+
+        size_t GetConnectorCount() const {
+            return mSelections.size();
+        }
+
+        size_t GetNodeCount() const {
+            return mNodeCount;
+        }
+
+        /**
+         *  Get the size of the state in bytes, which is what copying it costs
+         */
+        size_t GetSize() const {
+            return mSelections.size() * sizeof(uint32_t) + mSignals.size() * sizeof(uint64_t);
+        }
+
+        /**
+         *  Get the position among the connector's attachments of one of its two selected segments, or
+         *  NO_SELECTION
+         */
+        uint16_t GetSelection(ConnectorId c, unsigned int index) const {
+            return static_cast<uint16_t>(mSelections[c] >> (index * 16));
+        }
+
+        void Select(ConnectorId c, uint16_t first, uint16_t second) {
+            mSelections[c] = first | (static_cast<uint32_t>(second) << 16);
+        }
+
+        /**
+         *  Get the state of the signal before the end of a node
+         */
+        SignalState GetSignal(NodeId n) const {
+            return static_cast<SignalState>(((mSignals[n / 32] >> ((n % 32) * 2)) & 3) ^ DISABLED_BITS);
+        }
+
+        void SetSignal(NodeId n, SignalState state) {
+            uint64_t& word = mSignals[n / 32];
+            unsigned int shift = (n % 32) * 2;
+            word = (word & ~(static_cast<uint64_t>(3) << shift)) |
+                   (static_cast<uint64_t>(state ^ DISABLED_BITS) << shift);
+        }
+
+        /**
+         *  Change tracking API, for signals set on a state apart from its network, see
+         *  RailNetwork::SetSignal(NetworkState&, NodeId, SignalState). Switching connectors is not tracked
+         */
+
+        /**
+         *  Get the current epoch of the state. The epoch advances whenever a change is recorded
+         */
+        uint64_t GetEpoch() const {
+            return mEpoch;
+        }
+
+        /**
+         *  Record a change to the signal of a node in a new epoch
+         */
+        void MarkChanged(NodeId n);
+
+        /**
+         *  Get the segments whose signals have changed since the given epoch
+         *
+         *  @param epoch An epoch previously returned by GetEpoch()
+         *  @param changed Receives the ids of the changed segments, possibly with duplicates
+         *  @return false if the changes are too old to have been kept, in which case
+         *          every segment should be treated as changed
+         */
+        bool GetChangedSegments(uint64_t epoch, std::vector<SegmentId>& changed) const;
+
+        // The change journal is not part of the state compared
+        bool operator==(const NetworkState& other) const {
+            return mNodeCount == other.mNodeCount && mSelections == other.mSelections && mSignals == other.mSignals;
+        }
+
+        bool operator!=(const NetworkState& other) const {
+            return !(*this == other);
+        }
+
+        private:
+        // Signals are stored XORed with this, so that DISABLED is stored as zero
+        static const unsigned int DISABLED_BITS = SignalState::DISABLED;
+
+        size_t mNodeCount = 0;
+        std::vector<uint32_t> mSelections;
+        std::vector<uint64_t> mSignals;
+
+        // Change journal, holding the segment of each change made after mJournalStart, one per epoch
+        uint64_t mEpoch = 0;
+        uint64_t mJournalStart = 0;
+        std::vector<SegmentId> mJournal;
+    };
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef OccupancyIndex_H
+#define OccupancyIndex_H
+
+#include "Train.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Train {
+
+    /**
+     *  Tracks which trains occupy each component of the network, so that collision checks only need to
+     *  compare a train against the trains around it rather than every train in the simulation
+     *
+     *  Trains are re-bucketed as they are conducted on to new components. The index also tracks which
+     *  trains have been conducted in the current tick, so that trains which passed through each other
+     *  can be detected once both have moved.
+     *
+     *  A component's bucket is kept once it has been created, so the index can be updated and checked
+     *  from several threads at once, as long as each works on different components and the bucket of
+     *  every component a train moves on to already exists, see Prepare().
+     */
+    class OccupancyIndex {
+        public:
+        OccupancyIndex() {}
+        ~OccupancyIndex() {}
+
+        /**
+         *  Add a train to the index at its current component, if it is not already indexed
+         */
+        void Insert(Train* train);
+
+        /**
+         *  Remove a train from the index
+         */
+        void Remove(Train* train);
+
+        /**
+         *  Create the bucket of a component, if it does not already exist
+         */
+        void Prepare(const Rail::IComponent* component) {
+            mOccupants[component];
+        }
+
+        /**
+         *  Check whether a component has a bucket, so that trains can be moved on to it concurrently
+         */
+        bool IsPrepared(const Rail::IComponent* component) const {
+            return mOccupants.find(component) != mOccupants.end();
+        }
+
+        /**
+         *  Get the trains on a component
+         */
+        const std::vector<Train*>& GetOccupants(const Rail::IComponent* component) const;
+
+        /**
+         *  Start a new simulation tick, in which no trains have yet been conducted
+         */
+        void BeginTick() {
+            mTick++;
+        }
+
+        /**
+         *  Update the index after a train has been conducted in the current tick
+         */
+        void Update(Train* train);
+
+        /**
+         *  Checks to see if the train has collided with any other trains
+         *
+         *  Trains on the same component are checked with Train::CheckCollision(). Trains on the same or
+         *  the previous component which have also been conducted this tick are checked with
+         *  Train::CheckPassThrough()
+         *
+         *  @return true if the train has collided
+         */
+        bool CheckCollision(Train* train);
+
+        private:
+        struct Entry {
+            const Rail::IComponent* mComponent;
+            // The tick the train was last conducted in
+            uint64_t mTick;
+        };
+
+        /**
+         *  Move a train between component buckets
+         */
+        void removeOccupant(const Rail::IComponent* component, Train* train);
+        void addOccupant(const Rail::IComponent* component, Train* train);
+
+        std::unordered_map<const Rail::IComponent*, std::vector<Train*>> mOccupants;
+        std::unordered_map<Train*, Entry> mEntries;
+
+        uint64_t mTick = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef PathCache_H
+#define PathCache_H
+
+#include "interfaces/IRoutingEngine.h"
+#include "Train.h"
+
+#include <unordered_map>
+
+namespace Traffic {
+
+    /**
+     *  Counters describing the use of a PathCache
+     */
+    struct PathCacheStats {
+        // Lookups answered from the cache
+        uint64_t mHits = 0;
+        // Lookups which needed a new search
+        uint64_t mMisses = 0;
+        // Cached paths discarded because the network changed under them
+        uint64_t mInvalidations = 0;
+    };
+
+    /**
+     *  Caches the path found for each train, along with the segments the path depends on
+     *
+     *  Each cached path is indexed by the ids of the segments it runs over, so that a change to part of
+     *  the network only invalidates the paths which pass through it. Paths elsewhere are kept even if the
+     *  change would open up a shorter route for them.
+     */
+    class PathCache {
+        public:
+        PathCache() {}
+        ~PathCache() {}
+
+        /**
+         *  Look up the cached path for a train, counting a hit if it is found
+         *
+         *  @return The cached path, or nullptr if there is none
+         */
+        const Path* Find(Train::Train* train);
+
+        /**
+         *  Check whether a train has a cached path, without counting a hit
+         */
+        bool Contains(Train::Train* train) const {
+            return mEntries.count(train) != 0;
+        }
+
+        /**
+         *  Count a lookup which needed a new search
+         */
+        void RecordMiss() {
+            mStats.mMisses++;
+        }
+
+        /**
+         *  Cache the path for a train, replacing any existing path
+         *
+         *  @param train The train the path was found for
+         *  @param path The path to cache
+         *  @return The cached path, which is kept until the train's entry is replaced or removed
+         */
+        const Path* Insert(Train::Train* train, Path path);
+
+        /**
+         *  Remove the cached path for a train, if there is one
+         */
+        void Erase(Train::Train* train);
+
+        /**
+         *  Invalidate every cached path which runs over any of the given segments
+         */
+        void Invalidate(const std::vector<Rail::SegmentId>& segments);
+
+        /**
+         *  Invalidate every cached path
+         */
+        void Clear();
+
+        size_t GetSize() const {
+            return mEntries.size();
+        }
+
+        /**
+         *  Call fn(train, path) for every cached path, in no particular order
+         */
+        template<typename Fn>
+        void ForEach(Fn fn) const {
+            for(const auto& entry : mEntries) {
+                fn(entry.first, entry.second.mPath);
+            }
+        }
+
+        const PathCacheStats& GetStats() const {
+            return mStats;
+        }
+
+        private:
+        struct Entry {
+            Path mPath;
+            // The segments along the path, each once
+            std::vector<Rail::SegmentId> mSegments;
+        };
+
+        std::unordered_map<Train::Train*, Entry> mEntries;
+
+        // The trains whose cached path runs over each segment, indexed by SegmentId
+        std::vector<std::vector<Train::Train*>> mDependents;
+
+        PathCacheStats mStats;
+    };
+
+}
+
+#endif
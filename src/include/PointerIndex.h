@@ -0,0 +1,92 @@
+#ifndef PointerIndex_H
+#define PointerIndex_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Util {
+
+    /**
+     *  Maps pointers to 32 bit ids, in a single open addressed table
+     *
+     *  Unlike std::unordered_map, entries are not allocated individually, so filling an index with
+     *  millions of entries makes one allocation, and a lookup usually touches a single cache line.
+     *  Entries cannot be removed, other than by clearing the whole index.
+     */
+    class PointerIndex {
+        public:
+        static const uint32_t NOT_FOUND = UINT32_MAX;
+
+        PointerIndex() {}
+
+        /**
+         *  Make room for the given number of entries, so that adding them does not grow the table
+         */
+        void Reserve(size_t count);
+
+        /**
+         *  Remove every entry, keeping the table allocated
+         */
+        void Clear();
+
+        /**
+         *  Set the id of a pointer, adding it if it is not already in the index
+         *
+         *  @param key The pointer, which must not be nullptr
+         */
+        void Set(const void* key, uint32_t id);
+
+        /**
+         *  Look up the id of a pointer
+         *
+         *  @return The id of the pointer, or NOT_FOUND if it is not in the index
+         */
+        uint32_t Find(const void* key) const {
+            if(mSize == 0 || key == nullptr) {
+                return NOT_FOUND;
+            }
+
+            for(size_t i = slot(key); ; i = (i + 1) & mMask) {
+                const Entry& entry = mEntries[i];
+                if(entry.mKey == key) {
+                    return entry.mId;
+                }
+
+                if(entry.mKey == nullptr) {
+                    return NOT_FOUND;
+                }
+            }
+        }
+
+        size_t GetSize() const {
+            return mSize;
+        }
+
+        private:
+        struct Entry {
+            const void* mKey;
+            uint32_t mId;
+        };
+
+        /**
+         *  Get the preferred slot of a key, from the high bits of its Fibonacci hash
+         */
+        size_t slot(const void* key) const {
+            return (reinterpret_cast<uintptr_t>(key) * UINT64_C(0x9E3779B97F4A7C15)) >> mShift;
+        }
+
+        /**
+         *  Rehash every entry into a table of the given power of two size
+         */
+        void rehash(size_t capacity);
+
+        std::vector<Entry> mEntries;
+        size_t mSize = 0;
+        size_t mMask = 0;
+        unsigned int mShift = 64;
+    };
+
+}
+
+#endif
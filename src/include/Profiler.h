@@ -0,0 +1,214 @@
+#ifndef Profiler_H
+#define Profiler_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace Util {
+
+    /**
+     *  A histogram of latencies in nanoseconds, with buckets of constant relative width
+     *
+     *  Values below SUB_BUCKET_COUNT have a bucket each. Above that, each power of two range is split into
+     *  SUB_BUCKET_COUNT buckets, so any recorded value is known to within about 3% however large it is,
+     *  in a fixed amount of memory. Values may be recorded from several threads at once.
+     */
+    class LatencyHistogram {
+        public:
+        static const unsigned int SUB_BUCKET_BITS = 5;
+        static const unsigned int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+        static const unsigned int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        LatencyHistogram();
+
+        void Record(uint64_t value) {
+            mBuckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+            mCount.fetch_add(1, std::memory_order_relaxed);
+            mTotal.fetch_add(value, std::memory_order_relaxed);
+
+            uint64_t min = mMin.load(std::memory_order_relaxed);
+            while(value < min && !mMin.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+            }
+
+            uint64_t max = mMax.load(std::memory_order_relaxed);
+            while(value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+            }
+        }
+
+        void Reset();
+
+        uint64_t GetCount() const {
+            return mCount.load(std::memory_order_relaxed);
+        }
+
+        uint64_t GetTotal() const {
+            return mTotal.load(std::memory_order_relaxed);
+        }
+
+        uint64_t GetMin() const {
+            return (GetCount() > 0) ? mMin.load(std::memory_order_relaxed) : 0;
+        }
+
+        uint64_t GetMax() const {
+            return mMax.load(std::memory_order_relaxed);
+        }
+
+        double GetMean() const {
+            return (GetCount() > 0) ? static_cast<double>(GetTotal()) / static_cast<double>(GetCount()) : 0.0;
+        }
+
+        /**
+         *  Get the value at a percentile in [0, 100], as the highest value in its bucket
+         */
+        uint64_t GetPercentile(double percentile) const;
+
+        uint64_t GetBucketCount(unsigned int bucket) const {
+            return mBuckets[bucket].load(std::memory_order_relaxed);
+        }
+
+        /**
+         *  Get the bucket a value is counted in, and the range of values counted in a bucket
+         */
+        static unsigned int GetBucket(uint64_t value) {
+            if(value < SUB_BUCKET_COUNT) {
+                return static_cast<unsigned int>(value);
+            }
+
+            unsigned int exponent = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+            return (exponent + 1) * SUB_BUCKET_COUNT + static_cast<unsigned int>((value >> exponent) - SUB_BUCKET_COUNT);
+        }
+
+        static uint64_t GetBucketLowest(unsigned int bucket);
+        static uint64_t GetBucketHighest(unsigned int bucket);
+
+        private:
+        std::atomic<uint64_t> mBuckets[BUCKET_COUNT];
+        std::atomic<uint64_t> mCount;
+        std::atomic<uint64_t> mTotal;
+        std::atomic<uint64_t> mMin;
+        std::atomic<uint64_t> mMax;
+    };
+
+    /**
+     *  Times the phases of each simulated tick and each route query, and counts the work they do
+     *
+     *  The profiler is always recording, at the cost of reading the monotonic clock a few times a tick.
+     *  Summarize() prints a table of the latencies of each phase, and Write() dumps them as JSON, with every
+     *  non empty histogram bucket so that the distributions can be rebuilt exactly.
+     */
+    class Profiler {
+        public:
+        /**
+         *  The phases timed
+         *  TICK is the whole of each simulated tick
+         *  UPDATE_RAIL_NETWORK, CONDUCT_TRAINS and REMOVE_FINISHED_TRAINS are the parts of each tick
+         *  CHECK_TRAIN_COLLISION is a single train's collision check, timed on every train in one of every
+         *                        COLLISION_SAMPLE_INTERVAL ticks, as the checks are part of CONDUCT_TRAINS
+         *  ROUTE_QUERY is a single search for a train's path, on whichever thread ran it
+         */
+        typedef enum {
+            TICK,
+            UPDATE_RAIL_NETWORK,
+            CONDUCT_TRAINS,
+            CHECK_TRAIN_COLLISION,
+            REMOVE_FINISHED_TRAINS,
+            ROUTE_QUERY,
+            PHASE_COUNT
+        } Phase;
+
+        typedef enum {
+            TICKS,              // Ticks simulated
+            SKIPPED_TICKS,      // Ticks skipped over in EVENT mode
+            ROUTE_QUERIES,
+            NODES_SETTLED,      // Nodes settled by the route queries
+            CACHE_HITS,         // Paths found in the path cache
+            TRAINS_STOPPED,     // Times a train came to a stop
+            TRAVERSALS,         // Times a train moved on to another component
+            TRAINS_FINISHED,
+            COUNTER_COUNT
+        } Counter;
+
+        static const unsigned int COLLISION_SAMPLE_INTERVAL = 64;
+
+        Profiler();
+
+        static const char* PrintPhase(Phase phase);
+        static const char* PrintCounter(Counter counter);
+
+        /**
+         *  Get the time on the monotonic clock, in nanoseconds
+         */
+        static uint64_t Now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+         *  Records the time from its construction to its destruction against a phase
+         */
+        class ScopedTimer {
+            public:
+            ScopedTimer(Profiler& profiler, Phase phase) : mProfiler(profiler), mPhase(phase), mStart(Now()) {
+            }
+
+            ~ScopedTimer() {
+                mProfiler.Record(mPhase, Now() - mStart);
+            }
+
+            private:
+            Profiler& mProfiler;
+            Phase mPhase;
+            uint64_t mStart;
+        };
+
+        void Record(Phase phase, uint64_t nanoseconds) {
+            mHistograms[phase].Record(nanoseconds);
+        }
+
+        void Count(Counter counter, uint64_t count = 1) {
+            mCounters[counter].fetch_add(count, std::memory_order_relaxed);
+        }
+
+        const LatencyHistogram& GetHistogram(Phase phase) const {
+            return mHistograms[phase];
+        }
+
+        uint64_t GetCounter(Counter counter) const {
+            return mCounters[counter].load(std::memory_order_relaxed);
+        }
+
+        /**
+         *  Check whether the collision checks of the tick about to be simulated should be timed
+         */
+        bool IsCollisionSample() const {
+            return GetCounter(TICKS) % COLLISION_SAMPLE_INTERVAL == 0;
+        }
+
+        /**
+         *  Clear every histogram and counter
+         */
+        void Reset();
+
+        /**
+         *  Print the counters, and the count, mean, percentiles and maximum of each phase
+         */
+        void Summarize(FILE* out) const;
+
+        /**
+         *  Write the counters and histograms as JSON
+         *
+         *  @return false if the file could not be written
+         */
+        bool Write(const std::string& path) const;
+
+        private:
+        LatencyHistogram mHistograms[PHASE_COUNT];
+        std::atomic<uint64_t> mCounters[COUNTER_COUNT];
+    };
+
+}
+
+#endif
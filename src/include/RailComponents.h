@@ -2,10 +2,11 @@
 #define RailComponents_H
 
 #include "interfaces/IRailComponent.h"
+#include "Arena.h"
 
 #include <string>
 #include <set>
-#include <map>
+#include <vector>
 
 namespace Rail {
     /**
@@ -62,6 +63,10 @@ namespace Rail {
         virtual bool Select(const ISegment* s1, const ISegment* s2);
         virtual void Fix(ISegment* src);
 
+        virtual std::pair<const ISegment*, const ISegment*> GetSelected() const {
+            return mSelectedSegments;
+        }
+
         private:
         std::string mName = "";
 
@@ -105,8 +110,9 @@ namespace Rail {
         std::string mName = "";
         unsigned int mLength = 0;
 
-        std::map<Direction, IConnector*> mConnectorMap;
-        std::map<Direction, Signal> mSignalMap;
+        // Indexed by direction
+        IConnector* mConnectors[2] = {nullptr, nullptr};
+        Signal mSignals[2];
     };
 
     /**
@@ -130,32 +136,81 @@ namespace Rail {
         ISegment* mConnectedSegment = nullptr;
     };
 
+    /**
+     * Creates each component in its own heap allocation
+     */
     class ComponentFactory : public IComponentFactory {
         public: 
         
         ComponentFactory() {}
-        virtual ~ComponentFactory() {}
+        virtual ~ComponentFactory();
 
         /**
          * Create a new Segment
          */
-        virtual ISegment* NewSegment(const std::string& name, unsigned int length) const {
-            return new Segment(name, length);
+        virtual ISegment* NewSegment(const std::string& name, unsigned int length) {
+            mSegments.push_back(new Segment(name, length));
+            return mSegments.back();
         }
 
         /**
          * Create a new Connector
          */
-        virtual IConnector* NewConnector(const std::string& name) const {
-            return new Connector(name);
+        virtual IConnector* NewConnector(const std::string& name) {
+            mConnectors.push_back(new Connector(name));
+            return mConnectors.back();
         }
 
         /**
          * Create a new Terminator
          */
-        virtual IConnector* NewTerminator(const std::string& name) const {
-            return new Terminator(name);
+        virtual IConnector* NewTerminator(const std::string& name) {
+            mTerminators.push_back(new Terminator(name));
+            return mTerminators.back();
         }
+
+        private:
+        std::vector<Segment*> mSegments;
+        std::vector<Connector*> mConnectors;
+        std::vector<Terminator*> mTerminators;
+    };
+
+    /**
+     * Creates components contiguously in a slab arena per type, so that building a large network makes
+     * few allocations, components of a type are close together in memory, and the whole network is
+     * released at once
+     */
+    class ArenaComponentFactory : public IComponentFactory {
+        public:
+
+        ArenaComponentFactory() {}
+        virtual ~ArenaComponentFactory() {}
+
+        /**
+         * Create a new Segment
+         */
+        virtual ISegment* NewSegment(const std::string& name, unsigned int length) {
+            return mSegments.New(name, length);
+        }
+
+        /**
+         * Create a new Connector
+         */
+        virtual IConnector* NewConnector(const std::string& name) {
+            return mConnectors.New(name);
+        }
+
+        /**
+         * Create a new Terminator
+         */
+        virtual IConnector* NewTerminator(const std::string& name) {
+            return mTerminators.New(name);
+        }
+
+        private:
+        Util::Arena<Segment> mSegments;
+        Util::Arena<Connector> mConnectors;
+        Util::Arena<Terminator> mTerminators;
     };
 
 } // namespace Rail
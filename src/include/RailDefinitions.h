@@ -1,6 +1,8 @@
 #ifndef RailDefinitions_H
 #define RailDefinitions_H
 
+#include <cstdint>
+
 namespace Rail {
     /**
      * Rail direction is an arbitrary conctept to outline the direction of travel within the network
@@ -55,6 +57,45 @@ namespace Rail {
                 return "Unexpected Signal State";
         }
     }
+
+    /**
+     *  Dense integer handles for components within a RailTopology
+     *
+     *  Segment ids follow the order in which segments were created in the network, and are stable
+     *  as the network grows. Connector ids cover both connectors and terminators.
+     */
+    typedef uint32_t SegmentId;
+    typedef uint32_t ConnectorId;
+
+    /**
+     *  A node is a segment travelled in a given direction, and is the vertex type used for routing.
+     *  Encoding the direction in the low bit keeps both directions of a segment adjacent in memory.
+     */
+    typedef uint32_t NodeId;
+
+    static const uint32_t INVALID_ID = UINT32_MAX;
+
+    /**
+     *  Helper functions to encode and decode nodes
+     */
+    inline NodeId MakeNode(SegmentId s, Direction d) {
+        return (s << 1) | static_cast<uint32_t>(d);
+    }
+
+    inline SegmentId NodeSegment(NodeId n) {
+        return n >> 1;
+    }
+
+    inline Direction NodeDirection(NodeId n) {
+        return (n & 1) ? Direction::DOWN : Direction::UP;
+    }
+
+    /**
+     *  The same segment, travelled in the opposite direction
+     */
+    inline NodeId ReverseNode(NodeId n) {
+        return n ^ 1;
+    }
 }
 
 #endif
@@ -2,17 +2,30 @@
 #define RailNetwork_H
 
 #include "RailComponents.h"
+#include "RailTopology.h"
+#include "NetworkState.h"
+#include "NetworkFile.h"
 
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace Rail {
     class RailNetwork {
         public:
-        RailNetwork(const IComponentFactory* f);
+        /**
+         *  @param f The factory to create components with. The network takes ownership of the factory,
+         *           and so of every component in the network
+         */
+        RailNetwork(IComponentFactory* f);
         virtual ~RailNetwork();
 
         /**
          *  Network building API
+         *
+         *  @note A network loaded in part, see LoadPartial(), cannot be built on
          */
 
         /**
@@ -55,26 +68,236 @@ namespace Rail {
          */
         IConnector* AddTerminator(ISegment* src, Direction d, const std::string& name);
 
+        /**
+         *  Network file API
+         */
+
+        /**
+         *  Load a network saved with Save() into this network, which must be empty
+         *
+         *  The file is mapped into memory and its topology used in place until the network is next changed
+         *  through the building API, so only the components themselves are created.
+         *
+         *  @return false if the file could not be loaded, in which case the network is unchanged
+         */
+        bool Load(const std::string& path);
+
+        /**
+         *  As Load(), but creating none of the components, which are created as they are needed through
+         *  LoadComponent()
+         *
+         *  The topology and the network's own state cover the whole network, so routes can be found across
+         *  all of it, but GetSegment() and GetConnector() of the topology are nullptr for the components not
+         *  yet created. Simulations on part of a network too large to create whole can share the file.
+         */
+        bool LoadPartial(const std::string& path);
+
+        /**
+         *  Whether the network was loaded in part, see LoadPartial()
+         */
+        bool IsPartial() const {
+            return mPartial;
+        }
+
+        /**
+         *  Get a component by its id within the topology, with connectors numbered after the segments,
+         *  first creating it if the network was loaded in part and it has not been created yet
+         *
+         *  A component created here is connected to those already created, and switched and signalled as in
+         *  the network's own state.
+         *
+         *  @return The component, or nullptr if the topology has no such component
+         */
+        const IComponent* LoadComponent(uint32_t component);
+
+        /**
+         *  Save the network, including the state of its switches and signals, to a file
+         *
+         *  @return false if the file could not be written, or the network was loaded in part
+         */
+        bool Save(const std::string& path);
+
+        /**
+         *  As Save(), but with the switches and signals of the given state
+         */
+        bool Save(const std::string& path, const NetworkState& state);
+
         /**
          *  Network Traversal API
+         *
+         *  The switches and signals of the network are kept in a NetworkState, apart from the topology. The
+         *  network has a state of its own, which its components mirror and which the methods without a state
+         *  act on. Any number of other states may be copied from it and switched through the methods taking
+         *  a state, which touch neither the components nor the change journal, so simulations on separate
+         *  states can share the network from several threads once its topology has been built.
+         */
+
+        /**
+         *  Get the network's own state
+         *
+         *  @note The state is taken from the components again whenever the topology is rebuilt, and any
+         *        other states must then be copied from it afresh
          */
+        NetworkState& GetState() {
+            GetTopology();
+            return mState;
+        }
 
         /**
          *  Switch the connector between the given segments so that trains traverse from src to dst
          */
         bool RouteSegment(const ISegment* src, const ISegment* dst);
 
+        /**
+         *  As RouteSegment(), but switching the connector in the given state
+         */
+        bool RouteSegment(NetworkState& state, const ISegment* src, const ISegment* dst);
+
+        /**
+         *  As RouteSegment(), but only switching the connector at the end of src facing d, for a train
+         *  travelling that way along it
+         */
+        bool RouteSegment(NetworkState& state, const ISegment* src, Direction d, const ISegment* dst);
+
+        /**
+         *  As the RouteSegment() methods taking a state, but with the segments given by their ids, so that
+         *  they need not have been created in a network loaded in part
+         */
+        bool RouteSegment(NetworkState& state, SegmentId src, SegmentId dst);
+        bool RouteSegment(NetworkState& state, SegmentId src, Direction d, SegmentId dst);
+
+        /**
+         *  Record the ids of the segments of every successful RouteSegment() from now on, or stop recording
+         *  if routes is nullptr, so that the same switching can be repeated on another copy of the network
+         */
+        void SetRouteRecorder(std::vector<std::pair<SegmentId, SegmentId>>* routes) {
+            mRouteRecorder = routes;
+        }
+
         /**
          *  Set the given signal to a specific state
          */
         void SetSignal(ISegment* segment, Direction d, SignalState state);
 
+        /**
+         *  Set the signal before the end of the given node to a specific state
+         */
+        void SetSignal(NodeId node, SignalState state) {
+            SetSignal(mSegments[NodeSegment(node)], NodeDirection(node), state);
+        }
+
+        /**
+         *  As SetSignal(), but setting the signal in the given state. The change is recorded in the state's
+         *  own change journal rather than the network's, see NetworkState::GetChangedSegments()
+         */
+        void SetSignal(NetworkState& state, NodeId node, SignalState signalState);
+
+        /**
+         *  Get the frozen topology of the network
+         *
+         *  @note The topology is rebuilt on first use after the network building API has been called
+         */
+        const RailTopology& GetTopology();
+
+        /**
+         *  Change tracking API
+         */
+
+        /**
+         *  Get the current epoch of the network. The epoch advances whenever segments, connectors
+         *  or signals are added or changed. Switching connectors through RouteSegment is not tracked
+         */
+        uint64_t GetEpoch() const {
+            return mEpoch;
+        }
+
+        /**
+         *  Get the segments that have changed since the given epoch
+         *
+         *  A change to a connector is recorded against every segment attached to it.
+         *
+         *  @param epoch An epoch previously returned by GetEpoch()
+         *  @param changed Receives the ids of the changed segments, possibly with duplicates
+         *  @return false if the changes are too old to have been kept, in which case
+         *          every segment should be treated as changed
+         */
+        bool GetChangedSegments(uint64_t epoch, std::vector<SegmentId>& changed) const;
+
         private:
-        const IComponentFactory* mComponentFactory;
+        /**
+         *  Switch a connector in the given state for RouteSegment()
+         *
+         *  @param ends The ends of src to try, in order
+         *  @return The connector switched, or INVALID_ID if the segments do not meet at a connector
+         */
+        ConnectorId route(NetworkState& state, SegmentId src, SegmentId dst, std::initializer_list<Direction> ends);
+
+        /**
+         *  Get the name of a segment for a message, whether or not it has been created
+         */
+        const char* getSegmentName(SegmentId s);
+
+        /**
+         *  Load a network file for Load() and LoadPartial()
+         */
+        bool load(const std::string& path, bool partial);
+
+        /**
+         *  Create a component of a network loaded in part for LoadComponent()
+         */
+        void createSegment(SegmentId s);
+        void createConnector(ConnectorId c);
+
+        /**
+         *  Connect the segment of a node to the connector at its end, both created, and switch the connector
+         *  as in the network's own state once both of its selected segments are connected
+         */
+        void connectCreated(NodeId node, ConnectorId c, IConnector* connector);
+
+        /**
+         *  Take mState from the components, once the topology matches them
+         */
+        void captureState();
+
+        /**
+         *  Record a change to the given segment in a new epoch
+         */
+        void markChanged(const ISegment* segment);
+
+        /**
+         *  Record a change to a connector, against each of its attached segments
+         */
+        void markChanged(IConnector* connector, const ISegment* attached);
+
+        IComponentFactory* mComponentFactory;
 
         std::vector<ISegment*> mSegments;
         std::vector<IConnector*> mConnectors;
         std::vector<IConnector*> mTerminators;
+
+        RailTopology mTopology;
+        bool mTopologyDirty = true;
+
+        // The network's own switches and signals, kept in step with the components while the topology is built
+        NetworkState mState;
+
+        // The file a loaded network was mapped from, which may hold the tables used by mTopology
+        std::unique_ptr<NetworkFile> mFile;
+        // Whether the network was loaded in part, so components are created from mFile as they are needed
+        bool mPartial = false;
+
+        // Change journal, holding each change made after mJournalStart in epoch order
+        struct Change {
+            uint64_t mEpoch;
+            SegmentId mSegment;
+        };
+
+        uint64_t mEpoch = 0;
+        uint64_t mJournalStart = 0;
+        std::vector<Change> mJournal;
+        Util::PointerIndex mSegmentIds;
+
+        std::vector<std::pair<SegmentId, SegmentId>>* mRouteRecorder = nullptr;
     };
 
 }
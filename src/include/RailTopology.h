@@ -0,0 +1,313 @@
+#ifndef RailTopology_H
+#define RailTopology_H
+
+#include "interfaces/IRailComponent.h"
+#include "PointerIndex.h"
+#include "NetworkState.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Rail {
+    static_assert(INVALID_ID == Util::PointerIndex::NOT_FOUND, "Lookups return INVALID_ID for unknown components");
+
+    /**
+     *  The kind of a component within a topology, which says what its id indexes, so that the hot paths
+     *  can handle the component by id rather than through its interface
+     *  UNKNOWN is a component which is not part of the topology, or has not been looked up
+     */
+    typedef enum {
+        SEGMENT,
+        CONNECTOR,
+        TERMINATOR,
+        UNKNOWN
+    } ComponentKind;
+
+    /**
+     *  A contiguous, read only range of ids within a RailTopology
+     */
+    class IdRange {
+        public:
+        IdRange(const uint32_t* first, const uint32_t* last) : mFirst(first), mLast(last) {}
+
+        const uint32_t* begin() const {
+            return mFirst;
+        }
+
+        const uint32_t* end() const {
+            return mLast;
+        }
+
+        size_t size() const {
+            return mLast - mFirst;
+        }
+
+        private:
+        const uint32_t* mFirst;
+        const uint32_t* mLast;
+    };
+
+    /**
+     *  The arrays making up a topology, see RailTopology for their layout
+     */
+    struct TopologyArrays {
+        const uint32_t* mLengths;
+        const ConnectorId* mEnds;
+        const uint8_t* mTerminatorFlags;
+        const uint32_t* mAttachmentOffsets;
+        const NodeId* mAttachments;
+        const uint32_t* mSuccessorOffsets;
+        const NodeId* mSuccessors;
+    };
+
+    /**
+     *  A frozen, compressed sparse row view of the rail network
+     *
+     *  The topology is built from the components of a RailNetwork, and stores lengths and adjacency
+     *  in contiguous arrays indexed by SegmentId, ConnectorId and NodeId. It holds no switch or signal
+     *  state, which is kept in a NetworkState, so one topology can be shared by many states.
+     *
+     *  Node n has an edge to node m when a train travelling along n can cross the connector at its end
+     *  on to m. A train cannot leave a connector along the segment it arrived from, and terminators
+     *  have no outgoing edges. Each edge costs the length of its target segment.
+     */
+    class RailTopology {
+        public:
+        RailTopology();
+        ~RailTopology();
+
+        /**
+         *  Rebuild the topology from the given network components
+         *
+         *  @param segments The segments of the network, in SegmentId order
+         *  @param connectors The connectors of the network
+         *  @param terminators The terminators of the network, numbered after the connectors
+         */
+        void Build(const std::vector<ISegment*>& segments,
+                   const std::vector<IConnector*>& connectors,
+                   const std::vector<IConnector*>& terminators);
+
+        /**
+         *  Use arrays held elsewhere, such as in a mapped network file, as the topology of the given
+         *  components rather than building it from them
+         *
+         *  @param arrays The topology of the components, which must outlive this topology or its next rebuild
+         *  @note Any of the components may be nullptr, to be given to the topology later if needed
+         */
+        void Attach(const TopologyArrays& arrays,
+                    const std::vector<ISegment*>& segments,
+                    const std::vector<IConnector*>& connectors,
+                    const std::vector<IConnector*>& terminators);
+
+        /**
+         *  Give the topology a component it was attached without, see RailNetwork::LoadComponent()
+         */
+        void SetSegment(SegmentId s, ISegment* segment);
+        void SetConnector(ConnectorId c, IConnector* connector);
+
+        /**
+         *  Get the arrays making up the topology, for example to save them
+         */
+        const TopologyArrays& GetArrays() const {
+            return mArrays;
+        }
+
+        /**
+         *  Get the version of this build of the topology, so that derived data can tell when it needs to
+         *  be rebuilt
+         *
+         *  Versions are unique among every topology built in the process, not only this one, so derived
+         *  data kept for a topology which has been destroyed never matches another built at its address.
+         *  A topology which has not been built has version 0
+         */
+        uint64_t GetVersion() const {
+            return mVersion;
+        }
+
+        size_t GetSegmentCount() const {
+            return mSegments.size();
+        }
+
+        size_t GetConnectorCount() const {
+            return mConnectors.size();
+        }
+
+        size_t GetNodeCount() const {
+            return mSegments.size() * 2;
+        }
+
+        /**
+         *  Look up the id of a component
+         *
+         *  @return The id of the component, or INVALID_ID if it is not a segment (connector) of this topology
+         */
+        SegmentId LookupSegment(const IComponent* component) const;
+        ConnectorId LookupConnector(const IComponent* component) const;
+
+        /**
+         *  Look up the id and kind of any component
+         *
+         *  @return The id of the component, or INVALID_ID with a kind of UNKNOWN if it is not part of this topology
+         */
+        uint32_t Lookup(const IComponent* component, ComponentKind& kind) const;
+
+        /**
+         *  Get the component for a given id, which is nullptr if the topology was attached without it
+         */
+        const ISegment* GetSegment(SegmentId s) const {
+            return mSegments[s];
+        }
+
+        IConnector* GetConnector(ConnectorId c) const {
+            return mConnectors[c];
+        }
+
+        /**
+         *  Get the component for an id of the given kind, or nullptr for INVALID_ID
+         */
+        const IComponent* GetComponent(uint32_t id, ComponentKind kind) const {
+            if(id == INVALID_ID) {
+                return nullptr;
+            }
+
+            return (kind == ComponentKind::SEGMENT) ? static_cast<const IComponent*>(mSegments[id]) : mConnectors[id];
+        }
+
+        /**
+         *  Get the length of a segment
+         */
+        unsigned int GetLength(SegmentId s) const {
+            return mArrays.mLengths[s];
+        }
+
+        /**
+         *  Get the connector at the far end of a node, or INVALID_ID if the segment is unconnected
+         */
+        ConnectorId GetEnd(NodeId n) const {
+            return mArrays.mEnds[n];
+        }
+
+        bool IsTerminator(ConnectorId c) const {
+            return mArrays.mTerminatorFlags[c] != 0;
+        }
+
+        /**
+         *  Get the nodes which end at the given connector
+         */
+        IdRange GetAttachments(ConnectorId c) const {
+            return IdRange(mArrays.mAttachments + mArrays.mAttachmentOffsets[c],
+                           mArrays.mAttachments + mArrays.mAttachmentOffsets[c + 1]);
+        }
+
+        /**
+         *  Get the position of a segment among the attachments of a connector
+         *
+         *  @return The position, or NetworkState::NO_SELECTION if the segment does not end at the connector
+         */
+        uint16_t FindAttachment(ConnectorId c, SegmentId s) const;
+
+        /**
+         *  Get the nodes a train travelling along n can continue on to
+         */
+        IdRange GetSuccessors(NodeId n) const {
+            return IdRange(mArrays.mSuccessors + mArrays.mSuccessorOffsets[n],
+                           mArrays.mSuccessors + mArrays.mSuccessorOffsets[n + 1]);
+        }
+
+        /**
+         *  Traverse from the end of a node with the switches and signals of the given state, as
+         *  IComponent::Traverse() does with those of the components
+         *
+         *  @param kind Receives the kind of the component moved on to, SEGMENT or TERMINATOR
+         *  @return The id of the segment or terminator the train moves on to, the node's own segment if a red
+         *          signal holds it, or INVALID_ID if the connector at its end is not switched for it
+         */
+        uint32_t Traverse(const NetworkState& state, NodeId n, ComponentKind& kind) const {
+            const SegmentId s = NodeSegment(n);
+            if(state.GetSignal(n) == SignalState::RED) {
+                return blocked(n, kind);
+            }
+
+            const ConnectorId c = mArrays.mEnds[n];
+            if(c == INVALID_ID) {
+                return crashed(n, kind);
+            }
+
+            // A terminator only has the one segment attached, so is always switched for it
+            if(mArrays.mTerminatorFlags[c] != 0) {
+                kind = ComponentKind::TERMINATOR;
+                return c;
+            }
+
+            // Connectors are traversed based on the arriving segment, not direction
+            const NodeId* attachments = mArrays.mAttachments + mArrays.mAttachmentOffsets[c];
+            const uint16_t first = state.GetSelection(c, 0);
+            const uint16_t second = state.GetSelection(c, 1);
+
+            uint16_t target = NetworkState::NO_SELECTION;
+            if(first != NetworkState::NO_SELECTION && NodeSegment(attachments[first]) == s) {
+                target = second;
+            } else if(second != NetworkState::NO_SELECTION && NodeSegment(attachments[second]) == s) {
+                target = first;
+            }
+
+            if(target == NetworkState::NO_SELECTION) {
+                return crashed(n, kind);
+            }
+
+            kind = ComponentKind::SEGMENT;
+            return NodeSegment(attachments[target]);
+        }
+
+        /**
+         *  As Traverse(), but returning the component itself, or nullptr if the train crashes
+         */
+        const IComponent* Traverse(const NetworkState& state, NodeId n) const {
+            ComponentKind kind;
+            uint32_t id = Traverse(state, n, kind);
+            return GetComponent(id, kind);
+        }
+
+        private:
+        /**
+         *  The outcomes of Traverse() which are logged, kept out of line
+         */
+        uint32_t blocked(NodeId n, ComponentKind& kind) const;
+        uint32_t crashed(NodeId n, ComponentKind& kind) const;
+
+        /**
+         *  Set the component handles and reverse lookups
+         */
+        void setComponents(const std::vector<ISegment*>& segments,
+                           const std::vector<IConnector*>& connectors,
+                           const std::vector<IConnector*>& terminators);
+
+        uint64_t mVersion = 0;
+
+        // Component handles, indexed by id
+        std::vector<const ISegment*> mSegments;
+        std::vector<IConnector*> mConnectors;
+
+        Util::PointerIndex mSegmentIds;
+        Util::PointerIndex mConnectorIds;
+
+        // The arrays in use, which point either into the storage below or at attached arrays
+        TopologyArrays mArrays = {};
+
+        // Storage for a built topology
+        // Per segment and per node data
+        std::vector<uint32_t> mLengths;
+        std::vector<ConnectorId> mEnds;
+
+        // Per connector data
+        std::vector<uint8_t> mTerminatorFlags;
+        std::vector<uint32_t> mAttachmentOffsets;
+        std::vector<NodeId> mAttachments;
+
+        // Node adjacency
+        std::vector<uint32_t> mSuccessorOffsets;
+        std::vector<NodeId> mSuccessors;
+    };
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef ScenarioRunner_H
+#define ScenarioRunner_H
+
+#include "TrainSimulator.h"
+#include "RailNetwork.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Train {
+
+    /**
+     *  A train of a scenario, by the ids of its components within the network's topology
+     */
+    struct ScenarioTrain {
+        std::string mName;
+        Rail::SegmentId mStart;
+        Rail::Direction mDirection;
+        Rail::ConnectorId mDestination;
+        // The tick the train is added to the simulation at
+        uint64_t mDeparture;
+    };
+
+    /**
+     *  A signal a scenario sets before it starts, as the node the signal is before the end of
+     */
+    struct ScenarioSignal {
+        Rail::NodeId mNode;
+        Rail::SignalState mState;
+    };
+
+    /**
+     *  One variant of a simulation on the shared network
+     */
+    struct Scenario {
+        std::string mName;
+        std::vector<ScenarioTrain> mTrains;
+        std::vector<ScenarioSignal> mSignals;
+        // The simulation is stopped at this tick, with any trains still running counted as unfinished
+        uint64_t mTickLimit = UINT64_MAX;
+    };
+
+    /**
+     *  The outcome of a scenario
+     */
+    struct ScenarioResult {
+        // What Simulator::ValidateResults() returned
+        bool mValid = false;
+        size_t mSucceeded = 0;
+        size_t mCrashed = 0;
+        size_t mUnfinished = 0;
+        uint64_t mTicks = 0;
+        // Totals over every train
+        uint64_t mDistance = 0;
+        uint64_t mStoppedTime = 0;
+        double mSeconds = 0.0;
+    };
+
+    /**
+     *  Runs many scenarios on the same network, concurrently
+     *
+     *  The network is loaded once from a network file and shared read only between the threads. Scenarios
+     *  are handed out to the threads one at a time, so that long scenarios do not hold up the short ones.
+     *  Each scenario copies the switches and signals saved in the file into a Rail::NetworkState of its
+     *  own, and runs in a Simulator of its own on that state, so the results of a scenario do not depend on
+     *  the thread count or on the scenarios run before it.
+     *
+     *  The messages scenarios log are discarded, as they would interleave.
+     */
+    class ScenarioRunner {
+        public:
+        /**
+         *  @param threadCount The number of threads to run scenarios on, including the caller
+         */
+        ScenarioRunner(unsigned int threadCount);
+        ~ScenarioRunner();
+
+        /**
+         *  Load the network the scenarios run on
+         *
+         *  @return false if the file could not be loaded
+         */
+        bool Load(const std::string& path);
+
+        /**
+         *  Get the topology of the network, for the ids scenarios use
+         */
+        const Rail::RailTopology& GetTopology() {
+            return mNetwork->GetTopology();
+        }
+
+        /**
+         *  Get the switches and signals the network was saved with, which each scenario starts from
+         */
+        const Rail::NetworkState& GetState() {
+            return mNetwork->GetState();
+        }
+
+        /**
+         *  Run every scenario, and wait for them all to finish
+         *
+         *  @param results Receives the result of each scenario, in the order of the scenarios
+         */
+        void Run(const std::vector<Scenario>& scenarios, std::vector<ScenarioResult>& results);
+
+        /**
+         *  Print a table of the result of each scenario, followed by their totals
+         */
+        static void PrintResults(FILE* out, const std::vector<Scenario>& scenarios,
+                                 const std::vector<ScenarioResult>& results);
+
+        private:
+        /**
+         *  Run a scenario on a copy of the given state
+         */
+        ScenarioResult runScenario(const Rail::NetworkState& initial, const Scenario& scenario);
+
+        Util::ThreadPool mThreadPool;
+        std::unique_ptr<Rail::RailNetwork> mNetwork;
+    };
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef SearchSpace_H
+#define SearchSpace_H
+
+#include "interfaces/IRoutingEngine.h"
+
+#include <algorithm>
+
+namespace Traffic {
+
+    /**
+     *  An entry in the search queue, a node and the priority it was queued with
+     */
+    class QueueEntry {
+        public:
+        QueueEntry(unsigned int priority, Rail::NodeId vertex) :
+            mPriority(priority), mVertex(vertex) {}
+
+        /**
+         *  Orders the search queue as a min-heap on priority. Ties are broken on vertex so that
+         *  the search is independent of the order in which entries were pushed
+         */
+        struct Compare {
+            bool operator()(const QueueEntry& below, const QueueEntry& above) const {
+                return (below.mPriority != above.mPriority) ?
+                    below.mPriority > above.mPriority : below.mVertex > above.mVertex;
+            }
+        };
+
+        unsigned int mPriority;
+        Rail::NodeId mVertex;
+    };
+
+    /**
+     *  Scratch state for a single source shortest path search over a RailTopology
+     *
+     *  Distances, predecessors and the search queue are indexed by NodeId and reused between
+     *  queries. An entry is only valid for the current search when its stamp matches mStamp,
+     *  so Reset() does not need to touch the arrays.
+     */
+    class SearchSpace {
+        public:
+        SearchSpace() {}
+        ~SearchSpace() {}
+
+        /**
+         *  Prepare for a new search over a topology with the given number of nodes
+         */
+        void Reset(size_t nodeCount);
+
+        /**
+         *  Get the shortest known distance to the end of a node, or UINT32_MAX if it has not been reached
+         */
+        unsigned int GetDistance(Rail::NodeId node) const {
+            return (mStamps[node] == mStamp) ? mDistances[node] : UINT32_MAX;
+        }
+
+        Rail::NodeId GetPredecessor(Rail::NodeId node) const {
+            return mPredecessors[node];
+        }
+
+        bool IsSettled(Rail::NodeId node) const {
+            return mSettledStamps[node] == mStamp;
+        }
+
+        void Settle(Rail::NodeId node) {
+            mSettledStamps[node] = mStamp;
+        }
+
+        /**
+         *  Record a shorter distance to a node and queue it
+         *
+         *  @param node The node that has been reached
+         *  @param distance The new distance to the end of the node
+         *  @param predecessor The node it was reached from, or INVALID_ID for the start node
+         *  @param priority The priority to queue the node with
+         */
+        void Update(Rail::NodeId node, unsigned int distance, Rail::NodeId predecessor, unsigned int priority) {
+            mDistances[node] = distance;
+            mPredecessors[node] = predecessor;
+            mStamps[node] = mStamp;
+
+            mQueue.push_back(QueueEntry(priority, node));
+            std::push_heap(mQueue.begin(), mQueue.end(), QueueEntry::Compare());
+        }
+
+        bool Empty() const {
+            return mQueue.empty();
+        }
+
+        /**
+         *  Get the lowest priority in the queue, which must not be empty
+         */
+        unsigned int TopPriority() const {
+            return mQueue.front().mPriority;
+        }
+
+        /**
+         *  Remove and return the queue entry with the lowest priority
+         */
+        QueueEntry Pop() {
+            std::pop_heap(mQueue.begin(), mQueue.end(), QueueEntry::Compare());
+            QueueEntry top = mQueue.back();
+            mQueue.pop_back();
+            return top;
+        }
+
+        /**
+         *  Walk the predecessors back from the given node to build a Path
+         */
+        Path BuildPath(const Rail::RailTopology& topology, Rail::NodeId last) const;
+
+        private:
+        std::vector<unsigned int> mDistances;
+        std::vector<Rail::NodeId> mPredecessors;
+        std::vector<uint32_t> mStamps;
+        std::vector<uint32_t> mSettledStamps;
+        uint32_t mStamp = 0;
+        std::vector<QueueEntry> mQueue;
+    };
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef ShardedRun_H
+#define ShardedRun_H
+
+#include "TrainSimulator.h"
+#include "NetworkPartition.h"
+#include "SharedQueue.h"
+#include "BinaryStream.h"
+#include "Log.h"
+
+#include <memory>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Train {
+
+    /**
+     *  Runs a built simulation with its network split between several processes on the same machine
+     *
+     *  The network is partitioned into one region per shard, see Rail::NetworkPartition. Each shard is a
+     *  process forked from the simulator, which runs the trains on its region. Every process works on the
+     *  network loaded in part, see Rail::RailNetwork::LoadPartial(), from the simulator's own network file if
+     *  it was restored in part, or otherwise from a copy of it. A shard creates only the components of its
+     *  region and those next to it, and the coordinator those around the connectors between regions, while
+     *  the mapped topology and the switches and signals, which are compact, cover the whole network so that
+     *  routes can be found across it. The simulator's own process coordinates the shards once per tick,
+     *  through a pair of SharedQueues to each:
+     *
+     *    - Each shard routes all of its trains in one update of its traffic controller, leaving the
+     *      connectors between regions to the coordinator with the claims of the trains on them
+     *    - Trains around a connector between regions, and any trains which might meet them within the tick,
+     *      are handed to the coordinator, which switches the connectors between regions for them, as a
+     *      single update would have, then conducts them together while the shards conduct the rest
+     *    - The coordinator hands those trains, and the connectors it switched, to the shards whose regions
+     *      they are on, and each shard reports the trains which have finished, to be taken back into the
+     *      simulator
+     *
+     *  Trains are routed and conducted, and their messages written, in the order a single process would use,
+     *  so the results and the log are those of Simulator::Run() in TICK mode, and a run which deadlocks ends
+     *  with the trains still running left in the simulator. Runs recording an event log are not supported,
+     *  and the simulator's traffic controller must not route on threads of its own.
+     */
+    class ShardedRun {
+        public:
+        ShardedRun(Simulator& simulator, unsigned int shardCount);
+        ~ShardedRun();
+
+        /**
+         *  Run the simulation until every train has finished
+         *
+         *  @return false if the shards could not be started, or a shard failed
+         */
+        bool Run();
+
+        private:
+        /**
+         *  A train handed to the coordinator, with its place in the order of the trains and its path
+         */
+        struct Handover {
+            uint32_t mOrder;
+            Train* mTrain;
+            Util::BinaryReader mPath;
+        };
+
+        /**
+         *  Load the network the shards run on, in part
+         *
+         *  @return false if the simulator's network could not be copied
+         */
+        bool loadNetwork();
+
+        /**
+         *  Mark the components around each connector between regions
+         */
+        void markBoundary(const Rail::RailTopology& topology);
+
+        /**
+         *  Create the components of the network marked, in id order, with segments first
+         */
+        void createComponents(const std::vector<uint8_t>& components);
+
+        /**
+         *  Get the shard a train on the given component belongs to, or Rail::INVALID_ID if it is off the topology
+         */
+        uint32_t getShard(const Rail::RailTopology& topology, const Rail::IComponent* component) const;
+
+        /**
+         *  Coordinate the shards until every train has finished
+         */
+        bool coordinate(const Rail::RailTopology& topology);
+
+        /**
+         *  Stop the shards, and take back the trains they still have running
+         */
+        bool stopShards();
+
+        /**
+         *  Run a shard, in its own process, until told to stop
+         */
+        bool runShard(const Rail::RailTopology& topology);
+
+        /**
+         *  Run this shard's part of a tick
+         */
+        bool tickShard(const Rail::RailTopology& topology);
+
+        /**
+         *  Hand the trains still running on this shard back to the coordinator
+         */
+        bool handBack();
+
+        /**
+         *  Write the trains of this shard which may meet a train of another shard within the tick, and
+         *  take them out of the shard
+         */
+        void takeBoundaryTrains(Util::BinaryWriter& writer, const Rail::RailTopology& topology);
+
+        /**
+         *  Get the components a running train may be on or collide on within the tick
+         */
+        void getFootprint(const Train* train, const Rail::RailTopology& topology, std::vector<uint32_t>& components);
+
+        /**
+         *  Switch the connectors for routes set in another process
+         */
+        bool applyRoutes(Util::BinaryReader& reader, const Rail::RailTopology& topology);
+
+        /**
+         *  Write running trains, each with its place in the order of the trains, followed by their paths
+         */
+        static void writeTrains(Util::BinaryWriter& writer, Simulator& simulator,
+                                const std::vector<std::pair<uint32_t, Train*>>& trains);
+
+        /**
+         *  Read trains written by writeTrains() into a simulator, with their paths, adding them to the given list
+         *
+         *  @return false if the trains are damaged
+         */
+        bool readTrains(Util::BinaryReader& reader, Simulator& simulator, std::vector<std::pair<uint32_t, Train*>>& trains);
+
+        /**
+         *  Write the messages held back by the shard, and empty its buffer
+         */
+        void writeLog(Util::BinaryWriter& writer);
+
+        /**
+         *  Run work whose messages would not have been written by a single process, such as recreating
+         *  a train which has been handed over
+         */
+        template<typename Work>
+        void quietly(Work work);
+
+        /**
+         *  Pass messages between the coordinator and a shard
+         */
+        bool sendToShard(uint32_t shard, const Util::BinaryWriter& writer);
+        bool receiveFromShard(uint32_t shard, std::vector<char>& message);
+        bool sendToCoordinator(const Util::BinaryWriter& writer);
+        bool receiveFromCoordinator(std::vector<char>& message);
+
+        Simulator& mSimulator;
+        unsigned int mShardCount;
+
+        // The network the shards run on, and the simulator which runs the trains on it in each process
+        std::unique_ptr<Rail::RailNetwork> mCopiedNetwork;
+        Rail::RailNetwork* mNetwork = nullptr;
+        std::unique_ptr<Simulator> mPart;
+
+        Rail::NetworkPartition mPartition;
+        // Whether each component, segments first, is around a connector between regions
+        std::vector<uint8_t> mBoundary;
+        // Whether each connector is between regions
+        std::vector<uint8_t> mCrossing;
+
+        std::vector<std::unique_ptr<Util::SharedQueue>> mToShards;
+        std::vector<std::unique_ptr<Util::SharedQueue>> mFromShards;
+        std::vector<pid_t> mShardPids;
+        pid_t mCoordinatorPid = 0;
+
+        // Shard state, in each shard's process
+        uint32_t mShard = 0;
+        std::unordered_map<const Train*, uint32_t> mOrders;
+        Util::LogBuffer mLog;
+        std::vector<uint8_t> mMarked;
+        std::vector<uint32_t> mMarkedList;
+        std::vector<uint8_t> mSelected;
+    };
+
+}
+
+#endif
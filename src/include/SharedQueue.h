@@ -0,0 +1,90 @@
+#ifndef SharedQueue_H
+#define SharedQueue_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <pthread.h>
+#include <vector>
+
+namespace Util {
+
+    /**
+     *  A one way queue of messages between two processes, held in memory they share
+     *
+     *  The queue is created before the process forks, after which one process sends on it and the other
+     *  receives. Messages of any size can be sent: each is streamed through the queue's buffer as the
+     *  receiver empties it, so a message larger than the buffer only needs the receiver to be reading.
+     *
+     *  Waits are bounded by checks that the other process is still alive, so that a process which has
+     *  died, even while holding the queue's lock, is not waited on forever.
+     */
+    class SharedQueue {
+        public:
+        static const size_t DEFAULT_CAPACITY = 1024 * 1024;
+
+        /**
+         *  @param capacity The size of the buffer, rounded up to a power of two
+         */
+        SharedQueue(size_t capacity = DEFAULT_CAPACITY);
+        ~SharedQueue();
+
+        /**
+         *  Check whether the shared memory for the queue could be created
+         */
+        bool IsOpen() const {
+            return mState != nullptr;
+        }
+
+        /**
+         *  Send a message, waiting for room in the buffer as needed
+         *
+         *  @param isPeerAlive Checked while waiting, whether the receiving process is still running
+         *  @return false if the receiver died before the message was sent
+         */
+        bool Send(const std::vector<char>& message, const std::function<bool()>& isPeerAlive);
+
+        /**
+         *  Receive the next message, waiting for it to be sent
+         *
+         *  @param isPeerAlive Checked while waiting, whether the sending process is still running
+         *  @return false if the sender died before the message was received
+         */
+        bool Receive(std::vector<char>& message, const std::function<bool()>& isPeerAlive);
+
+        private:
+        /**
+         *  The part of the queue in shared memory. Head and tail count every byte sent and received, and
+         *  are reduced modulo the capacity to index the buffer which follows
+         */
+        struct State {
+            pthread_mutex_t mMutex;
+            pthread_cond_t mChanged;
+            uint64_t mHead;
+            uint64_t mTail;
+        };
+
+        /**
+         *  Copy bytes into or out of the buffer, waiting on the other process as needed
+         */
+        bool write(const char* data, size_t size, const std::function<bool()>& isPeerAlive);
+        bool read(char* data, size_t size, const std::function<bool()>& isPeerAlive);
+
+        /**
+         *  Lock the queue, and wait on it for a short time. Both keep the lock if the other process died
+         *  holding it
+         *
+         *  @return false if the lock could not be taken
+         */
+        bool lock();
+        void wait();
+
+        State* mState = nullptr;
+        char* mBuffer = nullptr;
+        size_t mCapacity;
+        size_t mMappingSize = 0;
+    };
+
+}
+
+#endif
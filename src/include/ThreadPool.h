@@ -0,0 +1,61 @@
+#ifndef ThreadPool_H
+#define ThreadPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Util {
+
+    /**
+     *  A fixed size pool of worker threads for data parallel loops
+     *
+     *  The calling thread takes part in each loop as worker 0, so a pool of one thread
+     *  runs everything inline without starting any threads.
+     */
+    class ThreadPool {
+        public:
+        /**
+         *  @param threadCount The total number of threads to run loops on, including the caller
+         */
+        ThreadPool(unsigned int threadCount);
+        ~ThreadPool();
+
+        unsigned int GetThreadCount() const {
+            return mThreads.size() + 1;
+        }
+
+        /**
+         *  Call fn(index, worker) for every index in [0, count), and wait for all calls to finish
+         *
+         *  Indexes are handed out one at a time, so uneven work is balanced across the pool.
+         *  worker is in [0, GetThreadCount()) and is unique among the concurrently running calls,
+         *  so it can be used to index per-thread scratch state.
+         */
+        void ParallelFor(size_t count, const std::function<void(size_t, unsigned int)>& fn);
+
+        private:
+        void workerLoop(unsigned int worker);
+        void runTasks(unsigned int worker);
+
+        std::vector<std::thread> mThreads;
+
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+
+        // The current loop, published to the workers under mMutex
+        const std::function<void(size_t, unsigned int)>* mTask = nullptr;
+        size_t mCount = 0;
+        std::atomic<size_t> mNext;
+        unsigned int mActive = 0;
+        uint64_t mGeneration = 0;
+        bool mStopping = false;
+    };
+
+}
+
+#endif
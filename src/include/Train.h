@@ -2,13 +2,25 @@
 #define Train_H
 
 #include "interfaces/IRailComponent.h"
+#include "RailTopology.h"
+#include "NetworkState.h"
+#include "TrainStore.h"
 
 #include <string>
 
 namespace Train {
+    /**
+     *  A train in the simulation
+     *
+     *  The position and counters of the train are held in a slot of a TrainStore, which this is a handle
+     *  on, so that the simulation can update every train in bulk
+     */
     class Train {
         public:
-        Train(const std::string& name, const Rail::IComponent *startingComponent, Rail::Direction direction);
+        /**
+         *  @param store The store to hold the state of the train, which must outlive it
+         */
+        Train(TrainStore& store, const std::string& name, const Rail::IComponent *startingComponent, Rail::Direction direction);
         ~Train();
 
         /**
@@ -23,11 +35,46 @@ namespace Train {
             SUCCESS
         } State;
 
+        /**
+         *  The position, state and counters of a train between ticks, for checkpoints
+         */
+        struct Snapshot {
+            const Rail::IComponent* mComponent;
+            const Rail::IComponent* mPreviousComponent;
+            unsigned int mSegmentIndex;
+            unsigned int mPreviousSegmentIndex;
+            unsigned int mDistance;
+            unsigned int mStoppedTime;
+            Rail::Direction mDirection;
+            State mState;
+            bool mStopped;
+        };
+
+        /**
+         *  Save the state of the train
+         *
+         *  @note Trains are only saved between ticks, when none has been progressed by TrainStore::Advance()
+         */
+        Snapshot Save() const;
+
+        /**
+         *  Restore the state of the train from a snapshot
+         */
+        void Restore(const Snapshot& snapshot);
+
         /**
          *  Each call causes the train to travel along the current segment one unit
          */
         void Conduct();
 
+        /**
+         *  As Conduct(), but reads component lengths from the given network topology, and traverses with the
+         *  switches and signals of the given state rather than those of the components
+         *
+         *  @note If the train has already been progressed by TrainStore::Advance(), this only completes that
+         */
+        void Conduct(const Rail::RailTopology& topology, const Rail::NetworkState& state);
+
         /**
          *  Gets the name of the train
          */
@@ -39,21 +86,63 @@ namespace Train {
          *  Gets the state of the train
          */
         State GetState() const {
-            return mState;
+            return static_cast<State>(mStore.mStates[mSlot]);
+        }
+
+        /**
+         *  Checks whether the train failed to traverse on to the next component in its last Conduct
+         */
+        bool IsStopped() const {
+            return mStore.mStopped[mSlot] != 0;
+        }
+
+        /**
+         *  Gets the id of the current component, as found when the train was last conducted with a topology
+         *
+         *  @return The id, or INVALID_ID if the component has not been looked up or is not a segment
+         */
+        Rail::SegmentId GetSegmentId() const {
+            return (GetComponentKind() == Rail::ComponentKind::SEGMENT) ? mStore.mComponentIds[mSlot] : Rail::INVALID_ID;
+        }
+
+        /**
+         *  Gets the id and kind of the current component, as GetSegmentId() does for segments
+         */
+        uint32_t GetComponentId() const {
+            return mStore.mComponentIds[mSlot];
+        }
+
+        Rail::ComponentKind GetComponentKind() const {
+            return static_cast<Rail::ComponentKind>(mStore.mComponentKinds[mSlot]);
+        }
+
+        /**
+         *  Checks whether the train has been progressed by TrainStore::Advance() and not yet conducted, in
+         *  which case conducting it cannot move it on to another component
+         */
+        bool IsAdvanced() const {
+            return mStore.mPending[mSlot] != 0;
         }
 
         /**
          *  Reverses the direction of the train
          */
         void ReverseDirection() {
-            mDirection = Rail::ReverseDirection(mDirection);
+            mStore.mDirections[mSlot] = Rail::ReverseDirection(GetDirection());
         }
 
         /**
          *  Gets the current segment of the train
          */
         const Rail::IComponent* GetCurrentComponent() const {
-            return mCurrentComponent;
+            return mStore.mComponents[mSlot];
+        }
+
+        /**
+         *  Gets the component the train was on before its last Conduct
+         */
+        const Rail::IComponent* GetPreviousComponent() const {
+            return mStore.mPreviousComponents[mSlot];
         }
 
         /**
@@ -71,6 +160,17 @@ namespace Train {
          */
         bool CheckCollision(Train* other);
 
+        /**
+         *  Checks whether this train and another passed through each other during their last Conduct,
+         *  either along the same component or by swapping components across a connector
+         *
+         *  @param other The other train to check against, which must have been conducted in the same tick
+         *  @return true if the two trains have collided, false otherwise
+         *
+         *  @note If a collision occurs this will update this Train and other Train states accordingly to CRASHED
+         */
+        bool CheckPassThrough(Train* other);
+
         /**
          *  Gets location of train within the current component
          *   
@@ -84,6 +184,17 @@ namespace Train {
          */
         void PrintStatus() const;
 
+        /**
+         *  Gets the distance the train has travelled, and the time it has spent stopped, in units
+         */
+        unsigned int GetDistance() const {
+            return mStore.mDistances[mSlot];
+        }
+
+        unsigned int GetStoppedTime() const {
+            return mStore.mStoppedTimes[mSlot];
+        }
+
         /**
          *  Gets the destination of the train
          */
@@ -102,7 +213,7 @@ namespace Train {
          *  Gets the direction of the train
          */
         Rail::Direction GetDirection() const {
-            return mDirection;
+            return static_cast<Rail::Direction>(mStore.mDirections[mSlot]);
         }
 
         // Helper function to print train state
@@ -123,26 +234,29 @@ namespace Train {
 
         // Helper functions to handle state transitions
         void handleProgressed();
-        void handleTraversed();
+        bool handleTraversed(const Rail::IComponent* newComponent);
         void handleStopped();
+        void faceAwayFrom(const Rail::IComponent* previousComponent);
 
-        const std::string mName = "DefaultTrainName";
+        // Records the position of the train before it is conducted
+        void savePosition();
 
-        const Rail::IComponent* mCurrentComponent = nullptr;
-        const Rail::IComponent* mDestinationComponent = nullptr;
-        Rail::Direction mDirection = Rail::Direction::DOWN;
+        // Looks up the current component in the topology, if it has not been since the train moved on to it
+        void resolveComponent(const Rail::RailTopology& topology);
 
-        // Zero-based index, representing the distance of the train in to
-        // its current component in its direction of travel
-        unsigned int mSegmentIndex = 0;
+        // Records an event for this train, if its store has an event logger
+        void recordEvent(Util::EventLogger::EventType type, const Rail::IComponent* component,
+                         uint32_t arg0 = 0, uint32_t arg1 = 0);
 
-        // Tracked for logging metrics
-        // Total distance traveled by this train
-        unsigned int mDistanceTraveled = 0;
-        // Total time stopped for this train
-        unsigned int mStoppedTime = 0;
+        // As GetCurrentLocation(), but for the position before the last Conduct
+        unsigned int getPreviousLocation(Rail::Direction d) const;
+
+        const std::string mName = "DefaultTrainName";
+        const Rail::IComponent* mDestinationComponent = nullptr;
 
-        State mState = State::RUNNING;
+        // The slot holding the rest of the train's state
+        TrainStore& mStore;
+        const uint32_t mSlot;
     };
 }
 
@@ -0,0 +1,72 @@
+#ifndef TrainPool_H
+#define TrainPool_H
+
+#include "Train.h"
+#include "Arena.h"
+
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+namespace Train {
+
+    /**
+     *  Recycles the memory of retired trains for new ones
+     *
+     *  Trains are allocated in slabs, and a released train's memory is reused by the next train acquired,
+     *  so a simulation where trains continually start and finish holds a constant amount of memory.
+     */
+    class TrainPool {
+        public:
+        /**
+         *  @param store The store to hold the state of the pool's trains, which must outlive the pool
+         */
+        TrainPool(TrainStore& store) : mStore(store) {}
+
+        /**
+         *  Destroys every train still acquired from the pool
+         */
+        ~TrainPool();
+
+        TrainPool(const TrainPool&) = delete;
+        TrainPool& operator=(const TrainPool&) = delete;
+
+        /**
+         *  Create a new train, reusing the memory of a released one where possible
+         */
+        Train* Acquire(const std::string& name, const Rail::IComponent* startingComponent, Rail::Direction direction);
+
+        /**
+         *  Destroy a train acquired from this pool, and keep its memory for the next train
+         *
+         *  @note The train's address may be handed out again, so anything keyed on it must be cleared first
+         */
+        void Release(Train* train);
+
+        /**
+         *  Gets the number of trains currently acquired from the pool
+         */
+        size_t GetActiveCount() const {
+            return mActiveTrains.size();
+        }
+
+        /**
+         *  Gets the number of trains the pool has memory for
+         */
+        size_t GetCapacity() const {
+            return mStorage.GetSize();
+        }
+
+        private:
+        typedef std::aligned_storage<sizeof(Train), alignof(Train)>::type TrainStorage;
+
+        TrainStore& mStore;
+
+        Util::Arena<TrainStorage> mStorage;
+        std::vector<TrainStorage*> mFreeStorage;
+        std::unordered_set<Train*> mActiveTrains;
+    };
+
+}
+
+#endif
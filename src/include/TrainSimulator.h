@@ -2,19 +2,114 @@
 #define TrainSimulator_H
 
 #include "Train.h"
+#include "TrainPool.h"
+#include "OccupancyIndex.h"
 #include "RailNetwork.h"
+#include "NetworkGenerator.h"
+#include "NetworkPartition.h"
+#include "EventLogger.h"
+#include "Log.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 #include "interfaces/ITrafficController.h"
 
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
 namespace Train {
+    class ShardedRun;
+    class ScenarioRunner;
+
     class Simulator {
         public:
         Simulator();
+
+        /**
+         *  Simulate on a network owned by the caller, which must outlive the simulator
+         *
+         *  @param state The switches and signals to simulate with, also owned by the caller, or nullptr to
+         *               use the network's own. Simulators with states of their own may share a network
+         */
+        Simulator(Rail::RailNetwork* network, Rail::NetworkState* state = nullptr);
         ~Simulator();
 
         /**
-         *  Build a rail network and populate it with trains
+         *  How Run() advances the simulation
+         *  TICK conducts every train one unit at a time, updating the rail network every tick
+         *  EVENT jumps straight to the next tick in which a train reaches the end of its component or may
+         *        collide with another train, and gives the same results as TICK
+         */
+        typedef enum {
+            TICK,
+            EVENT
+        } RunMode;
+
+        /**
+         *  Set how subsequent calls to Run() advance the simulation
+         */
+        void SetRunMode(RunMode mode) {
+            mRunMode = mode;
+        }
+
+        /**
+         *  Set the number of threads each tick conducts trains on
+         *
+         *  With more than one thread the network is split into regions, see Rail::NetworkPartition. Trains
+         *  in regions which no train can cross between within a tick are conducted concurrently, and the
+         *  trains of each region in the order a single thread would have. Regions joined by a train
+         *  crossing between them are conducted together, so the results and the log do not depend on the
+         *  thread count. Runs recording an event log conduct trains on one thread.
+         */
+        void SetThreadCount(unsigned int threadCount);
+
+        /**
+         *  Gets the number of ticks simulated so far
+         */
+        uint64_t GetTick() const {
+            return mTick;
+        }
+
+        /**
+         *  Set whether trains which have finished are kept until ValidateResults() reports on them. If not,
+         *  each is counted and recycled as soon as it finishes, so that long runs use constant memory
+         */
+        void SetRetainFinishedTrains(bool retain) {
+            mRetainFinishedTrains = retain;
+        }
+
+        /**
+         *  Add a train to the simulation, to run from the next call to Run()
+         */
+        Train* AddTrain(const std::string& name, const Rail::IComponent* startingComponent, Rail::Direction direction);
+
+        /**
+         *  Get the profile of the runs so far, which times each phase of every simulated tick and each route
+         *  query, see Util::Profiler
+         */
+        Util::Profiler& GetProfiler() {
+            return mProfiler;
+        }
+
+        /**
+         *  Record the events of subsequent runs to a binary event log, see Util::EventLogger
+         *
+         *  @return false if the log could not be opened
+         */
+        bool SetEventLog(const std::string& path);
+
+        /**
+         *  Build a rail network and populate it with trains, from a text network file
+         *  See Rail::TextNetworkLoader for the format of the file
+         *
+         *  @return false if the file could not be read or had any errors
          */
-        void Build();
+        bool Build(const std::string& path);
+
+        /**
+         *  Build a generated rail network and populate it with the generated trains, see Rail::NetworkGenerator
+         */
+        void Generate(const Rail::NetworkGenerator::Options& options);
 
         /**
          *  Run a built simulation
@@ -22,7 +117,53 @@ namespace Train {
         void Run();
 
         /**
-         *  Validate the results of a simulation
+         *  Run a built simulation until every train has finished, or the given tick is reached. The simulation
+         *  can be continued by running it again
+         *
+         *  @note A simulation restored in part can only be run with RunSharded()
+         */
+        void RunUntil(uint64_t tick);
+
+        /**
+         *  Run a built simulation up to the given tick, passing straight over the ticks after every train has
+         *  finished, so that trains can be added to depart at that tick
+         */
+        void AdvanceTo(uint64_t tick);
+
+        /**
+         *  Run a built simulation with its network split between the given number of processes, see
+         *  ShardedRun. The results and the log are those of Run() in TICK mode
+         *
+         *  @return false if the processes could not be run, in which case the simulation is lost
+         */
+        bool RunSharded(unsigned int shardCount);
+
+        /**
+         *  Save the full state of the simulation to a checkpoint file, between runs
+         *
+         *  The checkpoint holds the network, including the state of its switches and signals, every train
+         *  which is running or has finished but not yet been validated, and the state of the traffic
+         *  controller. It is a network file, see Rail::NetworkFile, with the rest of the state appended.
+         *
+         *  @return false if the checkpoint could not be written
+         */
+        bool Checkpoint(const std::string& path);
+
+        /**
+         *  Restore a simulation from a checkpoint, to be run on from the tick it was saved at
+         *
+         *  The checkpoint's network replaces the simulation's, so the simulation must own its network, and
+         *  not have built it or added any trains yet.
+         *
+         *  @param partial Whether to create only the components the trains are on or heading for, see
+         *                 Rail::RailNetwork::LoadPartial(), so that a network too large for one process can
+         *                 be run with RunSharded(). The simulation cannot then be run otherwise, or checkpointed
+         *  @return false if the checkpoint could not be read, in which case the simulation is unchanged
+         */
+        bool Restore(const std::string& path, bool partial = false);
+
+        /**
+         *  Validate the results of a simulation, and recycle its finished trains
          */
         bool ValidateResults();
 
@@ -33,6 +174,119 @@ namespace Train {
         void RunCollisionTest();
 
         private:
+        // Runs a copy of the simulator in each of its processes, and drives them a tick at a time
+        friend class ShardedRun;
+        // Reads the trains of each scenario it runs for their results
+        friend class ScenarioRunner;
+
+        /**
+         *  A tick in which something may happen to a train, or to a pair of trains on the same component
+         *
+         *  Events hold the schedule stamps of their trains when they were scheduled, and are ignored if
+         *  either train has since been rescheduled or removed
+         */
+        struct Event {
+            uint64_t mTick;
+            Train* mTrain;
+            Train* mOther;
+            unsigned int mStamp;
+            unsigned int mOtherStamp;
+
+            bool operator>(const Event& other) const {
+                return mTick > other.mTick;
+            }
+        };
+
+        /**
+         *  The running trains from one piece of the list, sorted by the region each is on
+         */
+        struct TickChunk {
+            // Positions in the list of running trains, in order, for each region
+            std::vector<std::vector<uint32_t>> mRegionTrains;
+            // Pairs of regions joined by a train which may cross between them
+            std::vector<std::pair<uint32_t, uint32_t>> mCrossings;
+            // Components trains may move on to which have no occupancy bucket yet
+            std::vector<const Rail::IComponent*> mUnprepared;
+        };
+
+        /**
+         *  Write a train's name, destination and state, with its components as ids within the topology
+         */
+        static void writeTrain(Util::BinaryWriter& writer, const Rail::RailTopology& topology, const Train* train);
+
+        /**
+         *  Create a train from the pool as written by writeTrain(), on the network it was written from or a copy
+         *  of it, creating its components if the network was loaded in part
+         *
+         *  @return The train, or nullptr if the record is damaged
+         */
+        Train* readTrain(Util::BinaryReader& reader, Rail::RailNetwork& network);
+
+        /**
+         *  Run the simulation one tick at a time, up to the given tick
+         */
+        void runTicks(uint64_t stopTick);
+
+        /**
+         *  Run the simulation up to the given tick, skipping the ticks in which nothing can happen
+         */
+        void runEvents(uint64_t stopTick);
+
+        /**
+         *  Update the rail network, then conduct every running train by one unit
+         *
+         *  @return true if any train changed component, stopped, started or finished, which may change
+         *          how the traffic controller sets up the network
+         */
+        bool tick();
+
+        /**
+         *  Schedule the next events for a train, and for the train paired with each of the trains sharing
+         *  its component
+         */
+        void scheduleEvents(Train* train);
+
+        /**
+         *  Schedule the first tick in which two trains on the same component could collide
+         *
+         *  @param moved Whether either train has just moved on to the component, or started or stopped
+         */
+        void schedulePair(Train* train, Train* other, bool moved);
+
+        /**
+         *  Check whether an event is still valid
+         */
+        bool isCurrent(const Event& event) const;
+
+        /**
+         *  The ways in which conducting a train can change it, as flags
+         */
+        typedef enum {
+            TRAVERSED = 1,
+            STOPPED = 2,
+            STARTED = 4
+        } ConductChange;
+
+        /**
+         *  Conduct a running train, and check whether it has collided or finished
+         *
+         *  @return The ConductChange flags for the ways the train changed, or 0 if it carried on along its
+         *          component
+         */
+        unsigned int conductTrain(Train* train, const Rail::RailTopology& topology, const Rail::NetworkState& state);
+
+        /**
+         *  Count the changes to a conducted train in the profile
+         */
+        void countChanges(unsigned int changes);
+
+        /**
+         *  Conduct every running train, with the trains of separate regions on separate threads
+         *
+         *  @return false if some train is not on the topology, in which case no train has been conducted
+         */
+        bool conductTrainsParallel(const Rail::RailTopology& topology, const Rail::NetworkState& state);
+
         /**
          *  Checks to see if the train has collided with any other trains
          */
@@ -44,20 +298,76 @@ namespace Train {
         bool checkTrainSucceeded(const Train* train);
 
         /**
-         *  Removes finished trains from the running simulation
+         *  Removes finished trains from the running simulation, keeping the rest in order
          */
         void removeFinishedTrains();
 
+        /**
+         *  Take a train which has finished out of the running simulation, and count it
+         */
+        void finishTrain(Train* train);
+
+        /**
+         *  Count a finished train, and return it to the pool
+         */
+        void retireTrain(Train* train);
+
         /**
          *  Updates rail network accoring to the Traffic Controller
          */
         void updateRailNetwork();
 
+        /**
+         *  Get the switches and signals the simulation runs with
+         */
+        Rail::NetworkState& getNetworkState() {
+            return (mNetworkState != nullptr) ? *mNetworkState : mRailNetwork->GetState();
+        }
+
         Rail::RailNetwork* mRailNetwork;
+        bool mOwnsRailNetwork;
+        // The state given on construction, or nullptr for the network's own
+        Rail::NetworkState* mNetworkState;
         Traffic::ITrafficController* mTrafficController;
 
+        // Holds the state of every train created for the simulation
+        TrainStore mTrainStore;
+        TrainPool mTrainPool;
+
         std::vector<Train*> mRunningTrains;
         std::vector<Train*> mFinishedTrains;
+        bool mRetainFinishedTrains = true;
+
+        // Trains which have finished since the results were last validated
+        size_t mSucceededCount = 0;
+        size_t mCrashedCount = 0;
+
+        // The location of every running train, for collision checks
+        OccupancyIndex mOccupancy;
+
+        Util::EventLogger* mEventLogger = nullptr;
+
+        Util::Profiler mProfiler;
+        // Whether the collision checks of the current tick are timed
+        bool mSampleCollisions = false;
+
+        RunMode mRunMode = RunMode::TICK;
+        uint64_t mTick = 0;
+
+        // Event mode state
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> mEvents;
+        std::unordered_map<Train*, unsigned int> mEventStamps;
+        std::vector<Train*> mChangedTrains;
+
+        // Parallel tick state
+        Util::ThreadPool* mThreadPool = nullptr;
+        Rail::NetworkPartition mPartition;
+        std::vector<TickChunk> mChunks;
+        std::vector<uint32_t> mRegionParents;
+        std::vector<std::vector<uint32_t>> mRegionGroups;
+        std::vector<std::vector<uint32_t>> mGroupTrains;
+        std::vector<uint8_t> mChangedFlags;
+        std::vector<Util::LogBuffer> mLogBuffers;
     };
 }
 
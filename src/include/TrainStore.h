@@ -0,0 +1,104 @@
+#ifndef TrainStore_H
+#define TrainStore_H
+
+#include "interfaces/IRailComponent.h"
+#include "RailTopology.h"
+#include "EventLogger.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Train {
+    class Train;
+
+    /**
+     *  Contiguous storage for the frequently updated state of a set of trains
+     *
+     *  Each field is held in its own array, indexed by the slot a train is given when it is created, so
+     *  that per tick updates stream through memory rather than visiting each Train object in turn. A Train
+     *  is a handle on its slot, and slots are reused once their train has been destroyed.
+     */
+    class TrainStore {
+        public:
+        TrainStore() {}
+        ~TrainStore() {}
+
+        /**
+         *  Allocate a slot for a new train
+         *
+         *  @return The slot of the train
+         */
+        uint32_t Add(const Rail::IComponent* component, Rail::Direction direction);
+
+        /**
+         *  Release the slot of a destroyed train
+         */
+        void Remove(uint32_t slot);
+
+        /**
+         *  Progress every running train which is part way along its component by one unit
+         *
+         *  Trains advanced this way are pending until they are next conducted, which completes the advance
+         *  without further work. Until then they appear to other trains at their previous location, so
+         *  collisions are found exactly as if each train had been conducted in turn. Trains at the end of
+         *  their component are left for Conduct() to traverse.
+         */
+        void Advance() {
+            Advance(0, GetSlotCount());
+        }
+
+        /**
+         *  As Advance(), for the slots in [first, last) only, so that ranges of slots can be advanced
+         *  concurrently
+         */
+        void Advance(size_t first, size_t last);
+
+        /**
+         *  As calling Advance() and conducting every train the given number of times, where no train will
+         *  reach the end of its component or start moving again in that time
+         */
+        void Skip(unsigned int ticks);
+
+        size_t GetSlotCount() const {
+            return mComponents.size();
+        }
+
+        /**
+         *  Set the logger the trains in this store record their events to, or nullptr to record nothing
+         */
+        void SetEventLogger(Util::EventLogger* logger) {
+            mEventLogger = logger;
+        }
+
+        Util::EventLogger* GetEventLogger() const {
+            return mEventLogger;
+        }
+
+        private:
+        friend class Train;
+
+        std::vector<const Rail::IComponent*> mComponents;
+        // Id and kind of each component within the topology, resolved on first use
+        std::vector<uint32_t> mComponentIds;
+        std::vector<uint8_t> mComponentKinds;
+        std::vector<unsigned int> mLengths;
+        std::vector<unsigned int> mSegmentIndexes;
+        std::vector<uint8_t> mDirections;
+        std::vector<uint8_t> mStates;
+        std::vector<uint8_t> mStopped;
+        // Whether the train has been advanced by Advance(), but not yet conducted
+        std::vector<uint8_t> mPending;
+
+        std::vector<unsigned int> mDistances;
+        std::vector<unsigned int> mStoppedTimes;
+
+        std::vector<const Rail::IComponent*> mPreviousComponents;
+        std::vector<unsigned int> mPreviousSegmentIndexes;
+
+        std::vector<uint32_t> mFreeSlots;
+
+        Util::EventLogger* mEventLogger = nullptr;
+    };
+}
+
+#endif
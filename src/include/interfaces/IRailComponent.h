@@ -2,6 +2,8 @@
 #define IRailComponent_H
 
 #include <set>
+#include <string>
+#include <utility>
 
 #include "RailDefinitions.h"
 
@@ -109,29 +111,41 @@ namespace Rail {
          */
         virtual bool Select(const ISegment* s1, const ISegment* s2) = 0;
 
+        /**
+         *  Get the segments currently selected in the connector
+         *  @return The selected segments, either of which is nullptr if not yet selected
+         */
+        virtual std::pair<const ISegment*, const ISegment*> GetSelected() const = 0;
+
         /**
          *  Fix a segment in a connector. The connector must always connect to this segment
          */
         virtual void Fix(ISegment* target) = 0;
     };
 
-    // Class interface to handle dependency injection of component types
+    /**
+     *  Class interface to handle dependency injection of component types
+     *
+     *  The factory owns the components it creates, and destroys them when it is destroyed
+     */
     class IComponentFactory {
         public:
+        virtual ~IComponentFactory() {}
+
         /**
          * Create a new Segment
          */
-        virtual ISegment* NewSegment(const std::string& name, unsigned int length) const = 0;
+        virtual ISegment* NewSegment(const std::string& name, unsigned int length) = 0;
 
         /**
          * Create a new Connector
          */
-        virtual IConnector* NewConnector(const std::string& name) const = 0;
+        virtual IConnector* NewConnector(const std::string& name) = 0;
 
         /**
          * Create a new Terminator
          */
-        virtual IConnector* NewTerminator(const std::string& name) const = 0;
+        virtual IConnector* NewTerminator(const std::string& name) = 0;
     };
 }
 
@@ -0,0 +1,83 @@
+#ifndef IRoutingEngine_H
+#define IRoutingEngine_H
+
+#include "IRailComponent.h"
+#include "RailTopology.h"
+#include "NetworkState.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Traffic {
+
+    // The ids of the segments along a route, so that a route can run over segments whose components are not
+    // loaded, see Rail::RailNetwork::Load()
+    using Path = std::vector<Rail::SegmentId>;
+
+    /**
+     *  Counters describing the work done by a routing engine
+     */
+    struct RoutingStats {
+        // Number of FindPath calls
+        uint64_t mQueries = 0;
+        // Total nodes settled across all queries
+        uint64_t mNodesExplored = 0;
+        // Nodes settled by the most recent query
+        unsigned int mLastNodesExplored = 0;
+    };
+
+    class IRoutingEngine {
+        public:
+        virtual ~IRoutingEngine() {}
+
+        /**
+         *  Build any preprocessed data the engine needs for a topology, if it is not already built
+         *
+         *  @note FindPath prepares the engine itself, but this allows preprocessing to be done
+         *        up front, before the engine is cloned
+         */
+        virtual void Prepare(const Rail::RailTopology& topology) = 0;
+
+        /**
+         *  Create a new engine of the same type, with its own search state
+         *
+         *  Read only preprocessed data is shared with the clone, so a prepared engine can be cloned
+         *  once per thread and each clone used to answer queries concurrently
+         */
+        virtual IRoutingEngine* Clone() const = 0;
+
+        /**
+         *  Tell the engine which segments have changed since the last call, so that any search state
+         *  depending on their signals can be repaired rather than rebuilt
+         *
+         *  @param topology The topology of the network the changes were made to
+         *  @param changed The ids of the changed segments, possibly with duplicates
+         */
+        virtual void UpdateCosts(const Rail::RailTopology& topology, const std::vector<Rail::SegmentId>& changed) = 0;
+
+        /**
+         *  Set the state whose signals routes are costed by, or nullptr to use the signals of the components.
+         *  Clones share the state, which must outlive the engine or be replaced
+         */
+        virtual void SetState(const Rail::NetworkState* state) {}
+
+        /**
+         *  Find the shortest path from a node to a destination connector
+         *
+         *  @param topology The topology of the network to search
+         *  @param start The segment and direction the train is starting on
+         *  @param destination The connector the train needs to reach
+         *  @return The segments along the shortest path, starting with the start segment,
+         *          or an empty Path if the destination is unreachable
+         */
+        virtual Path FindPath(const Rail::RailTopology& topology, Rail::NodeId start, Rail::ConnectorId destination) = 0;
+
+        /**
+         *  Get the counters for the queries made on this engine
+         */
+        virtual const RoutingStats& GetStats() const = 0;
+    };
+
+}
+
+#endif
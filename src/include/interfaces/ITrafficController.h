@@ -4,15 +4,107 @@
 #include "IRailComponent.h"
 #include "RailNetwork.h"
 #include "Train.h"
+#include "EventLogger.h"
+#include "Profiler.h"
+#include "BinaryStream.h"
+
+#include <unordered_map>
+#include <vector>
 
 namespace Traffic {
 
+    /**
+     *  A train's claim on the connector ahead of it, to be switched from the train's segment to the next
+     *  along its path, see ITrafficController::SetSharedConnectors()
+     */
+    struct ConnectorClaim {
+        Train::Train* mTrain;
+        Rail::ConnectorId mConnector;
+        Rail::SegmentId mFrom;
+        Rail::SegmentId mTo;
+        Rail::Direction mDirection;
+        // The distance of the train from the connector
+        unsigned int mDistance;
+    };
+
     class ITrafficController {
         public:
+        virtual ~ITrafficController() {}
+
         /**
          *  Update the rail network switching and signals, based on the currently active trains
+         *
+         *  Every train is routed in each update, so the trains can be conducted straight after it
+         *
+         *  @param state The switches and signals to update, which the trains traverse with
+         *  @return true if the network was set up for every train
+         */
+        virtual bool UpdateRailNetwork(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                       const std::vector<Train::Train *>& trains) = 0;
+
+        /**
+         *  Forget any state held for a train that has left the simulation, before it is destroyed
+         */
+        virtual void RemoveTrain(Train::Train* train) {}
+
+        /**
+         *  Set the logger to record routing events to, or nullptr to record nothing
+         *
+         *  @note Events are only recorded from the thread calling UpdateRailNetwork()
+         */
+        virtual void SetEventLogger(Util::EventLogger* logger) {}
+
+        /**
+         *  Set the profiler to time route queries and count their work on, or nullptr to profile nothing
+         */
+        virtual void SetProfiler(Util::Profiler* profiler) {}
+
+        /**
+         *  Save any state which should survive a checkpoint of the simulation, such as cached paths
+         *
+         *  The state saved suits the network as it stands, so must be restored on that network, or on a copy of
+         *  it such as one loaded from the checkpoint.
+         *
+         *  @param trainIds The id of each train within the checkpoint
+         */
+        virtual void SaveState(Util::BinaryWriter& writer, Rail::RailNetwork& network,
+                               const std::unordered_map<const Train::Train*, uint32_t>& trainIds) {}
+
+        /**
+         *  Restore the state saved by SaveState(), once the network and trains have been restored
+         *
+         *  @param trains The restored trains, indexed by their id within the checkpoint
+         *  @return false if the state could not be read, in which case the controller is unchanged
+         */
+        virtual bool RestoreState(Util::BinaryReader& reader, Rail::RailNetwork& network,
+                                  const std::vector<Train::Train*>& trains) {
+            return true;
+        }
+
+        /**
+         *  Leave the given connectors to be switched by another controller, recording the claims of the
+         *  trains routed on to them rather than switching them. This lets the trains of one simulation be
+         *  routed by several controllers, each with some of the trains, see Train::ShardedRun
+         *
+         *  @param shared Whether each connector is shared, indexed by ConnectorId, or nullptr for none
+         *  @param claims Receives the claims on the shared connectors, in the order of the trains
+         */
+        virtual void SetSharedConnectors(const std::vector<uint8_t>* shared, std::vector<ConnectorClaim>* claims) {}
+
+        /**
+         *  Switch connectors for claims recorded by other controllers, as though the claiming trains had
+         *  been routed in the same update, in the order given
+         */
+        virtual void ApplyClaims(Rail::RailNetwork& network, Rail::NetworkState& state,
+                                 const std::vector<ConnectorClaim>& claims) {}
+
+        /**
+         *  Key the messages logged while routing each train in the following updates, or applying each
+         *  claim, by its position in the trains or claims given, see Util::Log::SetKey()
+         *
+         *  @param keys The key of each position, or nullptr to leave the key alone
          */
-        virtual void UpdateRailNetwork(Rail::RailNetwork& network, const std::vector<Train::Train *>& trains) = 0;
+        virtual void SetLogKeys(const std::vector<uint64_t>* keys) {}
     };
 
 }
@@ -1,11 +1,139 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "TrainSimulator.h"
+#include "Log.h"
 
 
 int main(int argc, char **argv) {
     Train::Simulator simulator;
 
+    // Optional arguments set the lowest level logged, e.g. "debug" to follow every train movement,
+    // a binary event log to record to with --event-log=<path>, and a network file to simulate in place
+    // of the test cases with --network=<path>, or a checkpoint to resume with --restore=<path>. A
+    // simulation can be checkpointed part way with --checkpoint=<path> --checkpoint-tick=<tick>, trains
+    // conducted on several threads with --threads=<count>, and the network split between several
+    // processes with --shards=<count>, each creating only its part of a restored network unless a checkpoint
+    // is taken first. --profile=<path> prints a profile of the run and writes it as JSON
+    const char* networkPath = nullptr;
+    const char* restorePath = nullptr;
+    const char* checkpointPath = nullptr;
+    const char* profilePath = nullptr;
+    uint64_t checkpointTick = 0;
+    unsigned int shardCount = 0;
+    for(int i = 1; i < argc; i++) {
+        const char* networkOption = "--network=";
+        if(strncmp(argv[i], networkOption, strlen(networkOption)) == 0) {
+            networkPath = argv[i] + strlen(networkOption);
+            continue;
+        }
+
+        const char* restoreOption = "--restore=";
+        if(strncmp(argv[i], restoreOption, strlen(restoreOption)) == 0) {
+            restorePath = argv[i] + strlen(restoreOption);
+            continue;
+        }
+
+        const char* checkpointOption = "--checkpoint=";
+        if(strncmp(argv[i], checkpointOption, strlen(checkpointOption)) == 0) {
+            checkpointPath = argv[i] + strlen(checkpointOption);
+            continue;
+        }
+
+        const char* checkpointTickOption = "--checkpoint-tick=";
+        if(strncmp(argv[i], checkpointTickOption, strlen(checkpointTickOption)) == 0) {
+            checkpointTick = strtoull(argv[i] + strlen(checkpointTickOption), nullptr, 10);
+            continue;
+        }
+
+        const char* profileOption = "--profile=";
+        if(strncmp(argv[i], profileOption, strlen(profileOption)) == 0) {
+            profilePath = argv[i] + strlen(profileOption);
+            continue;
+        }
+
+        const char* threadsOption = "--threads=";
+        if(strncmp(argv[i], threadsOption, strlen(threadsOption)) == 0) {
+            simulator.SetThreadCount(strtoul(argv[i] + strlen(threadsOption), nullptr, 10));
+            continue;
+        }
+
+        const char* shardsOption = "--shards=";
+        if(strncmp(argv[i], shardsOption, strlen(shardsOption)) == 0) {
+            shardCount = strtoul(argv[i] + strlen(shardsOption), nullptr, 10);
+            continue;
+        }
+
+        const char* eventLogOption = "--event-log=";
+        if(strncmp(argv[i], eventLogOption, strlen(eventLogOption)) == 0) {
+            if(!simulator.SetEventLog(argv[i] + strlen(eventLogOption))) {
+                return 1;
+            }
+            continue;
+        }
+
+        Util::LogLevel level;
+        if(!Util::ParseLogLevel(argv[i], level)) {
+            printf("Unknown log level %s\n", argv[i]);
+            return 1;
+        }
+        Util::Log::SetLevel(level);
+    }
+
+    if(networkPath != nullptr && restorePath != nullptr) {
+        printf("Only one of --network and --restore can be given\n");
+        return 1;
+    }
+
+    if(shardCount > 0 && networkPath == nullptr && restorePath == nullptr) {
+        printf("--shards needs a simulation from --network or --restore\n");
+        return 1;
+    }
+
+    if(profilePath != nullptr && networkPath == nullptr && restorePath == nullptr) {
+        printf("--profile needs a simulation from --network or --restore\n");
+        return 1;
+    }
+
+    if(checkpointPath != nullptr && networkPath == nullptr && restorePath == nullptr) {
+        printf("--checkpoint needs a simulation from --network or --restore\n");
+        return 1;
+    }
+
+    if(networkPath != nullptr || restorePath != nullptr) {
+        // A sharded run has no need of the whole network in this process, unless it is to be checkpointed
+        bool partial = shardCount > 0 && checkpointPath == nullptr;
+        bool ready = (networkPath != nullptr) ? simulator.Build(networkPath) : simulator.Restore(restorePath, partial);
+        if(!ready) {
+            return 1;
+        }
+
+        if(checkpointPath != nullptr) {
+            simulator.RunUntil(checkpointTick);
+            if(!simulator.Checkpoint(checkpointPath)) {
+                return 1;
+            }
+        }
+
+        if(shardCount > 0) {
+            if(!simulator.RunSharded(shardCount)) {
+                return 1;
+            }
+        } else {
+            simulator.Run();
+        }
+
+        if(profilePath != nullptr) {
+            simulator.GetProfiler().Summarize(stdout);
+            if(!simulator.GetProfiler().Write(profilePath)) {
+                printf("Could not write profile %s\n", profilePath);
+                return 1;
+            }
+        }
+        return simulator.ValidateResults() ? 0 : 1;
+    }
+
     printf("\n- TrainSimulator ready to run SimpleNetworkTest -\n");
     getchar();
 
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include "TestNetworks.h"
+
+#include <cstdio>
+
+using namespace Train;
+
+TEST(Checkpoint, RestoredPathsAreKept) {
+    std::string path = Tests::GetTemporaryPath("RestoredPaths.ckpt");
+
+    Rail::RailNetwork network(new Rail::ComponentFactory());
+    Simulator original(&network);
+    Tests::BuildPassingLoop(network, original);
+    original.RunUntil(5);
+    ASSERT_TRUE(original.Checkpoint(path));
+
+    // The trains carry on along the paths they had when the checkpoint was saved, without searching again
+    Simulator restored;
+    ASSERT_TRUE(restored.Restore(path));
+    restored.RunUntil(6);
+    EXPECT_EQ(0u, restored.GetProfiler().GetCounter(Util::Profiler::ROUTE_QUERIES));
+    EXPECT_EQ(2u, restored.GetProfiler().GetCounter(Util::Profiler::CACHE_HITS));
+
+    remove(path.c_str());
+}
+
+TEST(Checkpoint, RestoredRunContinuesIdentically) {
+    std::string start = Tests::GetTemporaryPath("RoundTripStart.ckpt");
+    std::string continued = Tests::GetTemporaryPath("RoundTripContinued.ckpt");
+    std::string restored = Tests::GetTemporaryPath("RoundTripRestored.ckpt");
+
+    Rail::RailNetwork network(new Rail::ComponentFactory());
+    Simulator original(&network);
+    Tests::BuildPassingLoop(network, original);
+    original.RunUntil(10);
+    ASSERT_TRUE(original.Checkpoint(start));
+    original.RunUntil(40);
+    ASSERT_TRUE(original.Checkpoint(continued));
+
+    Simulator copy;
+    ASSERT_TRUE(copy.Restore(start));
+    EXPECT_EQ(10u, copy.GetTick());
+    copy.RunUntil(40);
+    ASSERT_TRUE(copy.Checkpoint(restored));
+
+    // The checkpoints hold the whole state of each simulation, so match only if the runs did
+    std::string expected = Tests::ReadFile(continued);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_TRUE(expected == Tests::ReadFile(restored));
+
+    // Both runs finish the same way
+    original.Run();
+    copy.Run();
+    EXPECT_EQ(original.GetTick(), copy.GetTick());
+    EXPECT_TRUE(original.ValidateResults());
+    EXPECT_TRUE(copy.ValidateResults());
+
+    remove(start.c_str());
+    remove(continued.c_str());
+    remove(restored.c_str());
+}
+
+TEST(Checkpoint, DamagedCheckpointLeavesSimulationUnchanged) {
+    std::string path = Tests::GetTemporaryPath("Damaged.ckpt");
+    std::string damagedPath = Tests::GetTemporaryPath("Damaged.damaged.ckpt");
+
+    Rail::RailNetwork network(new Rail::ComponentFactory());
+    Simulator original(&network);
+    Tests::BuildPassingLoop(network, original);
+    original.RunUntil(5);
+    ASSERT_TRUE(original.Checkpoint(path));
+
+    // The controller's state ends the simulation state, just before the footer, with the last segment of
+    // the last path saved. Point it outside the network
+    std::string damaged = Tests::ReadFile(path);
+    const size_t footerSize = 24;
+    ASSERT_GT(damaged.size(), footerSize + sizeof(uint32_t));
+    damaged.replace(damaged.size() - footerSize - sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), '\xff');
+    FILE* file = fopen(damagedPath.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    fwrite(damaged.data(), 1, damaged.size(), file);
+    fclose(file);
+
+    // The network is read before the damage is found, but must not be kept
+    Simulator restored;
+    EXPECT_FALSE(restored.Restore(damagedPath));
+    ASSERT_TRUE(restored.Restore(path));
+    EXPECT_EQ(5u, restored.GetTick());
+
+    remove(path.c_str());
+    remove(damagedPath.c_str());
+}
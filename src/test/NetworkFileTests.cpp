@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include "TestNetworks.h"
+
+#include <cstring>
+#include <functional>
+
+using namespace Rail;
+
+namespace {
+    // The directory of sections follows the fixed part of the header, each entry an offset and a size
+    const size_t SECTION_DIRECTORY_OFFSET = 32;
+    const size_t SECTION_ENTRY_SIZE = 16;
+
+    // Ids in the passing loop, in the order it is built
+    const SegmentId WEST = 0;
+    const SegmentId MAIN = 1;
+    const SegmentId EAST = 3;
+    const ConnectorId WEST_JUNCTION = 0;
+
+    template<typename T>
+    T* getTable(std::string& file, NetworkFile::Section section) {
+        uint64_t offset = 0;
+        memcpy(&offset, file.data() + SECTION_DIRECTORY_OFFSET + section * SECTION_ENTRY_SIZE, sizeof(offset));
+        return reinterpret_cast<T*>(&file[offset]);
+    }
+
+    class NetworkFileTest : public ::testing::Test {
+        protected:
+        void SetUp() override {
+            mPath = Tests::GetTemporaryPath("NetworkFile.net");
+            mDamagedPath = Tests::GetTemporaryPath("NetworkFile.damaged.net");
+
+            RailNetwork network(new ComponentFactory());
+            Train::Simulator simulator(&network);
+            Tests::BuildPassingLoop(network, simulator);
+            ASSERT_TRUE(network.Save(mPath));
+        }
+
+        void TearDown() override {
+            remove(mPath.c_str());
+            remove(mDamagedPath.c_str());
+        }
+
+        // Whether the file still opens once damaged by the given change
+        bool opensWhenDamaged(std::function<void(std::string&)> damage) {
+            std::string file = Tests::ReadFile(mPath);
+            damage(file);
+
+            FILE* out = fopen(mDamagedPath.c_str(), "wb");
+            fwrite(file.data(), 1, file.size(), out);
+            fclose(out);
+
+            NetworkFile networkFile;
+            bool opened = networkFile.Open(mDamagedPath);
+
+            // A network is never loaded from a file which does not open
+            RailNetwork network(new ComponentFactory());
+            EXPECT_EQ(opened, network.Load(mDamagedPath));
+            return opened;
+        }
+
+        std::string mPath;
+        std::string mDamagedPath;
+    };
+}
+
+TEST_F(NetworkFileTest, UndamagedFileOpens) {
+    EXPECT_TRUE(opensWhenDamaged([](std::string&) {}));
+}
+
+TEST_F(NetworkFileTest, SelectionOfUnattachedSegmentIsRejected) {
+    EXPECT_FALSE(opensWhenDamaged([](std::string& file) {
+        getTable<SegmentId>(file, NetworkFile::SELECTIONS)[WEST_JUNCTION * 2] = EAST;
+    }));
+}
+
+TEST_F(NetworkFileTest, DuplicateAttachmentIsRejected) {
+    EXPECT_FALSE(opensWhenDamaged([](std::string& file) {
+        const uint32_t* offsets = getTable<uint32_t>(file, NetworkFile::ATTACHMENT_OFFSETS);
+        NodeId* attachments = getTable<NodeId>(file, NetworkFile::ATTACHMENTS);
+        attachments[offsets[WEST_JUNCTION] + 1] = attachments[offsets[WEST_JUNCTION]];
+    }));
+}
+
+TEST_F(NetworkFileTest, SuccessorFromAnotherConnectorIsRejected) {
+    EXPECT_FALSE(opensWhenDamaged([](std::string& file) {
+        const uint32_t* offsets = getTable<uint32_t>(file, NetworkFile::SUCCESSOR_OFFSETS);
+        NodeId* successors = getTable<NodeId>(file, NetworkFile::SUCCESSORS);
+        successors[offsets[MakeNode(WEST, Direction::UP)]] = MakeNode(EAST, Direction::UP);
+    }));
+}
+
+TEST_F(NetworkFileTest, RepeatedSuccessorIsRejected) {
+    EXPECT_FALSE(opensWhenDamaged([](std::string& file) {
+        const uint32_t* offsets = getTable<uint32_t>(file, NetworkFile::SUCCESSOR_OFFSETS);
+        NodeId* successors = getTable<NodeId>(file, NetworkFile::SUCCESSORS);
+        NodeId west = MakeNode(WEST, Direction::UP);
+        successors[offsets[west] + 1] = successors[offsets[west]];
+    }));
+}
+
+TEST_F(NetworkFileTest, TruncatedFileIsRejected) {
+    EXPECT_FALSE(opensWhenDamaged([](std::string& file) {
+        file.resize(file.size() / 2);
+    }));
+}
+
+TEST_F(NetworkFileTest, PartialLoadCreatesComponentsAsNeeded) {
+    RailNetwork full(new ComponentFactory());
+    RailNetwork partial(new ComponentFactory());
+    ASSERT_TRUE(full.Load(mPath));
+    ASSERT_TRUE(partial.LoadPartial(mPath));
+    EXPECT_TRUE(partial.IsPartial());
+
+    // The topology and the state cover the whole network, but no component is created until it is needed
+    const RailTopology& topology = partial.GetTopology();
+    ASSERT_EQ(full.GetTopology().GetSegmentCount(), topology.GetSegmentCount());
+    EXPECT_TRUE(full.GetState() == partial.GetState());
+    EXPECT_EQ(nullptr, topology.GetSegment(WEST));
+
+    // A connector is connected to its segments, and switched as in the state, whichever is created first
+    partial.LoadComponent(topology.GetSegmentCount() + WEST_JUNCTION);
+    partial.LoadComponent(MAIN);
+    const IComponent* west = partial.LoadComponent(WEST);
+    ASSERT_NE(nullptr, west);
+    EXPECT_EQ(west, partial.LoadComponent(WEST));
+    EXPECT_EQ(WEST, topology.LookupSegment(west));
+    EXPECT_STREQ("West", west->GetName());
+    EXPECT_EQ(nullptr, topology.GetSegment(EAST));
+
+    const IConnector* junction = topology.GetConnector(WEST_JUNCTION);
+    EXPECT_EQ(junction, topology.GetSegment(WEST)->GetNext(Direction::UP));
+    auto expected = full.GetTopology().GetConnector(WEST_JUNCTION)->GetSelected();
+    EXPECT_STREQ(expected.first->GetName(), junction->GetSelected().first->GetName());
+    EXPECT_STREQ(expected.second->GetName(), junction->GetSelected().second->GetName());
+
+    // Without every component, the network cannot be saved
+    EXPECT_FALSE(partial.Save(mDamagedPath));
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include "Log.h"
+#include "NetworkLoader.h"
+#include "TestNetworks.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace Rail;
+
+namespace {
+    class NetworkLoaderTest : public ::testing::Test {
+        protected:
+        void SetUp() override {
+            mPath = Tests::GetTemporaryPath("NetworkLoader.txt");
+        }
+
+        void TearDown() override {
+            remove(mPath.c_str());
+        }
+
+        void writeFile(const std::string& text) {
+            FILE* file = fopen(mPath.c_str(), "wb");
+            ASSERT_NE(nullptr, file);
+            fwrite(text.data(), 1, text.size(), file);
+            fclose(file);
+        }
+
+        // Load the file, keeping the errors logged
+        bool load(TextNetworkLoader& loader) {
+            Util::LogBuffer buffer;
+            Util::Log::Capture(&buffer);
+            bool loaded = loader.Load(mPath);
+            Util::Log::Capture(nullptr);
+
+            mErrors.clear();
+            for(size_t i = 0; i < buffer.GetSize(); i++) {
+                if(buffer.GetText(i).compare(0, 5, "ERROR") == 0) {
+                    mErrors.push_back(buffer.GetText(i));
+                }
+            }
+            return loaded;
+        }
+
+        // Whether an error was logged for the given line
+        bool hasErrorOnLine(unsigned int line) const {
+            std::string prefix = mPath + ":" + std::to_string(line) + ":";
+            for(const auto& error : mErrors) {
+                if(error.find(prefix) != std::string::npos) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::string mPath;
+        std::vector<std::string> mErrors;
+    };
+
+    // A line of segments, described back to front so that every connection names a segment defined later
+    std::string describeLine(unsigned int segmentCount) {
+        std::string text = "train T0 S0 up End\n";
+        for(unsigned int s = segmentCount - 1; s > 0; s--) {
+            text += "connect S" + std::to_string(s - 1) + " up S" + std::to_string(s) + " down\n";
+            text += "signal S" + std::to_string(s) + " up green\n";
+        }
+        text += "terminator End S" + std::to_string(segmentCount - 1) + " up\n";
+        text += "terminator Start S0 down\n";
+        for(unsigned int s = 0; s < segmentCount; s++) {
+            text += "segment S" + std::to_string(s) + " " + std::to_string(10 + s) + "\n";
+        }
+        return text;
+    }
+}
+
+TEST_F(NetworkLoaderTest, ForwardReferencesAreLinked) {
+    writeFile(describeLine(4));
+
+    RailNetwork network(new ComponentFactory());
+    TextNetworkLoader loader(network);
+    EXPECT_TRUE(load(loader));
+    EXPECT_TRUE(mErrors.empty());
+
+    ASSERT_EQ(1u, loader.GetTrains().size());
+    const TextNetworkLoader::TrainRecord& train = loader.GetTrains()[0];
+    EXPECT_STREQ("S0", train.mStart->GetName());
+    EXPECT_STREQ("End", train.mDestination->GetName());
+    EXPECT_NE(nullptr, train.mStart->GetNext(Direction::UP));
+}
+
+TEST_F(NetworkLoaderTest, KeptBackStatementsAreAppliedInFileOrder) {
+    writeFile(
+        "terminator Stop A up\n"
+        "segment A 10\n"
+        "segment B 10\n"
+        "connect A up B down\n");
+
+    RailNetwork network(new ComponentFactory());
+    TextNetworkLoader loader(network);
+    EXPECT_FALSE(load(loader));
+
+    // The terminator came first, so has the end of A and the connection is the error
+    ASSERT_EQ(1u, mErrors.size());
+    EXPECT_TRUE(hasErrorOnLine(4));
+    EXPECT_EQ(nullptr, network.GetTopology().GetSegment(1)->GetNext(Direction::DOWN));
+}
+
+TEST_F(NetworkLoaderTest, ErrorsReportTheLineOfTheStatement) {
+    writeFile(
+        "connect A up B down\n"
+        "segment A 10\n"
+        "train T0 A up Nowhere\n"
+        "segment A 20\n"
+        "segment B 10\n");
+
+    RailNetwork network(new ComponentFactory());
+    TextNetworkLoader loader(network);
+    EXPECT_FALSE(load(loader));
+
+    ASSERT_EQ(2u, mErrors.size());
+    EXPECT_TRUE(hasErrorOnLine(3));
+    EXPECT_TRUE(hasErrorOnLine(4));
+}
+
+TEST_F(NetworkLoaderTest, NetworkDoesNotDependOnChunks) {
+    writeFile(describeLine(200));
+    std::string serialPath = Tests::GetTemporaryPath("NetworkLoader.serial.net");
+    std::string parallelPath = Tests::GetTemporaryPath("NetworkLoader.parallel.net");
+
+    RailNetwork serial(new ComponentFactory());
+    TextNetworkLoader serialLoader(serial);
+    EXPECT_TRUE(load(serialLoader));
+    ASSERT_TRUE(serial.Save(serialPath));
+
+    // Chunks of a few lines each, parsed a batch at a time
+    RailNetwork parallel(new ComponentFactory());
+    TextNetworkLoader parallelLoader(parallel, 4, 64);
+    EXPECT_TRUE(load(parallelLoader));
+    ASSERT_TRUE(parallel.Save(parallelPath));
+
+    std::string expected = Tests::ReadFile(serialPath);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_TRUE(expected == Tests::ReadFile(parallelPath));
+
+    remove(serialPath.c_str());
+    remove(parallelPath.c_str());
+}
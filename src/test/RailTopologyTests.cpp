@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "RailNetwork.h"
+
+#include <memory>
+#include <new>
+
+using namespace Rail;
+
+// A line of segments between two terminators
+static void buildLine(RailNetwork& network, unsigned int segmentCount) {
+    ISegment* segment = network.CreateSegment("S0", 10);
+    network.AddTerminator(segment, Direction::DOWN, "Down");
+    for(unsigned int s = 1; s < segmentCount; s++) {
+        segment = network.AttachSegment(segment, Direction::UP, "S" + std::to_string(s), 10);
+    }
+    network.AddTerminator(segment, Direction::UP, "Up");
+}
+
+TEST(RailTopology, UnbuiltTopologyHasNoVersion) {
+    RailTopology topology;
+    EXPECT_EQ(0u, topology.GetVersion());
+}
+
+TEST(RailTopology, RebuildingChangesVersion) {
+    RailNetwork network(new ComponentFactory());
+    buildLine(network, 3);
+    uint64_t version = network.GetTopology().GetVersion();
+    EXPECT_NE(0u, version);
+
+    // Unchanged networks keep their topology
+    EXPECT_EQ(version, network.GetTopology().GetVersion());
+
+    network.CreateSegment("Extra", 5);
+    EXPECT_NE(version, network.GetTopology().GetVersion());
+}
+
+TEST(RailTopology, VersionsAreUniqueAcrossTopologies) {
+    RailNetwork first(new ComponentFactory());
+    RailNetwork second(new ComponentFactory());
+    buildLine(first, 3);
+    buildLine(second, 3);
+
+    EXPECT_NE(first.GetTopology().GetVersion(), second.GetTopology().GetVersion());
+}
+
+TEST(RailTopology, TopologyAtReusedAddressHasNewVersion) {
+    // Build two networks in turn in the same storage, so their topologies have the same address, as a
+    // network freed and reallocated may
+    alignas(RailNetwork) unsigned char storage[sizeof(RailNetwork)];
+
+    RailNetwork* network = new(storage) RailNetwork(new ComponentFactory());
+    buildLine(*network, 3);
+    const RailTopology* firstTopology = &network->GetTopology();
+    uint64_t firstVersion = firstTopology->GetVersion();
+    network->~RailNetwork();
+
+    network = new(storage) RailNetwork(new ComponentFactory());
+    buildLine(*network, 3);
+    const RailTopology* secondTopology = &network->GetTopology();
+    uint64_t secondVersion = secondTopology->GetVersion();
+    network->~RailNetwork();
+
+    EXPECT_EQ(firstTopology, secondTopology);
+    EXPECT_NE(firstVersion, secondVersion);
+}
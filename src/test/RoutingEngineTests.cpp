@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+
+#include "AltRoutingEngine.h"
+#include "ChRoutingEngine.h"
+#include "DjikstraRoutingEngine.h"
+#include "IncrementalRoutingEngine.h"
+#include "NetworkGenerator.h"
+#include "RailNetwork.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace Rail;
+
+namespace {
+    const NetworkGenerator::Layout LAYOUTS[] = {
+        NetworkGenerator::GRID, NetworkGenerator::CORRIDOR, NetworkGenerator::HUB, NetworkGenerator::PLANAR
+    };
+
+    // A line between two terminators, of segments with the given lengths
+    void buildLine(RailNetwork& network, const std::vector<unsigned int>& lengths) {
+        ISegment* segment = network.CreateSegment("S0", lengths[0]);
+        network.AddTerminator(segment, Direction::DOWN, "Down");
+        for(size_t s = 1; s < lengths.size(); s++) {
+            segment = network.AttachSegment(segment, Direction::UP, "S" + std::to_string(s), lengths[s]);
+        }
+        network.AddTerminator(segment, Direction::UP, "Up");
+    }
+
+    // Build a generated network, giving a share of its segments no length at all. The generator and the
+    // network file loaders only make segments at least a unit long, so the generated network is copied
+    void buildGenerated(RailNetwork& network, const NetworkGenerator::Options& options, double zeroLengthShare) {
+        RailNetwork generated(new ComponentFactory());
+        std::vector<TextNetworkLoader::TrainRecord> trains;
+        NetworkGenerator(options).Build(generated, trains);
+        const RailTopology& topology = generated.GetTopology();
+
+        std::mt19937 random(options.mSeed);
+        std::bernoulli_distribution zeroLength(zeroLengthShare);
+        std::vector<ISegment*> segments(topology.GetSegmentCount());
+        for(SegmentId s = 0; s < segments.size(); s++) {
+            unsigned int length = zeroLength(random) ? 0 : topology.GetLength(s);
+            segments[s] = network.CreateSegment("S" + std::to_string(s), length);
+        }
+
+        for(ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+            auto attachments = topology.GetAttachments(c);
+            NodeId first = *attachments.begin();
+            if(topology.IsTerminator(c)) {
+                network.AddTerminator(segments[NodeSegment(first)], NodeDirection(first), "T" + std::to_string(c));
+                continue;
+            }
+
+            for(auto node = attachments.begin() + 1; node != attachments.end(); node++) {
+                network.ConnectSegments(segments[NodeSegment(first)], NodeDirection(first),
+                                        segments[NodeSegment(*node)], NodeDirection(*node));
+            }
+        }
+
+        for(NodeId n = 0; n < topology.GetNodeCount(); n++) {
+            SignalState signal = generated.GetState().GetSignal(n);
+            if(signal != SignalState::DISABLED) {
+                network.AddSignal(segments[NodeSegment(n)], NodeDirection(n), signal);
+            }
+        }
+    }
+
+    // The length of a path from a start node, plus the default cost of each red signal it passes in the given
+    // state, or UINT64_MAX if there is no path
+    uint64_t getCost(const RailTopology& topology, const Traffic::Path& path, NodeId start,
+                     const NetworkState* state = nullptr) {
+        if(path.empty()) {
+            return UINT64_MAX;
+        }
+
+        uint64_t cost = topology.GetLength(path[0]);
+        NodeId node = start;
+        for(size_t i = 1; i < path.size(); i++) {
+            if(state != nullptr && state->GetSignal(node) == SignalState::RED) {
+                cost += Traffic::IncrementalRoutingEngine::DEFAULT_RED_SIGNAL_COST;
+            }
+
+            NodeId next = INVALID_ID;
+            for(auto successor : topology.GetSuccessors(node)) {
+                if(NodeSegment(successor) == path[i]) {
+                    next = successor;
+                    break;
+                }
+            }
+
+            EXPECT_NE(INVALID_ID, next) << "path does not follow the network";
+            if(next == INVALID_ID) {
+                return UINT64_MAX;
+            }
+
+            cost += topology.GetLength(path[i]);
+            node = next;
+        }
+        return cost;
+    }
+
+    // Check that each engine finds paths as short as Djikstra's from every node to every terminator
+    void expectShortestPaths(const RailTopology& topology, const std::vector<Traffic::IRoutingEngine*>& engines) {
+        Traffic::DjikstraRoutingEngine djikstra;
+        for(ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+            if(!topology.IsTerminator(c)) {
+                continue;
+            }
+
+            for(NodeId n = 0; n < topology.GetNodeCount(); n++) {
+                uint64_t expected = getCost(topology, djikstra.FindPath(topology, n, c), n);
+                for(size_t e = 0; e < engines.size(); e++) {
+                    EXPECT_EQ(expected, getCost(topology, engines[e]->FindPath(topology, n, c), n))
+                        << "engine " << e << " from node " << n << " to connector " << c;
+                }
+            }
+        }
+    }
+}
+
+TEST(ChRoutingEngine, RoutesOverZeroLengthSegments) {
+    // Every path through a run of zero length segments weighs nothing, but still needs shortcuts
+    RailNetwork network(new ComponentFactory());
+    buildLine(network, {5, 0, 0, 0, 0, 5});
+
+    Traffic::ChRoutingEngine engine;
+    expectShortestPaths(network.GetTopology(), {&engine});
+}
+
+TEST(IncrementalRoutingEngine, RoutesRoundZeroLengthLoops) {
+    // Each segment of the loop gives the other its distance, so following the distances alone goes round it
+    RailNetwork network(new ComponentFactory());
+    ISegment* start = network.CreateSegment("Start", 5);
+    ISegment* first = network.AttachSegment(start, Direction::UP, "First", 0);
+    ISegment* second = network.AttachSegment(start, Direction::UP, "Second", 0);
+    ISegment* exit = network.AttachSegment(first, Direction::UP, "Exit", 5);
+    network.ConnectSegments(second, Direction::UP, exit, Direction::DOWN);
+    network.AddTerminator(start, Direction::DOWN, "Down");
+    network.AddTerminator(exit, Direction::UP, "Up");
+
+    Traffic::IncrementalRoutingEngine engine;
+    expectShortestPaths(network.GetTopology(), {&engine});
+}
+
+TEST(RoutingEngines, FindPathsAsShortAsDjikstra) {
+    for(auto layout : LAYOUTS) {
+        for(double zeroLengthShare : {0.0, 0.3}) {
+            NetworkGenerator::Options options;
+            options.mLayout = layout;
+            options.mSegmentCount = 100;
+            options.mMinLength = 1;
+            options.mMaxLength = 20;
+            options.mSignalDensity = 0.2;
+
+            RailNetwork network(new ComponentFactory());
+            buildGenerated(network, options, zeroLengthShare);
+            const RailTopology& topology = network.GetTopology();
+
+            // Without red signals, the incremental engine's paths are the shortest too
+            Traffic::AltRoutingEngine alt;
+            Traffic::ChRoutingEngine hierarchy;
+            Traffic::IncrementalRoutingEngine incremental;
+
+            SCOPED_TRACE("layout " + std::to_string(layout) + " zero length share " + std::to_string(zeroLengthShare));
+            expectShortestPaths(topology, {&alt, &hierarchy, &incremental});
+        }
+    }
+}
+
+TEST(IncrementalRoutingEngine, UpdatedCostsMatchFreshEngine) {
+    for(auto layout : LAYOUTS) {
+        NetworkGenerator::Options options;
+        options.mLayout = layout;
+        options.mSegmentCount = 100;
+        options.mMinLength = 1;
+        options.mMaxLength = 20;
+        options.mSignalDensity = 0.4;
+        options.mRedSignalRatio = 0.3;
+
+        RailNetwork network(new ComponentFactory());
+        buildGenerated(network, options, 0.1);
+        const RailTopology& topology = network.GetTopology();
+        NetworkState state = network.GetState();
+
+        std::vector<NodeId> signals;
+        std::vector<ConnectorId> terminators;
+        for(NodeId n = 0; n < topology.GetNodeCount(); n++) {
+            if(state.GetSignal(n) != SignalState::DISABLED) {
+                signals.push_back(n);
+            }
+        }
+        for(ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+            if(topology.IsTerminator(c)) {
+                terminators.push_back(c);
+            }
+        }
+        ASSERT_FALSE(signals.empty());
+
+        Traffic::IncrementalRoutingEngine engine;
+        engine.SetState(&state);
+
+        std::mt19937 random(layout + 1);
+        for(unsigned int round = 0; round < 5; round++) {
+            // Search towards every terminator, so each change has searches to repair
+            for(ConnectorId c : terminators) {
+                for(NodeId n = 0; n < topology.GetNodeCount(); n += 7) {
+                    engine.FindPath(topology, n, c);
+                }
+            }
+
+            uint64_t epoch = state.GetEpoch();
+            for(unsigned int i = 0; i < 10; i++) {
+                NodeId node = signals[random() % signals.size()];
+                SignalState signal = (state.GetSignal(node) == SignalState::RED) ? SignalState::GREEN : SignalState::RED;
+                network.SetSignal(state, node, signal);
+            }
+
+            std::vector<SegmentId> changed;
+            ASSERT_TRUE(state.GetChangedSegments(epoch, changed));
+            engine.UpdateCosts(topology, changed);
+
+            Traffic::IncrementalRoutingEngine fresh;
+            fresh.SetState(&state);
+            for(ConnectorId c : terminators) {
+                for(NodeId n = 0; n < topology.GetNodeCount(); n++) {
+                    uint64_t expected = getCost(topology, fresh.FindPath(topology, n, c), n, &state);
+                    ASSERT_EQ(expected, getCost(topology, engine.FindPath(topology, n, c), n, &state))
+                        << "layout " << layout << " round " << round << " from node " << n << " to connector " << c;
+                }
+            }
+        }
+    }
+}
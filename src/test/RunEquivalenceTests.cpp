@@ -0,0 +1,263 @@
+#include <gtest/gtest.h>
+
+#include "Log.h"
+#include "TestNetworks.h"
+
+#include <cstdio>
+#include <random>
+
+using namespace Train;
+
+namespace {
+    /**
+     *  A simulation of its own network, so that runs of the same scenario can be compared
+     */
+    struct Scenario {
+        Rail::RailNetwork mNetwork;
+        Simulator mSimulator;
+
+        Scenario() : mNetwork(new Rail::ComponentFactory()), mSimulator(&mNetwork) {
+        }
+    };
+
+    // Build the generated network and its trains into a scenario, planned so that every train finishes
+    void buildGenerated(Scenario& scenario, Rail::NetworkGenerator::Options options) {
+        options.mConflictFree = true;
+
+        std::vector<Rail::TextNetworkLoader::TrainRecord> trains;
+        Rail::NetworkGenerator(options).Build(scenario.mNetwork, trains);
+        for(const auto& record : trains) {
+            scenario.mSimulator.AddTrain(record.mName, record.mStart, record.mDirection)->SetDestination(record.mDestination);
+        }
+    }
+
+    // Build the generated network and its trains into a scenario, then add as many again on random segments,
+    // heading for random terminators, which may meet any other train
+    void buildRandomised(Scenario& scenario, const Rail::NetworkGenerator::Options& options) {
+        buildGenerated(scenario, options);
+
+        const Rail::RailTopology& topology = scenario.mNetwork.GetTopology();
+        std::vector<const Rail::IConnector*> terminators;
+        for(Rail::ConnectorId c = 0; c < topology.GetConnectorCount(); c++) {
+            if(topology.IsTerminator(c)) {
+                terminators.push_back(topology.GetConnector(c));
+            }
+        }
+
+        std::mt19937 random(options.mSeed);
+        for(unsigned int t = 0; t < options.mTrainCount; t++) {
+            const Rail::ISegment* start = topology.GetSegment(random() % topology.GetSegmentCount());
+            Rail::Direction direction = (random() % 2) ? Rail::Direction::UP : Rail::Direction::DOWN;
+            scenario.mSimulator.AddTrain("R" + std::to_string(t), start, direction)
+                    ->SetDestination(terminators[random() % terminators.size()]);
+        }
+    }
+
+    // The checkpoint of a simulation, which holds the whole state of the simulation
+    std::string checkpoint(Simulator& simulator, const std::string& name) {
+        std::string path = Tests::GetTemporaryPath(name);
+        EXPECT_TRUE(simulator.Checkpoint(path));
+        std::string contents = Tests::ReadFile(path);
+        remove(path.c_str());
+        return contents;
+    }
+
+    // Run a simulation to the given tick, or to the end, returning the messages it logged
+    std::vector<std::string> runLogged(Simulator& simulator, uint64_t tick) {
+        Util::LogBuffer buffer;
+        Util::Log::Capture(&buffer);
+        simulator.RunUntil(tick);
+        Util::Log::Capture(nullptr);
+
+        std::vector<std::string> messages;
+        for(size_t i = 0; i < buffer.GetSize(); i++) {
+            messages.push_back(buffer.GetText(i));
+        }
+        return messages;
+    }
+
+    // Run a scenario in both modes, and expect them to be in the same state at each of the given ticks and
+    // once they have finished
+    template<typename Build>
+    void expectModesMatch(Build build, std::initializer_list<uint64_t> ticks) {
+        Scenario tick, event;
+        build(tick);
+        build(event);
+        tick.mSimulator.SetRunMode(Simulator::RunMode::TICK);
+        event.mSimulator.SetRunMode(Simulator::RunMode::EVENT);
+
+        for(uint64_t stop : ticks) {
+            tick.mSimulator.RunUntil(stop);
+            event.mSimulator.RunUntil(stop);
+            ASSERT_EQ(tick.mSimulator.GetTick(), event.mSimulator.GetTick());
+            ASSERT_TRUE(checkpoint(tick.mSimulator, "Tick.ckpt") == checkpoint(event.mSimulator, "Event.ckpt"))
+                    << "at tick " << stop;
+        }
+
+        tick.mSimulator.Run();
+        event.mSimulator.Run();
+        EXPECT_EQ(tick.mSimulator.GetTick(), event.mSimulator.GetTick());
+        EXPECT_TRUE(checkpoint(tick.mSimulator, "Tick.ckpt") == checkpoint(event.mSimulator, "Event.ckpt"));
+        EXPECT_EQ(tick.mSimulator.ValidateResults(), event.mSimulator.ValidateResults());
+    }
+}
+
+TEST(RunEquivalence, EventModeMatchesTickModeOnPassingLoop) {
+    expectModesMatch([](Scenario& scenario) { Tests::BuildPassingLoop(scenario.mNetwork, scenario.mSimulator); }, {1, 7, 30, 55});
+}
+
+TEST(RunEquivalence, EventModeMatchesTickModeOnLongSegments) {
+    for(auto layout : {Rail::NetworkGenerator::GRID, Rail::NetworkGenerator::CORRIDOR}) {
+        Rail::NetworkGenerator::Options options;
+        options.mLayout = layout;
+        options.mSegmentCount = 100;
+        options.mTrainCount = 10;
+        options.mMinLength = 200;
+        options.mMaxLength = 2000;
+        options.mSignalDensity = 0.2;
+
+        expectModesMatch([&](Scenario& scenario) { buildGenerated(scenario, options); }, {1, 250, 1999, 4000});
+    }
+}
+
+TEST(RunEquivalence, EventModeMatchesTickModeOnRandomisedCorridors) {
+    for(uint64_t seed = 1; seed <= 400; seed++) {
+        Rail::NetworkGenerator::Options options;
+        options.mLayout = Rail::NetworkGenerator::CORRIDOR;
+        options.mSeed = seed;
+        options.mSegmentCount = 40;
+        options.mTrainCount = 6;
+        options.mMinLength = 2;
+        options.mMaxLength = 30;
+        options.mSignalDensity = 0.3;
+        options.mRedSignalRatio = 0.2;
+
+        SCOPED_TRACE("seed " + std::to_string(seed));
+        expectModesMatch([&](Scenario& scenario) { buildRandomised(scenario, options); }, {3, 20});
+    }
+}
+
+TEST(RunEquivalence, ThreadedRunsMatchSerialRuns) {
+    for(auto layout : {Rail::NetworkGenerator::GRID, Rail::NetworkGenerator::PLANAR}) {
+        for(auto mode : {Simulator::RunMode::TICK, Simulator::RunMode::EVENT}) {
+            Rail::NetworkGenerator::Options options;
+            options.mLayout = layout;
+            options.mSegmentCount = 400;
+            options.mTrainCount = 40;
+            options.mMinLength = 2;
+            options.mMaxLength = 20;
+            options.mSignalDensity = 0.2;
+
+            Scenario serial, threaded;
+            buildRandomised(serial, options);
+            buildRandomised(threaded, options);
+            serial.mSimulator.SetRunMode(mode);
+            threaded.mSimulator.SetRunMode(mode);
+            threaded.mSimulator.SetThreadCount(4);
+
+            // The log is written in the same order too, whichever thread each train was conducted on
+            for(uint64_t stop : {uint64_t(10), uint64_t(40), UINT64_MAX}) {
+                std::vector<std::string> serialLog = runLogged(serial.mSimulator, stop);
+                std::vector<std::string> threadedLog = runLogged(threaded.mSimulator, stop);
+                EXPECT_FALSE(serialLog.empty());
+                EXPECT_TRUE(serialLog == threadedLog) << "layout " << layout << " mode " << mode << " tick " << stop;
+                EXPECT_TRUE(checkpoint(serial.mSimulator, "Serial.ckpt") ==
+                            checkpoint(threaded.mSimulator, "Threaded.ckpt"));
+            }
+        }
+    }
+}
+
+TEST(RunEquivalence, ShardedRunsMatchSerialRuns) {
+    // Routing messages show how each connector contended for between regions was resolved
+    Util::LogLevel routingLevel = Util::Log::GetLevel(Util::ROUTING);
+    Util::Log::SetLevel(Util::ROUTING, Util::DEBUG);
+
+    for(auto layout : {Rail::NetworkGenerator::GRID, Rail::NetworkGenerator::PLANAR, Rail::NetworkGenerator::HUB}) {
+        for(uint64_t seed = 1; seed <= 3; seed++) {
+            Rail::NetworkGenerator::Options options;
+            options.mLayout = layout;
+            options.mSeed = seed;
+            options.mSegmentCount = 300;
+            options.mTrainCount = 30;
+            options.mMinLength = 2;
+            options.mMaxLength = 20;
+            options.mSignalDensity = 0.2;
+            options.mRedSignalRatio = 0.1;
+
+            Scenario serial, sharded;
+            buildRandomised(serial, options);
+            buildRandomised(sharded, options);
+            serial.mSimulator.SetRunMode(Simulator::RunMode::TICK);
+
+            Util::LogBuffer serialBuffer, shardedBuffer;
+            Util::Log::Capture(&serialBuffer);
+            serial.mSimulator.Run();
+            bool serialValid = serial.mSimulator.ValidateResults();
+            Util::Log::Capture(&shardedBuffer);
+            bool completed = sharded.mSimulator.RunSharded(3);
+            bool shardedValid = sharded.mSimulator.ValidateResults();
+            Util::Log::Capture(nullptr);
+
+            SCOPED_TRACE("layout " + std::to_string(layout) + " seed " + std::to_string(seed));
+            ASSERT_TRUE(completed);
+            EXPECT_EQ(serialValid, shardedValid);
+            EXPECT_EQ(serial.mSimulator.GetTick(), sharded.mSimulator.GetTick());
+
+            ASSERT_EQ(serialBuffer.GetSize(), shardedBuffer.GetSize());
+            for(size_t i = 0; i < serialBuffer.GetSize(); i++) {
+                ASSERT_EQ(serialBuffer.GetText(i), shardedBuffer.GetText(i)) << "message " << i;
+            }
+        }
+    }
+
+    Util::Log::SetLevel(Util::ROUTING, routingLevel);
+}
+
+TEST(RunEquivalence, ShardedRunsRestoredInPartMatchSerialRuns) {
+    Util::LogLevel routingLevel = Util::Log::GetLevel(Util::ROUTING);
+    Util::Log::SetLevel(Util::ROUTING, Util::DEBUG);
+
+    for(auto layout : {Rail::NetworkGenerator::GRID, Rail::NetworkGenerator::PLANAR}) {
+        Rail::NetworkGenerator::Options options;
+        options.mLayout = layout;
+        options.mSegmentCount = 300;
+        options.mTrainCount = 30;
+        options.mMinLength = 2;
+        options.mMaxLength = 20;
+        options.mSignalDensity = 0.2;
+
+        // Checkpoint part way, so that the trains are spread over the network with paths set
+        Scenario scenario;
+        buildRandomised(scenario, options);
+        scenario.mSimulator.RunUntil(20);
+        std::string path = Tests::GetTemporaryPath("Partial.ckpt");
+        ASSERT_TRUE(scenario.mSimulator.Checkpoint(path));
+
+        Simulator serial, sharded;
+        ASSERT_TRUE(serial.Restore(path));
+        ASSERT_TRUE(sharded.Restore(path, true));
+        remove(path.c_str());
+
+        Util::LogBuffer serialBuffer, shardedBuffer;
+        Util::Log::Capture(&serialBuffer);
+        serial.Run();
+        bool serialValid = serial.ValidateResults();
+        Util::Log::Capture(&shardedBuffer);
+        bool completed = sharded.RunSharded(3);
+        bool shardedValid = sharded.ValidateResults();
+        Util::Log::Capture(nullptr);
+
+        SCOPED_TRACE("layout " + std::to_string(layout));
+        ASSERT_TRUE(completed);
+        EXPECT_EQ(serialValid, shardedValid);
+        EXPECT_EQ(serial.GetTick(), sharded.GetTick());
+
+        ASSERT_EQ(serialBuffer.GetSize(), shardedBuffer.GetSize());
+        for(size_t i = 0; i < serialBuffer.GetSize(); i++) {
+            ASSERT_EQ(serialBuffer.GetText(i), shardedBuffer.GetText(i)) << "message " << i;
+        }
+    }
+
+    Util::Log::SetLevel(Util::ROUTING, routingLevel);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "Log.h"
+#include "TestNetworks.h"
+
+using namespace Train;
+
+namespace {
+    const Rail::NetworkGenerator::Layout LAYOUTS[] = {
+        Rail::NetworkGenerator::GRID,
+        Rail::NetworkGenerator::CORRIDOR,
+        Rail::NetworkGenerator::HUB,
+        Rail::NetworkGenerator::PLANAR
+    };
+
+    // Whether any message logged to the buffer contains the given text
+    bool hasMessage(const Util::LogBuffer& buffer, const char* text) {
+        for(size_t i = 0; i < buffer.GetSize(); i++) {
+            if(buffer.GetText(i).find(text) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+TEST(Simulator, GeneratedTrainsAllSucceed) {
+    for(auto layout : LAYOUTS) {
+        for(uint64_t seed = 1; seed <= 4; seed++) {
+            Rail::NetworkGenerator::Options options;
+            options.mLayout = layout;
+            options.mSeed = seed;
+            options.mSegmentCount = 300;
+            options.mTrainCount = 30;
+            options.mSignalDensity = 0.2;
+            options.mConflictFree = true;
+
+            for(auto mode : {Simulator::RunMode::TICK, Simulator::RunMode::EVENT}) {
+                Simulator simulator;
+                simulator.Generate(options);
+                simulator.SetRunMode(mode);
+                simulator.Run();
+                EXPECT_TRUE(simulator.ValidateResults()) << "layout " << layout << " seed " << seed
+                                                         << " mode " << mode;
+            }
+        }
+    }
+}
+
+TEST(Simulator, RunEndsWhenEveryTrainIsStopped) {
+    Rail::RailNetwork network(new Rail::ComponentFactory());
+    Rail::ISegment* start = network.CreateSegment("Start", 10);
+    Rail::ISegment* end = network.AttachSegment(start, Rail::Direction::UP, "End", 10);
+    network.AddTerminator(start, Rail::Direction::DOWN, "TermStart");
+    Rail::IConnector* termEnd = network.AddTerminator(end, Rail::Direction::UP, "TermEnd");
+    network.AddSignal(start, Rail::Direction::UP, Rail::SignalState::RED);
+
+    for(auto mode : {Simulator::RunMode::TICK, Simulator::RunMode::EVENT}) {
+        Simulator simulator(&network);
+        simulator.AddTrain("T0", start, Rail::Direction::UP)->SetDestination(termEnd);
+        simulator.SetRunMode(mode);
+
+        Util::LogBuffer buffer;
+        Util::Log::Capture(&buffer);
+        simulator.Run();
+        Util::Log::Capture(nullptr);
+
+        EXPECT_TRUE(hasMessage(buffer, "Simulation deadlocked with 1 trains stopped")) << "mode " << mode;
+        EXPECT_FALSE(simulator.ValidateResults());
+    }
+
+    // A sharded run ends the same way, leaving the stopped train running
+    Simulator simulator(&network);
+    simulator.AddTrain("T0", start, Rail::Direction::UP)->SetDestination(termEnd);
+
+    Util::LogBuffer buffer;
+    Util::Log::Capture(&buffer);
+    EXPECT_TRUE(simulator.RunSharded(2));
+    Util::Log::Capture(nullptr);
+
+    EXPECT_TRUE(hasMessage(buffer, "Simulation deadlocked with 1 trains stopped"));
+    EXPECT_FALSE(simulator.ValidateResults());
+}
+
+TEST(Simulator, RestoredInPartOnlyRunsSharded) {
+    Rail::RailNetwork network(new Rail::ComponentFactory());
+    Simulator built(&network);
+    Tests::BuildPassingLoop(network, built);
+    std::string path = Tests::GetTemporaryPath("RestoredInPart.ckpt");
+    ASSERT_TRUE(built.Checkpoint(path));
+
+    Simulator simulator;
+    ASSERT_TRUE(simulator.Restore(path, true));
+    remove(path.c_str());
+
+    Util::LogBuffer buffer;
+    Util::Log::Capture(&buffer);
+    simulator.Run();
+    EXPECT_FALSE(simulator.Checkpoint(Tests::GetTemporaryPath("RestoredInPart.again.ckpt")));
+    Util::Log::Capture(nullptr);
+
+    EXPECT_TRUE(hasMessage(buffer, "can only be run sharded"));
+    EXPECT_EQ(0u, simulator.GetTick());
+
+    EXPECT_TRUE(simulator.RunSharded(2));
+    EXPECT_TRUE(simulator.ValidateResults());
+}
@@ -0,0 +1,70 @@
+#ifndef TestNetworks_H
+#define TestNetworks_H
+
+#include "RailNetwork.h"
+#include "TrainSimulator.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+/**
+ *  Networks and files shared between the unit tests
+ */
+namespace Tests {
+
+    /**
+     *  Get a path for a temporary file, unique to this process
+     */
+    inline std::string GetTemporaryPath(const std::string& name) {
+        return std::string(P_tmpdir) + "/TrainSimulatorTest." + std::to_string(getpid()) + "." + name;
+    }
+
+    /**
+     *  Build a network with a passing loop, and add two trains which both finish to the simulation
+     *
+     *  TermW --> West 20 --> Main 30 --> East 20 --> TermE
+     *                    \-- Loop 25 --/       \-- Branch 15 --> TermB
+     *
+     *  Express runs from West to TermE over the loop, and Freight from Main to TermB, crossing the east
+     *  junction before Express reaches it
+     */
+    inline void BuildPassingLoop(Rail::RailNetwork& network, Train::Simulator& simulator) {
+        Rail::ISegment* west = network.CreateSegment("West", 20);
+        Rail::ISegment* main = network.AttachSegment(west, Rail::Direction::UP, "Main", 30);
+        Rail::ISegment* loop = network.AttachSegment(west, Rail::Direction::UP, "Loop", 25);
+        Rail::ISegment* east = network.AttachSegment(main, Rail::Direction::UP, "East", 20);
+        network.ConnectSegments(loop, Rail::Direction::UP, east, Rail::Direction::DOWN);
+        Rail::ISegment* branch = network.CreateSegment("Branch", 15);
+        network.ConnectSegments(main, Rail::Direction::UP, branch, Rail::Direction::DOWN);
+
+        network.AddTerminator(west, Rail::Direction::DOWN, "TermW");
+        Rail::IConnector* termE = network.AddTerminator(east, Rail::Direction::UP, "TermE");
+        Rail::IConnector* termB = network.AddTerminator(branch, Rail::Direction::UP, "TermB");
+
+        simulator.AddTrain("Express", west, Rail::Direction::UP)->SetDestination(termE);
+        simulator.AddTrain("Freight", main, Rail::Direction::UP)->SetDestination(termB);
+    }
+
+    /**
+     *  Read a whole file, or return an empty string if it cannot be read
+     */
+    inline std::string ReadFile(const std::string& path) {
+        std::string contents;
+        FILE* file = fopen(path.c_str(), "rb");
+        if(file == nullptr) {
+            return contents;
+        }
+
+        char buffer[4096];
+        size_t read;
+        while((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            contents.append(buffer, read);
+        }
+
+        fclose(file);
+        return contents;
+    }
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include "DjikstraTrafficController.h"
+#include "TrainPool.h"
+
+using namespace Rail;
+
+namespace {
+    // Two segments merging at a connector on to a third, which runs on to a terminator
+    struct Merge {
+        ISegment* mLeft;
+        ISegment* mRight;
+        ISegment* mExit;
+        IConnector* mDestination;
+    };
+
+    Merge buildMerge(RailNetwork& network, const std::string& name, unsigned int leftLength, unsigned int rightLength) {
+        Merge merge;
+        merge.mLeft = network.CreateSegment(name + "Left", leftLength);
+        merge.mRight = network.CreateSegment(name + "Right", rightLength);
+        network.AddTerminator(merge.mLeft, Direction::DOWN, name + "LeftStart");
+        network.AddTerminator(merge.mRight, Direction::DOWN, name + "RightStart");
+
+        merge.mExit = network.AttachSegment(merge.mLeft, Direction::UP, name + "Exit", 10);
+        network.ConnectSegments(merge.mRight, Direction::UP, merge.mExit, Direction::DOWN);
+        merge.mDestination = network.AddTerminator(merge.mExit, Direction::UP, name + "End");
+        return merge;
+    }
+
+    // Whether a train travelling up from the given segment would cross on to the next
+    bool isRouted(RailNetwork& network, const ISegment* from, const ISegment* to) {
+        const RailTopology& topology = network.GetTopology();
+        return topology.Traverse(network.GetState(), MakeNode(topology.LookupSegment(from), Direction::UP)) == to;
+    }
+}
+
+TEST(DjikstraController, RoutesEveryTrainInOneUpdate) {
+    RailNetwork network(new ComponentFactory());
+    Merge first = buildMerge(network, "First", 10, 10);
+    Merge second = buildMerge(network, "Second", 10, 10);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    trains.push_back(pool.Acquire("T0", first.mRight, Direction::UP));
+    trains.push_back(pool.Acquire("T1", second.mRight, Direction::UP));
+    trains[0]->SetDestination(first.mDestination);
+    trains[1]->SetDestination(second.mDestination);
+
+    Traffic::DjikstraController controller;
+    EXPECT_TRUE(controller.UpdateRailNetwork(network, network.GetState(), trains));
+    EXPECT_TRUE(isRouted(network, first.mRight, first.mExit));
+    EXPECT_TRUE(isRouted(network, second.mRight, second.mExit));
+}
+
+TEST(DjikstraController, NearestTrainWinsContendedConnector) {
+    RailNetwork network(new ComponentFactory());
+    Merge merge = buildMerge(network, "Merge", 20, 5);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    trains.push_back(pool.Acquire("Far", merge.mLeft, Direction::UP));
+    trains.push_back(pool.Acquire("Near", merge.mRight, Direction::UP));
+    for(auto train : trains) {
+        train->SetDestination(merge.mDestination);
+    }
+
+    // The nearer train is switched for even though it is routed after the other
+    Traffic::DjikstraController controller;
+    EXPECT_FALSE(controller.UpdateRailNetwork(network, network.GetState(), trains));
+    EXPECT_TRUE(isRouted(network, merge.mRight, merge.mExit));
+}
+
+TEST(DjikstraController, FirstTrainWinsConnectorAtEqualDistance) {
+    RailNetwork network(new ComponentFactory());
+    Merge merge = buildMerge(network, "Merge", 10, 10);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    trains.push_back(pool.Acquire("Right", merge.mRight, Direction::UP));
+    trains.push_back(pool.Acquire("Left", merge.mLeft, Direction::UP));
+    for(auto train : trains) {
+        train->SetDestination(merge.mDestination);
+    }
+
+    Traffic::DjikstraController controller;
+    EXPECT_FALSE(controller.UpdateRailNetwork(network, network.GetState(), trains));
+    EXPECT_TRUE(isRouted(network, merge.mRight, merge.mExit));
+
+    // Once the first train has gone, the other has the connector to itself
+    trains.erase(trains.begin());
+    EXPECT_TRUE(controller.UpdateRailNetwork(network, network.GetState(), trains));
+    EXPECT_TRUE(isRouted(network, merge.mLeft, merge.mExit));
+}
+
+TEST(DjikstraController, RestoringPathsKeepsPendingInvalidations) {
+    RailNetwork network(new ComponentFactory());
+    Merge first = buildMerge(network, "First", 10, 10);
+    Merge second = buildMerge(network, "Second", 10, 10);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    trains.push_back(pool.Acquire("T0", first.mRight, Direction::UP));
+    trains.push_back(pool.Acquire("T1", second.mRight, Direction::UP));
+    trains[0]->SetDestination(first.mDestination);
+    trains[1]->SetDestination(second.mDestination);
+
+    Traffic::DjikstraController controller;
+    controller.UpdateRailNetwork(network, network.GetState(), trains);
+
+    Util::BinaryWriter writer;
+    controller.SaveState(writer, network, {{trains[1], 0}});
+
+    // A change along the first train's path, which the controller has not seen when the second's is restored
+    network.AddSignal(first.mExit, Direction::UP, SignalState::GREEN);
+
+    Util::BinaryReader reader(writer.GetData().data(), writer.GetData().size());
+    ASSERT_TRUE(controller.RestoreState(reader, network, {trains[1]}));
+    EXPECT_EQ(1u, controller.GetPathCacheStats().mInvalidations);
+
+    // Only the first train needs a new path
+    uint64_t queries = controller.GetRoutingStats().mQueries;
+    controller.UpdateRailNetwork(network, network.GetState(), trains);
+    EXPECT_EQ(queries + 1, controller.GetRoutingStats().mQueries);
+}
+
+TEST(DjikstraController, IncrementalRoutingSeesSignalsSetOnItsState) {
+    RailNetwork network(new ComponentFactory());
+    ISegment* start = network.CreateSegment("Start", 10);
+    ISegment* fast = network.AttachSegment(start, Direction::UP, "Fast", 10);
+    ISegment* slow = network.AttachSegment(start, Direction::UP, "Slow", 20);
+    ISegment* exit = network.AttachSegment(fast, Direction::UP, "Exit", 10);
+    network.ConnectSegments(slow, Direction::UP, exit, Direction::DOWN);
+    network.AddTerminator(start, Direction::DOWN, "Begin");
+    IConnector* end = network.AddTerminator(exit, Direction::UP, "End");
+    network.AddSignal(fast, Direction::UP, SignalState::GREEN);
+
+    // A state of its own, as each scenario run over a shared network has
+    const RailTopology& topology = network.GetTopology();
+    NetworkState state = network.GetState();
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    std::vector<Train::Train*> trains;
+    trains.push_back(pool.Acquire("T0", start, Direction::UP));
+    trains[0]->SetDestination(end);
+
+    Traffic::DjikstraController controller(Traffic::RoutingMode::INCREMENTAL);
+    EXPECT_TRUE(controller.UpdateRailNetwork(network, state, trains));
+    EXPECT_EQ(fast, topology.Traverse(state, MakeNode(topology.LookupSegment(start), Direction::UP)));
+
+    network.SetSignal(state, MakeNode(topology.LookupSegment(fast), Direction::UP), SignalState::RED);
+    EXPECT_TRUE(controller.UpdateRailNetwork(network, state, trains));
+    EXPECT_EQ(slow, topology.Traverse(state, MakeNode(topology.LookupSegment(start), Direction::UP)));
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "RailNetwork.h"
+#include "TrainPool.h"
+
+using namespace Rail;
+
+namespace {
+    // A junction at the up end of Approach, switched between the two other segments which meet there
+    struct Junction {
+        ISegment* mApproach;
+        ISegment* mLeft;
+        ISegment* mRight;
+    };
+
+    Junction buildSwitchedAway(RailNetwork& network) {
+        Junction junction;
+        junction.mApproach = network.CreateSegment("Approach", 5);
+        junction.mLeft = network.AttachSegment(junction.mApproach, Direction::UP, "Left", 5);
+        junction.mRight = network.CreateSegment("Right", 5);
+        network.ConnectSegments(junction.mApproach, Direction::UP, junction.mRight, Direction::DOWN);
+
+        network.AddTerminator(junction.mApproach, Direction::DOWN, "Start");
+        network.AddTerminator(junction.mLeft, Direction::UP, "LeftEnd");
+        network.AddTerminator(junction.mRight, Direction::UP, "RightEnd");
+
+        network.RouteSegment(junction.mLeft, junction.mRight);
+        return junction;
+    }
+}
+
+TEST(Train, CrashesCrossingUnswitchedConnector) {
+    RailNetwork network(new ComponentFactory());
+    Junction junction = buildSwitchedAway(network);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    Train::Train* train = pool.Acquire("T0", junction.mApproach, Direction::UP);
+
+    for(unsigned int tick = 0; tick < 20 && train->GetState() == Train::Train::State::RUNNING; tick++) {
+        train->Conduct(network.GetTopology(), network.GetState());
+    }
+
+    EXPECT_EQ(Train::Train::State::CRASHED, train->GetState());
+    EXPECT_EQ(junction.mApproach, train->GetCurrentComponent());
+}
+
+TEST(Train, CrashesCrossingUnswitchedConnectorWithoutTopology) {
+    RailNetwork network(new ComponentFactory());
+    Junction junction = buildSwitchedAway(network);
+
+    Train::TrainStore store;
+    Train::TrainPool pool(store);
+    Train::Train* train = pool.Acquire("T0", junction.mApproach, Direction::UP);
+
+    for(unsigned int tick = 0; tick < 20 && train->GetState() == Train::Train::State::RUNNING; tick++) {
+        train->Conduct();
+    }
+
+    EXPECT_EQ(Train::Train::State::CRASHED, train->GetState());
+    EXPECT_EQ(junction.mApproach, train->GetCurrentComponent());
+}
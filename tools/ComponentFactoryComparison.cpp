@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "RailNetwork.h"
+#include "Log.h"
+
+/**
+ *  Times building and tearing down a large network with each component factory
+ */
+
+struct Timings {
+    double mBuild;
+    double mTeardown;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Builds a line of segments, with a branch and a terminator every few segments
+static Timings buildAndTeardown(Rail::IComponentFactory* factory, unsigned int segmentCount) {
+    Timings timings;
+    auto start = std::chrono::steady_clock::now();
+
+    Rail::RailNetwork* network = new Rail::RailNetwork(factory);
+    Rail::ISegment* previous = network->CreateSegment("Seg0", 10);
+    for(unsigned int i = 1; i < segmentCount; i++) {
+        std::string name = "Seg" + std::to_string(i);
+        Rail::ISegment* segment = network->AttachSegment(previous, Rail::Direction::UP, name, 10);
+
+        if(i % 8 == 0) {
+            Rail::ISegment* branch = network->AttachSegment(previous, Rail::Direction::UP, name + "Branch", 10);
+            network->AddTerminator(branch, Rail::Direction::UP, name + "Term");
+        }
+
+        previous = segment;
+    }
+    network->GetTopology();
+    timings.mBuild = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    delete network;
+    timings.mTeardown = secondsSince(start);
+
+    return timings;
+}
+
+int main(int argc, char **argv) {
+    unsigned int segmentCount = (argc > 1) ? atoi(argv[1]) : 1000000;
+    unsigned int repeats = (argc > 2) ? atoi(argv[2]) : 3;
+
+    // Building the branches logs each connection made to an existing connector
+    Util::Log::SetLevel(Util::LogLevel::WARNING);
+
+    printf("Building networks of %u segments, best of %u\n", segmentCount, repeats);
+    printf("%-10s %12s %12s\n", "Factory", "Build (ms)", "Teardown (ms)");
+
+    for(int arena = 0; arena < 2; arena++) {
+        Timings best = {1e9, 1e9};
+        for(unsigned int r = 0; r < repeats; r++) {
+            Rail::IComponentFactory* factory = arena ? static_cast<Rail::IComponentFactory*>(new Rail::ArenaComponentFactory())
+                                                     : static_cast<Rail::IComponentFactory*>(new Rail::ComponentFactory());
+            Timings timings = buildAndTeardown(factory, segmentCount);
+            best.mBuild = std::min(best.mBuild, timings.mBuild);
+            best.mTeardown = std::min(best.mTeardown, timings.mTeardown);
+        }
+
+        printf("%-10s %12.1f %12.1f\n", arena ? "Arena" : "Heap", best.mBuild * 1000, best.mTeardown * 1000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+#include <cstdio>
+
+#include "EventLogger.h"
+
+/**
+ *  Prints the log messages recorded in a binary event log, see Util::EventLogger
+ */
+int main(int argc, char **argv) {
+    if(argc != 2) {
+        printf("Usage: %s <event log>\n", argv[0]);
+        return 1;
+    }
+
+    return Util::EventLogger::Decode(argv[1], stdout) ? 0 : 1;
+}
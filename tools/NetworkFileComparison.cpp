@@ -0,0 +1,113 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "RailNetwork.h"
+#include "Log.h"
+
+/**
+ *  Times building a large network through the building API against loading it from a network file
+ */
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Builds a line of segments, with a signalled branch and a terminator every few segments
+static void build(Rail::RailNetwork& network, unsigned int segmentCount) {
+    Rail::ISegment* previous = network.CreateSegment("Seg0", 10);
+    for(unsigned int i = 1; i < segmentCount; i++) {
+        std::string name = "Seg" + std::to_string(i);
+        Rail::ISegment* segment = network.AttachSegment(previous, Rail::Direction::UP, name, 10);
+
+        if(i % 8 == 0) {
+            Rail::ISegment* branch = network.AttachSegment(previous, Rail::Direction::UP, name + "Branch", 10);
+            network.AddSignal(branch, Rail::Direction::UP, Rail::SignalState::GREEN);
+            network.AddTerminator(branch, Rail::Direction::UP, name + "Term");
+        }
+
+        previous = segment;
+    }
+}
+
+// Check that a loaded network has the same topology and state as the network it was saved from
+static bool matches(const Rail::RailTopology& built, const Rail::RailTopology& loaded) {
+    if(built.GetSegmentCount() != loaded.GetSegmentCount() || built.GetConnectorCount() != loaded.GetConnectorCount()) {
+        return false;
+    }
+
+    for(Rail::NodeId n = 0; n < built.GetNodeCount(); n++) {
+        Rail::SegmentId s = Rail::NodeSegment(n);
+        Rail::Direction d = Rail::NodeDirection(n);
+        if(built.GetLength(s) != loaded.GetLength(s) || built.GetEnd(n) != loaded.GetEnd(n) ||
+                strcmp(built.GetSegment(s)->GetName(), loaded.GetSegment(s)->GetName()) != 0 ||
+                built.GetSegment(s)->GetSignalState(d) != loaded.GetSegment(s)->GetSignalState(d) ||
+                built.GetSuccessors(n).size() != loaded.GetSuccessors(n).size()) {
+            return false;
+        }
+    }
+
+    for(Rail::ConnectorId c = 0; c < built.GetConnectorCount(); c++) {
+        auto builtSelected = built.GetConnector(c)->GetSelected();
+        auto loadedSelected = loaded.GetConnector(c)->GetSelected();
+        if(built.LookupSegment(builtSelected.first) != loaded.LookupSegment(loadedSelected.first) ||
+                built.LookupSegment(builtSelected.second) != loaded.LookupSegment(loadedSelected.second)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    unsigned int segmentCount = (argc > 1) ? atoi(argv[1]) : 1000000;
+    unsigned int repeats = (argc > 2) ? atoi(argv[2]) : 3;
+    std::string path = (argc > 3) ? argv[3] : "NetworkFileComparison.tsnw";
+
+    // Building the branches logs each connection made to an existing connector
+    Util::Log::SetLevel(Util::LogLevel::WARNING);
+
+    printf("Building a network of %u segments, best of %u\n", segmentCount, repeats);
+
+    auto start = std::chrono::steady_clock::now();
+    Rail::RailNetwork* built = new Rail::RailNetwork(new Rail::ArenaComponentFactory());
+    build(*built, segmentCount);
+    built->GetTopology();
+    double buildTime = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    if(!built->Save(path)) {
+        return 1;
+    }
+    double saveTime = secondsSince(start);
+
+    double loadTime = 1e9;
+    for(unsigned int r = 0; r < repeats; r++) {
+        Rail::RailNetwork* loaded = new Rail::RailNetwork(new Rail::ArenaComponentFactory());
+
+        start = std::chrono::steady_clock::now();
+        if(!loaded->Load(path)) {
+            return 1;
+        }
+        loaded->GetTopology();
+        loadTime = std::min(loadTime, secondsSince(start));
+
+        if(r == 0 && !matches(built->GetTopology(), loaded->GetTopology())) {
+            printf("Loaded network does not match the network saved\n");
+            return 1;
+        }
+
+        delete loaded;
+    }
+
+    printf("%-10s %12s\n", "", "Time (ms)");
+    printf("%-10s %12.1f\n", "Build", buildTime * 1000);
+    printf("%-10s %12.1f\n", "Save", saveTime * 1000);
+    printf("%-10s %12.1f\n", "Load", loadTime * 1000);
+
+    delete built;
+    remove(path.c_str());
+    return 0;
+}
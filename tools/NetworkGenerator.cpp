@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "NetworkGenerator.h"
+#include "RailNetwork.h"
+#include "Log.h"
+
+/**
+ *  Generates a network and a workload of trains, and writes them as a text network file for the
+ *  simulator's --network option, and optionally as a network file of the network alone
+ */
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printUsage() {
+    printf("Usage: NetworkGenerator --output=<path> [options]\n"
+           "  --layout=<grid|corridor|hub|planar>          Default grid\n"
+           "  --segments=<count>                           Segments to aim for, default 1000\n"
+           "  --seed=<seed>                                Default 1\n"
+           "  --lengths=<constant|uniform|exponential>     Segment length distribution, default uniform\n"
+           "  --min-length=<length> --max-length=<length>  Default 5 and 50\n"
+           "  --junction-degree=<count>                    Most segments at a junction, default 4\n"
+           "  --signals=<share>                            Share of segment ends with a signal, default 0\n"
+           "  --red-signals=<share>                        Share of signals which are red, default 0\n"
+           "  --terminators=<count>                        Default depends on the layout\n"
+           "  --trains=<count>                             Default 0\n"
+           "  --conflict-free=<0|1>                        Only plan trains which never meet, default 0\n"
+           "  --network-file=<path>                        Also save the network, without its trains\n");
+}
+
+// Matches an option of the form --name=value, pointing value at its value
+static bool getOption(const char* argument, const char* name, const char*& value) {
+    size_t length = strlen(name);
+    if(strncmp(argument, name, length) != 0 || argument[length] != '=') {
+        return false;
+    }
+
+    value = argument + length + 1;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Rail::NetworkGenerator::Options options;
+    const char* outputPath = nullptr;
+    const char* networkFilePath = nullptr;
+
+    for(int i = 1; i < argc; i++) {
+        const char* value = nullptr;
+        if(getOption(argv[i], "--output", value)) {
+            outputPath = value;
+        } else if(getOption(argv[i], "--network-file", value)) {
+            networkFilePath = value;
+        } else if(getOption(argv[i], "--layout", value)) {
+            if(!Rail::NetworkGenerator::ParseLayout(value, options.mLayout)) {
+                printf("Unknown layout %s\n", value);
+                return 1;
+            }
+        } else if(getOption(argv[i], "--lengths", value)) {
+            if(!Rail::NetworkGenerator::ParseLengthDistribution(value, options.mLengthDistribution)) {
+                printf("Unknown length distribution %s\n", value);
+                return 1;
+            }
+        } else if(getOption(argv[i], "--segments", value)) {
+            options.mSegmentCount = strtoull(value, nullptr, 10);
+        } else if(getOption(argv[i], "--seed", value)) {
+            options.mSeed = strtoull(value, nullptr, 10);
+        } else if(getOption(argv[i], "--min-length", value)) {
+            options.mMinLength = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--max-length", value)) {
+            options.mMaxLength = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--junction-degree", value)) {
+            options.mJunctionDegree = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--signals", value)) {
+            options.mSignalDensity = strtod(value, nullptr);
+        } else if(getOption(argv[i], "--red-signals", value)) {
+            options.mRedSignalRatio = strtod(value, nullptr);
+        } else if(getOption(argv[i], "--terminators", value)) {
+            options.mTerminatorCount = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--trains", value)) {
+            options.mTrainCount = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--conflict-free", value)) {
+            options.mConflictFree = (strtoul(value, nullptr, 10) != 0);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if(outputPath == nullptr && networkFilePath == nullptr) {
+        printUsage();
+        return 1;
+    }
+
+    // Connecting each junction logs every segment joined to an existing connector
+    Util::Log::SetLevel(Util::LogLevel::WARNING);
+
+    auto start = std::chrono::steady_clock::now();
+    Rail::NetworkGenerator generator(options);
+    printf("Planned %zu segments, %zu terminators and %zu trains in %.1f ms\n", generator.GetSegmentCount(),
+           generator.GetTerminatorCount(), generator.GetTrainCount(), secondsSince(start) * 1000);
+
+    if(outputPath != nullptr) {
+        start = std::chrono::steady_clock::now();
+        if(!generator.Write(outputPath)) {
+            return 1;
+        }
+        printf("Wrote %s in %.1f ms\n", outputPath, secondsSince(start) * 1000);
+    }
+
+    if(networkFilePath != nullptr) {
+        start = std::chrono::steady_clock::now();
+        Rail::RailNetwork network(new Rail::ComponentFactory());
+        std::vector<Rail::TextNetworkLoader::TrainRecord> trains;
+        generator.Build(network, trains);
+        printf("Built the network in %.1f ms\n", secondsSince(start) * 1000);
+
+        if(!network.Save(networkFilePath)) {
+            return 1;
+        }
+        printf("Saved %s\n", networkFilePath);
+    }
+
+    return 0;
+}
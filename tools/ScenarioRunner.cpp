@@ -0,0 +1,198 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ScenarioRunner.h"
+#include "Log.h"
+
+/**
+ *  Runs random variants of a simulation on a network file, each with its own trains, departure times and
+ *  signal settings, and prints a table of their results
+ *
+ *  Each train starts on a random segment, heading for a random terminator it can reach, and departs at a
+ *  random tick within the departure window. Every signal of the network is set red or green at random.
+ *  The variants are drawn from the seed alone, so the same options give the same results.
+ */
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printUsage() {
+    printf("Usage: ScenarioRunner --network=<network file> [options]\n"
+           "  --scenarios=<count>          Default 100\n"
+           "  --trains=<count>             Trains per scenario, default 10\n"
+           "  --departures=<ticks>         Window trains depart within, default 0\n"
+           "  --red-signals=<share>        Share of signals set red, default 0\n"
+           "  --tick-limit=<tick>          Tick each scenario is stopped at, default 100000\n"
+           "  --seed=<seed>                Default 1\n"
+           "  --threads=<count>            Default 1\n");
+}
+
+// Matches an option of the form --name=value, pointing value at its value
+static bool getOption(const char* argument, const char* name, const char*& value) {
+    size_t length = strlen(name);
+    if(strncmp(argument, name, length) != 0 || argument[length] != '=') {
+        return false;
+    }
+
+    value = argument + length + 1;
+    return true;
+}
+
+// SplitMix64, for the same scenarios on every platform
+static uint64_t nextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t nextRandom(uint64_t& state, uint64_t bound) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(nextRandom(state)) * bound) >> 64);
+}
+
+static double nextUnit(uint64_t& state) {
+    return static_cast<double>(nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ *  Find the terminators a train can reach from a node, searching outwards from it
+ *
+ *  @param visited The search each node was last visited by, stamped with search
+ */
+static void findTerminators(const Rail::RailTopology& topology, Rail::NodeId start, uint32_t search,
+                            std::vector<uint32_t>& visited, std::vector<Rail::NodeId>& queue,
+                            std::vector<Rail::ConnectorId>& terminators) {
+    terminators.clear();
+    queue.assign(1, start);
+    visited[start] = search;
+
+    for(size_t i = 0; i < queue.size(); i++) {
+        Rail::NodeId node = queue[i];
+        Rail::ConnectorId end = topology.GetEnd(node);
+        if(end != Rail::INVALID_ID && topology.IsTerminator(end)) {
+            terminators.push_back(end);
+        }
+
+        for(auto successor : topology.GetSuccessors(node)) {
+            if(visited[successor] != search) {
+                visited[successor] = search;
+                queue.push_back(successor);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char* networkPath = nullptr;
+    unsigned int scenarioCount = 100;
+    unsigned int trainCount = 10;
+    uint64_t departureWindow = 0;
+    double redSignalRatio = 0.0;
+    uint64_t tickLimit = 100000;
+    uint64_t seed = 1;
+    unsigned int threadCount = 1;
+
+    for(int i = 1; i < argc; i++) {
+        const char* value = nullptr;
+        if(getOption(argv[i], "--network", value)) {
+            networkPath = value;
+        } else if(getOption(argv[i], "--scenarios", value)) {
+            scenarioCount = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--trains", value)) {
+            trainCount = strtoul(value, nullptr, 10);
+        } else if(getOption(argv[i], "--departures", value)) {
+            departureWindow = strtoull(value, nullptr, 10);
+        } else if(getOption(argv[i], "--red-signals", value)) {
+            redSignalRatio = strtod(value, nullptr);
+        } else if(getOption(argv[i], "--tick-limit", value)) {
+            tickLimit = strtoull(value, nullptr, 10);
+        } else if(getOption(argv[i], "--seed", value)) {
+            seed = strtoull(value, nullptr, 10);
+        } else if(getOption(argv[i], "--threads", value)) {
+            threadCount = strtoul(value, nullptr, 10);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if(networkPath == nullptr) {
+        printUsage();
+        return 1;
+    }
+
+    Util::Log::SetLevel(Util::LogLevel::WARNING);
+
+    auto start = std::chrono::steady_clock::now();
+    Train::ScenarioRunner runner(threadCount);
+    if(!runner.Load(networkPath)) {
+        return 1;
+    }
+    printf("Loaded %s on %u threads in %.1f ms\n", networkPath, threadCount, secondsSince(start) * 1000);
+
+    const Rail::RailTopology& topology = runner.GetTopology();
+    if(topology.GetSegmentCount() == 0) {
+        printf("The network has no segments\n");
+        return 1;
+    }
+
+    std::vector<Rail::NodeId> signals;
+    for(Rail::NodeId n = 0; n < topology.GetNodeCount(); n++) {
+        if(runner.GetState().GetSignal(n) != Rail::SignalState::DISABLED) {
+            signals.push_back(n);
+        }
+    }
+
+    // Draw the scenarios. A train which can reach no terminator from its segment tries another
+    uint64_t state = seed;
+    std::vector<uint32_t> visited(topology.GetNodeCount(), 0);
+    uint32_t search = 0;
+    std::vector<Rail::NodeId> queue;
+    std::vector<Rail::ConnectorId> terminators;
+
+    std::vector<Train::Scenario> scenarios(scenarioCount);
+    for(unsigned int s = 0; s < scenarioCount; s++) {
+        Train::Scenario& scenario = scenarios[s];
+        scenario.mName = "Scenario" + std::to_string(s);
+        scenario.mTickLimit = tickLimit;
+
+        for(unsigned int t = 0; t < trainCount; t++) {
+            const unsigned int ATTEMPTS = 16;
+            for(unsigned int attempt = 0; attempt < ATTEMPTS; attempt++) {
+                Rail::NodeId node = nextRandom(state, topology.GetNodeCount());
+                findTerminators(topology, node, ++search, visited, queue, terminators);
+                if(terminators.empty()) {
+                    continue;
+                }
+
+                Train::ScenarioTrain train;
+                train.mName = "Train" + std::to_string(t);
+                train.mStart = Rail::NodeSegment(node);
+                train.mDirection = Rail::NodeDirection(node);
+                train.mDestination = terminators[nextRandom(state, terminators.size())];
+                train.mDeparture = (departureWindow > 0) ? nextRandom(state, departureWindow) : 0;
+                scenario.mTrains.push_back(train);
+                break;
+            }
+        }
+
+        for(auto node : signals) {
+            bool red = nextUnit(state) < redSignalRatio;
+            scenario.mSignals.push_back(Train::ScenarioSignal {node, red ? Rail::SignalState::RED : Rail::SignalState::GREEN});
+        }
+    }
+
+    start = std::chrono::steady_clock::now();
+    std::vector<Train::ScenarioResult> results;
+    runner.Run(scenarios, results);
+    double seconds = secondsSince(start);
+
+    Train::ScenarioRunner::PrintResults(stdout, scenarios, results);
+    printf("Ran %u scenarios in %.1f ms\n", scenarioCount, seconds * 1000);
+    return 0;
+}